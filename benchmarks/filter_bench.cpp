@@ -0,0 +1,122 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+// Compare the bloom, blocked bloom and ribbon filter policies.
+// For each policy, it reports the filter size in bits per key, the false
+// positive rate, the construction time and the lookup latency of keys that
+// are present and absent.
+
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+
+#include "common/nova_common.h"
+#include "common/nova_config.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "leveldb/env.h"
+
+DEFINE_uint32(num_keys, 1000000, "Number of keys per filter.");
+DEFINE_uint32(num_filters, 16,
+              "Number of filters. Lookups go to random filters so that most of them miss the CPU cache.");
+DEFINE_uint32(bits_per_key, 10, "Bits per key of bloom filters.");
+DEFINE_uint64(num_lookups, 10000000, "Number of lookups.");
+DEFINE_string(filters, "bloom,blocked_bloom,ribbon", "Filter policies to compare.");
+
+namespace {
+    std::string Key(uint64_t i) {
+        std::string key;
+        leveldb::PutFixed64(&key, i * 0x9e3779b97f4a7c15ull);
+        return key;
+    }
+
+    const leveldb::FilterPolicy *NewPolicy(const std::string &name) {
+        if (name == "blocked_bloom") {
+            return leveldb::NewBlockedBloomFilterPolicy(FLAGS_bits_per_key);
+        } else if (name == "ribbon") {
+            return leveldb::NewRibbonFilterPolicy(FLAGS_bits_per_key);
+        }
+        return leveldb::NewBloomFilterPolicy(FLAGS_bits_per_key);
+    }
+
+    void Bench(const std::string &name) {
+        const leveldb::FilterPolicy *policy = NewPolicy(name);
+        std::vector<std::string> filters(FLAGS_num_filters);
+        uint64_t filter_bytes = 0;
+        uint64_t start = leveldb::Env::Default()->NowMicros();
+        for (uint32_t f = 0; f < FLAGS_num_filters; f++) {
+            std::vector<std::string> keys;
+            std::vector<leveldb::Slice> key_slices;
+            keys.reserve(FLAGS_num_keys);
+            for (uint64_t i = 0; i < FLAGS_num_keys; i++) {
+                keys.push_back(Key(f * FLAGS_num_keys + i));
+            }
+            for (const auto &key : keys) {
+                key_slices.push_back(key);
+            }
+            policy->CreateFilter(&key_slices[0], key_slices.size(), &filters[f]);
+            filter_bytes += filters[f].size();
+        }
+        uint64_t build_us = leveldb::Env::Default()->NowMicros() - start;
+        uint64_t total_keys = (uint64_t) FLAGS_num_keys * FLAGS_num_filters;
+
+        // Generate the lookup keys in advance so that the lookup latency
+        // excludes key generation.
+        const uint64_t num_probes = std::min<uint64_t>(FLAGS_num_lookups, 1000000);
+        std::vector<uint32_t> probe_filters(num_probes);
+        std::vector<std::string> present_keys(num_probes);
+        std::vector<std::string> absent_keys(num_probes);
+        unsigned int seed = 0;
+        for (uint64_t i = 0; i < num_probes; i++) {
+            uint32_t f = rand_r(&seed) % FLAGS_num_filters;
+            probe_filters[i] = f;
+            present_keys[i] = Key(f * FLAGS_num_keys + rand_r(&seed) % FLAGS_num_keys);
+            absent_keys[i] = Key(total_keys + i);
+        }
+
+        uint64_t found = 0;
+        start = leveldb::Env::Default()->NowMicros();
+        for (uint64_t i = 0; i < FLAGS_num_lookups; i++) {
+            uint64_t p = i % num_probes;
+            found += policy->KeyMayMatch(present_keys[p], filters[probe_filters[p]]);
+        }
+        uint64_t positive_us = leveldb::Env::Default()->NowMicros() - start;
+        NOVA_ASSERT(found == FLAGS_num_lookups) << "false negatives";
+
+        uint64_t false_positives = 0;
+        start = leveldb::Env::Default()->NowMicros();
+        for (uint64_t i = 0; i < FLAGS_num_lookups; i++) {
+            uint64_t p = i % num_probes;
+            false_positives += policy->KeyMayMatch(absent_keys[p], filters[probe_filters[p]]);
+        }
+        uint64_t negative_us = leveldb::Env::Default()->NowMicros() - start;
+
+        printf("%s\n", fmt::format(
+                "{},bits-per-key:{:.2f},fp-rate:{:.4f}%,build-ns-per-key:{:.1f},positive-lookup-ns:{:.1f},negative-lookup-ns:{:.1f}",
+                policy->Name(),
+                filter_bytes * 8.0 / total_keys,
+                false_positives * 100.0 / FLAGS_num_lookups,
+                build_us * 1000.0 / total_keys,
+                positive_us * 1000.0 / FLAGS_num_lookups,
+                negative_us * 1000.0 / FLAGS_num_lookups).c_str());
+        delete policy;
+    }
+}
+
+nova::NovaConfig *nova::NovaConfig::config;
+nova::NovaGlobalVariables nova::NovaGlobalVariables::global;
+
+int main(int argc, char *argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    std::vector<std::string> names = nova::SplitByDelimiter(&FLAGS_filters, ",");
+    for (const auto &name : names) {
+        Bench(name);
+    }
+    return 0;
+}
@@ -0,0 +1,201 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+// Measure the time to recover memtables from their log files. The log
+// files are in memory and a fetch is a memcpy that takes fetch_latency_us,
+// so the benchmark runs without RDMA. It compares fetching whole log files
+// and replaying them in one thread with fetching the used portion of each
+// log file in reads of read_kb and replaying on multiple threads.
+
+#include <gflags/gflags.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+
+#include "common/nova_common.h"
+#include "common/nova_config.h"
+#include "db/dbformat.h"
+#include "db/memtable.h"
+#include "db/version_set.h"
+#include "leveldb/comparator.h"
+#include "log/log_recovery.h"
+#include "ltc/storage_selector.h"
+#include "leveldb/env.h"
+
+DEFINE_uint32(num_memtables, 64, "Number of memtables to recover.");
+DEFINE_uint32(num_log_records, 20000, "Number of log records per memtable.");
+DEFINE_uint32(key_size, 16, "Key size.");
+DEFINE_uint32(value_size, 400, "Value size.");
+DEFINE_uint32(log_file_mb, 16, "Size of a log file buffer.");
+DEFINE_uint32(read_kb, 64, "Size of a read that fetches a log file.");
+DEFINE_uint32(fetch_latency_us, 0, "Latency of a read.");
+DEFINE_string(num_threads, "1,4,16", "Number of replay threads to compare.");
+
+namespace nova {
+    NovaConfig *NovaConfig::config;
+    NovaGlobalVariables NovaGlobalVariables::global;
+}
+std::atomic<nova::Servers *> leveldb::StorageSelector::available_stoc_servers;
+std::atomic_int_fast32_t leveldb::StorageSelector::stoc_for_compaction_seq_id;
+std::atomic_int_fast32_t leveldb::EnvBGThread::bg_flush_memtable_thread_id_seq;
+std::atomic_int_fast32_t leveldb::EnvBGThread::bg_compaction_thread_id_seq;
+std::unordered_map<uint64_t, leveldb::FileMetaData *> leveldb::Version::last_fnfile;
+
+namespace {
+    struct BenchResult {
+        uint64_t duration_us = 0;
+        uint64_t fetched_bytes = 0;
+        uint64_t log_records = 0;
+    };
+
+    void Fetch(char *dst, const char *src, uint64_t size) {
+        memcpy(dst, src, size);
+        if (FLAGS_fetch_latency_us > 0) {
+            usleep(FLAGS_fetch_latency_us);
+        }
+    }
+
+    std::vector<leveldb::MemTable *> NewMemTables(const leveldb::InternalKeyComparator &cmp) {
+        std::vector<leveldb::MemTable *> memtables;
+        for (uint32_t i = 0; i < FLAGS_num_memtables; i++) {
+            auto memtable = new leveldb::MemTable(cmp, i, nullptr, true);
+            memtable->Ref();
+            memtables.push_back(memtable);
+        }
+        return memtables;
+    }
+
+    void DeleteMemTables(const std::vector<leveldb::MemTable *> &memtables) {
+        for (auto memtable : memtables) {
+            memtable->Unref();
+        }
+    }
+
+    // Fetch whole log files and replay them in one thread.
+    BenchResult RecoverWholeLogFiles(const std::vector<char *> &log_files, uint64_t log_file_size,
+                                     const leveldb::InternalKeyComparator &cmp) {
+        BenchResult result = {};
+        std::vector<leveldb::MemTable *> memtables = NewMemTables(cmp);
+        char *buf = new char[log_file_size];
+        uint64_t start = leveldb::Env::Default()->NowMicros();
+        for (uint32_t i = 0; i < log_files.size(); i++) {
+            Fetch(buf, log_files[i], log_file_size);
+            result.fetched_bytes += log_file_size;
+            result.log_records += leveldb::LogRecovery::Replay(buf, log_file_size, memtables[i]);
+        }
+        result.duration_us = leveldb::Env::Default()->NowMicros() - start;
+        delete[] buf;
+        DeleteMemTables(memtables);
+        return result;
+    }
+
+    // Fetch the used portion of log files and replay them on num_threads
+    // threads while fetching the remaining log files.
+    BenchResult RecoverPipelined(const std::vector<char *> &log_files, uint64_t log_file_size,
+                                 uint32_t num_threads, const leveldb::InternalKeyComparator &cmp) {
+        BenchResult result = {};
+        std::vector<leveldb::MemTable *> memtables = NewMemTables(cmp);
+        uint64_t read_size = std::min((uint64_t) FLAGS_read_kb * 1024, log_file_size);
+        uint32_t window = 2 * num_threads;
+        std::vector<char *> free_bufs;
+        for (uint32_t i = 0; i < window; i++) {
+            free_bufs.push_back(new char[log_file_size]);
+        }
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::atomic_uint_fast64_t log_records;
+        log_records = 0;
+        uint64_t start = leveldb::Env::Default()->NowMicros();
+        {
+            leveldb::LogReplayPool replay_pool(num_threads);
+            for (uint32_t i = 0; i < log_files.size(); i++) {
+                char *buf = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&] { return !free_bufs.empty(); });
+                    buf = free_bufs.back();
+                    free_bufs.pop_back();
+                }
+                uint64_t fetched_size = 0;
+                uint64_t valid_size = 0;
+                do {
+                    uint64_t size = std::min(read_size, log_file_size - fetched_size);
+                    Fetch(buf + fetched_size, log_files[i] + fetched_size, size);
+                    fetched_size += size;
+                } while (leveldb::LogRecovery::HasMoreLogRecords(buf, fetched_size, log_file_size,
+                                                                 &valid_size));
+                result.fetched_bytes += fetched_size;
+                leveldb::MemTable *memtable = memtables[i];
+                replay_pool.Schedule([&, buf, valid_size, memtable]() {
+                    log_records += leveldb::LogRecovery::Replay(buf, valid_size, memtable);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        free_bufs.push_back(buf);
+                    }
+                    cv.notify_one();
+                });
+            }
+        }
+        result.duration_us = leveldb::Env::Default()->NowMicros() - start;
+        result.log_records = log_records;
+        for (auto buf : free_bufs) {
+            delete[] buf;
+        }
+        DeleteMemTables(memtables);
+        return result;
+    }
+
+    void Report(const std::string &name, const BenchResult &result) {
+        printf("%s\n", fmt::format("{},duration_ms:{:.1f},fetched_mb:{:.1f},log_records:{}", name,
+                                   result.duration_us / 1000.0,
+                                   result.fetched_bytes / 1024.0 / 1024.0,
+                                   result.log_records).c_str());
+    }
+}
+
+int main(int argc, char *argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    nova::NovaConfig::config = new nova::NovaConfig;
+    uint64_t log_file_size = (uint64_t) FLAGS_log_file_mb * 1024 * 1024;
+    leveldb::InternalKeyComparator cmp(leveldb::BytewiseComparator());
+
+    // Generate the log files in advance.
+    std::vector<char *> log_files;
+    uint64_t sequence_number = 1;
+    std::string value(FLAGS_value_size, 'v');
+    for (uint32_t i = 0; i < FLAGS_num_memtables; i++) {
+        char *log_file = new char[log_file_size];
+        memset(log_file, 0, log_file_size);
+        uint64_t size = 0;
+        for (uint32_t j = 0; j < FLAGS_num_log_records; j++) {
+            std::string key = fmt::format("{:0{}}", sequence_number, FLAGS_key_size);
+            leveldb::LevelDBLogRecord record = {};
+            record.sequence_number = sequence_number++;
+            record.key = key;
+            record.value = value;
+            if (size + nova::LogRecordSize(record) > log_file_size) {
+                break;
+            }
+            size += nova::EncodeLogRecord(log_file + size, record);
+        }
+        log_files.push_back(log_file);
+    }
+
+    Report("whole-sequential", RecoverWholeLogFiles(log_files, log_file_size, cmp));
+    for (auto num_threads : nova::SplitByDelimiterToInt(&FLAGS_num_threads, ",")) {
+        Report(fmt::format("pipelined-{}", num_threads),
+               RecoverPipelined(log_files, log_file_size, std::max(1u, (uint32_t) num_threads), cmp));
+    }
+    for (auto log_file : log_files) {
+        delete[] log_file;
+    }
+    return 0;
+}
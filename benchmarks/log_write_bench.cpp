@@ -0,0 +1,179 @@
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+// Measure the latency of logging a write. It compares the local disk log
+// (DiskLogWriter with group commit) with replicating log records to StoCs.
+// The StoC log buffers are in memory and an RDMA WRITE is a memcpy that
+// takes rdma_latency_us, so the benchmark runs without RDMA.
+
+#include <gflags/gflags.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fmt/core.h>
+
+#include "common/nova_common.h"
+#include "common/nova_config.h"
+#include "leveldb/env.h"
+#include "log/disk_log_writer.h"
+#include "ltc/storage_selector.h"
+
+DEFINE_uint32(num_writes, 10000, "Number of writes per thread.");
+DEFINE_uint32(key_size, 16, "Key size.");
+DEFINE_uint32(value_size, 400, "Value size.");
+DEFINE_uint32(num_replicas, 3, "Number of StoC replicas of a log record.");
+DEFINE_uint32(rdma_latency_us, 5, "Latency of an RDMA WRITE to a StoC.");
+DEFINE_string(local_log_path, "/tmp/log_write_bench", "Directory of the local disk log files.");
+DEFINE_string(local_log_io_engine, "threadpool", "Disk engine of the local disk log: io_uring/threadpool.");
+DEFINE_uint32(io_threads, 4, "Number of threads of the disk engine.");
+DEFINE_string(num_threads, "1,4,16", "Number of writer threads to compare.");
+
+namespace nova {
+    NovaConfig *NovaConfig::config;
+    NovaGlobalVariables NovaGlobalVariables::global;
+}
+std::atomic<nova::Servers *> leveldb::StorageSelector::available_stoc_servers;
+
+namespace {
+    struct BenchResult {
+        uint64_t duration_us = 0;
+        std::vector<uint64_t> latencies_us;
+    };
+
+    leveldb::LevelDBLogRecord NewLogRecord(uint64_t sequence_number, std::string *key,
+                                           const std::string &value) {
+        *key = fmt::format("{:0{}}", sequence_number, FLAGS_key_size);
+        leveldb::LevelDBLogRecord record = {};
+        record.sequence_number = sequence_number;
+        record.key = *key;
+        record.value = value;
+        return record;
+    }
+
+    // Run num_threads writers. Each writer logs num_writes records with
+    // log(thread_id, record).
+    template<typename LogFn>
+    BenchResult Run(uint32_t num_threads, LogFn log) {
+        BenchResult result = {};
+        std::vector<std::vector<uint64_t>> latencies(num_threads);
+        std::vector<std::thread> threads;
+        leveldb::Env *env = leveldb::Env::Default();
+        uint64_t start = env->NowMicros();
+        for (uint32_t t = 0; t < num_threads; t++) {
+            threads.emplace_back([&, t]() {
+                std::string key;
+                std::string value(FLAGS_value_size, 'v');
+                for (uint32_t i = 0; i < FLAGS_num_writes; i++) {
+                    leveldb::LevelDBLogRecord record = NewLogRecord(
+                            (uint64_t) t * FLAGS_num_writes + i + 1, &key, value);
+                    uint64_t write_start = env->NowMicros();
+                    log(t, record);
+                    latencies[t].push_back(env->NowMicros() - write_start);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        result.duration_us = env->NowMicros() - start;
+        for (auto &thread_latencies : latencies) {
+            result.latencies_us.insert(result.latencies_us.end(), thread_latencies.begin(),
+                                       thread_latencies.end());
+        }
+        return result;
+    }
+
+    leveldb::DiskLogWriter *NewDiskLogWriter() {
+        leveldb::StoCIOEngine *engine = leveldb::StoCIOEngine::NewEngine(
+                FLAGS_local_log_io_engine, FLAGS_io_threads, FLAGS_io_threads, nullptr, 0, []() {});
+        NOVA_ASSERT(engine) << FLAGS_local_log_io_engine;
+        return new leveldb::DiskLogWriter(FLAGS_local_log_path, 0, engine);
+    }
+
+    BenchResult RunLocalDisk(uint32_t num_threads) {
+        auto writer = NewDiskLogWriter();
+        writer->DeleteOldLogFiles();
+        // A memtable log holds at most max_stoc_file_size bytes.
+        uint64_t records_per_memtable = nova::NovaConfig::config->max_stoc_file_size /
+                                        (FLAGS_key_size + FLAGS_value_size + 64);
+        std::atomic_uint_fast64_t num_records;
+        num_records = 0;
+        BenchResult result = Run(num_threads, [&](uint32_t thread_id,
+                                                  const leveldb::LevelDBLogRecord &record) {
+            uint64_t n = num_records.fetch_add(1);
+            writer->AddRecords(n / records_per_memtable, {record});
+        });
+        // A writer keeps its log files for recovery.
+        delete writer;
+        writer = NewDiskLogWriter();
+        writer->DeleteOldLogFiles();
+        delete writer;
+        return result;
+    }
+
+    BenchResult RunRDMA(uint32_t num_threads) {
+        uint64_t log_buf_size = nova::NovaConfig::config->max_stoc_file_size;
+        // Each writer thread appends to its own log buffer at every replica.
+        std::vector<char *> log_bufs;
+        for (uint32_t i = 0; i < num_threads * FLAGS_num_replicas; i++) {
+            log_bufs.push_back((char *) malloc(log_buf_size));
+        }
+        std::vector<uint64_t> offsets(num_threads, 0);
+        BenchResult result = Run(num_threads, [&](uint32_t thread_id,
+                                                  const leveldb::LevelDBLogRecord &record) {
+            std::string buf;
+            buf.resize(nova::LogRecordSize(record));
+            uint32_t size = nova::EncodeLogRecord(&buf[0], record);
+            if (offsets[thread_id] + size > log_buf_size) {
+                offsets[thread_id] = 0;
+            }
+            // The WRITEs to the replicas are in flight in parallel.
+            for (uint32_t r = 0; r < FLAGS_num_replicas; r++) {
+                memcpy(log_bufs[thread_id * FLAGS_num_replicas + r] + offsets[thread_id], buf.data(), size);
+            }
+            offsets[thread_id] += size;
+            if (FLAGS_rdma_latency_us > 0) {
+                usleep(FLAGS_rdma_latency_us);
+            }
+        });
+        for (auto log_buf : log_bufs) {
+            free(log_buf);
+        }
+        return result;
+    }
+
+    void Report(const std::string &name, BenchResult result) {
+        std::sort(result.latencies_us.begin(), result.latencies_us.end());
+        uint64_t total = 0;
+        for (auto latency : result.latencies_us) {
+            total += latency;
+        }
+        uint64_t n = result.latencies_us.size();
+        printf("%s\n", fmt::format("{},duration_ms:{:.1f},writes:{},ops/s:{:.0f},avg_us:{:.1f},p50_us:{},p99_us:{}",
+                                   name, result.duration_us / 1000.0, n,
+                                   n * 1000000.0 / std::max((uint64_t) 1, result.duration_us),
+                                   (double) total / std::max((uint64_t) 1, n),
+                                   n ? result.latencies_us[n / 2] : 0,
+                                   n ? result.latencies_us[n * 99 / 100] : 0).c_str());
+    }
+}
+
+int main(int argc, char *argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    nova::NovaConfig::config = new nova::NovaConfig;
+    nova::NovaConfig::config->max_stoc_file_size = 16 * 1024 * 1024;
+
+    for (auto num_threads : nova::SplitByDelimiterToInt(&FLAGS_num_threads, ",")) {
+        uint32_t n = std::max(1u, (uint32_t) num_threads);
+        Report(fmt::format("rdma-{}", n), RunRDMA(n));
+        Report(fmt::format("local-disk-{}", n), RunLocalDisk(n));
+    }
+    return 0;
+}
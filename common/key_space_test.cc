@@ -0,0 +1,144 @@
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "common/nova_config.h"
+#include "leveldb/subrange.h"
+#include "util/testharness.h"
+
+namespace nova {
+
+    class KeySpaceTest {
+    public:
+        KeySpaceTest() {
+            if (!NovaConfig::config) {
+                NovaConfig::config = new NovaConfig;
+            }
+            NovaConfig::config->key_type = KeyType::KEY_TYPE_INT;
+        }
+
+        void UseByteKeys() {
+            NovaConfig::config->key_type = KeyType::KEY_TYPE_BYTES;
+        }
+    };
+
+    TEST(KeySpaceTest, IntCompare) {
+        ASSERT_LT(KeySpace::Compare("9", "10"), 0);
+        ASSERT_GT(KeySpace::Compare("100", "99"), 0);
+        ASSERT_EQ(KeySpace::Compare("42", "42"), 0);
+
+        RangePartition range;
+        range.SetBoundaries("10", "100");
+        ASSERT_EQ(range.int_key_start, 10);
+        ASSERT_EQ(range.int_key_end, 100);
+        ASSERT_LT(KeySpace::CompareStart("9", range), 0);
+        ASSERT_EQ(KeySpace::CompareStart("10", range), 0);
+        ASSERT_LT(KeySpace::CompareEnd("99", range), 0);
+        ASSERT_EQ(KeySpace::CompareEnd("100", range), 0);
+        ASSERT_GT(KeySpace::CompareEnd("1000", range), 0);
+    }
+
+    TEST(KeySpaceTest, BytesCompare) {
+        UseByteKeys();
+        // Bytewise, not by integer value.
+        ASSERT_GT(KeySpace::Compare("9", "10"), 0);
+        ASSERT_LT(KeySpace::Compare("a", "ab"), 0);
+        ASSERT_EQ(KeySpace::Compare("ab", "ab"), 0);
+
+        RangePartition range;
+        range.SetBoundaries("b", "d");
+        ASSERT_LT(KeySpace::CompareStart("a", range), 0);
+        ASSERT_EQ(KeySpace::CompareStart("b", range), 0);
+        ASSERT_LT(KeySpace::CompareEnd("cz", range), 0);
+        ASSERT_EQ(KeySpace::CompareEnd("d", range), 0);
+    }
+
+    TEST(KeySpaceTest, Successor) {
+        ASSERT_EQ(KeySpace::Successor("9"), "10");
+        ASSERT_EQ(KeySpace::NumKeys("10", "20"), 10);
+        ASSERT_EQ(KeySpace::NumKeys("20", "10"), 0);
+
+        UseByteKeys();
+        ASSERT_EQ(KeySpace::Successor("a"), std::string("a\0", 2));
+        ASSERT_EQ(KeySpace::NumKeys("a", std::string("a\0", 2)), 1);
+        ASSERT_EQ(KeySpace::NumKeys("a", "b"), UINT64_MAX);
+        ASSERT_EQ(KeySpace::NumKeys("b", "a"), 0);
+    }
+
+    TEST(KeySpaceTest, IntSplit) {
+        std::vector<std::string> boundaries = KeySpace::Split("0", "100", 4);
+        std::vector<std::string> expected = {"0", "25", "50", "75", "100"};
+        ASSERT_TRUE(boundaries == expected);
+
+        // Too few keys to split.
+        boundaries = KeySpace::Split("0", "3", 4);
+        expected = {"0", "3"};
+        ASSERT_TRUE(boundaries == expected);
+    }
+
+    TEST(KeySpaceTest, BytesSplit) {
+        UseByteKeys();
+        std::vector<std::string> boundaries = KeySpace::Split("a", "c", 2);
+        std::vector<std::string> expected = {"a", "b", "c"};
+        ASSERT_TRUE(boundaries == expected);
+
+        // Interpolate after the common prefix.
+        boundaries = KeySpace::Split("usera", "userc", 2);
+        expected = {"usera", "userb", "userc"};
+        ASSERT_TRUE(boundaries == expected);
+
+        for (int n = 1; n < 16; n++) {
+            boundaries = KeySpace::Split("key0001", "key9999", n);
+            ASSERT_EQ(boundaries.front(), "key0001");
+            ASSERT_EQ(boundaries.back(), "key9999");
+            for (int i = 1; i < boundaries.size(); i++) {
+                ASSERT_LT(KeySpace::Compare(boundaries[i - 1], boundaries[i]), 0);
+            }
+        }
+    }
+
+    TEST(KeySpaceTest, Boundary) {
+        ASSERT_EQ(KeySpace::EncodeBoundary("123"), "123");
+        ASSERT_EQ(KeySpace::DecodeBoundary("0123"), "123");
+
+        UseByteKeys();
+        std::string key("\x01\xff" "a", 3);
+        ASSERT_EQ(KeySpace::EncodeBoundary(key), "01ff61");
+        ASSERT_EQ(KeySpace::DecodeBoundary("01ff61"), key);
+        ASSERT_EQ(KeySpace::DecodeBoundary(KeySpace::EncodeBoundary("")), "");
+    }
+
+    TEST(KeySpaceTest, ParseKey) {
+        leveldb::Slice key;
+        const char *int_buf = "123!rest";
+        ASSERT_EQ(KeySpace::ParseKey(int_buf, &key), 4);
+        ASSERT_EQ(key.ToString(), "123");
+
+        UseByteKeys();
+        const char *bytes_buf = "3!a!crest";
+        ASSERT_EQ(KeySpace::ParseKey(bytes_buf, &key), 5);
+        ASSERT_EQ(key.ToString(), "a!c");
+    }
+
+    TEST(KeySpaceTest, RangeDebugString) {
+        leveldb::Range range;
+        range.lower = "1";
+        range.upper = "1";
+        range.lower_inclusive = false;
+        ASSERT_TRUE(range.DebugString().find("keys=0") != std::string::npos);
+        range.lower_inclusive = true;
+        range.upper_inclusive = true;
+        ASSERT_TRUE(range.DebugString().find("keys=1") != std::string::npos);
+
+        UseByteKeys();
+        range.lower = "a";
+        range.upper = "b";
+        ASSERT_TRUE(range.DebugString().find(fmt::format("keys={}", UINT64_MAX)) != std::string::npos);
+    }
+}
+
+nova::NovaConfig *nova::NovaConfig::config;
+nova::NovaGlobalVariables nova::NovaGlobalVariables::global;
+
+int main(int argc, char **argv) { return leveldb::test::RunAllTests(); }
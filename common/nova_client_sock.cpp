@@ -106,4 +106,23 @@ namespace nova {
         return size;
     }
 
+    int NovaClientSock::ReceiveResponse() {
+        int size = 0;
+        while (true) {
+            int ret = read(sockfd_, recv_buf_ + size, NovaConfig::config->max_msg_size - size - 1);
+            NOVA_ASSERT(ret > 0) << "read error:" << strerror(errno) << " " << sockfd_;
+            size += ret;
+            if (recv_buf_[size - 1] == MSG_TERMINATER_CHAR) {
+                break;
+            }
+        }
+        size -= 1;
+        recv_buf_[size] = 0;
+        return size;
+    }
+
+    void NovaClientSock::Close() {
+        close(sockfd_);
+    }
+
 }
\ No newline at end of file
@@ -21,6 +21,12 @@ namespace nova {
 
         int Receive();
 
+        // Receive a response terminated by MSG_TERMINATER_CHAR. Return its
+        // size without the terminator.
+        int ReceiveResponse();
+
+        void Close();
+
         char *send_buf() { return send_buf_; }
 
         char *recv_buf() { return recv_buf_; }
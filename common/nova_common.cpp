@@ -6,6 +6,7 @@
 
 #include <sys/stat.h>
 #include "nova_common.h"
+#include "nova_config.h"
 
 namespace nova {
     // random vector from http://home.comcast.net/~bretm/hash/10.html
@@ -208,11 +209,27 @@ namespace nova {
 
     LTCFragment::LTCFragment() : is_ready_(false),
                                  is_stoc_migrated_(false),
-                                 is_ready_signal_(&is_ready_mutex_), is_complete_(false) {
+                                 is_ready_signal_(&is_ready_mutex_), is_complete_(false),
+                                 live_migration_state_(LiveMigrationState::LIVE_MIGRATION_NONE),
+                                 live_migration_writes_(0) {
     }
 
     std::string LTCFragment::DebugString() {
-        return fmt::format("[{},{}): {}-{}", range.key_start, range.key_end, ltc_server_id, dbid);
+        return fmt::format("[{},{}): {}-{}", KeySpace::EncodeBoundary(range.key_start),
+                           KeySpace::EncodeBoundary(range.key_end), ltc_server_id, dbid);
+    }
+
+    void RangePartition::SetBoundaries(const std::string &start, const std::string &end) {
+        key_start = start;
+        key_end = end;
+        int_key_start = 0;
+        int_key_end = 0;
+        str_to_int(key_start.data(), &int_key_start, key_start.size());
+        str_to_int(key_end.data(), &int_key_end, key_end.size());
+    }
+
+    bool LTCFragment::IsRetired() const {
+        return range.key_start == range.key_end;
     }
 
     std::string
@@ -394,6 +411,9 @@ namespace nova {
     }
 
     uint64_t keyhash(const char *key, uint64_t nkey) {
+        if (NovaConfig::config && NovaConfig::config->key_type == KeyType::KEY_TYPE_BYTES) {
+            return CityHash64(key, nkey);
+        }
         uint64_t hv = 0;
         str_to_int(key, &hv, nkey);
         return hv;
@@ -36,6 +36,7 @@ namespace nova {
 #define RDMA_POLL_MAX_TIMEOUT_US 10
 #define LEVELDB_TABLE_PADDING_SIZE_MB 2
 #define MAX_BLOCK_SIZE 10240
+#define MAX_NUM_SERVERS 64
     using namespace std;
     using namespace rdmaio;
 
@@ -49,6 +50,23 @@ namespace nova {
             written_memtable_sizes = 0;
             total_disk_writes = 0;
             total_disk_reads = 0;
+            total_disk_syncs = 0;
+            stoc_live_bytes = 0;
+            stoc_dead_bytes = 0;
+            stoc_reclaimed_bytes = 0;
+            stoc_replicated_bytes = 0;
+            stoc_block_cache_hits = 0;
+            stoc_block_cache_misses = 0;
+            log_quorum_writes = 0;
+            log_quorum_saved_us = 0;
+            local_log_records = 0;
+            local_log_commits = 0;
+            local_log_commit_us = 0;
+            memory_write_delay_us = 0;
+            for (int i = 0; i < MAX_NUM_SERVERS; i++) {
+                log_replica_lagged_writes[i] = 0;
+                log_replica_lag_us[i] = 0;
+            }
             is_ready_to_process_requests = false;
         }
 
@@ -56,11 +74,39 @@ namespace nova {
         std::atomic_int_fast64_t stoc_pending_disk_writes;
         std::atomic_int_fast64_t stoc_pending_disk_reads;
         std::atomic_int_fast64_t stoc_queue_depth;
+        // Bytes of live fragments, deleted fragments that still occupy disk,
+        // and deleted fragments returned to the file system in StoC files.
+        std::atomic_int_fast64_t stoc_live_bytes;
+        std::atomic_int_fast64_t stoc_dead_bytes;
+        std::atomic_int_fast64_t stoc_reclaimed_bytes;
+        // Bytes copied to other StoCs to restore the replication factor.
+        std::atomic_int_fast64_t stoc_replicated_bytes;
+        std::atomic_int_fast64_t stoc_block_cache_hits;
+        std::atomic_int_fast64_t stoc_block_cache_misses;
+
+        // LTC stats
+        // Log records acknowledged by a write quorum before all replicas
+        // and the latency it saved.
+        std::atomic_int_fast64_t log_quorum_writes;
+        std::atomic_int_fast64_t log_quorum_saved_us;
+        // Log records each StoC acknowledged after the write quorum and its
+        // total lag behind the quorum.
+        std::atomic_int_fast64_t log_replica_lagged_writes[MAX_NUM_SERVERS];
+        std::atomic_int_fast64_t log_replica_lag_us[MAX_NUM_SERVERS];
+        // Log records written to local disk, group commits and their total
+        // duration.
+        std::atomic_int_fast64_t local_log_records;
+        std::atomic_int_fast64_t local_log_commits;
+        std::atomic_int_fast64_t local_log_commit_us;
+        // Delay of each write while the LTC uses more memory than its
+        // budget.
+        std::atomic_int_fast64_t memory_write_delay_us;
 
         std::atomic_int_fast64_t generated_memtable_sizes;
         std::atomic_int_fast64_t written_memtable_sizes;
         std::atomic_int_fast64_t total_disk_writes;
         std::atomic_int_fast64_t total_disk_reads;
+        std::atomic_int_fast64_t total_disk_syncs;
         std::atomic_bool is_ready_to_process_requests;
         static NovaGlobalVariables global;
     };
@@ -76,11 +122,30 @@ namespace nova {
         LOG_RDMA = 1,
         LOG_NIC = 2,
         LOG_NONE = 3,
+        LOG_LOCAL_DISK = 4,
+    };
+
+    enum LiveMigrationState {
+        LIVE_MIGRATION_NONE = 0,
+        // The source serves the range while the destination catches up.
+        LIVE_MIGRATION_DUAL_SERVING = 1,
+        // The source pauses writes to the range to take a snapshot.
+        LIVE_MIGRATION_SNAPSHOT = 2,
+        // The source stops writes to the range and sends the writes since
+        // the snapshot to the destination.
+        LIVE_MIGRATION_HANDOFF = 3,
     };
 
+    // Keys in [key_start, key_end) ordered by KeySpace.
     struct RangePartition {
-        uint64_t key_start;
-        uint64_t key_end;
+        std::string key_start;
+        std::string key_end;
+        // The integer values of the boundaries so that comparing integer
+        // keys with them does not parse them again.
+        uint64_t int_key_start = 0;
+        uint64_t int_key_end = 0;
+
+        void SetBoundaries(const std::string &start, const std::string &end);
     };
 
     struct LTCFragment {
@@ -88,6 +153,10 @@ namespace nova {
 
         std::string DebugString();
 
+        // A merge retires the fragments of the merged ranges. A retired
+        // fragment keeps its dbid and serves no keys.
+        bool IsRetired() const;
+
         // for range partition only.
         RangePartition range;
         uint32_t dbid;
@@ -100,8 +169,15 @@ namespace nova {
         std::atomic_bool is_ready_;
         leveldb::port::Mutex is_ready_mutex_;
         leveldb::port::CondVar is_ready_signal_;
+        // See LiveMigrationState. Changes are signaled with
+        // is_ready_signal_.
+        std::atomic_int live_migration_state_;
+        // Writes in progress. A live migration waits for them to complete
+        // before a snapshot and the handoff.
+        std::atomic_int_fast32_t live_migration_writes_;
     };
 
+    // The integer value of an integer key. A hash of a byte-string key.
     uint64_t keyhash(const char *key, uint64_t nkey);
 
     enum ConnState {
@@ -164,6 +240,9 @@ namespace nova {
         STATS = 's',
         CHANGE_CONFIG = 'b',
         QUERY_CONFIG_CHANGE = 'R',
+        LOAD_STATS = 'L',
+        ADD_CONFIG = 'A',
+        FETCH_CONFIG = 'F',
     };
 
     static RequestType char_to_req_type(char c) {
@@ -677,7 +756,8 @@ namespace nova {
         if (!leveldb::DecodeFixed64(buf, &log_record->sequence_number)) {
             return false;
         }
-        if ((*buf)[0] != 1) {
+        // The last byte may lie beyond the valid bytes of buf.
+        if (buf->empty() || (*buf)[0] != 1) {
             return false;
         }
         if (record_size != LogRecordSize(*log_record)) {
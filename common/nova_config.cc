@@ -6,6 +6,8 @@
 
 #include "nova_config.h"
 
+#include <algorithm>
+
 namespace nova {
     uint64_t nrdma_buf_unit() {
         return (NovaConfig::config->rdma_max_num_sends * 2) *
@@ -36,8 +38,8 @@ namespace nova {
                                         cfg_id, start_time_in_seconds, fragments.size(), ltcs, stocs);
         for (int i = 0; i < fragments.size(); i++) {
             debug += fmt::format("frag[{}]: {}-{}-{}-{}-{}\n", i,
-                                 fragments[i]->range.key_start,
-                                 fragments[i]->range.key_end,
+                                 KeySpace::EncodeBoundary(fragments[i]->range.key_start),
+                                 KeySpace::EncodeBoundary(fragments[i]->range.key_end),
                                  fragments[i]->ltc_server_id,
                                  fragments[i]->dbid,
                                  ToString(fragments[i]->log_replica_stoc_ids));
@@ -45,6 +47,53 @@ namespace nova {
         return debug;
     }
 
+    void Configuration::SortFragments() {
+        sorted_fragments.clear();
+        for (auto frag : fragments) {
+            if (!frag->IsRetired()) {
+                sorted_fragments.push_back(frag);
+            }
+        }
+        std::sort(sorted_fragments.begin(), sorted_fragments.end(), [](LTCFragment *a, LTCFragment *b) {
+            return KeySpace::Compare(a->range.key_start, b->range.key_start) < 0;
+        });
+    }
+
+    std::string Configuration::Encode() {
+        std::string buf = fmt::format("{};{};{};{}", cfg_id, ToString(ltc_servers), ToString(stoc_servers),
+                                      start_time_in_seconds);
+        for (auto frag : fragments) {
+            buf += fmt::format(";{},{},{},{}", KeySpace::EncodeBoundary(frag->range.key_start),
+                               KeySpace::EncodeBoundary(frag->range.key_end), frag->ltc_server_id, frag->dbid);
+            for (auto stoc_id : frag->log_replica_stoc_ids) {
+                buf += fmt::format(",{}", stoc_id);
+            }
+        }
+        return buf;
+    }
+
+    Configuration *Configuration::Decode(const std::string &buf) {
+        std::string line = buf;
+        std::vector<std::string> tokens = SplitByDelimiter(&line, ";");
+        NOVA_ASSERT(tokens.size() >= 4) << buf;
+        auto cfg = new Configuration;
+        cfg->cfg_id = std::stoi(tokens[0]);
+        cfg->ltc_servers = SplitByDelimiterToInt(&tokens[1], ",");
+        cfg->stoc_servers = SplitByDelimiterToInt(&tokens[2], ",");
+        cfg->start_time_in_seconds = std::stoll(tokens[3]);
+        for (auto id : cfg->ltc_servers) {
+            cfg->ltc_server_ids.insert(id);
+        }
+        for (auto id : cfg->stoc_servers) {
+            cfg->stoc_server_ids.insert(id);
+        }
+        for (int i = 4; i < tokens.size(); i++) {
+            cfg->fragments.push_back(NovaConfig::ParseFragment(&tokens[i]));
+        }
+        cfg->SortFragments();
+        return cfg;
+    }
+
     bool Configuration::IsLTC() {
         return ltc_server_ids.find(NovaConfig::config->my_server_id) != ltc_server_ids.end();
     }
@@ -52,4 +101,153 @@ namespace nova {
     bool Configuration::IsStoC() {
         return stoc_server_ids.find(NovaConfig::config->my_server_id) != stoc_server_ids.end();
     }
+
+    namespace {
+        // Keys are integers without a configuration, e.g., in unit tests.
+        bool IsIntKey() {
+            return !NovaConfig::config || NovaConfig::config->key_type == KeyType::KEY_TYPE_INT;
+        }
+
+        uint64_t ToInt(const leveldb::Slice &key) {
+            uint64_t x = 0;
+            str_to_int(key.data(), &x, key.size());
+            return x;
+        }
+
+        int CompareInt(uint64_t a, uint64_t b) {
+            if (a < b) {
+                return -1;
+            } else if (a > b) {
+                return 1;
+            }
+            return 0;
+        }
+
+        // The 8 bytes of key after its first offset bytes as a big-endian
+        // integer. Missing bytes are 0.
+        uint64_t BigEndianAt(const std::string &key, uint32_t offset) {
+            uint64_t x = 0;
+            for (uint32_t i = 0; i < 8; i++) {
+                x <<= 8;
+                if (offset + i < key.size()) {
+                    x |= (uint8_t) key[offset + i];
+                }
+            }
+            return x;
+        }
+    }
+
+    int KeySpace::Compare(const leveldb::Slice &a, const leveldb::Slice &b) {
+        if (!IsIntKey()) {
+            return a.compare(b);
+        }
+        return CompareInt(ToInt(a), ToInt(b));
+    }
+
+    int KeySpace::CompareStart(const leveldb::Slice &key, const RangePartition &range) {
+        if (!IsIntKey()) {
+            return key.compare(range.key_start);
+        }
+        return CompareInt(ToInt(key), range.int_key_start);
+    }
+
+    int KeySpace::CompareEnd(const leveldb::Slice &key, const RangePartition &range) {
+        if (!IsIntKey()) {
+            return key.compare(range.key_end);
+        }
+        return CompareInt(ToInt(key), range.int_key_end);
+    }
+
+    std::string KeySpace::Successor(const leveldb::Slice &key) {
+        if (!IsIntKey()) {
+            std::string successor = key.ToString();
+            successor.push_back('\0');
+            return successor;
+        }
+        return std::to_string(ToInt(key) + 1);
+    }
+
+    uint64_t KeySpace::NumKeys(const std::string &lower, const std::string &upper) {
+        if (Compare(lower, upper) >= 0) {
+            return 0;
+        }
+        if (IsIntKey()) {
+            return ToInt(upper) - ToInt(lower);
+        }
+        if (Compare(Successor(lower), upper) == 0) {
+            return 1;
+        }
+        return UINT64_MAX;
+    }
+
+    std::vector<std::string>
+    KeySpace::Split(const std::string &lower, const std::string &upper, uint32_t n) {
+        std::vector<std::string> boundaries;
+        boundaries.push_back(lower);
+        if (IsIntKey()) {
+            uint64_t l = ToInt(lower);
+            uint64_t width = (ToInt(upper) - l) / n;
+            for (uint32_t i = 1; i < n && width > 0; i++) {
+                boundaries.push_back(std::to_string(l + width * i));
+            }
+            boundaries.push_back(upper);
+            return boundaries;
+        }
+        uint32_t prefix = 0;
+        while (prefix < lower.size() && prefix < upper.size() && lower[prefix] == upper[prefix]) {
+            prefix++;
+        }
+        uint64_t l = BigEndianAt(lower, prefix);
+        uint64_t u = BigEndianAt(upper, prefix);
+        uint64_t width = u > l ? (u - l) / n : 0;
+        for (uint32_t i = 1; i < n && width > 0; i++) {
+            uint64_t x = l + width * i;
+            std::string boundary = upper.substr(0, prefix);
+            for (int shift = 56; shift >= 0 && x != 0; shift -= 8) {
+                boundary.push_back((char) ((x >> shift) & 0xff));
+                x &= (1ull << shift) - 1;
+            }
+            boundaries.push_back(std::move(boundary));
+        }
+        boundaries.push_back(upper);
+        return boundaries;
+    }
+
+    std::string KeySpace::EncodeBoundary(const std::string &key) {
+        if (IsIntKey()) {
+            return key;
+        }
+        static const char *hex = "0123456789abcdef";
+        std::string encoded;
+        for (char c : key) {
+            encoded.push_back(hex[(uint8_t) c >> 4]);
+            encoded.push_back(hex[(uint8_t) c & 0xf]);
+        }
+        return encoded;
+    }
+
+    std::string KeySpace::DecodeBoundary(const std::string &token) {
+        if (IsIntKey()) {
+            return std::to_string(std::stoull(token));
+        }
+        NOVA_ASSERT(token.size() % 2 == 0) << token;
+        std::string key;
+        for (int i = 0; i < token.size(); i += 2) {
+            key.push_back((char) std::stoi(token.substr(i, 2), nullptr, 16));
+        }
+        return key;
+    }
+
+    uint32_t KeySpace::ParseKey(const char *buf, leveldb::Slice *key) {
+        if (IsIntKey()) {
+            uint64_t int_key = 0;
+            uint32_t nkey = str_to_int(buf, &int_key) - 1;
+            *key = leveldb::Slice(buf, nkey);
+            return nkey + 1;
+        }
+        uint64_t nkey = 0;
+        uint32_t len = str_to_int(buf, &nkey);
+        *key = leveldb::Slice(buf + len, nkey);
+        return len + nkey;
+    }
 }
\ No newline at end of file
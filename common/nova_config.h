@@ -19,6 +19,9 @@
 #include "rdma/rdma_ctrl.hpp"
 #include "nova_common.h"
 
+// Configurations are added at runtime without moving the existing ones.
+#define MAX_NUM_CONFIGURATIONS 1024
+
 namespace nova {
     using namespace std;
     using namespace rdmaio;
@@ -33,7 +36,10 @@ namespace nova {
 
     enum LTCMigrationPolicy {
         PROCESS_UNTIL_MIGRATION_COMPLETE,
-        IMMEDIATE
+        IMMEDIATE,
+        // The source serves a migrating range until the destination catches
+        // up and takes over.
+        LIVE
     };
 
     struct ZipfianDist {
@@ -41,9 +47,62 @@ namespace nova {
         std::vector<uint64_t> accesses;
     };
 
+    enum KeyType {
+        // Decimal strings ordered by their integer values.
+        KEY_TYPE_INT,
+        // Byte strings ordered bytewise.
+        KEY_TYPE_BYTES
+    };
+
+    // Orders the keys of the configured key type. Ranges, subranges and
+    // tiny ranges are [lower, upper) with boundaries in this order.
+    class KeySpace {
+    public:
+        struct Less {
+            bool operator()(const std::string &a, const std::string &b) const {
+                return Compare(a, b) < 0;
+            }
+        };
+
+        static int Compare(const leveldb::Slice &a, const leveldb::Slice &b);
+
+        // Compare key with range.key_start and range.key_end using their
+        // cached integer values.
+        static int CompareStart(const leveldb::Slice &key, const RangePartition &range);
+
+        static int CompareEnd(const leveldb::Slice &key, const RangePartition &range);
+
+        // The smallest key that is greater than key.
+        static std::string Successor(const leveldb::Slice &key);
+
+        // The number of keys in [lower, upper). It is UINT64_MAX for a
+        // byte-string range with more than one key.
+        static uint64_t NumKeys(const std::string &lower, const std::string &upper);
+
+        // Split [lower, upper) into at most n ranges of about equal width.
+        // Return their boundaries including lower and upper. Byte strings
+        // are interpolated on the 8 bytes after their common prefix.
+        static std::vector<std::string> Split(const std::string &lower, const std::string &upper, uint32_t n);
+
+        // Boundaries in the configuration are hex encoded for byte-string
+        // keys.
+        static std::string EncodeBoundary(const std::string &key);
+
+        static std::string DecodeBoundary(const std::string &token);
+
+        // Parse the key at the start of a client request into *key. An
+        // integer key is terminated by TERMINATER_CHAR. A byte-string key
+        // is prefixed with its size terminated by TERMINATER_CHAR. Return
+        // the number of parsed bytes.
+        static uint32_t ParseKey(const char *buf, leveldb::Slice *key);
+    };
+
     struct Configuration {
         uint32_t cfg_id = 0;
+        // Indexed by dbid. A split appends the fragment of the new range.
         std::vector<LTCFragment *> fragments;
+        // Fragments that are not retired sorted by their ranges.
+        std::vector<LTCFragment *> sorted_fragments;
         uint64_t start_time_in_seconds = 0;
         uint64_t start_time_us_ = 0;
 
@@ -58,6 +117,53 @@ namespace nova {
         bool IsStoC();
 
         std::string DebugString();
+
+        void SortFragments();
+
+        // Encode the configuration in one line. Fragments are separated by
+        // ';' and use the format of the configuration file.
+        std::string Encode();
+
+        static Configuration *Decode(const std::string &buf);
+    };
+
+    // Configurations indexed by their ids. Slots never move and an appended
+    // configuration is published by a release store of the size, so readers
+    // access it without a lock. Appends are serialized by NovaConfig::m.
+    class ConfigurationList {
+    public:
+        ConfigurationList() : size_(0) {}
+
+        uint32_t size() const {
+            return size_.load(std::memory_order_acquire);
+        }
+
+        uint32_t capacity() const {
+            return MAX_NUM_CONFIGURATIONS;
+        }
+
+        Configuration *operator[](uint32_t cfg_id) const {
+            return cfgs_[cfg_id];
+        }
+
+        void push_back(Configuration *cfg) {
+            uint32_t size = size_.load(std::memory_order_relaxed);
+            NOVA_ASSERT(size < MAX_NUM_CONFIGURATIONS) << size;
+            cfgs_[size] = cfg;
+            size_.store(size + 1, std::memory_order_release);
+        }
+
+        Configuration *const *begin() const {
+            return cfgs_;
+        }
+
+        Configuration *const *end() const {
+            return cfgs_ + size();
+        }
+
+    private:
+        Configuration *cfgs_[MAX_NUM_CONFIGURATIONS] = {};
+        std::atomic_uint_fast32_t size_;
     };
 
     class NovaConfig {
@@ -119,44 +225,70 @@ namespace nova {
                     continue;
                 }
                 NOVA_LOG(INFO) << fmt::format("Read config line: {}", line);
-                auto *frag = new LTCFragment();
-                std::vector<std::string> tokens = SplitByDelimiter(&line, ",");
-                frag->range.key_start = std::stoll(tokens[0]);
-                frag->range.key_end = std::stoll(tokens[1]);
-                frag->ltc_server_id = std::stoll(tokens[2]);
-                frag->dbid = std::stoi(tokens[3]);
+                auto *frag = ParseFragment(&line);
                 if (cfg->cfg_id == 0) {
                     frag->is_ready_ = true;
                     frag->is_complete_ = true;
                 }
-                int nreplicas = (tokens.size() - 4);
-                for (int i = 0; i < nreplicas; i++) {
-                    frag->log_replica_stoc_ids.push_back(
-                            std::stoi(tokens[i + 4]));
-                }
 //                NOVA_LOG(rdmaio::INFO) << fmt::format("{}", frag->DebugString());
                 cfg->fragments.push_back(frag);
             }
+            for (auto c : config->cfgs) {
+                c->SortFragments();
+                config->max_num_ranges = std::max(config->max_num_ranges, (uint32_t) c->fragments.size());
+            }
+        }
+
+        // Parse a fragment line of the configuration file.
+        static LTCFragment *ParseFragment(std::string *line) {
+            auto *frag = new LTCFragment();
+            std::vector<std::string> tokens = SplitByDelimiter(line, ",");
+            frag->range.SetBoundaries(KeySpace::DecodeBoundary(tokens[0]), KeySpace::DecodeBoundary(tokens[1]));
+            frag->ltc_server_id = std::stoll(tokens[2]);
+            frag->dbid = std::stoi(tokens[3]);
+            int nreplicas = (tokens.size() - 4);
+            for (int i = 0; i < nreplicas; i++) {
+                frag->log_replica_stoc_ids.push_back(
+                        std::stoi(tokens[i + 4]));
+            }
+            return frag;
+        }
+
+        // Append a configuration created at runtime. Return false if the
+        // configuration exists.
+        static bool AddConfiguration(Configuration *cfg) {
+            std::lock_guard<std::mutex> l(config->m);
+            if (cfg->cfg_id < config->cfgs.size()) {
+                return false;
+            }
+            NOVA_ASSERT(cfg->cfg_id == config->cfgs.size()) << cfg->cfg_id;
+            NOVA_ASSERT(config->cfgs.size() < config->cfgs.capacity());
+            NOVA_ASSERT(cfg->fragments.size() <= config->max_num_ranges)
+                << fmt::format("{} ranges exceed the maximum {}", cfg->fragments.size(), config->max_num_ranges);
+            config->cfgs.push_back(cfg);
+            return true;
         }
 
         static LTCFragment *
-        home_fragment(uint64_t key, uint32_t server_cfg_id) {
+        home_fragment(const leveldb::Slice &key, uint32_t server_cfg_id) {
             LTCFragment *home = nullptr;
             Configuration *cfg = config->cfgs[server_cfg_id];
+            const std::vector<LTCFragment *> &frags = cfg->sorted_fragments;
             NOVA_ASSERT(
-                    key <= cfg->fragments[cfg->fragments.size() - 1]->range.key_end);
-            uint32_t l = 0;
-            uint32_t r = cfg->fragments.size() - 1;
+                    KeySpace::CompareEnd(key, frags[frags.size() - 1]->range) <= 0);
+            int l = 0;
+            int r = frags.size() - 1;
 
             while (l <= r) {
-                uint32_t m = l + (r - l) / 2;
-                home = cfg->fragments[m];
+                int m = l + (r - l) / 2;
+                home = frags[m];
                 // Check if x is present at mid
-                if (key >= home->range.key_start && key < home->range.key_end) {
+                int end = KeySpace::CompareEnd(key, home->range);
+                if (KeySpace::CompareStart(key, home->range) >= 0 && end < 0) {
                     return home;
                 }
                 // If x greater, ignore left half
-                if (key >= home->range.key_end)
+                if (end >= 0)
                     l = m + 1;
                     // If x is smaller, ignore right half
                 else
@@ -165,6 +297,7 @@ namespace nova {
             return nullptr;
         }
 
+        KeyType key_type = KeyType::KEY_TYPE_INT;
         bool enable_load_data = false;
         bool enable_rdma = false;
         bool use_ordered_flush = false;
@@ -197,6 +330,7 @@ namespace nova {
 
         uint64_t mem_pool_size_gb = 0;
         uint32_t num_mem_partitions = 0;
+        uint32_t mem_rebalance_interval_sec = 0;
         char *nova_buf = nullptr;
         uint64_t nnovabuf = 0;
 
@@ -204,12 +338,16 @@ namespace nova {
         NovaLogRecordMode log_record_mode = NovaLogRecordMode::LOG_NONE;
         bool recover_dbs = false;
         uint32_t number_of_recovery_threads = 0;
+        uint64_t log_recovery_read_size = 0;
         uint32_t number_of_sstable_metadata_replicas = 0;
         uint32_t number_of_sstable_data_replicas = 0;
         uint32_t number_of_manifest_replicas = 0;
         bool use_parity_for_sstable_data_blocks = false;
 
         double subrange_sampling_ratio = 0;
+        // Number of keys per level of the key sketch of each subrange. 0
+        // samples memtables for subrange reorganization.
+        uint32_t subrange_sketch_size = 0;
         std::string zipfian_dist_file_path;
         ZipfianDist zipfian_dist;
         std::string client_access_pattern;
@@ -225,18 +363,76 @@ namespace nova {
         int level = 0;
 
         int block_cache_mb = 0;
+        uint64_t stoc_block_cache_mb = 0;
         bool enable_lookup_index = false;
         bool enable_range_index = false;
         uint32_t num_memtables = 0;
         uint32_t num_memtable_partitions = 0;
         uint64_t memtable_size_mb = 0;
+        uint64_t memtable_arena_pool_mb = 0;
+        uint64_t ltc_memory_budget_mb = 0;
         uint64_t l0_stop_write_mb = 0;
         uint64_t l0_start_compaction_mb = 0;
+        uint64_t l0_slowdown_write_mb = 0;
+        uint64_t pending_compaction_slowdown_write_mb = 0;
+        uint64_t pending_compaction_stop_write_mb = 0;
+        uint32_t num_imms_slowdown_write = 0;
+        uint64_t delayed_write_rate_mb = 0;
+
+        bool enable_compaction_scheduler = false;
+        double compaction_scheduler_urgent_stall_risk = 0;
+        std::vector<uint32_t> compaction_scheduler_weights;
+
+        std::vector<std::string> compaction_styles;
+        uint32_t tiered_max_sorted_runs = 0;
+        uint32_t tiered_size_ratio = 0;
+        uint32_t tiered_min_merge_width = 0;
+        bool enable_dynamic_level_bytes = false;
+        uint32_t bloom_bits_per_key = 0;
+        std::string filter_type;
+        bool enable_whole_table_filter = false;
+        bool enable_monkey_bloom_filter = false;
+
+        std::string stoc_io_engine;
+        uint32_t stoc_io_queue_depth = 0;
+        uint32_t stoc_io_threads = 0;
+        bool stoc_io_direct = false;
+        uint32_t stoc_group_commit_window_us = 0;
+        uint32_t stoc_replication_window_mb = 0;
+        uint32_t stoc_replication_rate_mb = 0;
+        uint32_t stoc_qos_max_outstanding = 0;
+        uint32_t log_buf_pool_size = 0;
+        uint32_t log_write_quorum = 0;
+        std::string local_log_path;
+        std::string local_log_io_engine;
+        std::vector<uint32_t> stoc_qos_weights;
+        std::vector<uint64_t> stoc_qos_rate_limits;
 
         int num_stocs_scatter_data_blocks = 0;
         int num_migration_threads = 0;
 
         LTCMigrationPolicy ltc_migration_policy = LTCMigrationPolicy::IMMEDIATE;
+        // Maximum number of hot data blocks of a range that the destination
+        // of a migration prefetches. 0 disables warming the caches.
+        uint32_t ltc_migration_warm_blocks = 0;
+        // Interval of the range rebalancer on the first LTC. 0 disables it.
+        uint32_t ltc_rebalance_interval_sec = 0;
+        // Maximum number of ranges moved by one configuration change.
+        uint32_t ltc_rebalance_max_moves = 0;
+        // Rebalance when the most loaded LTC exceeds the average load by
+        // this ratio.
+        double ltc_rebalance_imbalance = 0;
+        // Maximum number of ranges including the ones created by splits.
+        uint32_t max_num_ranges = 0;
+        // Interval of the StoC rebalancer on each LTC. 0 disables it.
+        uint32_t ltc_stoc_rebalance_interval_sec = 0;
+        // Maximum size of the SSTable replicas moved in one interval.
+        uint64_t ltc_stoc_rebalance_max_mb = 0;
+        // Move replicas away from a StoC that stores more than the average
+        // bytes by this ratio.
+        double ltc_stoc_rebalance_imbalance = 0;
+        // Rate of moving SSTable replicas. 0 does not limit the rate.
+        uint64_t ltc_stoc_rebalance_rate_mb = 0;
 
         void ReadZipfianDist() {
             if (zipfian_dist_file_path.empty()) {
@@ -273,7 +469,7 @@ namespace nova {
             }
         }
 
-        std::vector<Configuration *> cfgs;
+        ConfigurationList cfgs;
         std::atomic_uint_fast32_t current_cfg_id;
         std::mutex m;
         std::map<std::thread::id, pid_t> threads;
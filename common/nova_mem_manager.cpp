@@ -5,13 +5,60 @@
 //
 
 #include <fmt/core.h>
+#include <unistd.h>
+#include <algorithm>
+#include <unordered_set>
 
 #include "nova_mem_manager.h"
 #include "nova_common.h"
 
 namespace nova {
+    namespace {
+        // The magazines of a thread indexed by the id of a partition. They
+        // return their items once the thread exits.
+        class ThreadMagazines {
+        public:
+            ~ThreadMagazines() {
+                for (int i = 0; i < magazines_.size(); i++) {
+                    if (magazines_[i]) {
+                        managers_[i]->UnregisterMagazines(magazines_[i]);
+                        delete magazines_[i];
+                    }
+                }
+            }
+
+            MagazineSet *Get(uint32_t id, NovaPartitionedMemManager *manager) {
+                if (id >= magazines_.size()) {
+                    magazines_.resize(id + 1, nullptr);
+                    managers_.resize(id + 1, nullptr);
+                }
+                if (!magazines_[id]) {
+                    magazines_[id] = new MagazineSet;
+                    managers_[id] = manager;
+                    manager->RegisterMagazines(magazines_[id]);
+                }
+                return magazines_[id];
+            }
 
-    Slab::Slab(char *base, uint64_t slab_size_mb) {
+            // Return the magazines of id if this thread has them.
+            MagazineSet *Find(uint32_t id) {
+                if (id >= magazines_.size()) {
+                    return nullptr;
+                }
+                return magazines_[id];
+            }
+
+        private:
+            std::vector<MagazineSet *> magazines_;
+            std::vector<NovaPartitionedMemManager *> managers_;
+        };
+
+        thread_local ThreadMagazines thread_magazines;
+    }
+
+    std::atomic_int_fast32_t NovaPartitionedMemManager::next_id_;
+
+    Slab::Slab(char *base, uint64_t slab_size_mb) : base(base) {
         next_ = base;
         slab_size_mb_ = slab_size_mb;
     }
@@ -21,6 +68,8 @@ namespace nova {
         item_size_ = item_size;
         auto num_items = static_cast<uint32_t>(size / item_size);
         available_bytes_ = item_size * num_items;
+        next_ = base;
+        nallocated = 0;
     }
 
     char *Slab::AllocItem() {
@@ -36,9 +85,9 @@ namespace nova {
     char *SlabClass::AllocItem() {
         // check free list first.
         if (!free_list.empty()) {
-            char *ptr = free_list.front();
+            char *ptr = free_list.back();
             NOVA_ASSERT(ptr != nullptr);
-            free_list.pop();
+            free_list.pop_back();
             return ptr;
         }
 
@@ -51,7 +100,7 @@ namespace nova {
     }
 
     void SlabClass::FreeItem(char *buf) {
-        free_list.push(buf);
+        free_list.push_back(buf);
     }
 
     void SlabClass::AddSlab(Slab *slab) {
@@ -61,25 +110,41 @@ namespace nova {
     NovaPartitionedMemManager::NovaPartitionedMemManager(int pid, char *buf,
                                                          uint64_t data_size,
                                                          uint64_t slab_size_mb)
-            : slab_size_mb_(slab_size_mb) {
+            : pid_(pid), id_(next_id_.fetch_add(1)), base_(buf),
+              slab_size_mb_(slab_size_mb) {
         uint64_t slab_size = slab_size_mb * 1024 * 1024;
+        slab_size_ = slab_size;
+        nmagazine_sets_ = 0;
+        max_magazine_bytes_ = data_size / MAGAZINE_PARTITION_SHARE;
 //        uint64_t slab_sizes[] = {8192, 1024 };
 
         uint64_t size = 1200;
         for (int i = 0; i < MAX_NUMBER_OF_SLAB_CLASSES; i++) {
+            if (i == MAX_NUMBER_OF_SLAB_CLASSES - 1) {
+                size = slab_size;
+            }
             slab_classes_[i].size = size;
             slab_classes_[i].nitems_per_slab = slab_size / size;
+            magazine_capacity_[i] = std::min((uint64_t) MAGAZINE_MAX_ITEMS,
+                                             MAGAZINE_BYTES / size);
             if (pid == 0) {
                 NOVA_LOG(INFO) << "slab class " << i << " size:" << size
                                << " nitems:"
                                << slab_size / size;
             }
-            size *= SLAB_SIZE_FACTOR;
+            if (size < LARGE_SLAB_ITEM_SIZE) {
+                size *= SLAB_SIZE_FACTOR;
+            } else {
+                // Round up to a cache line.
+                size = (uint64_t) (size * LARGE_SLAB_SIZE_FACTOR);
+                size = (size + 63) / 64 * 64;
+            }
             if (size > slab_size) {
                 size = slab_size;
             }
         }
         uint64_t ndataslabs = data_size / slab_size;
+        nslabs_ = ndataslabs;
         if (pid == 0) {
             NOVA_LOG(INFO)
                 << fmt::format("slab size mb:{} nslabs:{}", slab_size_mb,
@@ -91,10 +156,15 @@ namespace nova {
         for (int i = 0; i < ndataslabs; i++) {
             auto *slab = new Slab(slab_buf, slab_size_mb);
             free_slabs_[i] = slab;
+            slabs_.push_back(slab);
             slab_buf += slab_size;
         }
     }
 
+    MagazineSet *NovaPartitionedMemManager::GetMagazines() {
+        return thread_magazines.Get(id_, this);
+    }
+
     uint32_t NovaPartitionedMemManager::slabclassid(uint64_t size) {
         NOVA_ASSERT(size > 0 && size <= slab_size_mb_ * 1024 * 1024)
             << fmt::format("alloc size:{} max size:{}", size,
@@ -107,68 +177,332 @@ namespace nova {
         return res;
     }
 
-    char *NovaPartitionedMemManager::ItemAlloc(uint32_t scid) {
-        char *free_item = nullptr;
-        Slab *slab = nullptr;
+    char *NovaPartitionedMemManager::AllocItemLocked(uint32_t scid) {
+        char *free_item = slab_classes_[scid].AllocItem();
+        if (free_item == nullptr) {
+            // Grab a slab from the free list.
+            free_slabs_mutex_.lock();
+            if (free_slab_index_ == -1) {
+                free_slabs_mutex_.unlock();
+                return nullptr;
+            }
+            Slab *slab = free_slabs_[free_slab_index_];
+            free_slab_index_--;
+            free_slabs_mutex_.unlock();
 
-        slab_class_mutex_[scid].lock();
-        free_item = slab_classes_[scid].AllocItem();
-        if (free_item != nullptr) {
-            slab_class_mutex_[scid].unlock();
-            return free_item;
+            slab->Init(static_cast<uint32_t>(slab_classes_[scid].size));
+            slab_classes_[scid].AddSlab(slab);
+            free_item = slab->AllocItem();
         }
-        // Grab a slab from the free list.
-        free_slabs_mutex_.lock();
-        if (free_slab_index_ == -1) {
-            free_slabs_mutex_.unlock();
-            slab_class_mutex_[scid].unlock();
+        SlabOf(free_item)->nallocated += 1;
+        return free_item;
+    }
 
-            oom_lock.lock();
-            if (!print_class_oom) {
-                NOVA_LOG(INFO) << "No free slabs: Print slab class usages.";
-                print_class_oom = true;
-                for (int i = 0; i < MAX_NUMBER_OF_SLAB_CLASSES; i++) {
-                    slab_class_mutex_[scid].lock();
-                    NOVA_LOG(INFO) << fmt::format(
-                                "slab class {} size:{} nfreeitems:{} slabs:{}",
-                                i,
-                                slab_classes_[i].size,
-                                slab_classes_[i].free_list.size(),
-                                slab_classes_[i].slabs.size());
-                    slab_class_mutex_[scid].unlock();
-                }
+    void NovaPartitionedMemManager::FreeItemLocked(char *buf, uint32_t scid) {
+        Slab *slab = SlabOf(buf);
+        NOVA_ASSERT(slab->nallocated > 0);
+        slab->nallocated -= 1;
+        slab_classes_[scid].FreeItem(buf);
+    }
+
+    void NovaPartitionedMemManager::LogOOM() {
+        oom_lock.lock();
+        if (!print_class_oom) {
+            NOVA_LOG(INFO) << "No free slabs: Print slab class usages.";
+            print_class_oom = true;
+            for (int i = 0; i < MAX_NUMBER_OF_SLAB_CLASSES; i++) {
+                slab_class_mutex_[i].lock();
+                NOVA_LOG(INFO) << fmt::format(
+                            "slab class {} size:{} nfreeitems:{} slabs:{}",
+                            i,
+                            slab_classes_[i].size,
+                            slab_classes_[i].free_list.size(),
+                            slab_classes_[i].slabs.size());
+                slab_class_mutex_[i].unlock();
             }
-            oom_lock.unlock();
-            return nullptr;
         }
-        slab = free_slabs_[free_slab_index_];
-        free_slab_index_--;
-        free_slabs_mutex_.unlock();
-
-        slab->Init(static_cast<uint32_t>(slab_classes_[scid].size));
+        oom_lock.unlock();
+    }
 
-        slab_classes_[scid].AddSlab(slab);
-        free_item = slab->AllocItem();
-        slab_class_mutex_[scid].unlock();
+    char *NovaPartitionedMemManager::ItemAlloc(uint32_t scid) {
+        uint32_t capacity = magazine_capacity_[scid];
+        char *free_item = nullptr;
+        if (capacity > 0) {
+            int64_t size = slab_classes_[scid].size;
+            MagazineSet *magazines = GetMagazines();
+            ServeDrainRequests(magazines);
+            Magazine *magazine = &magazines->magazines[scid];
+            if (!magazine->used.load(std::memory_order_relaxed)) {
+                magazine->used.store(true, std::memory_order_relaxed);
+            }
+            if (magazine->nitems == 0) {
+                // Refill half of the magazine.
+                uint32_t nitems = std::max(1u, capacity / 2);
+                int64_t max_bytes = MaxThreadMagazineBytes();
+                slab_class_mutex_[scid].lock();
+                while (magazine->nitems < nitems) {
+                    if (magazine->nitems > 0 && magazines->bytes + size > max_bytes) {
+                        break;
+                    }
+                    char *item = AllocItemLocked(scid);
+                    if (item == nullptr) {
+                        break;
+                    }
+                    magazine->items[magazine->nitems] = item;
+                    magazine->nitems++;
+                    magazines->bytes += size;
+                }
+                slab_class_mutex_[scid].unlock();
+            }
+            if (magazine->nitems > 0) {
+                magazine->nitems--;
+                magazines->bytes -= size;
+                return magazine->items[magazine->nitems];
+            }
+            // The slab class is empty. Other threads may cache its free
+            // items.
+            free_item = AllocItemAfterDrain(scid);
+        } else {
+            slab_class_mutex_[scid].lock();
+            free_item = AllocItemLocked(scid);
+            slab_class_mutex_[scid].unlock();
+        }
+        if (free_item == nullptr) {
+            LogOOM();
+        }
         return free_item;
     }
 
+    char *NovaPartitionedMemManager::AllocItemAfterDrain(uint32_t scid) {
+        DrainMagazines(scid, false);
+        for (int round = 0; round < MAGAZINE_DRAIN_WAIT_ROUNDS; round++) {
+            slab_class_mutex_[scid].lock();
+            char *free_item = AllocItemLocked(scid);
+            slab_class_mutex_[scid].unlock();
+            if (free_item != nullptr) {
+                return free_item;
+            }
+            usleep(MAGAZINE_DRAIN_WAIT_US);
+        }
+        return nullptr;
+    }
+
     void NovaPartitionedMemManager::FreeItem(char *buf, uint32_t scid) {
 //        memset(buf, 0, slab_classes_[scid].size);
+        uint32_t capacity = magazine_capacity_[scid];
+        if (capacity > 0) {
+            int64_t size = slab_classes_[scid].size;
+            MagazineSet *magazines = GetMagazines();
+            ServeDrainRequests(magazines);
+            Magazine *magazine = &magazines->magazines[scid];
+            if (!magazine->used.load(std::memory_order_relaxed)) {
+                magazine->used.store(true, std::memory_order_relaxed);
+            }
+            if (magazine->nitems == capacity) {
+                // Return the older half of the magazine.
+                uint32_t nitems = std::max(1u, capacity / 2);
+                slab_class_mutex_[scid].lock();
+                for (int i = 0; i < nitems; i++) {
+                    FreeItemLocked(magazine->items[i], scid);
+                }
+                slab_class_mutex_[scid].unlock();
+                memmove(magazine->items, magazine->items + nitems,
+                        (capacity - nitems) * sizeof(char *));
+                magazine->nitems -= nitems;
+                magazines->bytes -= nitems * size;
+            }
+            if (magazines->bytes + size <= MaxThreadMagazineBytes()) {
+                magazine->items[magazine->nitems] = buf;
+                magazine->nitems++;
+                magazines->bytes += size;
+                return;
+            }
+        }
         slab_class_mutex_[scid].lock();
-        slab_classes_[scid].FreeItem(buf);
+        FreeItemLocked(buf, scid);
         slab_class_mutex_[scid].unlock();
     }
 
     void NovaPartitionedMemManager::FreeItems(const std::vector<char *> &items,
                                               uint32_t scid) {
+        if (magazine_capacity_[scid] > 0) {
+            for (auto buf : items) {
+                FreeItem(buf, scid);
+            }
+            return;
+        }
         slab_class_mutex_[scid].lock();
         for (auto buf : items) {
-            slab_classes_[scid].FreeItem(buf);
+            FreeItemLocked(buf, scid);
         }
         slab_class_mutex_[scid].unlock();
     }
 
+    void NovaPartitionedMemManager::RegisterMagazines(MagazineSet *magazines) {
+        magazines_mutex_.lock();
+        magazines_.push_back(magazines);
+        nmagazine_sets_ = magazines_.size();
+        magazines_mutex_.unlock();
+    }
+
+    void NovaPartitionedMemManager::UnregisterMagazines(MagazineSet *magazines) {
+        magazines_mutex_.lock();
+        magazines_.erase(std::remove(magazines_.begin(), magazines_.end(), magazines), magazines_.end());
+        nmagazine_sets_ = magazines_.size();
+        magazines_mutex_.unlock();
+        for (int scid = 0; scid < MAX_NUMBER_OF_SLAB_CLASSES; scid++) {
+            FlushMagazine(magazines, scid);
+        }
+    }
+
+    void NovaPartitionedMemManager::FlushMagazine(MagazineSet *magazines, uint32_t scid) {
+        Magazine *magazine = &magazines->magazines[scid];
+        if (magazine->nitems == 0) {
+            return;
+        }
+        slab_class_mutex_[scid].lock();
+        for (int i = 0; i < magazine->nitems; i++) {
+            FreeItemLocked(magazine->items[i], scid);
+        }
+        slab_class_mutex_[scid].unlock();
+        magazines->bytes -= (int64_t) magazine->nitems * slab_classes_[scid].size;
+        magazine->nitems = 0;
+    }
+
+    void NovaPartitionedMemManager::ServeDrainRequests(MagazineSet *magazines) {
+        if (magazines->drain_requests.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        uint64_t scids = magazines->drain_requests.exchange(0);
+        for (uint32_t scid = 0; scid < MAX_NUMBER_OF_SLAB_CLASSES; scid++) {
+            if (scids & (1ull << scid)) {
+                FlushMagazine(magazines, scid);
+            }
+        }
+    }
+
+    void NovaPartitionedMemManager::DrainMagazines(uint32_t scid, bool only_idle) {
+        MagazineSet *own = thread_magazines.Find(id_);
+        magazines_mutex_.lock();
+        for (auto magazines : magazines_) {
+            Magazine *magazine = &magazines->magazines[scid];
+            if (!only_idle || !magazine->used.load(std::memory_order_relaxed)) {
+                if (magazines == own) {
+                    FlushMagazine(magazines, scid);
+                } else {
+                    magazines->drain_requests.fetch_or(1ull << scid);
+                }
+            }
+            if (only_idle) {
+                magazine->used.store(false, std::memory_order_relaxed);
+            }
+        }
+        magazines_mutex_.unlock();
+    }
+
+    uint32_t NovaPartitionedMemManager::Rebalance() {
+        uint32_t nreturned = 0;
+        for (int scid = 0; scid < MAX_NUMBER_OF_SLAB_CLASSES; scid++) {
+            if (magazine_capacity_[scid] > 0) {
+                DrainMagazines(scid, true);
+            }
+            SlabClass &slab_class = slab_classes_[scid];
+            std::unordered_set<Slab *> free_slabs;
+            slab_class_mutex_[scid].lock();
+            for (auto slab : slab_class.slabs) {
+                if (free_slabs.size() + 1 >= slab_class.slabs.size()) {
+                    break;
+                }
+                if (slab->nallocated == 0) {
+                    free_slabs.insert(slab);
+                }
+            }
+            if (free_slabs.empty()) {
+                slab_class_mutex_[scid].unlock();
+                continue;
+            }
+            auto is_free = [&](char *buf) {
+                return free_slabs.find(SlabOf(buf)) != free_slabs.end();
+            };
+            slab_class.free_list.erase(
+                    std::remove_if(slab_class.free_list.begin(),
+                                   slab_class.free_list.end(), is_free),
+                    slab_class.free_list.end());
+            slab_class.slabs.erase(
+                    std::remove_if(slab_class.slabs.begin(),
+                                   slab_class.slabs.end(),
+                                   [&](Slab *slab) {
+                                       return free_slabs.find(slab) !=
+                                              free_slabs.end();
+                                   }),
+                    slab_class.slabs.end());
+            slab_class_mutex_[scid].unlock();
+
+            free_slabs_mutex_.lock();
+            for (auto slab : free_slabs) {
+                free_slab_index_++;
+                free_slabs_[free_slab_index_] = slab;
+            }
+            free_slabs_mutex_.unlock();
+            nreturned += free_slabs.size();
+            NOVA_LOG(DEBUG) << fmt::format(
+                        "mem-{}: slab class {} size:{} returned {} slabs",
+                        pid_, scid, slab_class.size, free_slabs.size());
+        }
+        return nreturned;
+    }
+
+    std::string NovaPartitionedMemManager::Stats() {
+        std::string output;
+        uint64_t assigned_bytes = 0;
+        uint64_t allocated_bytes = 0;
+        for (int scid = 0; scid < MAX_NUMBER_OF_SLAB_CLASSES; scid++) {
+            SlabClass &slab_class = slab_classes_[scid];
+            slab_class_mutex_[scid].lock();
+            uint64_t nslabs = slab_class.slabs.size();
+            uint64_t nallocated = 0;
+            for (auto slab : slab_class.slabs) {
+                nallocated += slab->nallocated;
+            }
+            uint64_t nfree = slab_class.free_list.size();
+            slab_class_mutex_[scid].unlock();
+            if (nslabs == 0) {
+                continue;
+            }
+            assigned_bytes += nslabs * slab_size_;
+            allocated_bytes += nallocated * slab_class.size;
+            // Allocated items include those in thread caches.
+            output += fmt::format("mem-class,{},{},{},{},{},{},{:.2f}\n",
+                                  pid_, scid, slab_class.size, nslabs,
+                                  nallocated, nfree,
+                                  (double) nallocated * slab_class.size /
+                                  (nslabs * slab_size_));
+        }
+        free_slabs_mutex_.lock();
+        uint64_t nfree_slabs = free_slab_index_ + 1;
+        free_slabs_mutex_.unlock();
+        double fragmentation = 0;
+        if (assigned_bytes > 0) {
+            fragmentation = 1.0 - (double) allocated_bytes / assigned_bytes;
+        }
+        output += fmt::format("mem,{},{},{},{:.2f}\n", pid_, nfree_slabs,
+                              nslabs_, fragmentation);
+        return output;
+    }
+
+    uint64_t NovaPartitionedMemManager::AllocatedBytes() {
+        uint64_t allocated_bytes = 0;
+        for (int scid = 0; scid < MAX_NUMBER_OF_SLAB_CLASSES; scid++) {
+            SlabClass &slab_class = slab_classes_[scid];
+            slab_class_mutex_[scid].lock();
+            for (auto slab : slab_class.slabs) {
+                allocated_bytes += slab->nallocated * slab_class.size;
+            }
+            slab_class_mutex_[scid].unlock();
+        }
+        return allocated_bytes;
+    }
+
     NovaMemManager::NovaMemManager(char *buf, uint32_t num_mem_partitions,
                                    uint64_t mem_pool_size_gb,
                                    uint64_t slab_size_mb) {
@@ -201,6 +535,37 @@ namespace nova {
                 buf, scid);
     }
 
+    void NovaMemManager::StartRebalancer(uint32_t interval_sec) {
+        NOVA_ASSERT(interval_sec > 0);
+        while (true) {
+            sleep(interval_sec);
+            uint32_t nreturned = 0;
+            for (auto manager : partitioned_mem_managers_) {
+                nreturned += manager->Rebalance();
+            }
+            if (nreturned > 0) {
+                NOVA_LOG(INFO) << fmt::format("Returned {} free slabs",
+                                              nreturned);
+            }
+        }
+    }
+
+    std::string NovaMemManager::Stats() {
+        std::string output;
+        for (auto manager : partitioned_mem_managers_) {
+            output += manager->Stats();
+        }
+        return output;
+    }
+
+    uint64_t NovaMemManager::AllocatedBytes() {
+        uint64_t allocated_bytes = 0;
+        for (auto manager : partitioned_mem_managers_) {
+            allocated_bytes += manager->AllocatedBytes();
+        }
+        return allocated_bytes;
+    }
+
     void NovaMemManager::FreeItems(uint64_t key,
                                    const std::vector<char *> &items,
                                    uint32_t scid) {
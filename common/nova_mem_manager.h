@@ -8,7 +8,10 @@
 #define NOVA_MEM_MANAGER_H
 
 #include <stdint.h>
+#include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <string>
 #include <vector>
 #include <queue>
 #include <mutex>
@@ -18,6 +21,22 @@ namespace nova {
 
 #define MAX_NUMBER_OF_SLAB_CLASSES 64
 #define SLAB_SIZE_FACTOR 2
+// Items larger than LARGE_SLAB_ITEM_SIZE grow by LARGE_SLAB_SIZE_FACTOR to
+// bound the memory wasted by a large item.
+#define LARGE_SLAB_ITEM_SIZE (64 * 1024)
+#define LARGE_SLAB_SIZE_FACTOR 1.25
+// A thread caches at most MAGAZINE_MAX_ITEMS items and MAGAZINE_BYTES
+// bytes per slab class. Items larger than MAGAZINE_BYTES bypass the cache.
+#define MAGAZINE_MAX_ITEMS 64
+#define MAGAZINE_BYTES (1024 * 1024)
+// The magazines of a partition hold at most 1/MAGAZINE_PARTITION_SHARE of
+// its memory.
+#define MAGAZINE_PARTITION_SHARE 16
+// An allocation that finds no free items waits at most
+// MAGAZINE_DRAIN_WAIT_ROUNDS * MAGAZINE_DRAIN_WAIT_US for other threads to
+// drain their magazines.
+#define MAGAZINE_DRAIN_WAIT_ROUNDS 100
+#define MAGAZINE_DRAIN_WAIT_US 100
 
     class Slab {
     public:
@@ -28,6 +47,8 @@ namespace nova {
         char *AllocItem();
 
         char *base;
+        // Number of items held by users or thread caches.
+        uint32_t nallocated = 0;
     private:
         uint32_t item_size_;
         char *next_;
@@ -46,7 +67,9 @@ namespace nova {
         uint64_t nitems_per_slab;
         uint64_t size;
         std::vector<Slab *> slabs;
-        std::queue<char *> free_list;
+        // Freed items are reused in LIFO order so that the least recently
+        // used slabs drain and can be returned to the free slabs.
+        std::vector<char *> free_list;
 
         Slab *get_slab(int index) {
             return slabs[index];
@@ -57,6 +80,39 @@ namespace nova {
         }
     };
 
+    // A per-thread cache of free items of a slab class. Only its owner
+    // thread touches the items.
+    struct Magazine {
+        uint32_t nitems = 0;
+        // Used since the last rebalance.
+        std::atomic_bool used;
+        char *items[MAGAZINE_MAX_ITEMS];
+
+        Magazine() : used(false) {}
+    };
+
+    // The magazines of a thread in a partition.
+    struct MagazineSet {
+        Magazine magazines[MAX_NUMBER_OF_SLAB_CLASSES];
+        // Bytes of the items in the magazines. Only the owner updates it.
+        int64_t bytes = 0;
+        // A bit per slab class whose magazine other threads asked the owner
+        // to return to its slab class.
+        std::atomic_uint_fast64_t drain_requests;
+
+        MagazineSet() : drain_requests(0) {}
+    };
+
+    // Each thread allocates and frees items through its own magazines
+    // without locks. A thread refills an empty magazine from its slab class
+    // and returns half of a full magazine to its slab class. Other threads
+    // cannot take the items of a magazine. They ask its owner to return
+    // them instead, and the owner does so at its next allocation or free.
+    // Before failing an allocation, a thread asks all threads to return
+    // their items of the slab class and waits for them briefly. Items
+    // cached by a thread that stays idle are returned when it exits. The
+    // magazines of a thread hold at most their share of
+    // 1/MAGAZINE_PARTITION_SHARE of the partition.
     class NovaPartitionedMemManager {
     public:
         NovaPartitionedMemManager(int pid, char *buf, uint64_t data_size,
@@ -71,7 +127,80 @@ namespace nova {
 
         uint32_t slabclassid(uint64_t  size);
 
+        // Drain the magazines that were idle since the last rebalance. The
+        // magazines of other threads are drained by their owners, so their
+        // slabs are returned in a later round. Then return the slabs whose
+        // items are all free to the free slabs so that other slab classes
+        // can use them. A slab class keeps at least one slab. Return the
+        // number of returned slabs.
+        uint32_t Rebalance();
+
+        // Occupancy of each slab class and fragmentation of the
+        // partition.
+        std::string Stats();
+
+        // Bytes of items held by users or thread caches.
+        uint64_t AllocatedBytes();
+
+        void RegisterMagazines(MagazineSet *magazines);
+
+        // Return the items in magazines to their slab classes and stop
+        // tracking them. Requires the owner of magazines.
+        void UnregisterMagazines(MagazineSet *magazines);
+
     private:
+        // Return the items in the magazine of scid to its slab class.
+        // Requires the owner of magazines.
+        void FlushMagazine(MagazineSet *magazines, uint32_t scid);
+
+        // Flush the magazines that other threads asked to drain. Requires
+        // the owner of magazines.
+        void ServeDrainRequests(MagazineSet *magazines);
+
+        // Return the items that the magazines of all threads cache for
+        // scid to its slab class. Drain only idle magazines if only_idle
+        // is true. The calling thread flushes its own magazines and asks
+        // the other threads to flush theirs.
+        void DrainMagazines(uint32_t scid, bool only_idle);
+
+        // Drain the magazines of scid and wait for their owners to return
+        // a free item.
+        char *AllocItemAfterDrain(uint32_t scid);
+
+        // Bytes that the magazines of a thread may hold.
+        int64_t MaxThreadMagazineBytes() {
+            return max_magazine_bytes_ /
+                   std::max((int64_t) 1, (int64_t) nmagazine_sets_.load(
+                           std::memory_order_relaxed));
+        }
+
+        MagazineSet *GetMagazines();
+
+        void LogOOM();
+
+        // Requires slab_class_mutex_[scid] held.
+        char *AllocItemLocked(uint32_t scid);
+
+        // Requires slab_class_mutex_[scid] held.
+        void FreeItemLocked(char *buf, uint32_t scid);
+
+        Slab *SlabOf(char *buf) {
+            return slabs_[(buf - base_) / slab_size_];
+        }
+
+        static std::atomic_int_fast32_t next_id_;
+        const int pid_;
+        // Index of the magazines of this partition in a thread.
+        const uint32_t id_;
+        char *base_ = nullptr;
+        uint64_t slab_size_ = 0;
+        uint64_t nslabs_ = 0;
+        std::vector<Slab *> slabs_;
+        uint32_t magazine_capacity_[MAX_NUMBER_OF_SLAB_CLASSES];
+        int64_t max_magazine_bytes_ = 0;
+        std::mutex magazines_mutex_;
+        std::vector<MagazineSet *> magazines_;
+        std::atomic_int_fast32_t nmagazine_sets_;
         std::mutex slab_class_mutex_[MAX_NUMBER_OF_SLAB_CLASSES];
         SlabClass slab_classes_[MAX_NUMBER_OF_SLAB_CLASSES];
         std::mutex oom_lock;
@@ -97,6 +226,13 @@ namespace nova {
 
         uint32_t slabclassid(uint64_t key, uint64_t  size) override;
 
+        // Rebalance slabs every interval_sec seconds. It never returns.
+        void StartRebalancer(uint32_t interval_sec);
+
+        std::string Stats();
+
+        uint64_t AllocatedBytes();
+
     private:
         std::vector<NovaPartitionedMemManager *> partitioned_mem_managers_;
     };
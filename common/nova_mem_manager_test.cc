@@ -0,0 +1,143 @@
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "common/nova_config.h"
+#include "common/nova_mem_manager.h"
+#include "util/testharness.h"
+
+namespace nova {
+
+    class NovaMemManagerTest {
+    public:
+        static const uint64_t kSlabSizeMB = 1;
+        static const uint64_t kSlabSize = kSlabSizeMB * 1024 * 1024;
+
+        // The managers are never deleted since the magazines of the test
+        // thread refer to them until it exits.
+        NovaPartitionedMemManager *NewManager(uint64_t nslabs) {
+            char *buf = (char *) malloc(nslabs * kSlabSize);
+            return new NovaPartitionedMemManager(0, buf, nslabs * kSlabSize,
+                                                 kSlabSizeMB);
+        }
+    };
+
+    TEST(NovaMemManagerTest, Refill) {
+        NovaPartitionedMemManager *manager = NewManager(4);
+        uint32_t scid = manager->slabclassid(1000);
+        ASSERT_EQ(0, manager->AllocatedBytes());
+
+        // An empty magazine takes half of its capacity from the slab class.
+        std::vector<char *> items;
+        items.push_back(manager->ItemAlloc(scid));
+        uint64_t refill_bytes = manager->AllocatedBytes();
+        ASSERT_TRUE(refill_bytes > 0);
+        uint64_t item_size = refill_bytes / (MAGAZINE_MAX_ITEMS / 2);
+        ASSERT_EQ(refill_bytes, item_size * (MAGAZINE_MAX_ITEMS / 2));
+        for (int i = 1; i < MAGAZINE_MAX_ITEMS / 2; i++) {
+            items.push_back(manager->ItemAlloc(scid));
+            ASSERT_EQ(refill_bytes, manager->AllocatedBytes());
+        }
+        items.push_back(manager->ItemAlloc(scid));
+        ASSERT_EQ(2 * refill_bytes, manager->AllocatedBytes());
+        for (int i = 0; i < items.size(); i++) {
+            ASSERT_TRUE(items[i] != nullptr);
+            for (int j = i + 1; j < items.size(); j++) {
+                ASSERT_TRUE(items[i] != items[j]);
+            }
+        }
+
+        // A full magazine returns its older half to the slab class.
+        for (auto item : items) {
+            manager->FreeItem(item, scid);
+        }
+        ASSERT_EQ(2 * refill_bytes, manager->AllocatedBytes());
+        manager->FreeItem(manager->ItemAlloc(scid), scid);
+        ASSERT_EQ(2 * refill_bytes, manager->AllocatedBytes());
+    }
+
+    TEST(NovaMemManagerTest, DrainBeforeOOM) {
+        NovaPartitionedMemManager *manager = NewManager(16);
+        uint32_t small_scid = manager->slabclassid(1000);
+        uint32_t scid = manager->slabclassid(100 * 1024);
+        std::atomic_bool cached(false);
+        std::atomic_bool done(false);
+        uint32_t ncached = 2;
+
+        // The other thread takes all items and caches some of them.
+        std::thread owner([&]() {
+            manager->FreeItem(manager->ItemAlloc(small_scid), small_scid);
+            std::vector<char *> items;
+            while (true) {
+                char *item = manager->ItemAlloc(scid);
+                if (item == nullptr) {
+                    break;
+                }
+                items.push_back(item);
+            }
+            ASSERT_TRUE(items.size() > ncached);
+            for (uint32_t i = 0; i < ncached; i++) {
+                manager->FreeItem(items[i], scid);
+            }
+            cached = true;
+            // Allocations of another slab class serve drain requests.
+            while (!done) {
+                manager->FreeItem(manager->ItemAlloc(small_scid), small_scid);
+            }
+        });
+        while (!cached) {
+            std::this_thread::yield();
+        }
+        for (uint32_t i = 0; i < ncached; i++) {
+            ASSERT_TRUE(manager->ItemAlloc(scid) != nullptr);
+        }
+        done = true;
+        owner.join();
+        ASSERT_TRUE(manager->ItemAlloc(scid) == nullptr);
+    }
+
+    TEST(NovaMemManagerTest, RebalanceReturnsFreeSlabs) {
+        NovaPartitionedMemManager *manager = NewManager(4);
+        uint32_t scid = manager->slabclassid(1000);
+        uint32_t other_scid = manager->slabclassid(4 * 1024);
+        std::vector<char *> items;
+        while (true) {
+            char *item = manager->ItemAlloc(scid);
+            if (item == nullptr) {
+                break;
+            }
+            items.push_back(item);
+        }
+        // Every slab is in use.
+        ASSERT_EQ(0, manager->Rebalance());
+        ASSERT_TRUE(manager->ItemAlloc(other_scid) == nullptr);
+
+        for (auto item : items) {
+            manager->FreeItem(item, scid);
+        }
+        // The magazine was used since the last rebalance and pins its slab.
+        // The slab class keeps one slab.
+        uint32_t nreturned = manager->Rebalance();
+        ASSERT_TRUE(nreturned >= 2);
+        // The magazine is idle now and is drained.
+        nreturned += manager->Rebalance();
+        ASSERT_EQ(3, nreturned);
+        ASSERT_EQ(0, manager->AllocatedBytes());
+        ASSERT_EQ(0, manager->Rebalance());
+
+        char *item = manager->ItemAlloc(other_scid);
+        ASSERT_TRUE(item != nullptr);
+        manager->FreeItem(item, other_scid);
+    }
+}
+
+nova::NovaConfig *nova::NovaConfig::config;
+nova::NovaGlobalVariables nova::NovaGlobalVariables::global;
+
+int main(int argc, char **argv) { return leveldb::test::RunAllTests(); }
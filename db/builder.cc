@@ -101,7 +101,9 @@ namespace leveldb {
                     bg_thread->rand_seed(),
                     filename);
             WritableFile *file = new MemWritableFile(stoc_writable_file);
-            TableBuilder *builder = new TableBuilder(options, file);
+            Options table_options = options;
+            table_options.filter_policy = FilterPolicyForLevel(options, 0);
+            TableBuilder *builder = new TableBuilder(table_options, file);
 
             Slice user_key;
             bool insert = true;
@@ -6,6 +6,7 @@
 
 #include "compaction.h"
 #include "filename.h"
+#include "common/nova_common.h"
 
 namespace leveldb {
     void
@@ -243,7 +244,13 @@ namespace leveldb {
                 bg_thread_->rand_seed(),
                 filename);
         compact->outfile = new MemWritableFile(stoc_writable_file);
-        compact->builder = new TableBuilder(options_, compact->outfile);
+        int level = 0;
+        if (compact->compaction) {
+            level = compact->compaction->target_level();
+        }
+        Options table_options = options_;
+        table_options.filter_policy = FilterPolicyForLevel(options_, level);
+        compact->builder = new TableBuilder(table_options, compact->outfile);
         return Status::OK();
     }
 
@@ -346,9 +353,20 @@ namespace leveldb {
         SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
         std::vector<std::string> keys;
         uint64_t memtable_size = 0;
+        // A database that shares the SSTables of a split drops the keys
+        // outside its range.
+        bool drop_out_of_range = output_type == kCompactOutputSSTables &&
+                                 user_comparator_->Compare(options_.upper_key, options_.lower_key) > 0;
         while (input->Valid()) {
             Slice key = input->key();
             NOVA_ASSERT(ParseInternalKey(key, &ikey));
+            if (drop_out_of_range) {
+                if (user_comparator_->Compare(ikey.user_key, options_.lower_key) < 0 ||
+                    user_comparator_->Compare(ikey.user_key, options_.upper_key) >= 0) {
+                    input->Next();
+                    continue;
+                }
+            }
 
             if (output_type == kCompactOutputSSTables &&
                 compact->ShouldStopBefore(key, user_comparator_) &&
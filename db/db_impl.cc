@@ -13,6 +13,7 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <thread>
 #include <fmt/core.h>
 
 #include "db/builder.h"
@@ -22,6 +23,7 @@
 #include "db/log_reader.h"
 #include "leveldb/log_writer.h"
 #include "db/memtable.h"
+#include "db/shared_tables.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
@@ -43,6 +45,15 @@
 
 namespace leveldb {
     namespace {
+        // Whether a write is logged before it is inserted into a memtable.
+        bool IsLoggedWrite(const WriteOptions &options) {
+            if (options.local_write) {
+                return false;
+            }
+            return nova::NovaConfig::config->log_record_mode == nova::NovaLogRecordMode::LOG_RDMA ||
+                   nova::NovaConfig::config->log_record_mode == nova::NovaLogRecordMode::LOG_LOCAL_DISK;
+        }
+
         uint64_t time_diff(timeval t1, timeval t2) {
             return (t2.tv_sec - t1.tv_sec) * 1000000 +
                    (t2.tv_usec - t1.tv_usec);
@@ -88,6 +99,13 @@ namespace leveldb {
         result.comparator = icmp;
         result.filter_policy = (src.filter_policy != nullptr) ? ipolicy
                                                               : nullptr;
+        result.level_filter_policies.clear();
+        if (src.filter_policy != nullptr) {
+            for (auto policy : src.level_filter_policies) {
+                result.level_filter_policies.push_back(
+                        new InternalFilterPolicy(policy));
+            }
+        }
         ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
         ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
         ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
@@ -135,14 +153,17 @@ namespace leveldb {
               l0_stop_write_signal_(&l0_stop_write_mutex_),
               user_comparator_(raw_options.comparator) {
         is_loading_db_ = false;
+        capture_migration_tail_ = false;
         memtable_id_seq_ = 100;
         start_coordinated_compaction_ = false;
         terminate_coordinated_compaction_ = false;
         start_compaction_ = true;
+        lower_key_ = options_.lower_key;
+        upper_key_ = options_.upper_key;
         if (options_.enable_lookup_index) {
-            lookup_index_ = new LookupIndex(
-                    options_.upper_key - options_.lower_key);
-            for (int i = 0; i < options_.upper_key - options_.lower_key; i++) {
+            uint64_t nkeys = nova::KeySpace::NumKeys(options_.lower_key, options_.upper_key);
+            lookup_index_ = new LookupIndex(nkeys);
+            for (uint64_t i = 0; i < nkeys; i++) {
                 lookup_index_->Insert(Slice(), i, 0);
             }
         }
@@ -164,6 +185,9 @@ namespace leveldb {
         if (owns_cache_) {
             delete options_.block_cache;
         }
+        for (auto policy : options_.level_filter_policies) {
+            delete policy;
+        }
     }
 
     void DBImpl::EvictFileFromCache(uint64_t file_number) {
@@ -233,7 +257,20 @@ namespace leveldb {
     void DBImpl::UpdateFileMetaReplicaLocations(
             const std::vector<leveldb::ReplicationPair> &results, uint32_t stoc_server_id, int level,
             StoCClient *client) {
+        ApplyReplicaLocations(results, stoc_server_id, level, client, false);
+    }
+
+    void DBImpl::MoveReplicaLocations(const std::vector<leveldb::ReplicationPair> &results, uint32_t src_stoc_id,
+                                      int level, StoCClient *client) {
+        ApplyReplicaLocations(results, src_stoc_id, level, client, true);
+    }
+
+    void DBImpl::ApplyReplicaLocations(const std::vector<leveldb::ReplicationPair> &results,
+                                       uint32_t stoc_server_id, int level, StoCClient *client,
+                                       bool retire_replaced) {
         std::unordered_map<uint64_t, FileMetaData> fn_meta_to_update;
+        // Copies of SSTables that were compacted while they were replicated.
+        std::unordered_map<uint32_t, std::vector<SSTableStoCFilePair>> orphaned_replicas;
         mutex_.Lock();
         Version *current = versions_->current();
         NOVA_ASSERT(current);
@@ -242,11 +279,20 @@ namespace leveldb {
         VersionEdit edit;
         edit.SetUpdateReplicaLocations(true);
         for (auto result : results) {
+            SSTableStoCFilePair pair = {};
+            pair.sstable_name = TableFileName(dbname_, result.sstable_file_number, result.internal_type,
+                                              result.replica_id);
             if (current->fn_files_.find(result.sstable_file_number) == current->fn_files_.end()) {
                 missing_fns += 1;
+                pair.stoc_file_id = result.dest_stoc_file_id;
+                orphaned_replicas[result.dest_stoc_id].push_back(pair);
                 continue;
             }
             updated_fns += 1;
+            if (retire_replaced) {
+                pair.stoc_file_id = result.source_stoc_file_id;
+                moved_replicas_[stoc_server_id].push_back(pair);
+            }
             auto metadata = current->fn_files_[result.sstable_file_number];
             if (fn_meta_to_update.find(metadata->number) == fn_meta_to_update.end()) {
                 fn_meta_to_update[metadata->number] = *metadata;
@@ -287,10 +333,54 @@ namespace leveldb {
         }
         mutex_.Unlock();
         versions_->AppendChangesToManifest(&edit, manifest_file_, options_.manifest_stoc_ids);
+        for (const auto &it : orphaned_replicas) {
+            client->InitiateDeleteTables(it.first, it.second);
+        }
+    }
+
+    void DBImpl::ObtainObsoleteReplicas(
+            std::unordered_map<uint32_t, std::vector<SSTableStoCFilePair>> *server_pairs) {
+        mutex_.AssertHeld();
+        if (moved_replicas_.empty()) {
+            return;
+        }
+        std::set<std::pair<uint32_t, uint32_t>> live;
+        versions_->AddLiveStoCFiles(&live);
+        auto it = moved_replicas_.begin();
+        while (it != moved_replicas_.end()) {
+            uint32_t stoc_id = it->first;
+            auto &replicas = it->second;
+            auto replica = replicas.begin();
+            while (replica != replicas.end()) {
+                if (live.find(std::make_pair(stoc_id, replica->stoc_file_id)) != live.end()) {
+                    replica++;
+                    continue;
+                }
+                (*server_pairs)[stoc_id].push_back(*replica);
+                replica = replicas.erase(replica);
+            }
+            if (replicas.empty()) {
+                it = moved_replicas_.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+
+    void DBImpl::DeleteObsoleteReplicas(StoCClient *client) {
+        std::unordered_map<uint32_t, std::vector<SSTableStoCFilePair>> server_pairs;
+        mutex_.Lock();
+        ObtainObsoleteReplicas(&server_pairs);
+        mutex_.Unlock();
+        for (const auto &it : server_pairs) {
+            client->InitiateDeleteTables(it.first, it.second);
+        }
     }
 
-    uint32_t DBImpl::EncodeDBMetadata(char *buf, nova::StoCInMemoryLogFileManager *log_manager, uint32_t cfg_id) {
-        // dump the latest version, subranges, log files, range index, lookup index, and table id mapping.
+    uint32_t DBImpl::EncodeDBMetadata(char *buf, nova::StoCInMemoryLogFileManager *log_manager, uint32_t cfg_id,
+                                      bool split, bool live_migration) {
+        // dump the latest version, subranges, log files, range index, lookup index, table id mapping, and shared
+        // tables.
         uint32_t msg_size = 1 + 4 + 4 + 4 + 8 + 8 + 8;
         // Lock the database and all memtable partitions.
         // This ensures a consistent snapshot of the database.
@@ -333,6 +423,44 @@ namespace leveldb {
         NOVA_LOG(rdmaio::INFO) << fmt::format("SRS: {}", srs->DebugString());
         NOVA_LOG(rdmaio::INFO) << fmt::format("Range index: {}", range_index->DebugString());
         msg_size += range_index_size;
+
+        // shared tables. The tables of a split are shared before the
+        // database releases its lock so that it does not delete them.
+        std::unordered_map<uint64_t, std::string> owners;
+        for (int level = 0; level < options_.level; level++) {
+            for (auto file : v->files_[level]) {
+                auto inherited = inherited_tables_.find(file->number);
+                owners[file->number] = inherited != inherited_tables_.end() ? inherited->second : dbname_;
+            }
+        }
+        if (split) {
+            SharedTables::tables->Share(owners);
+        }
+        uint32_t shared_tables_size = 4;
+        uint32_t num_shared_tables = 0;
+        for (const auto &owner : owners) {
+            if (owner.second == dbname_ && !SharedTables::tables->IsShared(owner.second, owner.first)) {
+                continue;
+            }
+            shared_tables_size += EncodeFixed64(buf + msg_size + shared_tables_size, owner.first);
+            shared_tables_size += EncodeStr(buf + msg_size + shared_tables_size, owner.second);
+            num_shared_tables += 1;
+        }
+        EncodeFixed32(buf + msg_size, num_shared_tables);
+        msg_size += shared_tables_size;
+        if (live_migration) {
+            // Flushes and compactions continue until the handoff. They must
+            // not delete the tables and log files that the destination
+            // recovers from.
+            for (const auto &owner : owners) {
+                migrated_tables_.insert(owner.first);
+            }
+            std::lock_guard<std::mutex> lock(migration_tail_mutex_);
+            migration_tail_.clear();
+            migration_log_files_.clear();
+            keep_migration_log_files_ = true;
+            capture_migration_tail_ = true;
+        }
         {
             uint32_t header_size = 1;
             buf[0] = StoCRequestType::LTC_MIGRATION;
@@ -348,10 +476,11 @@ namespace leveldb {
         }
         mutex_.Unlock();
         NOVA_LOG(rdmaio::INFO)
-            << fmt::format("{}-{}: v:{} srs:{} mp:{} log:{} lookupidx:{} tid:{} rangeidx:{} {} {} {} {}", msg_size,
-                           options_.max_stoc_file_size, version_size, srs_size, memtables_size, logfile_size,
-                           lookup_index_size, tableid_mapping_size, range_index_size, dbid_, v->version_id_,
-                           versions_->last_sequence_, versions_->next_file_number_);
+            << fmt::format("{}-{}: v:{} srs:{} mp:{} log:{} lookupidx:{} tid:{} rangeidx:{} shared:{} {} {} {} {}",
+                           msg_size, options_.max_stoc_file_size, version_size, srs_size, memtables_size,
+                           logfile_size, lookup_index_size, tableid_mapping_size, range_index_size,
+                           num_shared_tables, dbid_, v->version_id_, versions_->last_sequence_,
+                           versions_->next_file_number_);
         NOVA_ASSERT(msg_size < options_.max_stoc_file_size)
             << fmt::format("{}-{}: v:{} srs:{} mp:{} log:{} lookupidx:{} tid:{} rangeidx:{}", msg_size,
                            options_.max_stoc_file_size, version_size, srs_size, memtables_size, logfile_size,
@@ -362,7 +491,8 @@ namespace leveldb {
     void
     DBImpl::RecoverDBMetadata(const Slice &buf, uint32_t version_id, uint64_t last_sequence, uint64_t next_file_number,
                               uint64_t memtable_id_seq, nova::StoCInMemoryLogFileManager *log_manager,
-                              std::unordered_map<uint32_t, leveldb::MemTableLogFilePair> *mid_table_map) {
+                              std::unordered_map<uint32_t, leveldb::MemTableLogFilePair> *mid_table_map,
+                              bool pin_shared_tables) {
         Slice tmp = buf;
         uint32_t size = tmp.size();
         memtable_id_seq_ = memtable_id_seq;
@@ -388,7 +518,16 @@ namespace leveldb {
         NOVA_LOG(rdmaio::INFO) << fmt::format("Decoded {} bytes: db:{}, Log manager", size - tmp.size(), dbid_);
         size = tmp.size();
 
-        lookup_index_->Decode(&tmp);
+        if (DecodeFixed32(tmp.data()) == lookup_index_->size()) {
+            lookup_index_->Decode(&tmp);
+        } else {
+            // The range of a split is smaller than the range of its source.
+            LookupIndex encoded(DecodeFixed32(tmp.data()));
+            encoded.Decode(&tmp);
+            key_range_mutex_.Lock();
+            lookup_index_->CopyFrom(&encoded, std::stoull(lower_key_), std::stoull(upper_key_));
+            key_range_mutex_.Unlock();
+        }
         NOVA_LOG(rdmaio::INFO) << fmt::format("Decoded {} bytes: db:{}, Lookup index", size - tmp.size(), dbid_);
         size = tmp.size();
 
@@ -402,6 +541,27 @@ namespace leveldb {
             << fmt::format("Decoded {} bytes: db:{}, Range idx: {}", size - tmp.size(), dbid_,
                            range_index->DebugString());
         size = tmp.size();
+
+        uint32_t num_shared_tables = 0;
+        std::unordered_map<uint64_t, std::string> shared_tables;
+        NOVA_ASSERT(DecodeFixed32(&tmp, &num_shared_tables));
+        for (int i = 0; i < num_shared_tables; i++) {
+            uint64_t file_number = 0;
+            std::string owner;
+            NOVA_ASSERT(DecodeFixed64(&tmp, &file_number));
+            NOVA_ASSERT(DecodeStr(&tmp, &owner));
+            shared_tables[file_number] = owner;
+            if (owner != dbname_) {
+                inherited_tables_[file_number] = owner;
+            }
+        }
+        if (pin_shared_tables) {
+            SharedTables::tables->Share(shared_tables);
+        }
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("Decoded {} bytes: db:{}, Shared tables: {}", size - tmp.size(), dbid_,
+                           num_shared_tables);
+        size = tmp.size();
         // Remove memtables that do not exist in tableid-mapping.
 
         for (int j = 0; j < range_index->ranges_.size(); j++) {
@@ -412,8 +572,8 @@ namespace leveldb {
             for (int i = 0; i < srs->subranges.size(); i++) {
                 const auto &sr = srs->subranges[i];
                 const auto &partition = partitioned_active_memtables_[i];
-                if (range.upper_int() < sr.tiny_ranges[0].lower_int() ||
-                    range.lower_int() > sr.tiny_ranges[sr.tiny_ranges.size() - 1].upper_int()) {
+                if (user_comparator_->Compare(range.upper, sr.tiny_ranges[0].lower) < 0 ||
+                    user_comparator_->Compare(range.lower, sr.tiny_ranges[sr.tiny_ranges.size() - 1].upper) > 0) {
                     continue;
                 }
                 // overlapping.
@@ -500,7 +660,17 @@ namespace leveldb {
             }
             // The file can be deleted.
             table_cache_->Evict(meta.number, false);
-            ObtainStoCFilesOfSSTable(files_to_delete, server_pairs, meta);
+            std::string owner = dbname_;
+            auto inherited = inherited_tables_.find(fn);
+            if (inherited != inherited_tables_.end()) {
+                owner = inherited->second;
+                inherited_tables_.erase(inherited);
+            }
+            // Another database of a split may still use it. The destination
+            // of a live migration owns the tables of its snapshot.
+            if (SharedTables::tables->Release(owner, fn) && migrated_tables_.find(fn) == migrated_tables_.end()) {
+                ObtainStoCFilesOfSSTable(files_to_delete, server_pairs, meta, owner);
+            }
             success += 1;
             it = compacted_tables_.erase(it);
         }
@@ -509,16 +679,17 @@ namespace leveldb {
                 << fmt::format("Delete files. Success:{} Failed:{}", success,
                                compacted_tables_.size());
         }
+        ObtainObsoleteReplicas(server_pairs);
     }
 
     void DBImpl::ObtainStoCFilesOfSSTable(std::vector<std::string> *files_to_delete,
                                           std::unordered_map<uint32_t, std::vector<SSTableStoCFilePair>> *server_pairs,
-                                          const FileMetaData &meta) const {
+                                          const FileMetaData &meta, const std::string &owner) const {
         // Delete metadata file.
         for (int replica_id = 0; replica_id <
                                  nova::NovaConfig::config->number_of_sstable_metadata_replicas; replica_id++) {
             SSTableStoCFilePair pair = {};
-            pair.sstable_name = TableFileName(this->dbname_, meta.number, FileInternalType::kFileMetadata, replica_id);
+            pair.sstable_name = TableFileName(owner, meta.number, FileInternalType::kFileMetadata, replica_id);
             pair.stoc_file_id = meta.block_replica_handles[replica_id].meta_block_handle.stoc_file_id;
             (*server_pairs)[meta.block_replica_handles[replica_id].meta_block_handle.server_id].push_back(pair);
         }
@@ -528,7 +699,7 @@ namespace leveldb {
             auto handles = meta.block_replica_handles[replica_id].data_block_group_handles;
             for (int i = 0; i < handles.size(); i++) {
                 SSTableStoCFilePair pair = {};
-                pair.sstable_name = TableFileName(this->dbname_, meta.number, FileInternalType::kFileData, replica_id);
+                pair.sstable_name = TableFileName(owner, meta.number, FileInternalType::kFileData, replica_id);
                 pair.stoc_file_id = handles[i].stoc_file_id;
                 (*server_pairs)[handles[i].server_id].push_back(pair);
             }
@@ -539,7 +710,7 @@ namespace leveldb {
         if (nova::NovaConfig::config->use_parity_for_sstable_data_blocks) {
             auto handle = meta.parity_block_handle;
             SSTableStoCFilePair pair = {};
-            pair.sstable_name = TableFileName(this->dbname_, meta.number, FileInternalType::kFileParity, 0);
+            pair.sstable_name = TableFileName(owner, meta.number, FileInternalType::kFileParity, 0);
             pair.stoc_file_id = handle.stoc_file_id;
             (*server_pairs)[handle.server_id].push_back(pair);
         }
@@ -788,8 +959,8 @@ namespace leveldb {
                 }
             } else {
                 Range r = {};
-                r.lower = std::to_string(options_.lower_key);
-                r.upper = std::to_string(options_.upper_key);
+                r.lower = options_.lower_key;
+                r.upper = options_.upper_key;
                 init->ranges_.push_back(r);
                 RangeTables tables = {};
                 for (int i = 0; i < partitioned_active_memtables_.size(); i++) {
@@ -815,6 +986,9 @@ namespace leveldb {
         gettimeofday(&rdma_read_complete, nullptr);
 
         NOVA_ASSERT(RecoverLogFile(logfile_buf, &recovered_log_records, &rdma_read_complete).ok());
+        if (local_log_) {
+            RecoverLocalLogFiles(&recovered_log_records);
+        }
         timeval end = {};
         gettimeofday(&end, nullptr);
 
@@ -828,6 +1002,63 @@ namespace leveldb {
         return Status::OK();
     }
 
+    void DBImpl::RecoverLocalLogFiles(uint32_t *recovered_log_records) {
+        std::vector<DiskLogRecord> log_records;
+        local_log_->ReadOldLogFiles(options_.num_recovery_thread, &log_records);
+        if (!log_records.empty()) {
+            uint64_t last_sequence = log_records.back().sequence_number + 1;
+            if (versions_->last_sequence_ < last_sequence) {
+                versions_->last_sequence_ = last_sequence;
+            }
+        }
+        // Replay with their original sequence numbers so that a crash during
+        // recovery does not reorder the log records. A key is always replayed
+        // by the same thread in the order of its sequence numbers.
+        uint32_t num_threads = std::max(1u, (uint32_t) options_.num_recovery_thread);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < num_threads; t++) {
+            threads.emplace_back([&, t]() {
+                unsigned int rand_seed = t;
+                WriteOptions wo;
+                wo.stoc_client = options_.stoc_client;
+                wo.local_write = false;
+                wo.thread_id = t;
+                wo.rand_seed = &rand_seed;
+                wo.is_loading_db = false;
+                for (const auto &record : log_records) {
+                    uint64_t hash = nova::keyhash(record.key.data(), record.key.size());
+                    if (hash % num_threads != t) {
+                        continue;
+                    }
+                    Slice key(record.key);
+                    Slice value(record.value);
+                    wo.hash = nova::keyhash(key.data(), key.size());
+                    if (options_.memtable_type != MemTableType::kStaticPartition) {
+                        // The memtable pool assigns new sequence numbers.
+                        NOVA_ASSERT(Put(wo, key, value).ok());
+                    } else if (options_.enable_subranges) {
+                        SubRange *subrange = nullptr;
+                        int subrange_id = subrange_manager_->SearchSubranges(wo, key, value, &subrange);
+                        NOVA_ASSERT(subrange_id >= 0);
+                        NOVA_ASSERT(WriteStaticPartition(wo, key, value, subrange_id, true,
+                                                         record.sequence_number, subrange));
+                    } else {
+                        uint32_t partition_id = rand_r(&rand_seed) % partitioned_active_memtables_.size();
+                        NOVA_ASSERT(WriteStaticPartition(wo, key, value, partition_id, true,
+                                                         record.sequence_number, nullptr));
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        local_log_->DeleteOldLogFiles();
+        *recovered_log_records += log_records.size();
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("Recovered {} log records from local disk", log_records.size());
+    }
+
     Status
     DBImpl::RecoverLogFile(
             const std::unordered_map<std::string, uint64_t> &logfile_buf,
@@ -1077,6 +1308,7 @@ namespace leveldb {
                           meta.largest,
                           meta.block_replica_handles, meta.parity_block_handle);
             nova::NovaGlobalVariables::global.written_memtable_sizes += meta.file_size;
+            flushed_bytes_ += meta.file_size;
         }
     }
 
@@ -1272,6 +1504,7 @@ namespace leveldb {
                              meta.smallest,
                              meta.largest,
                              meta.block_replica_handles, meta.parity_block_handle);
+                flushed_bytes_ += meta.file_size;
             }
             NOVA_LOG(rdmaio::DEBUG)
                 << fmt::format(
@@ -1325,20 +1558,26 @@ namespace leveldb {
             for (const auto &file : closed_memtable_log_files) {
                 logs.push_back(nova::LogFileName(dbid_, file));
             }
-            bg_thread->stoc_client()->InitiateCloseLogFiles(logs, dbid_);
+            if (!KeepLogFilesForMigration(logs)) {
+                bg_thread->stoc_client()->InitiateCloseLogFiles(logs, dbid_);
+            }
+        }
+        if (local_log_ && !closed_memtable_log_files.empty()) {
+            local_log_->DeleteLogFiles(closed_memtable_log_files);
         }
 
         options_.memtable_pool->mutex_.lock();
-        options_.memtable_pool->num_available_memtables_ += num_available;
+        options_.memtable_pool->Release(num_available);
         NOVA_ASSERT(options_.memtable_pool->num_available_memtables_ <
-                    nova::NovaConfig::config->num_memtables -
+                    options_.memtable_pool->capacity_ -
                     nova::NovaConfig::config->cfgs[0]->fragments.size());
         options_.memtable_pool->mutex_.unlock();
 
         if (wakeup_all) {
-            for (int i = 0;
-                 i < nova::NovaConfig::config->cfgs[0]->fragments.size(); i++) {
-                options_.memtable_pool->range_cond_vars_[i]->SignalAll();
+            for (int i = 0; i < nova::NovaConfig::config->max_num_ranges; i++) {
+                if (options_.memtable_pool->range_cond_vars_[i]) {
+                    options_.memtable_pool->range_cond_vars_[i]->SignalAll();
+                }
             }
         } else {
             options_.memtable_pool->range_cond_vars_[dbid_]->SignalAll();
@@ -1353,6 +1592,67 @@ namespace leveldb {
         }
     }
 
+    double DBImpl::StallRisk() {
+        double risk = 0;
+        if (options_.num_memtables > 0) {
+            risk = (double) number_of_immutable_memtables_ / (double) options_.num_memtables;
+        }
+        if (options_.l0bytes_stop_writes_trigger > 0) {
+            Version *current = nullptr;
+            while (current == nullptr) {
+                uint32_t vid = versions_->current_version_id();
+                NOVA_ASSERT(vid < MAX_LIVE_MEMTABLES) << vid;
+                current = versions_->versions_[vid]->Ref();
+            }
+            risk = std::max(risk, (double) current->l0_bytes_ / (double) options_.l0bytes_stop_writes_trigger);
+            versions_->versions_[current->version_id_]->Unref(dbname_);
+        }
+        if (write_controller_) {
+            risk = std::max(risk, write_controller_->pressure());
+        }
+        return risk;
+    }
+
+    void DBImpl::RefreshWritePressure() {
+        if (!write_controller_) {
+            return;
+        }
+        Version *current = nullptr;
+        while (current == nullptr) {
+            uint32_t vid = versions_->current_version_id();
+            NOVA_ASSERT(vid < MAX_LIVE_MEMTABLES) << vid;
+            current = versions_->versions_[vid]->Ref();
+        }
+        write_controller_->Refresh(current->l0_bytes_, current->pending_compaction_bytes_,
+                                   number_of_immutable_memtables_);
+        versions_->versions_[current->version_id_]->Unref(dbname_);
+    }
+
+    void DBImpl::ThrottleWrite(uint64_t bytes) {
+        uint64_t now = env_->NowMicros();
+        if (write_controller_->ShouldRefresh(now)) {
+            RefreshWritePressure();
+        }
+        uint64_t delay = write_controller_->GetDelay(now, bytes);
+        if (delay > 0) {
+            number_of_puts_delayed_ += 1;
+            write_delay_us_ += delay;
+            env_->SleepForMicroseconds(delay);
+        }
+    }
+
+    SequenceNumber DBImpl::NextSequenceNumber(const WriteOptions &options) {
+        if (options.sequence_number == 0) {
+            return versions_->last_sequence_.fetch_add(1);
+        }
+        // Keep the following writes after the replayed write.
+        uint64_t last_sequence = versions_->last_sequence_;
+        while (last_sequence <= options.sequence_number &&
+               !versions_->last_sequence_.compare_exchange_weak(last_sequence, options.sequence_number + 1)) {
+        }
+        return options.sequence_number;
+    }
+
     void DBImpl::ScheduleCompactionTask(int thread_id, void *compaction) {
         EnvBGTask task = {};
         task.db = this;
@@ -1517,6 +1817,7 @@ namespace leveldb {
             mutex_.Unlock();
         }
         DeleteFiles(bg_thread, files_to_delete, server_pairs);
+        RefreshWritePressure();
         // Delete log files.
         if (nova::NovaConfig::config->log_record_mode == nova::NovaLogRecordMode::LOG_RDMA &&
             !closed_memtable_log_files.empty()) {
@@ -1524,8 +1825,13 @@ namespace leveldb {
             for (const auto &file : closed_memtable_log_files) {
                 logs.push_back(nova::LogFileName(dbid_, file));
             }
-            log_manager_->DeleteLogBuf(logs);
-            bg_thread->stoc_client()->InitiateCloseLogFiles(logs, dbid_);
+            if (!KeepLogFilesForMigration(logs)) {
+                log_manager_->DeleteLogBuf(logs);
+                bg_thread->stoc_client()->InitiateCloseLogFiles(logs, dbid_);
+            }
+        }
+        if (local_log_ && !closed_memtable_log_files.empty()) {
+            local_log_->DeleteLogFiles(closed_memtable_log_files);
         }
         for (const auto &task : sstable_tasks) {
             CompactionState *state = reinterpret_cast<CompactionState *> (task.compaction_task);
@@ -1535,7 +1841,12 @@ namespace leveldb {
             CompactionStats stats = state->BuildStats();
             std::function<uint64_t(void)> fn_generator = std::bind(
                     &VersionSet::NewFileNumber, versions_);
-            CompactionJob job(fn_generator, env_, dbname_, user_comparator_, options_, bg_thread, table_cache_);
+            Options options = options_;
+            key_range_mutex_.Lock();
+            options.lower_key = lower_key_;
+            options.upper_key = upper_key_;
+            key_range_mutex_.Unlock();
+            CompactionJob job(fn_generator, env_, dbname_, user_comparator_, options, bg_thread, table_cache_);
             Status status = job.CompactTables(state, input, &stats, true, kCompactInputSSTables,
                                               kCompactOutputSSTables);
         }
@@ -1550,7 +1861,7 @@ namespace leveldb {
         bool moves = false;
         auto frags = nova::NovaConfig::config->cfgs[0];
         if (nova::NovaConfig::config->cfgs.size() == 1 && frags->fragments.size() == 1 &&
-            frags->fragments[frags->fragments.size() - 1]->range.key_end == 1000000000 && is_loading_db_) {
+            frags->fragments[frags->fragments.size() - 1]->range.key_end == "1000000000" && is_loading_db_) {
             // 1 TB database with one range.
             std::vector<uint64_t> level_size;
             std::vector<uint64_t> max_level_size;
@@ -1561,7 +1872,7 @@ namespace leveldb {
                 level_size[level] = 0;
             }
             for (int level = 0; level < options_.level; level++) {
-                max_level_size[level] = MaxBytesForLevel(options_, level);
+                max_level_size[level] = current->TargetBytesForLevel(level);
                 if (level == 0) {
                     max_level_size[level] = 0;
                 }
@@ -1588,6 +1899,9 @@ namespace leveldb {
                     }
                 }
             }
+        } else if (options_.compaction_style == kCompactionStyleTiered &&
+                   current->ComputeTieredCompactions(compactions)) {
+            // Merge sorted runs at level 0.
         } else {
             current->ComputeNonOverlappingSet(compactions, delete_due_to_low_overlap);
         }
@@ -1685,6 +1999,17 @@ namespace leveldb {
                 sleep(1);
                 continue;
             }
+            // Do not compact SSTables whose replicas are being moved. Only
+            // the coordinator inserts compaction inputs.
+            mutex_compacting_tables.Lock();
+            bool is_moving_replicas = !compacting_tables_.empty();
+            is_picking_compactions_ = !is_moving_replicas;
+            mutex_compacting_tables.Unlock();
+            if (is_moving_replicas) {
+                mutex_.Unlock();
+                sleep(1);
+                continue;
+            }
             NOVA_ASSERT(versions_->versions_[current->version_id()]->Ref() == current);
             NOVA_LOG(rdmaio::DEBUG)
                 << fmt::format("comv-init {} {}", current->version_id_, current->refs_);
@@ -1720,6 +2045,7 @@ namespace leveldb {
                     }
                 }
             }
+            is_picking_compactions_ = false;
             mutex_compacting_tables.Unlock();
 
             for (int i = 0; i < compactions.size(); i++) {
@@ -1996,6 +2322,7 @@ namespace leveldb {
         }
         mutex_.Unlock();
         DeleteFiles(compaction_coordinator_thread_, files_to_delete, server_pairs);
+        RefreshWritePressure();
 
         for (int i = 0; i < partitioned_active_memtables_.size(); i++) {
             partitioned_active_memtables_[i]->background_work_finished_signal_.SignalAll();
@@ -2009,8 +2336,18 @@ namespace leveldb {
                                             VersionEdit *edit,
                                             int target_level) {
         // Add compaction outputs
+        uint64_t flush_timestamp = versions_->last_sequence_;
         if (compact->compaction) {
             compact->compaction->AddInputDeletions(edit);
+            if (options_.compaction_style == kCompactionStyleTiered &&
+                compact->compaction->level() == 0 && target_level == 0) {
+                // The merged sorted run takes the place of its newest input
+                // sorted run so that reads still check sorted runs newest first.
+                flush_timestamp = 0;
+                for (auto f : compact->compaction->inputs_[0]) {
+                    flush_timestamp = std::max(flush_timestamp, f->flush_timestamp);
+                }
+            }
         }
         for (size_t i = 0; i < compact->outputs.size(); i++) {
             const FileMetaData &out = compact->outputs[i];
@@ -2019,10 +2356,11 @@ namespace leveldb {
                           out.number,
                           out.file_size,
                           out.converted_file_size,
-                          versions_->last_sequence_,
+                          flush_timestamp,
                           out.smallest, out.largest,
                           out.block_replica_handles,
                           out.parity_block_handle);
+            compaction_output_bytes_ += out.file_size;
         }
         return Status::OK();
     }
@@ -2219,6 +2557,61 @@ namespace leveldb {
         start_compaction_ = false;
     }
 
+    void DBImpl::ReleaseTables(StoCClient *client) {
+        std::vector<std::string> files_to_delete;
+        std::unordered_map<uint32_t, std::vector<SSTableStoCFilePair>> server_pairs;
+        mutex_.Lock();
+        // A table is either in the current version or waits for deletion.
+        std::unordered_map<uint64_t, FileMetaData> tables = compacted_tables_;
+        compacted_tables_.clear();
+        Version *current = versions_->current();
+        for (int level = 0; level < options_.level; level++) {
+            for (auto file : current->files_[level]) {
+                tables[file->number] = *file;
+            }
+        }
+        for (const auto &it : tables) {
+            std::string owner = dbname_;
+            auto inherited = inherited_tables_.find(it.first);
+            if (inherited != inherited_tables_.end()) {
+                owner = inherited->second;
+            }
+            if (SharedTables::tables->Release(owner, it.first) &&
+                migrated_tables_.find(it.first) == migrated_tables_.end()) {
+                table_cache_->Evict(it.first, false);
+                ObtainStoCFilesOfSSTable(&files_to_delete, &server_pairs, it.second, owner);
+            }
+        }
+        inherited_tables_.clear();
+        mutex_.Unlock();
+
+        for (const std::string &filename : files_to_delete) {
+            env_->DeleteFile(dbname_ + "/" + filename);
+        }
+        for (auto &it : server_pairs) {
+            client->InitiateDeleteTables(it.first, it.second);
+        }
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("db[{}]: Released {} tables on {} StoCs", dbid_, tables.size(), server_pairs.size());
+    }
+
+    void DBImpl::SetKeyRange(const std::string &lower, const std::string &upper) {
+        key_range_mutex_.Lock();
+        lower_key_ = lower;
+        upper_key_ = upper;
+        key_range_mutex_.Unlock();
+        if (subrange_manager_) {
+            subrange_manager_->SetKeyRange(lower, upper);
+        }
+    }
+
+    std::string DBImpl::MedianKey() {
+        if (!subrange_manager_) {
+            return "";
+        }
+        return subrange_manager_->MedianKey();
+    }
+
     Iterator *DBImpl::NewIterator(const ReadOptions &options) {
         scan_stats.number_of_scans_ += 1;
         SequenceNumber latest_snapshot;
@@ -2242,6 +2635,15 @@ namespace leveldb {
     Status
     DBImpl::Put(const WriteOptions &o, const Slice &key, const Slice &val) {
         processed_writes_ += 1;
+        if (write_controller_ && !o.is_loading_db) {
+            ThrottleWrite(key.size() + val.size());
+        }
+        uint64_t memory_delay = nova::NovaGlobalVariables::global.memory_write_delay_us;
+        if (memory_delay > 0 && !o.is_loading_db) {
+            number_of_puts_delayed_ += 1;
+            write_delay_us_ += memory_delay;
+            env_->SleepForMicroseconds(memory_delay);
+        }
         if (options_.memtable_type == MemTableType::kStaticPartition) {
             if (o.is_loading_db || !options_.enable_subranges) {
                 return WriteStaticPartition(o, key, val);
@@ -2365,6 +2767,212 @@ namespace leveldb {
         return msg_size;
     }
 
+    void DBImpl::CaptureMigrationTail(SequenceNumber sequence, const Slice &key, const Slice &val) {
+        if (!capture_migration_tail_) {
+            return;
+        }
+        LevelDBLogRecord record = {};
+        record.sequence_number = sequence;
+        record.key = key;
+        record.value = val;
+        uint32_t record_size = nova::LogRecordSize(record);
+        // A chunk fits in a message with its header.
+        uint32_t max_chunk_size = options_.max_stoc_file_size - 1024;
+        NOVA_ASSERT(record_size < max_chunk_size);
+        std::lock_guard<std::mutex> lock(migration_tail_mutex_);
+        if (migration_tail_.empty() || migration_tail_.back().size() + record_size > max_chunk_size) {
+            migration_tail_.emplace_back();
+        }
+        std::string &chunk = migration_tail_.back();
+        size_t size = chunk.size();
+        chunk.resize(size + record_size);
+        nova::EncodeLogRecord(&chunk[size], record);
+    }
+
+    bool DBImpl::KeepLogFilesForMigration(const std::vector<std::string> &log_files) {
+        std::lock_guard<std::mutex> lock(migration_tail_mutex_);
+        if (!keep_migration_log_files_) {
+            return false;
+        }
+        migration_log_files_.insert(migration_log_files_.end(), log_files.begin(), log_files.end());
+        return true;
+    }
+
+    void DBImpl::QueryMigrationLogFiles(std::vector<std::string> *log_files) {
+        std::lock_guard<std::mutex> lock(migration_tail_mutex_);
+        log_files->insert(log_files->end(), migration_log_files_.begin(), migration_log_files_.end());
+    }
+
+    uint32_t DBImpl::EncodeMigrationTail(char *buf, uint32_t cfg_id, const std::vector<std::string> &log_files,
+                                         bool *last) {
+        std::lock_guard<std::mutex> lock(migration_tail_mutex_);
+        capture_migration_tail_ = false;
+        std::string chunk;
+        if (!migration_tail_.empty()) {
+            chunk = std::move(migration_tail_.front());
+            migration_tail_.pop_front();
+        }
+        uint32_t msg_size = 1;
+        buf[0] = StoCRequestType::LTC_MIGRATION_TAIL;
+        msg_size += EncodeFixed32(buf + msg_size, cfg_id);
+        msg_size += EncodeFixed32(buf + msg_size, dbid_);
+        uint32_t log_files_size = 4;
+        for (const auto &log_file : log_files) {
+            log_files_size += 4 + log_file.size();
+        }
+        // The log files follow the last chunk if they fit in the message.
+        // Otherwise, they are sent in another message without writes.
+        *last = migration_tail_.empty() &&
+                msg_size + 1 + 4 + chunk.size() + log_files_size < options_.max_stoc_file_size;
+        buf[msg_size] = *last ? 1 : 0;
+        msg_size += 1;
+        msg_size += EncodeFixed32(buf + msg_size, chunk.size());
+        memcpy(buf + msg_size, chunk.data(), chunk.size());
+        msg_size += chunk.size();
+        if (*last) {
+            msg_size += EncodeFixed32(buf + msg_size, log_files.size());
+            for (const auto &log_file : log_files) {
+                msg_size += EncodeStr(buf + msg_size, log_file);
+            }
+        }
+        NOVA_ASSERT(msg_size < options_.max_stoc_file_size)
+            << fmt::format("db[{}]: migration tail of {} bytes", dbid_, msg_size);
+        return msg_size;
+    }
+
+    uint32_t DBImpl::EncodeHotBlocks(char *buf, uint32_t cfg_id, uint32_t max_blocks, uint32_t max_size) {
+        std::vector<CachedBlock> tables;
+        std::vector<CachedBlock> blocks;
+        table_cache_->RecentlyUsed(options_.block_cache, &tables, &blocks);
+
+        Version *current = nullptr;
+        while (current == nullptr) {
+            uint32_t vid = versions_->current_version_id();
+            NOVA_ASSERT(vid < MAX_LIVE_MEMTABLES) << vid;
+            current = versions_->versions_[vid]->Ref();
+        }
+        uint32_t msg_size = 1;
+        buf[0] = StoCRequestType::LTC_MIGRATION_WARM_CACHE;
+        msg_size += EncodeFixed32(buf + msg_size, cfg_id);
+        msg_size += EncodeFixed32(buf + msg_size, dbid_);
+        // Skip the tables deleted by compactions.
+        uint32_t num_tables = 0;
+        uint32_t num_tables_offset = msg_size;
+        msg_size += 4;
+        for (const auto &table : tables) {
+            if (current->fn_files_.find(table.file_number) == current->fn_files_.end()) {
+                continue;
+            }
+            if (msg_size + 8 + 4 + 4 > max_size) {
+                break;
+            }
+            msg_size += EncodeFixed64(buf + msg_size, table.file_number);
+            msg_size += EncodeFixed32(buf + msg_size, table.replica_id);
+            num_tables++;
+        }
+        EncodeFixed32(buf + num_tables_offset, num_tables);
+        uint32_t num_blocks = 0;
+        uint32_t num_blocks_offset = msg_size;
+        msg_size += 4;
+        for (const auto &block : blocks) {
+            if (num_blocks == max_blocks ||
+                msg_size + 8 + 4 + StoCBlockHandle::HandleSize() > max_size) {
+                break;
+            }
+            if (current->fn_files_.find(block.file_number) == current->fn_files_.end()) {
+                continue;
+            }
+            msg_size += EncodeFixed64(buf + msg_size, block.file_number);
+            msg_size += EncodeFixed32(buf + msg_size, block.replica_id);
+            block.handle.EncodeHandle(buf + msg_size);
+            msg_size += StoCBlockHandle::HandleSize();
+            num_blocks++;
+        }
+        EncodeFixed32(buf + num_blocks_offset, num_blocks);
+        versions_->versions_[current->version_id_]->Unref(dbname_);
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("db[{}]: Hot tables:{} blocks:{} msg:{}", dbid_, num_tables, num_blocks, msg_size);
+        return msg_size;
+    }
+
+    void DBImpl::WarmCache(Slice *buf, const ReadOptions &options, uint32_t *opened_tables,
+                           uint32_t *read_blocks) {
+        *opened_tables = 0;
+        *read_blocks = 0;
+        Version *current = nullptr;
+        while (current == nullptr) {
+            uint32_t vid = versions_->current_version_id();
+            NOVA_ASSERT(vid < MAX_LIVE_MEMTABLES) << vid;
+            current = versions_->versions_[vid]->Ref();
+        }
+        uint32_t num_tables = 0;
+        NOVA_ASSERT(DecodeFixed32(buf, &num_tables));
+        for (uint32_t i = 0; i < num_tables; i++) {
+            uint64_t file_number = 0;
+            uint32_t replica_id = 0;
+            NOVA_ASSERT(DecodeFixed64(buf, &file_number));
+            NOVA_ASSERT(DecodeFixed32(buf, &replica_id));
+            auto it = current->fn_files_.find(file_number);
+            if (it == current->fn_files_.end()) {
+                continue;
+            }
+            table_cache_->Prefetch(options, it->second, it->second->SelectReplica(), {});
+            *opened_tables += 1;
+        }
+
+        uint32_t num_blocks = 0;
+        NOVA_ASSERT(DecodeFixed32(buf, &num_blocks));
+        // Read consecutive blocks of the same table together.
+        const FileMetaData *meta = nullptr;
+        std::vector<StoCBlockHandle> handles;
+        Cache *block_cache = options_.block_cache;
+        // All ranges of the LTC share the block cache. Warm up to the share
+        // of this range.
+        uint64_t max_bytes = 0;
+        if (block_cache) {
+            uint32_t num_ranges = 0;
+            for (auto frag : nova::NovaConfig::config->cfgs[options.cfg_id]->fragments) {
+                if (frag->ltc_server_id == nova::NovaConfig::config->my_server_id && !frag->IsRetired()) {
+                    num_ranges += 1;
+                }
+            }
+            max_bytes = block_cache->TotalCapacity() / std::max(1u, num_ranges);
+        }
+        uint64_t warmed_bytes = 0;
+        for (uint32_t i = 0; i <= num_blocks; i++) {
+            uint64_t file_number = 0;
+            uint32_t replica_id = 0;
+            StoCBlockHandle handle = {};
+            if (i < num_blocks) {
+                NOVA_ASSERT(DecodeFixed64(buf, &file_number));
+                NOVA_ASSERT(DecodeFixed32(buf, &replica_id));
+                NOVA_ASSERT(StoCBlockHandle::DecodeHandle(buf, &handle));
+            }
+            if (meta && (i == num_blocks || meta->number != file_number)) {
+                *read_blocks += table_cache_->Prefetch(options, meta, meta->SelectReplica(), handles);
+                for (const auto &h : handles) {
+                    warmed_bytes += h.size;
+                }
+                handles.clear();
+                meta = nullptr;
+                if (block_cache && warmed_bytes >= max_bytes) {
+                    break;
+                }
+            }
+            if (i == num_blocks) {
+                break;
+            }
+            auto it = current->fn_files_.find(file_number);
+            // The blocks of another replica have different handles.
+            if (it == current->fn_files_.end() || it->second->SelectReplica() != replica_id) {
+                continue;
+            }
+            meta = it->second;
+            handles.push_back(handle);
+        }
+        versions_->versions_[current->version_id_]->Unref(dbname_);
+    }
+
     void DBImpl::DecodeMemTablePartitions(Slice *buf,
                                           std::unordered_map<uint32_t, leveldb::MemTableLogFilePair> *mid_table_map) {
         auto srs = subrange_manager_->latest_subranges_.load();
@@ -2441,6 +3049,16 @@ namespace leveldb {
     }
 
     uint32_t DBImpl::FlushMemTables(bool flush_active_memtable) {
+        return FlushMemTables(flush_active_memtable, nullptr);
+    }
+
+    bool DBImpl::IsFlushed(uint32_t memtable_id) {
+        AtomicMemTable *atomic_memtable = versions_->mid_table_mapping_[memtable_id];
+        std::lock_guard<std::mutex> lock(atomic_memtable->mutex_);
+        return atomic_memtable->is_flushed_;
+    }
+
+    uint32_t DBImpl::FlushMemTables(bool flush_active_memtable, std::vector<uint32_t> *memtable_ids) {
         NOVA_LOG(rdmaio::INFO) << "Flush memtables";
         struct ImmutableTable {
             int thread_id;
@@ -2511,6 +3129,9 @@ namespace leveldb {
             partition->mutex.Unlock();
         }
         for (auto &imm : imms) {
+            if (memtable_ids) {
+                memtable_ids->push_back(imm.memtable_id);
+            }
             ScheduleFlushMemTableTask(imm.thread_id, imm.memtable_id, imm.table, imm.partition_id, imm.next_imm_slot, &rand_seed_,
                                       false);
         }
@@ -2531,6 +3152,7 @@ namespace leveldb {
             NOVA_ASSERT(BinarySearch(subrange->tiny_ranges, key, &tinyrange_id, user_comparator_))
                 << fmt::format("key:{} range:{}", key.ToString(), subrange->DebugString());
             subrange->tiny_ranges[tinyrange_id].ninserts++;
+            subrange_manager_->RecordInsert(partition_id, key);
         }
 
         MemTable *table = nullptr;
@@ -2656,20 +3278,19 @@ namespace leveldb {
         auto atomic_mem = versions_->mid_table_mapping_[memtable_id];
         atomic_mem->number_of_pending_writes_ += 1;
         atomic_mem->memtable_size_ += (key.size() + value.size());
-        if (nova::NovaConfig::config->log_record_mode ==
-            nova::NovaLogRecordMode::LOG_RDMA && !options.local_write) {
+        if (IsLoggedWrite(options)) {
             partition->mutex.Unlock();
             GenerateLogRecord(options, last_sequence, key, value, memtable_id);
             partition->mutex.Lock();
         }
         table->Add(last_sequence, ValueType::kTypeValue, key, value);
+        CaptureMigrationTail(last_sequence, key, value);
         atomic_mem->number_of_pending_writes_ -= 1;
         versions_->mid_table_mapping_[memtable_id]->nentries_ += 1;
         if (lookup_index_) {
             lookup_index_->Insert(key, options.hash, table->memtableid());
         }
-        if (nova::NovaConfig::config->log_record_mode ==
-            nova::NovaLogRecordMode::LOG_RDMA && !options.local_write) {
+        if (IsLoggedWrite(options)) {
             if (atomic_mem->number_of_pending_writes_ == 0 &&
                 atomic_mem->memtable_size_ > options_.write_buffer_size) {
                 // Wake up other threads that are waiting on pending.
@@ -2701,7 +3322,7 @@ namespace leveldb {
 
     Status DBImpl::WriteStaticPartition(const WriteOptions &options,
                                         const Slice &key, const Slice &val) {
-        uint64_t last_sequence = versions_->last_sequence_.fetch_add(1);
+        uint64_t last_sequence = NextSequenceNumber(options);
         if (options.is_loading_db) {
             NOVA_ASSERT(WriteStaticPartition(options, key, val, 0, true, last_sequence, nullptr));
             return Status::OK();
@@ -2733,7 +3354,7 @@ namespace leveldb {
     Status DBImpl::WriteSubrange(const leveldb::WriteOptions &options,
                                  const leveldb::Slice &key,
                                  const leveldb::Slice &val) {
-        uint64_t last_sequence = versions_->last_sequence_.fetch_add(1);
+        uint64_t last_sequence = NextSequenceNumber(options);
         if (processed_writes_ > SUBRANGE_WARMUP_NPUTS &&
             processed_writes_ % SUBRANGE_REORG_INTERVAL == 0 &&
             options_.enable_subrange_reorg) {
@@ -2756,7 +3377,7 @@ namespace leveldb {
     Status DBImpl::WriteMemTablePool(const WriteOptions &options,
                                      const Slice &key,
                                      const Slice &val) {
-        uint64_t last_sequence = versions_->last_sequence_.fetch_add(1);
+        uint64_t last_sequence = NextSequenceNumber(options);
 
         std::vector<MemTable *> full_memtables;
         AtomicMemTable *atomic_memtable = nullptr;
@@ -3049,8 +3670,7 @@ namespace leveldb {
         NOVA_ASSERT(atomic_memtable->memtable_);
         atomic_memtable->memtable_size_ += (key.size() + val.size());
 
-        if (nova::NovaConfig::config->log_record_mode ==
-            nova::NovaLogRecordMode::LOG_RDMA && !options.local_write) {
+        if (IsLoggedWrite(options)) {
             // this memtable is selected. Replicate the log records first.
             // Increment the pending writes counter.
             atomic_memtable->number_of_pending_writes_ += 1;
@@ -3063,6 +3683,7 @@ namespace leveldb {
 
         atomic_memtable->memtable_->Add(last_sequence, ValueType::kTypeValue,
                                         key, val);
+        CaptureMigrationTail(last_sequence, key, val);
         atomic_memtable->nentries_ += 1;
         if (lookup_index_) {
             lookup_index_->Insert(key, options.hash,
@@ -3122,6 +3743,10 @@ namespace leveldb {
                     options.rdma_backing_mem, log_records,
                     options.replicate_log_record_states);
             stoc->Wait();
+        } else if (nova::NovaConfig::config->log_record_mode ==
+                   nova::NovaLogRecordMode::LOG_LOCAL_DISK && !options.local_write) {
+            NOVA_ASSERT(local_log_);
+            local_log_->AddRecords(memtable_id, log_records);
         }
     }
 
@@ -3145,6 +3770,14 @@ namespace leveldb {
                     options.rdma_backing_mem, {log_record},
                     options.replicate_log_record_states);
             stoc->Wait();
+        } else if (nova::NovaConfig::config->log_record_mode ==
+                   nova::NovaLogRecordMode::LOG_LOCAL_DISK && !options.local_write) {
+            NOVA_ASSERT(local_log_);
+            LevelDBLogRecord log_record = {};
+            log_record.sequence_number = last_sequence;
+            log_record.key = key;
+            log_record.value = val;
+            local_log_->AddRecords(memtable_id, {log_record});
         }
     }
 
@@ -3152,6 +3785,101 @@ namespace leveldb {
         return dbname_;
     }
 
+    void DBImpl::QueryStoCBytes(std::unordered_map<uint32_t, uint64_t> *stoc_bytes) {
+        Version *current = nullptr;
+        uint32_t vid = 0;
+        while (current == nullptr) {
+            vid = versions_->current_version_id();
+            current = versions_->versions_[vid]->Ref();
+        }
+        for (int level = 0; level < options_.level; level++) {
+            for (auto file : current->files_[level]) {
+                for (const auto &replica : file->block_replica_handles) {
+                    (*stoc_bytes)[replica.meta_block_handle.server_id] += replica.meta_block_handle.size;
+                    for (const auto &handle : replica.data_block_group_handles) {
+                        (*stoc_bytes)[handle.server_id] += handle.size;
+                    }
+                }
+                if (file->parity_block_handle.size > 0) {
+                    (*stoc_bytes)[file->parity_block_handle.server_id] += file->parity_block_handle.size;
+                }
+            }
+        }
+        versions_->versions_[vid]->Unref(dbname_);
+    }
+
+    uint64_t DBImpl::QueryReplicasToMove(uint32_t src_stoc_id, uint32_t dest_stoc_id, int level,
+                                         uint64_t max_bytes, std::vector<ReplicationPair> *pairs) {
+        Version *current = nullptr;
+        uint32_t vid = 0;
+        while (current == nullptr) {
+            vid = versions_->current_version_id();
+            current = versions_->versions_[vid]->Ref();
+        }
+        uint64_t bytes = 0;
+        mutex_.Lock();
+        mutex_compacting_tables.Lock();
+        for (auto file : current->files_[level]) {
+            if (bytes >= max_bytes || is_picking_compactions_) {
+                break;
+            }
+            if (compacting_tables_.find(file->number) != compacting_tables_.end() ||
+                inherited_tables_.find(file->number) != inherited_tables_.end() ||
+                SharedTables::tables->IsShared(dbname_, file->number)) {
+                continue;
+            }
+            bool on_dest = file->parity_block_handle.size > 0 && file->parity_block_handle.server_id == dest_stoc_id;
+            int src_replica_id = -1;
+            for (int replica_id = 0; replica_id < file->block_replica_handles.size(); replica_id++) {
+                const auto &replica = file->block_replica_handles[replica_id];
+                if (replica.data_block_group_handles.size() != 1) {
+                    on_dest = true;
+                    break;
+                }
+                if (replica.meta_block_handle.server_id == dest_stoc_id ||
+                    replica.data_block_group_handles[0].server_id == dest_stoc_id) {
+                    on_dest = true;
+                    break;
+                }
+                if (src_replica_id == -1 && replica.meta_block_handle.server_id == src_stoc_id &&
+                    replica.data_block_group_handles[0].server_id == src_stoc_id) {
+                    src_replica_id = replica_id;
+                }
+            }
+            // Keep the replicas of an SSTable on different StoCs.
+            if (on_dest || src_replica_id == -1) {
+                continue;
+            }
+            const auto &replica = file->block_replica_handles[src_replica_id];
+            ReplicationPair pair = {};
+            pair.dest_stoc_id = dest_stoc_id;
+            pair.sstable_file_number = file->number;
+            pair.replica_id = src_replica_id;
+            pair.internal_type = FileInternalType::kFileMetadata;
+            pair.source_stoc_file_id = replica.meta_block_handle.stoc_file_id;
+            pair.source_file_size = replica.meta_block_handle.size;
+            pairs->push_back(pair);
+            pair.internal_type = FileInternalType::kFileData;
+            pair.source_stoc_file_id = replica.data_block_group_handles[0].stoc_file_id;
+            pair.source_file_size = replica.data_block_group_handles[0].size;
+            pairs->push_back(pair);
+            bytes += replica.meta_block_handle.size + replica.data_block_group_handles[0].size;
+            compacting_tables_.insert(file->number);
+        }
+        mutex_compacting_tables.Unlock();
+        mutex_.Unlock();
+        versions_->versions_[vid]->Unref(dbname_);
+        return bytes;
+    }
+
+    void DBImpl::ReleaseReplicasToMove(const std::vector<ReplicationPair> &pairs) {
+        mutex_compacting_tables.Lock();
+        for (const auto &pair : pairs) {
+            compacting_tables_.erase(pair.sstable_file_number);
+        }
+        mutex_compacting_tables.Unlock();
+    }
+
     void DBImpl::QueryFailedReplicas(uint32_t failed_stoc_id,
                                      bool is_stoc_failed,
                                      std::unordered_map<uint32_t, std::vector<ReplicationPair> > *stoc_repl_pairs,
@@ -3241,6 +3969,7 @@ namespace leveldb {
         }
         current->QueryStats(db_stats, options_.enable_detailed_stats);
         versions_->versions_[vid]->Unref(dbname_);
+        RefreshWritePressure();
     }
 
     bool DBImpl::GetProperty(const Slice &property, std::string *value) {
@@ -3395,7 +4124,17 @@ namespace leveldb {
         impl->processed_writes_ = 0;
         impl->number_of_puts_no_wait_ = 0;
         impl->number_of_puts_wait_ = 0;
+        impl->number_of_puts_delayed_ = 0;
+        impl->write_delay_us_ = 0;
+        impl->flushed_bytes_ = 0;
+        impl->compaction_output_bytes_ = 0;
         impl->flush_order_ = new FlushOrder(&impl->partitioned_active_memtables_);
+        WriteController *write_controller = new WriteController(impl->options_);
+        if (write_controller->enabled()) {
+            impl->write_controller_ = write_controller;
+        } else {
+            delete write_controller;
+        }
 
         if (options.enable_subranges) {
             FlushOrder *flush_order = nullptr;
@@ -34,8 +34,10 @@
 #include "compaction.h"
 #include "lookup_index.h"
 #include "range_index.h"
+#include "write_controller.h"
 
 #include "log/log_recovery.h"
+#include "log/disk_log_writer.h"
 
 namespace leveldb {
 
@@ -112,6 +114,12 @@ namespace leveldb {
 
         void QueryDBStats(DBStats *db_stats) override;
 
+        // The risk that this db stalls writes, i.e., the larger of the
+        // fraction of memtables that are immutable and L0 bytes relative to
+        // the stop trigger. The compaction scheduler serves dbs with a high
+        // risk first.
+        double StallRisk() override;
+
         Status Recover() override;
 
         Status
@@ -120,6 +128,10 @@ namespace leveldb {
                 uint32_t *recovered_log_records,
                 timeval *rdma_read_complete);
 
+        // Replay the log records of the previous run from local disk. They
+        // are logged again before the old log files are deleted.
+        void RecoverLocalLogFiles(uint32_t *recovered_log_records);
+
         void
         CoordinateMajorCompaction() override;
 
@@ -138,6 +150,10 @@ namespace leveldb {
 
         void StopCompaction();
 
+        // Release the SSTables of a retired database. A table is deleted
+        // unless another database of a split still shares it.
+        void ReleaseTables(StoCClient *client);
+
         uint32_t EncodeMemTablePartitions(char *buf);
 
         void
@@ -145,12 +161,57 @@ namespace leveldb {
 
         const std::string &dbname() override;
 
-        uint32_t EncodeDBMetadata(char *buf, nova::StoCInMemoryLogFileManager *log_manager, uint32_t cfg_id);
+        // With split, the SSTables of the snapshot become shared with the
+        // database that recovers from it. With live_migration, the database
+        // starts capturing the migration tail and keeps the SSTables and log
+        // files of the snapshot for the destination.
+        uint32_t EncodeDBMetadata(char *buf, nova::StoCInMemoryLogFileManager *log_manager, uint32_t cfg_id,
+                                  bool split = false, bool live_migration = false);
 
+        // A database migrated from another LTC never deletes the SSTables
+        // that it shares since the other databases sharing them are on the
+        // other LTC.
         void
         RecoverDBMetadata(const Slice &buf, uint32_t version_id, uint64_t last_sequence, uint64_t next_file_number,
                           uint64_t memtable_id_seq, nova::StoCInMemoryLogFileManager *log_manager,
-                          std::unordered_map<uint32_t, leveldb::MemTableLogFilePair> *mid_table_map);
+                          std::unordered_map<uint32_t, leveldb::MemTableLogFilePair> *mid_table_map,
+                          bool pin_shared_tables = true);
+
+        // Serve the keys in [lower, upper) after a split. Compactions drop
+        // the keys outside it.
+        void SetKeyRange(const std::string &lower, const std::string &upper);
+
+        // A key that splits the recent inserts in half according to the
+        // subranges. It is empty without subranges.
+        std::string MedianKey();
+
+        // Encode the next chunk of the captured writes and stop capturing
+        // them. The last chunk also carries log_files, the log files that
+        // the destination closes once it has flushed the tail. The caller
+        // ensures that no writes are in progress.
+        uint32_t EncodeMigrationTail(char *buf, uint32_t cfg_id, const std::vector<std::string> &log_files,
+                                     bool *last);
+
+        // The log files that were not closed since a live migration
+        // started.
+        void QueryMigrationLogFiles(std::vector<std::string> *log_files);
+
+        // Flush all memtables. memtable_ids contains the memtables to
+        // flush.
+        uint32_t FlushMemTables(bool flush_active_memtable, std::vector<uint32_t> *memtable_ids);
+
+        bool IsFlushed(uint32_t memtable_id);
+
+        // Encode the tables opened for user requests and up to max_blocks of
+        // their data blocks in the block cache from the most recently used
+        // one. The message fits in max_size bytes.
+        uint32_t EncodeHotBlocks(char *buf, uint32_t cfg_id, uint32_t max_blocks, uint32_t max_size);
+
+        // Open the tables and read the data blocks of EncodeHotBlocks into
+        // the caches in order until they fill the share of this range of
+        // the block cache.
+        void WarmCache(Slice *buf, const ReadOptions &options, uint32_t *opened_tables,
+                       uint32_t *read_blocks);
 
         void ScheduleFlushMemTableTask(
                 int thread_id,
@@ -161,6 +222,8 @@ namespace leveldb {
 
         const Options options_;  // options_.comparator == &internal_comparator_
         nova::StoCInMemoryLogFileManager *log_manager_ = nullptr;
+        // Set in LOG_LOCAL_DISK mode.
+        leveldb::DiskLogWriter *local_log_ = nullptr;
         std::vector<EnvBGThread *> bg_flush_memtable_threads_;
 
         void ScheduleFileDeletionTask();
@@ -168,12 +231,43 @@ namespace leveldb {
         void UpdateFileMetaReplicaLocations(
                 const std::vector<leveldb::ReplicationPair> &results, uint32_t stoc_server_id, int level, StoCClient* client) override ;
 
+        // Add the bytes of the SSTables on each StoC to *stoc_bytes.
+        void QueryStoCBytes(std::unordered_map<uint32_t, uint64_t> *stoc_bytes);
+
+        // Select the replicas at level on src_stoc_id to move to
+        // dest_stoc_id up to max_bytes. It skips SSTables that are being
+        // compacted, shared with another database or already have a
+        // replica on dest_stoc_id. The selected SSTables are not compacted
+        // until ReleaseReplicasToMove. Return the bytes of the selected
+        // replicas.
+        uint64_t QueryReplicasToMove(uint32_t src_stoc_id, uint32_t dest_stoc_id, int level,
+                                     uint64_t max_bytes, std::vector<ReplicationPair> *pairs);
+
+        // Allow compactions of the SSTables selected by QueryReplicasToMove.
+        void ReleaseReplicasToMove(const std::vector<ReplicationPair> &pairs);
+
+        // Same as UpdateFileMetaReplicaLocations. In addition, the replaced
+        // replicas on src_stoc_id are deleted once no live version
+        // references them.
+        void MoveReplicaLocations(const std::vector<leveldb::ReplicationPair> &results, uint32_t src_stoc_id,
+                                  int level, StoCClient *client);
+
+        // Delete the moved replicas that no live version references.
+        void DeleteObsoleteReplicas(StoCClient *client);
+
         std::atomic_bool is_loading_db_;
 
     private:
+        // owner is the name of the database that created the SSTable.
         void ObtainStoCFilesOfSSTable(std::vector<std::string> *files_to_delete,
                                       std::unordered_map<uint32_t, std::vector<SSTableStoCFilePair>> *server_pairs,
-                                      const FileMetaData &meta) const;
+                                      const FileMetaData &meta, const std::string &owner) const;
+
+        void ApplyReplicaLocations(const std::vector<leveldb::ReplicationPair> &results, uint32_t stoc_server_id,
+                                   int level, StoCClient *client, bool retire_replaced);
+
+        void ObtainObsoleteReplicas(std::unordered_map<uint32_t, std::vector<SSTableStoCFilePair>> *server_pairs)
+        EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
         Status GetWithLookupIndex(const ReadOptions &options, const Slice &key,
                                   std::string *value);
@@ -289,6 +383,22 @@ namespace leveldb {
 
         void ScheduleFileDeletionTask(int thread_id);
 
+        // Delay the write if the compaction debt exceeds a slowdown trigger.
+        void ThrottleWrite(uint64_t bytes);
+
+        // Recompute the write pressure from the current version. Flushes,
+        // compactions and stats queries call it so that the pressure drops
+        // even when no write arrives.
+        void RefreshWritePressure();
+
+        SequenceNumber NextSequenceNumber(const WriteOptions &options);
+
+        void CaptureMigrationTail(SequenceNumber sequence, const Slice &key, const Slice &val);
+
+        // Return true if the log files are kept for a live migration
+        // instead of being closed.
+        bool KeepLogFilesForMigration(const std::vector<std::string> &log_files);
+
         Status
         InstallCompactionResults(CompactionState *compact, VersionEdit *edit, int target_level);
 
@@ -297,6 +407,7 @@ namespace leveldb {
         }
 
         FlushOrder *flush_order_;
+        WriteController *write_controller_ = nullptr;
 
         // Constant after construction
         Env *const env_;
@@ -322,6 +433,16 @@ namespace leveldb {
         int number_of_available_pinned_memtables_ = 2;
         const int min_memtables_ = 2;
 
+        // Writes of a live migration in chunks that fit in a message. See
+        // EncodeDBMetadata.
+        std::atomic_bool capture_migration_tail_;
+        std::mutex migration_tail_mutex_;
+        std::deque<std::string> migration_tail_;
+        // The source of a live migration keeps its log files from the
+        // snapshot on. The destination closes them.
+        bool keep_migration_log_files_ = false;
+        std::vector<std::string> migration_log_files_;
+
         port::Mutex mutex_;
         std::atomic<bool> shutting_down_;
         port::Mutex l0_stop_write_mutex_;
@@ -352,6 +473,18 @@ namespace leveldb {
         // Set of table files to protect from deletion because they are
         // part of ongoing compactions.
         std::unordered_map<uint64_t, FileMetaData> compacted_tables_ GUARDED_BY(mutex_);
+        // The database that created each SSTable inherited from a split.
+        std::unordered_map<uint64_t, std::string> inherited_tables_ GUARDED_BY(mutex_);
+        // SSTables of a live migration snapshot. The destination owns them
+        // and this database never deletes them.
+        std::set<uint64_t> migrated_tables_ GUARDED_BY(mutex_);
+        // Replicas replaced by a move, keyed by StoC id. Versions before the
+        // move may still read them.
+        std::unordered_map<uint32_t, std::vector<SSTableStoCFilePair>> moved_replicas_ GUARDED_BY(mutex_);
+        // Keys served by this database.
+        port::Mutex key_range_mutex_;
+        std::string lower_key_ GUARDED_BY(key_range_mutex_);
+        std::string upper_key_ GUARDED_BY(key_range_mutex_);
         bool is_major_compaciton_running_ = false;
         ManualCompaction *manual_compaction_ GUARDED_BY(mutex_);
 
@@ -359,6 +492,9 @@ namespace leveldb {
 
         port::Mutex mutex_compacting_tables;
         std::set<uint64_t> compacting_tables_;
+        // The coordinator is picking compactions. Their inputs are not in
+        // compacting_tables_ yet.
+        bool is_picking_compactions_ = false;
 
         // Have we encountered a background error in paranoid mode?
         Status bg_error_ GUARDED_BY(mutex_);
@@ -183,10 +183,11 @@ namespace leveldb {
                 // The current key is the last key in this range. There is no need to call next.
                 Slice ikey = iter_->key();
                 SaveKey(ikey, &saved_ikey_);
-                uint64_t key = 0;
                 Slice ukey = ExtractUserKey(ikey);
-                nova::str_to_int(ukey.data(), &key, ukey.size());
-                if (key == range_partition_.key_end - 1) {
+                // Tables shared with the other half of a split range may
+                // contain keys beyond this range.
+                if (nova::KeySpace::Compare(nova::KeySpace::Successor(ukey),
+                                            range_partition_.key_end) >= 0) {
 //                    NOVA_LOG(rdmaio::INFO)
 //                        << fmt::format("Stop iterating since reaching the end of range partition {}:{}:{}",
 //                                       ukey.ToString(), range_partition_.key_start, range_partition_.key_end);
@@ -26,6 +26,9 @@ namespace leveldb {
     namespace config {
 // Approximate gap in bytes between samples of data read during iteration.
         static const int kReadBytesPeriod = 1048576;
+// The target size of a level is kLevelSizeMultiplier times the size of its
+// upper level.
+        static const double kLevelSizeMultiplier = 3.2;
     }  // namespace config
 
 // Maximum bytes of overlaps in grandparent (i.e., level+2) before we
@@ -40,12 +43,20 @@ namespace leveldb {
             result = 4.0 * 1024 * 1024 * 1024;// / nova::NovaConfig::config->cfgs[0]->fragments.size();
         }
         while (level > 0) {
-            result *= 3.2;
+            result *= config::kLevelSizeMultiplier;
             level--;
         }
         return result;
     }
 
+    // Return the filter policy of SSTables at "level".
+    static const FilterPolicy *FilterPolicyForLevel(const Options &options, int level) {
+        if (level >= 0 && level < options.level_filter_policies.size()) {
+            return options.level_filter_policies[level];
+        }
+        return options.filter_policy;
+    }
+
     static int64_t TotalFileSize(const std::vector<FileMetaData *> &files) {
         int64_t sum = 0;
         for (size_t i = 0; i < files.size(); i++) {
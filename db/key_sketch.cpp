@@ -0,0 +1,74 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "key_sketch.h"
+
+#include <algorithm>
+
+namespace leveldb {
+    KeySketch::KeySketch(uint32_t capacity) : capacity_(std::max(2u, capacity)) {
+        levels_.emplace_back();
+        levels_[0].reserve(capacity_);
+    }
+
+    void KeySketch::Insert(const std::string &key) {
+        num_inserts_ += 1;
+        levels_[0].push_back(key);
+        if (levels_[0].size() >= capacity_) {
+            Compact(0);
+        }
+    }
+
+    void KeySketch::Compact(uint32_t level) {
+        if (level + 1 == levels_.size()) {
+            levels_.emplace_back();
+        }
+        std::vector<std::string> &keys = levels_[level];
+        std::sort(keys.begin(), keys.end(), nova::KeySpace::Less());
+        // An odd key out stays to preserve the total weight.
+        std::string leftover;
+        bool has_leftover = keys.size() % 2 == 1;
+        if (has_leftover) {
+            leftover = std::move(keys.back());
+            keys.pop_back();
+        }
+        for (int i = promote_odd_ ? 1 : 0; i < keys.size(); i += 2) {
+            levels_[level + 1].push_back(std::move(keys[i]));
+        }
+        promote_odd_ = !promote_odd_;
+        keys.clear();
+        if (has_leftover) {
+            keys.push_back(std::move(leftover));
+        }
+        if (levels_[level + 1].size() >= capacity_) {
+            Compact(level + 1);
+        }
+    }
+
+    double KeySketch::AddTo(const std::string &lower, const std::string &upper,
+                            std::map<std::string, double, nova::KeySpace::Less> *key_weights) const {
+        double total = 0;
+        double weight = 1;
+        for (const auto &keys : levels_) {
+            for (const auto &key : keys) {
+                if (nova::KeySpace::Compare(key, lower) < 0 ||
+                    nova::KeySpace::Compare(key, upper) >= 0) {
+                    continue;
+                }
+                (*key_weights)[key] += weight;
+                total += weight;
+            }
+            weight *= 2;
+        }
+        return total;
+    }
+
+    void KeySketch::Clear() {
+        levels_.resize(1);
+        levels_[0].clear();
+        num_inserts_ = 0;
+    }
+}
@@ -0,0 +1,51 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#ifndef LEVELDB_KEY_SKETCH_H
+#define LEVELDB_KEY_SKETCH_H
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "common/nova_config.h"
+
+namespace leveldb {
+    // A streaming quantile sketch of the inserted keys. Level i holds up to
+    // capacity keys that each stand for 2^i inserts. A full level sorts its
+    // keys and promotes every other key to the next level. It summarizes n
+    // inserts with O(capacity * log(n / capacity)) keys and a popular key
+    // keeps a weight proportional to its inserts. It is not thread-safe.
+    class KeySketch {
+    public:
+        explicit KeySketch(uint32_t capacity);
+
+        void Insert(const std::string &key);
+
+        // Add the weight of each key in [lower, upper) to *key_weights.
+        // Return the total added weight.
+        double AddTo(const std::string &lower, const std::string &upper,
+                     std::map<std::string, double, nova::KeySpace::Less> *key_weights) const;
+
+        void Clear();
+
+        uint64_t num_inserts() const {
+            return num_inserts_;
+        }
+
+    private:
+        void Compact(uint32_t level);
+
+        const uint32_t capacity_;
+        std::vector<std::vector<std::string>> levels_;
+        uint64_t num_inserts_ = 0;
+        // Alternate the promoted half to avoid a bias toward small keys.
+        bool promote_odd_ = false;
+    };
+}
+
+#endif //LEVELDB_KEY_SKETCH_H
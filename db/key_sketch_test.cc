@@ -0,0 +1,100 @@
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "db/key_sketch.h"
+#include "util/random.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+    class KeySketchTest {
+    public:
+        typedef std::map<std::string, double, nova::KeySpace::Less> KeyWeights;
+
+        // The smallest key whose cumulative weight reaches fraction of the
+        // total weight.
+        static std::string Quantile(const KeyWeights &key_weights, double total, double fraction) {
+            double weight = 0;
+            for (const auto &it : key_weights) {
+                weight += it.second;
+                if (weight >= total * fraction) {
+                    return it.first;
+                }
+            }
+            return "";
+        }
+    };
+
+    TEST(KeySketchTest, TotalWeight) {
+        KeySketch sketch(8);
+        Random rand(301);
+        for (int i = 0; i < 1000; i++) {
+            sketch.Insert(std::to_string(rand.Uniform(500)));
+        }
+        ASSERT_EQ(sketch.num_inserts(), 1000);
+
+        // Compactions keep the total weight equal to the number of inserts.
+        KeyWeights key_weights;
+        double total = sketch.AddTo("0", "500", &key_weights);
+        ASSERT_EQ(total, 1000);
+        double sum = 0;
+        for (const auto &it : key_weights) {
+            sum += it.second;
+        }
+        ASSERT_EQ(sum, total);
+        ASSERT_LT(key_weights.size(), 100);
+
+        // Keys outside [lower, upper) are skipped.
+        KeyWeights lower_half;
+        double lower_total = sketch.AddTo("0", "250", &lower_half);
+        KeyWeights upper_half;
+        double upper_total = sketch.AddTo("250", "500", &upper_half);
+        ASSERT_EQ(lower_total + upper_total, total);
+
+        sketch.Clear();
+        ASSERT_EQ(sketch.num_inserts(), 0);
+        key_weights.clear();
+        ASSERT_EQ(sketch.AddTo("0", "500", &key_weights), 0);
+    }
+
+    TEST(KeySketchTest, SkewedSplit) {
+        KeySketch sketch(64);
+        Random rand(301);
+        // 90% of the inserts go to [0, 100) and the rest to [100, 10000).
+        for (int i = 0; i < 100000; i++) {
+            if (rand.Uniform(10) < 9) {
+                sketch.Insert(std::to_string(rand.Uniform(100)));
+            } else {
+                sketch.Insert(std::to_string(100 + rand.Uniform(9900)));
+            }
+        }
+        KeyWeights key_weights;
+        double total = sketch.AddTo("0", "10000", &key_weights);
+        ASSERT_EQ(total, 100000);
+
+        double hot = 0;
+        for (const auto &it : key_weights) {
+            if (nova::KeySpace::Compare(it.first, "100") < 0) {
+                hot += it.second;
+            }
+        }
+        ASSERT_GT(hot, total * 0.85);
+        ASSERT_LT(hot, total * 0.95);
+
+        // Splitting by weight puts the boundary inside the hot keys instead
+        // of at the middle of the key space.
+        std::string median = Quantile(key_weights, total, 0.5);
+        ASSERT_LT(nova::KeySpace::Compare(median, "100"), 0);
+        ASSERT_GT(nova::KeySpace::Compare(median, "30"), 0);
+        ASSERT_LT(nova::KeySpace::Compare(median, "70"), 0);
+        std::string p95 = Quantile(key_weights, total, 0.95);
+        ASSERT_GT(nova::KeySpace::Compare(p95, "100"), 0);
+    }
+}
+
+nova::NovaConfig *nova::NovaConfig::config;
+nova::NovaGlobalVariables nova::NovaGlobalVariables::global;
+
+int main(int argc, char **argv) { return leveldb::test::RunAllTests(); }
@@ -18,6 +18,10 @@ namespace leveldb {
             << fmt::format("Create lookup index of size {}", size);
     }
 
+    LookupIndex::~LookupIndex() {
+        delete[] table_locator_;
+    }
+
     uint64_t LookupIndex::Lookup(const leveldb::Slice &key, uint64_t hash) {
 //        NOVA_ASSERT(hash >= 0 && hash <= size_);
         TableLocation &loc = table_locator_[hash % size_];
@@ -61,4 +65,10 @@ namespace leveldb {
             table_locator_[i].memtable_id = id;
         }
     }
+
+    void LookupIndex::CopyFrom(LookupIndex *src, uint64_t lower, uint64_t upper) {
+        for (uint64_t key = lower; key < upper; key++) {
+            Insert(Slice(), key, src->Lookup(Slice(), key));
+        }
+    }
 }
\ No newline at end of file
@@ -21,6 +21,8 @@ namespace leveldb {
     public:
         LookupIndex(uint32_t size);
 
+        ~LookupIndex();
+
         uint64_t Lookup(const Slice &key, uint64_t hash);
 
         void Insert(const Slice &key, uint64_t hash, uint32_t memtableid);
@@ -32,6 +34,14 @@ namespace leveldb {
 
         void Decode(Slice *buf);
 
+        // Copy the entries of the keys in [lower, upper) from src. src
+        // may have a different size.
+        void CopyFrom(LookupIndex *src, uint64_t lower, uint64_t upper);
+
+        uint32_t size() const {
+            return size_;
+        }
+
         std::string DebugString();
 
     private:
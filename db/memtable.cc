@@ -28,7 +28,7 @@ namespace leveldb {
                        DBProfiler *db_profiler,
                        bool is_ready)
             : comparator_(comparator), memtable_id_(memtable_id), refs_(0),
-              table_(comparator_, &arena_),
+              arena_(ArenaChunkPool::pool), table_(comparator_, &arena_),
               db_profiler_(db_profiler), is_ready_(is_ready),
               is_ready_signal_(&is_ready_mutex_) {
     }
@@ -137,16 +137,11 @@ namespace leveldb {
                 Seek(target);
             }
             auto userkey = ExtractUserKey(target);
-            uint64_t userkeyint;
-            nova::str_to_int(userkey.data(), &userkeyint, userkey.size());
             while (Valid()) {
                 auto current_key = ExtractUserKey(key());
-                uint64_t pivot = 0;
-                nova::str_to_int(current_key.data(), &pivot,
-                                 current_key.size());
                 NOVA_LOG(rdmaio::DEBUG)
-                    << fmt::format("memtable skip:{} {}", userkeyint, pivot);
-                if (userkeyint != pivot) {
+                    << fmt::format("memtable skip:{} {}", userkey.ToString(), current_key.ToString());
+                if (nova::KeySpace::Compare(userkey, current_key) != 0) {
                     return;
                 }
                 Next();
@@ -0,0 +1,84 @@
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "leveldb/db_types.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+    class MemTablePoolTest {
+    public:
+        MemTablePoolTest() {
+            pool_.capacity_ = 10;
+            pool_.num_available_memtables_ = 10;
+        }
+
+        // Take n memtables from the pool.
+        void Acquire(uint32_t n) {
+            ASSERT_LE(n, pool_.num_available_memtables_);
+            pool_.num_available_memtables_ -= n;
+        }
+
+        MemTablePool pool_;
+    };
+
+    TEST(MemTablePoolTest, GrowAndShrinkIdlePool) {
+        pool_.Resize(16);
+        ASSERT_EQ(16, pool_.capacity_);
+        ASSERT_EQ(16, pool_.num_available_memtables_);
+        ASSERT_EQ(0, pool_.num_used_memtables());
+
+        pool_.Resize(4);
+        ASSERT_EQ(4, pool_.capacity_);
+        ASSERT_EQ(4, pool_.num_available_memtables_);
+        ASSERT_EQ(0, pool_.num_withheld_memtables_);
+        ASSERT_EQ(0, pool_.num_used_memtables());
+    }
+
+    TEST(MemTablePoolTest, ShrinkWithholdsMemtablesInUse) {
+        Acquire(8);
+        ASSERT_EQ(8, pool_.num_used_memtables());
+
+        // Only 2 memtables are available. The other 4 are withheld.
+        pool_.Resize(4);
+        ASSERT_EQ(0, pool_.num_available_memtables_);
+        ASSERT_EQ(4, pool_.num_withheld_memtables_);
+        ASSERT_EQ(8, pool_.num_used_memtables());
+
+        // Released memtables are withheld until the pool fits.
+        pool_.Release(3);
+        ASSERT_EQ(0, pool_.num_available_memtables_);
+        ASSERT_EQ(1, pool_.num_withheld_memtables_);
+        ASSERT_EQ(5, pool_.num_used_memtables());
+
+        pool_.Release(5);
+        ASSERT_EQ(4, pool_.num_available_memtables_);
+        ASSERT_EQ(0, pool_.num_withheld_memtables_);
+        ASSERT_EQ(0, pool_.num_used_memtables());
+    }
+
+    TEST(MemTablePoolTest, GrowCancelsWithheldMemtables) {
+        Acquire(10);
+        pool_.Resize(4);
+        ASSERT_EQ(6, pool_.num_withheld_memtables_);
+
+        // Growing cancels the withheld memtables before it adds new ones.
+        pool_.Resize(8);
+        ASSERT_EQ(2, pool_.num_withheld_memtables_);
+        ASSERT_EQ(0, pool_.num_available_memtables_);
+        ASSERT_EQ(10, pool_.num_used_memtables());
+
+        pool_.Resize(12);
+        ASSERT_EQ(0, pool_.num_withheld_memtables_);
+        ASSERT_EQ(2, pool_.num_available_memtables_);
+        ASSERT_EQ(10, pool_.num_used_memtables());
+
+        pool_.Release(10);
+        ASSERT_EQ(12, pool_.num_available_memtables_);
+        ASSERT_EQ(0, pool_.num_used_memtables());
+    }
+}
+
+int main(int argc, char **argv) { return leveldb::test::RunAllTests(); }
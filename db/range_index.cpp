@@ -6,6 +6,7 @@
 
 #include "range_index.h"
 #include "table/merger.h"
+#include "common/nova_config.h"
 
 namespace leveldb {
     uint32_t RangeTables::Encode(char *buf) {
@@ -127,16 +128,13 @@ namespace leveldb {
     }
 
     void RangeIndexIterator::SkipToNextUserKey(const Slice &target) {
-        Slice userkey = ExtractUserKey(target);
-        uint64_t ukey = 0;
-        nova::str_to_int(userkey.data(), &ukey, userkey.size());
-        ukey += 1;
+        std::string successor = nova::KeySpace::Successor(ExtractUserKey(target));
         if (!Valid()) {
             Seek(target);
         }
         if (Valid()) {
             auto range = range_index_->ranges_[index_];
-            if (range.upper_int() == ukey) {
+            if (nova::KeySpace::Compare(range.upper, successor) == 0) {
                 index_++;
             }
         }
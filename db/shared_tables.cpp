@@ -0,0 +1,49 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "shared_tables.h"
+
+#include <fmt/core.h>
+
+namespace leveldb {
+    namespace {
+        std::string TableKey(const std::string &owner, uint64_t file_number) {
+            return fmt::format("{}/{}", owner, file_number);
+        }
+    }
+
+    SharedTables *SharedTables::tables = new SharedTables;
+
+    void SharedTables::Share(const std::unordered_map<uint64_t, std::string> &owners) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &owner : owners) {
+            auto it = refs_.find(TableKey(owner.second, owner.first));
+            if (it == refs_.end()) {
+                refs_[TableKey(owner.second, owner.first)] = 2;
+            } else {
+                it->second += 1;
+            }
+        }
+    }
+
+    bool SharedTables::IsShared(const std::string &owner, uint64_t file_number) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return refs_.find(TableKey(owner, file_number)) != refs_.end();
+    }
+
+    bool SharedTables::Release(const std::string &owner, uint64_t file_number) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = refs_.find(TableKey(owner, file_number));
+        if (it == refs_.end()) {
+            return true;
+        }
+        it->second -= 1;
+        if (it->second == 1) {
+            refs_.erase(it);
+        }
+        return false;
+    }
+}
@@ -0,0 +1,38 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#ifndef LEVELDB_SHARED_TABLES_H
+#define LEVELDB_SHARED_TABLES_H
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace leveldb {
+    // Reference counts of the SSTables that the databases of a split share
+    // without rewriting them. An SSTable is named after the database that
+    // created it. An SSTable that is not shared has one reference.
+    class SharedTables {
+    public:
+        // Add a reference to each table. owners maps the file number of a
+        // table to the name of the database that created it.
+        void Share(const std::unordered_map<uint64_t, std::string> &owners);
+
+        bool IsShared(const std::string &owner, uint64_t file_number);
+
+        // Drop a reference to a table. Return true if it was the last one
+        // and the table can be deleted.
+        bool Release(const std::string &owner, uint64_t file_number);
+
+        static SharedTables *tables;
+
+    private:
+        std::mutex mutex_;
+        std::unordered_map<std::string, uint32_t> refs_;
+    };
+}
+
+#endif //LEVELDB_SHARED_TABLES_H
@@ -0,0 +1,55 @@
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "db/shared_tables.h"
+
+#include "util/testharness.h"
+
+namespace leveldb {
+
+    class SharedTablesTest {
+    public:
+        SharedTables tables_;
+    };
+
+    TEST(SharedTablesTest, NotShared) {
+        ASSERT_TRUE(!tables_.IsShared("db-0", 1));
+        // A table with one reference can be deleted right away.
+        ASSERT_TRUE(tables_.Release("db-0", 1));
+    }
+
+    TEST(SharedTablesTest, TwoOwners) {
+        // Range db-0 splits and db-1 shares its tables 1 and 2.
+        tables_.Share({{1, "db-0"}, {2, "db-0"}});
+        ASSERT_TRUE(tables_.IsShared("db-0", 1));
+        ASSERT_TRUE(tables_.IsShared("db-0", 2));
+        // Tables are named after their creator.
+        ASSERT_TRUE(!tables_.IsShared("db-1", 1));
+        ASSERT_TRUE(!tables_.IsShared("db-0", 3));
+
+        // The first owner that compacts table 1 away keeps it on disk.
+        ASSERT_TRUE(!tables_.Release("db-0", 1));
+        ASSERT_TRUE(!tables_.IsShared("db-0", 1));
+        // The last owner deletes it.
+        ASSERT_TRUE(tables_.Release("db-0", 1));
+
+        ASSERT_TRUE(tables_.IsShared("db-0", 2));
+        ASSERT_TRUE(!tables_.Release("db-0", 2));
+        ASSERT_TRUE(tables_.Release("db-0", 2));
+    }
+
+    TEST(SharedTablesTest, SharedAgain) {
+        // A child range splits again before it compacts the shared table.
+        tables_.Share({{1, "db-0"}});
+        tables_.Share({{1, "db-0"}});
+        ASSERT_TRUE(!tables_.Release("db-0", 1));
+        ASSERT_TRUE(tables_.IsShared("db-0", 1));
+        ASSERT_TRUE(!tables_.Release("db-0", 1));
+        ASSERT_TRUE(!tables_.IsShared("db-0", 1));
+        ASSERT_TRUE(tables_.Release("db-0", 1));
+    }
+}
+
+int main(int argc, char **argv) { return leveldb::test::RunAllTests(); }
@@ -2,11 +2,11 @@
 //
 // Created by Haoyu Huang on 5/4/20.
 // Copyright (c) 2020 University of Southern California. All rights reserved.
-// It assumes keys are integers.
 //
 
 #include "leveldb/subrange.h"
 #include "common/nova_common.h"
+#include "common/nova_config.h"
 
 namespace leveldb {
 
@@ -42,28 +42,24 @@ namespace leveldb {
 
     std::string Range::DebugString() const {
         std::string output;
-        uint64_t low;
-        uint64_t up;
-        nova::str_to_int(lower.data(), &low, lower.size());
-        nova::str_to_int(upper.data(), &up, upper.size());
-        if (lower_inclusive) {
-            output += "[";
-        } else {
-            low++;
-            output += "(";
+        uint64_t keys = nova::KeySpace::NumKeys(lower, upper);
+        // UINT64_MAX means too many keys to count.
+        if (keys != UINT64_MAX) {
+            if (upper_inclusive && (lower_inclusive || keys > 0)) {
+                keys++;
+            }
+            if (!lower_inclusive && keys > 0) {
+                keys--;
+            }
         }
+        output += lower_inclusive ? "[" : "(";
         output += lower;
         output += ",";
         output += upper;
-        if (upper_inclusive) {
-            up++;
-            output += "]";
-        } else {
-            output += ")";
-        }
+        output += upper_inclusive ? "]" : ")";
         output += fmt::format(":{}, {}%, d={} keys={}", ninserts,
                               (uint32_t) insertion_ratio * 100.0,
-                              num_duplicates, up - low);
+                              num_duplicates, keys);
         return output;
     }
 
@@ -100,7 +96,7 @@ namespace leveldb {
     }
 
     bool Range::IsAPoint(const Comparator *comparator) const {
-        if (upper_int() - lower_int() == 1) {
+        if (nova::KeySpace::NumKeys(lower, upper) == 1) {
             return true;
         }
 //        if (lower_inclusive && upper_inclusive &&
@@ -176,9 +172,7 @@ namespace leveldb {
         output += fmt::format("c:{} {} {} ", start_tid, end_tid,
                               merge_memtables_without_flushing);
         output += "keys:";
-        output += std::to_string(
-                tiny_ranges[tiny_ranges.size() - 1].upper_int() -
-                tiny_ranges[0].lower_int());
+        output += std::to_string(keys());
         output += " tiny:";
         for (auto &range : tiny_ranges) {
             output += range.DebugString();
@@ -210,17 +204,17 @@ namespace leveldb {
         return start_tid + index;
     }
 
-    int SubRange::keys() const {
-        return tiny_ranges[tiny_ranges.size() - 1].upper_int() -
-               tiny_ranges[0].lower_int();
+    uint64_t SubRange::keys() const {
+        return nova::KeySpace::NumKeys(tiny_ranges[0].lower,
+                                       tiny_ranges[tiny_ranges.size() - 1].upper);
     }
 
     bool SubRange::RangeEquals(const SubRange &other, const Comparator *comparator) const {
-        if (tiny_ranges[0].lower_int() != other.tiny_ranges[0].lower_int()) {
+        if (comparator->Compare(tiny_ranges[0].lower, other.tiny_ranges[0].lower) != 0) {
             return false;
         }
-        if (tiny_ranges[tiny_ranges.size() - 1].upper_int() !=
-            other.tiny_ranges[other.tiny_ranges.size() - 1].upper_int()) {
+        if (comparator->Compare(tiny_ranges[tiny_ranges.size() - 1].upper,
+                                other.tiny_ranges[other.tiny_ranges.size() - 1].upper) != 0) {
             return false;
         }
         return true;
@@ -323,12 +317,12 @@ namespace leveldb {
             if (it->num_duplicates > 0) {
                 NOVA_ASSERT(it->tiny_ranges.size() == 1) << DebugString();
                 NOVA_ASSERT(it->IsAPoint(comparator)) << DebugString();
-                uint64_t lk = it->tiny_ranges[0].lower_int();
+                std::string lk = it->tiny_ranges[0].lower;
                 for (int i = 0; i < it->num_duplicates - 1; i++) {
                     NOVA_ASSERT(it->tiny_ranges.size() == 1) << DebugString();
                     NOVA_ASSERT(it->IsAPoint(comparator)) << DebugString();
-                    uint64_t other = it->tiny_ranges[0].lower_int();
-                    NOVA_ASSERT(lk == other)
+                    const std::string &other = it->tiny_ranges[0].lower;
+                    NOVA_ASSERT(comparator->Compare(lk, other) == 0)
                         << fmt::format("{} {} {}", lk, other, DebugString());
                     NOVA_ASSERT(it->tiny_ranges[0].num_duplicates ==
                                 it->num_duplicates) << DebugString();
@@ -340,8 +334,9 @@ namespace leveldb {
             it++;
         }
         // Assert boundaries.
-        int prior_lower = -1;
-        int prior_upper = -1;
+        bool has_prior = false;
+        std::string prior_lower;
+        std::string prior_upper;
         bool isPriorDup = false;
         for (int i = 0; i < subranges.size(); i++) {
             for (int j = 0; j < subranges[i].tiny_ranges.size(); j++) {
@@ -351,25 +346,26 @@ namespace leveldb {
                 Range &range = subranges[i].tiny_ranges[j];
                 NOVA_ASSERT(range.lower_inclusive) << DebugString();
                 NOVA_ASSERT(!range.upper_inclusive) << DebugString();
-                if (prior_lower == -1) {
-                    prior_lower = range.lower_int();
-                    prior_upper = range.upper_int();
+                if (!has_prior) {
+                    has_prior = true;
+                    prior_lower = range.lower;
+                    prior_upper = range.upper;
                     isPriorDup = range.num_duplicates > 0;
                     continue;
                 }
-                if (range.lower_int() == prior_lower) {
-                    NOVA_ASSERT(range.upper_int() == prior_upper)
+                if (comparator->Compare(range.lower, prior_lower) == 0) {
+                    NOVA_ASSERT(comparator->Compare(range.upper, prior_upper) == 0)
                         << DebugString();
                     NOVA_ASSERT(range.num_duplicates > 0) << DebugString();
                     NOVA_ASSERT(isPriorDup) << DebugString();
                 } else {
-                    NOVA_ASSERT(range.lower_int() >= prior_upper)
+                    NOVA_ASSERT(comparator->Compare(range.lower, prior_upper) >= 0)
                         << DebugString();
-                    NOVA_ASSERT(range.upper_int() > range.lower_int())
+                    NOVA_ASSERT(comparator->Compare(range.upper, range.lower) > 0)
                         << fmt::format("{} {}", range.DebugString(),
                                        DebugString());
-                    prior_lower = range.lower_int();
-                    prior_upper = range.upper_int();
+                    prior_lower = range.lower;
+                    prior_upper = range.upper;
                     isPriorDup = range.num_duplicates > 0;
                 }
             }
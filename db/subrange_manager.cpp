@@ -28,22 +28,27 @@ namespace leveldb {
               partitioned_imms_(partitioned_imms) {
         lower_bound_ = options.lower_key;
         upper_bound_ = options.upper_key;
+        if (options_.subrange_reorg_sketch_size > 0) {
+            for (int i = 0; i < options_.num_memtable_partitions; i++) {
+                sketches_.push_back(new KeySketch(options_.subrange_reorg_sketch_size));
+            }
+        }
         auto sr = new SubRanges;
 
         uint32_t cfgid = nova::NovaConfig::config->current_cfg_id;
         auto range = nova::NovaConfig::config->cfgs[cfgid]->fragments[dbindex_];
-        if (range->range.key_end - range->range.key_start <= options_.num_memtable_partitions) {
-            int nkeys = range->range.key_end - range->range.key_start;
+        uint64_t nkeys = nova::KeySpace::NumKeys(range->range.key_start, range->range.key_end);
+        if (nkeys <= options_.num_memtable_partitions) {
             int num_duplicates = options_.num_memtable_partitions / nkeys;
             int cdup = 0;
-            int lower = range->range.key_start;
-            int upper = range->range.key_start + 1;
+            std::string lower = range->range.key_start;
+            std::string upper = nova::KeySpace::Successor(lower);
 
             for (int i = 0; i < options_.num_memtable_partitions; i++) {
                 SubRange nsr;
                 Range r;
-                r.lower = std::to_string(lower);
-                r.upper = std::to_string(upper);
+                r.lower = lower;
+                r.upper = upper;
                 if (num_duplicates == 1) {
                     r.num_duplicates = 0;
                     nsr.num_duplicates = 0;
@@ -56,10 +61,10 @@ namespace leveldb {
                 cdup++;
                 if (cdup == num_duplicates) {
                     lower = upper;
-                    upper = lower + 1;
+                    upper = nova::KeySpace::Successor(lower);
                     cdup = 0;
                 }
-                if (upper > range->range.key_end) {
+                if (nova::KeySpace::CompareEnd(upper, range->range) > 0) {
                     break;
                 }
             }
@@ -67,8 +72,8 @@ namespace leveldb {
             // Construct one subrange.
             SubRange nsr;
             Range r;
-            r.lower = std::to_string(lower_bound_);
-            r.upper = std::to_string(upper_bound_);
+            r.lower = lower_bound_;
+            r.upper = upper_bound_;
             nsr.tiny_ranges.push_back(r);
             sr->subranges.push_back(nsr);
         }
@@ -76,7 +81,8 @@ namespace leveldb {
         ComputeCompactionThreadsAssignment(sr);
         latest_subranges_.store(sr);
         NOVA_LOG(rdmaio::INFO)
-            << fmt::format("keys:{},{}", lower_bound_, upper_bound_);
+            << fmt::format("keys:{},{}", nova::KeySpace::EncodeBoundary(lower_bound_),
+                           nova::KeySpace::EncodeBoundary(upper_bound_));
     }
 
     int SubRangeManager::SearchSubranges(const leveldb::WriteOptions &options,
@@ -187,14 +193,13 @@ namespace leveldb {
                                     key, user_comparator_));
                     SubRange &sr = new_subranges->last();
                     Range &last = sr.last();
-                    uint64_t k;
-                    nova::str_to_int(key.data(), &k, key.size());
-                    last.upper.assign(std::to_string(k + 1));
+                    std::string successor = nova::KeySpace::Successor(key);
+                    last.upper.assign(successor);
                     for (int i = 1; i < sr.num_duplicates; i++) {
                         SubRange &dup = new_subranges->subranges[
                                 new_subranges->subranges.size() - i - 1];
                         Range &dup_last = dup.last();
-                        dup_last.upper.assign(std::to_string(k + 1));
+                        dup_last.upper.assign(successor);
                     }
                     subrange_id = new_subranges->subranges.size() - 1;
                 }
@@ -207,8 +212,7 @@ namespace leveldb {
                 SubRange sr = {};
                 Range new_range = {};
                 new_range.lower.assign(key.ToString());
-                new_range.upper.assign(
-                        std::to_string(new_range.lower_int() + 1));
+                new_range.upper.assign(nova::KeySpace::Successor(key));
                 sr.tiny_ranges.push_back(std::move(new_range));
                 new_subranges->subranges.push_back(std::move(sr));
                 subrange_id = 0;
@@ -223,9 +227,7 @@ namespace leveldb {
                     first.lower.assign(key.ToString());
                 } else {
                     Range &last = new_subranges->first().last();
-                    uint64_t u = 0;
-                    nova::str_to_int(key.data(), &u, key.size());
-                    last.upper.assign(std::to_string(u + 1));
+                    last.upper.assign(nova::KeySpace::Successor(key));
                 }
                 subrange_id = 0;
                 break;
@@ -251,9 +253,7 @@ namespace leveldb {
                 SubRange sr = {};
                 Range new_range = {};
                 new_range.lower.assign(new_subranges->last().last().upper);
-                uint64_t u = 0;
-                nova::str_to_int(key.data(), &u, key.size());
-                new_range.upper.assign(std::to_string(u + 1));
+                new_range.upper.assign(nova::KeySpace::Successor(key));
                 sr.tiny_ranges.push_back(std::move(new_range));
                 new_subranges->subranges.push_back(std::move(sr));
                 subrange_id = new_subranges->subranges.size() - 1;
@@ -277,15 +277,41 @@ namespace leveldb {
         return subrange_id;
     }
 
+    void SubRangeManager::RecordInsert(uint32_t partition_id, const Slice &key) {
+        if (sketches_.empty()) {
+            return;
+        }
+        sketches_[partition_id]->Insert(key.ToString());
+    }
+
+    double SubRangeManager::SketchSampling(uint32_t partition_id, const std::string &lower,
+                                           const std::string &upper,
+                                           std::map<std::string, double, nova::KeySpace::Less> *userkey_rate) {
+        MemTablePartition *partition = (*partitioned_active_memtables_)[partition_id];
+        partition->mutex.Lock();
+        double total = sketches_[partition_id]->AddTo(lower, upper, userkey_rate);
+        partition->mutex.Unlock();
+        return total;
+    }
+
     bool SubRangeManager::MajorReorg() {
         std::vector<double> insertion_rates;
         std::vector<SubRange> &subranges = latest_->subranges;
         // Perform major reorg.
         std::vector<std::vector<AtomicMemTable *>> subrange_imms;
+        std::map<std::string, double, nova::KeySpace::Less> userkey_rate;
+        double total_rate = 0;
+        if (!sketches_.empty()) {
+            // The sketches record every insert since the last major reorg.
+            // The weight of a key is its number of inserts.
+            for (int i = 0; i < sketches_.size(); i++) {
+                total_rate += SketchSampling(i, lower_bound_, upper_bound_, &userkey_rate);
+            }
+        }
         uint32_t nslots = options_.num_memtables / options_.num_memtable_partitions;
         uint32_t remainder = options_.num_memtables % options_.num_memtable_partitions;
         uint32_t slot_id = 0;
-        for (int i = 0; i < options_.num_memtable_partitions; i++) {
+        for (int i = 0; i < options_.num_memtable_partitions && sketches_.empty(); i++) {
             std::vector<AtomicMemTable *> memtables;
             (*partitioned_active_memtables_)[i]->mutex.Lock();
             MemTable *m = (*partitioned_active_memtables_)[i]->active_memtable;
@@ -335,8 +361,6 @@ namespace leveldb {
 
         // Sample from each memtable.
         sample_size_per_subrange = (double) (sample_size_per_subrange) * options_.subrange_reorg_sampling_ratio;
-        std::map<uint64_t, double> userkey_rate;
-        double total_rate = 0;
         for (int i = 0; i < subrange_imms.size(); i++) {
             SubRange &sr = subranges[i];
             uint32_t total_puts = subrange_nputs[i];
@@ -357,9 +381,7 @@ namespace leveldb {
                 it->SeekToFirst();
                 while (it->Valid() && samples < sample_size) {
                     Slice userkey = ExtractUserKey(it->key());
-                    uint64_t k = 0;
-                    nova::str_to_int(userkey.data(), &k, userkey.size());
-                    userkey_rate[k] += insertion_ratio;
+                    userkey_rate[userkey.ToString()] += insertion_ratio;
                     total_rate += insertion_ratio;
                     samples += 1;
                     it->Next();
@@ -400,17 +422,17 @@ namespace leveldb {
         // Second, break each subrange that contains more than one value into
         // alpha tiny ranges.
         for (int i = 0; i < tmp_subranges.size(); i++) {
-            std::map<uint64_t, double> sub_userkey_rate;
-            uint64_t lower = tmp_subranges[i].lower_int();
-            uint64_t upper = tmp_subranges[i].upper_int();
+            std::map<std::string, double, nova::KeySpace::Less> sub_userkey_rate;
+            const std::string lower = tmp_subranges[i].lower;
+            const std::string upper = tmp_subranges[i].upper;
             SubRange sr = {};
-            if (upper - lower > 1) {
+            if (nova::KeySpace::NumKeys(lower, upper) > 1) {
                 double sub_total_share = 0;
-                for (auto it : userkey_rate) {
-                    if (it.first < lower) {
+                for (const auto &it : userkey_rate) {
+                    if (nova::KeySpace::Compare(it.first, lower) < 0) {
                         continue;
                     }
-                    if (it.first >= upper) {
+                    if (nova::KeySpace::Compare(it.first, upper) >= 0) {
                         continue;
                     }
                     sub_total_share += it.second;
@@ -432,6 +454,13 @@ namespace leveldb {
                 subrange_imms[i][j]->Unref(dbname_);
             }
         }
+        // Start over with the new subranges.
+        for (int i = 0; i < sketches_.size(); i++) {
+            MemTablePartition *partition = (*partitioned_active_memtables_)[i];
+            partition->mutex.Lock();
+            sketches_[i]->Clear();
+            partition->mutex.Unlock();
+        }
         if (options_.enable_detailed_stats) {
             NOVA_LOG(rdmaio::INFO)
                 << fmt::format("major with {} keys: {}",
@@ -442,7 +471,7 @@ namespace leveldb {
 
     void SubRangeManager::MoveShareForDuplicateSubRange(int index) {
         SubRange &sr = latest_->subranges[index];
-        uint64_t lower = sr.tiny_ranges[0].lower_int();
+        std::string lower = sr.tiny_ranges[0].lower;
         int remaining_num_duplicates = 0;
         int start = -1;
         int end = -1;
@@ -452,7 +481,7 @@ namespace leveldb {
                 continue;
             }
             NOVA_ASSERT(r.tiny_ranges.size() == 1);
-            if (r.tiny_ranges[0].lower_int() != lower) {
+            if (user_comparator_->Compare(r.tiny_ranges[0].lower, lower) != 0) {
                 continue;
             }
             end = i;
@@ -479,36 +508,36 @@ namespace leveldb {
     }
 
     void SubRangeManager::ConstructRanges(
-            const std::map<uint64_t, double> &userkey_rate, double total_rate,
-            uint64_t lower, uint64_t upper, uint32_t num_ranges_to_construct,
+            const std::map<std::string, double, nova::KeySpace::Less> &userkey_rate, double total_rate,
+            const std::string &lower, const std::string &upper, uint32_t num_ranges_to_construct,
             bool is_constructing_subranges,
             std::vector<leveldb::Range> *ranges) {
-        NOVA_ASSERT(upper - lower > 1);
+        NOVA_ASSERT(nova::KeySpace::NumKeys(lower, upper) > 1);
         NOVA_ASSERT(num_ranges_to_construct > 1);
         double share_per_range = total_rate / (double) num_ranges_to_construct;
         double fair_rate = total_rate / (double) num_ranges_to_construct;
         double total = total_rate;
 
-        uint32_t current_lower = lower;
-        uint32_t current_upper = 0;
+        std::string current_lower = lower;
+        std::string current_upper;
         double current_rate = 0.0;
-        for (auto it : userkey_rate) {
-            NOVA_ASSERT(it.first >= lower);
-            NOVA_ASSERT(it.first < upper);
+        for (const auto &it : userkey_rate) {
+            NOVA_ASSERT(nova::KeySpace::Compare(it.first, lower) >= 0);
+            NOVA_ASSERT(nova::KeySpace::Compare(it.first, upper) < 0);
             double rate = it.second;
             if (rate >= fair_rate && is_constructing_subranges) {
                 if (options_.enable_detailed_stats) {
                     NOVA_LOG(rdmaio::INFO)
-                        << fmt::format("hot key {}:{}:{}", it.first,
+                        << fmt::format("hot key {}:{}:{}", nova::KeySpace::EncodeBoundary(it.first),
                                        rate / total,
                                        fair_rate / total);
                 }
                 // close the current subrange.
-                if (current_lower < it.first) {
+                if (nova::KeySpace::Compare(current_lower, it.first) < 0) {
                     current_upper = it.first;
                     Range r = {};
-                    r.lower = std::to_string(current_lower);
-                    r.upper = std::to_string((current_upper));
+                    r.lower = current_lower;
+                    r.upper = current_upper;
                     r.insertion_ratio = current_rate / total;
                     (*ranges).push_back(std::move(r));
                 }
@@ -516,13 +545,13 @@ namespace leveldb {
                 int num_duplicates = (int) std::ceil(rate / fair_rate);
                 for (int i = 0; i < num_duplicates; i++) {
                     Range r = {};
-                    r.lower = std::to_string(it.first);
-                    r.upper = std::to_string(it.first + 1);
+                    r.lower = it.first;
+                    r.upper = nova::KeySpace::Successor(it.first);
                     r.num_duplicates = num_duplicates;
                     r.insertion_ratio = rate / num_duplicates;
                     (*ranges).push_back(std::move(r));
                 }
-                current_lower = it.first + 1;
+                current_lower = nova::KeySpace::Successor(it.first);
                 total_rate -= it.second;
                 current_rate = 0;
                 share_per_range =
@@ -531,15 +560,15 @@ namespace leveldb {
             }
 
             if (current_rate + rate > share_per_range) {
-                if (current_lower == it.first) {
-                    current_upper = it.first + 1;
+                if (nova::KeySpace::Compare(current_lower, it.first) == 0) {
+                    current_upper = nova::KeySpace::Successor(it.first);
                     Range r = {};
-                    r.lower = std::to_string(current_lower);
-                    r.upper = std::to_string(current_upper);
+                    r.lower = current_lower;
+                    r.upper = current_upper;
                     r.insertion_ratio = current_rate / total;
                     (*ranges).push_back(std::move(r));
 
-                    current_lower = it.first + 1;
+                    current_lower = current_upper;
                     if (ranges->size() + 1 == num_ranges_to_construct) {
                         break;
                     }
@@ -551,8 +580,8 @@ namespace leveldb {
                 } else {
                     current_upper = it.first;
                     Range r = {};
-                    r.lower = std::to_string(current_lower);
-                    r.upper = std::to_string(current_upper);
+                    r.lower = current_lower;
+                    r.upper = current_upper;
                     r.insertion_ratio = current_rate / total;
                     (*ranges).push_back(std::move(r));
 
@@ -571,20 +600,20 @@ namespace leveldb {
 
         if (is_constructing_subranges) {
             Range r = {};
-            r.lower = std::to_string(current_lower);
+            r.lower = current_lower;
             ranges->push_back(std::move(r));
             NOVA_ASSERT(ranges->size() == num_ranges_to_construct);
         } else {
-            if (current_lower < upper) {
+            if (nova::KeySpace::Compare(current_lower, upper) < 0) {
                 Range r = {};
-                r.lower = std::to_string(current_lower);
+                r.lower = current_lower;
                 ranges->push_back(std::move(r));
             }
             NOVA_ASSERT(ranges->size() <= num_ranges_to_construct);
         }
 
-        (*ranges)[0].lower = std::to_string(lower);
-        (*ranges->rbegin()).upper = std::to_string(upper);
+        (*ranges)[0].lower = lower;
+        (*ranges->rbegin()).upper = upper;
     }
 
     bool
@@ -630,8 +659,8 @@ namespace leveldb {
             return false;
         }
         num_minor_reorgs_for_dup++;
-        uint64_t lower = sr.tiny_ranges[0].lower_int();
-        uint64_t upper = sr.tiny_ranges[0].upper_int();
+        std::string lower = sr.tiny_ranges[0].lower;
+        std::string upper = sr.tiny_ranges[0].upper;
         // Update num duplicates.
         uint32_t total_num_dups = sr.num_duplicates + new_num_duplicates + 1;
         if (sr.num_duplicates == 0) {
@@ -650,10 +679,10 @@ namespace leveldb {
                 if (r.tiny_ranges.size() != 1) {
                     continue;
                 }
-                if (r.tiny_ranges[0].lower_int() != lower) {
+                if (user_comparator_->Compare(r.tiny_ranges[0].lower, lower) != 0) {
                     continue;
                 }
-                if (r.tiny_ranges[0].upper_int() != upper) {
+                if (user_comparator_->Compare(r.tiny_ranges[0].upper, upper) != 0) {
                     continue;
                 }
                 end = i;
@@ -675,8 +704,8 @@ namespace leveldb {
         for (int i = 0; i < new_num_duplicates; i++) {
             SubRange new_sr = {};
             Range tinyrange = {};
-            tinyrange.lower = std::to_string(lower);
-            tinyrange.upper = std::to_string(upper);
+            tinyrange.lower = lower;
+            tinyrange.upper = upper;
             tinyrange.ninserts = total_inserts / (new_num_duplicates + 1);
             tinyrange.insertion_ratio =
                     tinyrange.ninserts / total_num_inserts_since_last_major_;
@@ -713,7 +742,7 @@ namespace leveldb {
                 SubRange &min_sr = latest_->subranges[i];
                 // Skip the new subranges.
                 if (min_sr.tiny_ranges.size() == 1) {
-                    if (min_sr.tiny_ranges[0].lower_int() == lower) {
+                    if (user_comparator_->Compare(min_sr.tiny_ranges[0].lower, lower) == 0) {
                         continue;
                     }
                 }
@@ -886,7 +915,38 @@ namespace leveldb {
         }
         std::vector<AtomicMemTable *> subrange_imms;
         if ((double) unfair_ranges / (double) sr.tiny_ranges.size() >
-            SUBRANGE_MAJOR_REORG_THRESHOLD) {
+            SUBRANGE_MAJOR_REORG_THRESHOLD && !sketches_.empty()) {
+            std::map<std::string, double, nova::KeySpace::Less> userkey_freq;
+            double total_accesses = SketchSampling(subrange_id,
+                                                   sr.first().lower,
+                                                   sr.last().upper,
+                                                   &userkey_freq);
+            num_minor_reorgs_samples += 1;
+            if (userkey_freq.size() <=
+                options_.num_tiny_ranges_per_subrange * 2 ||
+                total_accesses <= 100) {
+                num_skipped_minor_reorgs++;
+            } else {
+                std::vector<Range> ranges;
+                ConstructRanges(userkey_freq, total_accesses,
+                                sr.first().lower,
+                                sr.last().upper,
+                                options_.num_tiny_ranges_per_subrange, false, &ranges);
+                for (auto &range : ranges) {
+                    range.ninserts = range.insertion_ratio * sr.ninserts;
+                }
+                sr.tiny_ranges.clear();
+                sr.tiny_ranges = ranges;
+                sr.UpdateStats(total_num_inserts_since_last_major_);
+                MemTablePartition *partition = (*partitioned_active_memtables_)[subrange_id];
+                partition->mutex.Lock();
+                sketches_[subrange_id]->Clear();
+                partition->mutex.Unlock();
+                NOVA_LOG(rdmaio::INFO)
+                    << fmt::format("Minor sketch sampling {} {}", total_accesses, sr.DebugString());
+            }
+        } else if ((double) unfair_ranges / (double) sr.tiny_ranges.size() >
+                   SUBRANGE_MAJOR_REORG_THRESHOLD) {
             // higher share.
             // Perform major reorg.
             uint32_t nslots = options_.num_memtables / options_.num_memtable_partitions;
@@ -924,7 +984,7 @@ namespace leveldb {
             }
             (*partitioned_active_memtables_)[subrange_id]->mutex.Unlock();
             // We have all memtables now.
-            std::map<uint64_t, double> userkey_freq;
+            std::map<std::string, double, nova::KeySpace::Less> userkey_freq;
             double total_accesses = 0;
             for (int i = 0; i < subrange_imms.size(); i++) {
                 AtomicMemTable *mem = subrange_imms[i];
@@ -941,9 +1001,7 @@ namespace leveldb {
                         continue;
                     }
 
-                    uint64_t k = 0;
-                    nova::str_to_int(uk.data(), &k, uk.size());
-                    userkey_freq[k] += 1;
+                    userkey_freq[uk.ToString()] += 1;
                     total_accesses += 1;
                     it->Next();
                 }
@@ -957,8 +1015,8 @@ namespace leveldb {
             } else {
                 std::vector<Range> ranges;
                 ConstructRanges(userkey_freq, total_accesses,
-                                sr.first().lower_int(),
-                                sr.last().upper_int(),
+                                sr.first().lower,
+                                sr.last().upper,
                                 options_.num_tiny_ranges_per_subrange, false, &ranges);
                 for (auto &range : ranges) {
                     range.ninserts = range.insertion_ratio * sr.ninserts;
@@ -1012,7 +1070,8 @@ namespace leveldb {
     SubRangeManager::ReorganizeSubranges() {
         uint32_t cfgid = nova::NovaConfig::config->current_cfg_id;
         auto range = nova::NovaConfig::config->cfgs[cfgid]->fragments[dbindex_];
-        if (range->range.key_end - range->range.key_start <= options_.num_memtable_partitions) {
+        if (nova::KeySpace::NumKeys(range->range.key_start, range->range.key_end) <=
+            options_.num_memtable_partitions) {
             return;
         }
 
@@ -1213,19 +1272,19 @@ namespace leveldb {
         auto sr = new SubRanges;
         uint32_t cfgid = nova::NovaConfig::config->current_cfg_id;
         auto range = nova::NovaConfig::config->cfgs[cfgid]->fragments[dbindex_];
-        int nkeys = range->range.key_end - range->range.key_start;
+        uint64_t nkeys = nova::KeySpace::NumKeys(range->range.key_start, range->range.key_end);
 
         if (nkeys < options_.num_memtable_partitions) {
             int num_duplicates = options_.num_memtable_partitions / nkeys;
             int cdup = 0;
-            int lower = range->range.key_start;
-            int upper = range->range.key_start + 1;
+            std::string lower = range->range.key_start;
+            std::string upper = nova::KeySpace::Successor(lower);
 
             for (int i = 0; i < options_.num_memtable_partitions; i++) {
                 SubRange nsr;
                 Range r;
-                r.lower = std::to_string(lower);
-                r.upper = std::to_string(upper);
+                r.lower = lower;
+                r.upper = upper;
                 if (num_duplicates == 1) {
                     r.num_duplicates = 0;
                     nsr.num_duplicates = 0;
@@ -1238,39 +1297,64 @@ namespace leveldb {
                 cdup++;
                 if (cdup == num_duplicates) {
                     lower = upper;
-                    upper = lower + 1;
+                    upper = nova::KeySpace::Successor(lower);
                     cdup = 0;
                 }
-                if (upper > range->range.key_end) {
+                if (nova::KeySpace::CompareEnd(upper, range->range) > 0) {
                     break;
                 }
             }
         } else {
-            int nkeys_per_range = nkeys / options_.num_memtable_partitions;
-            int lower = range->range.key_start;
-            int upper = range->range.key_start + nkeys_per_range;
-
-            for (int i = 0; i < options_.num_memtable_partitions; i++) {
-                if (i == options_.num_memtable_partitions - 1) {
-                    upper = range->range.key_end;
-                }
+            std::vector<std::string> boundaries = nova::KeySpace::Split(range->range.key_start,
+                                                                        range->range.key_end,
+                                                                        options_.num_memtable_partitions);
+            for (int i = 0; i + 1 < boundaries.size(); i++) {
                 SubRange nsr;
                 Range r;
-                r.lower = std::to_string(lower);
-                r.upper = std::to_string(upper);
+                r.lower = boundaries[i];
+                r.upper = boundaries[i + 1];
                 nsr.tiny_ranges.push_back(r);
                 sr->subranges.push_back(nsr);
-                lower = upper;
-                upper = lower + nkeys_per_range;
             }
         }
         sr->AssertSubrangeBoundary(user_comparator);
-        NOVA_ASSERT(sr->first().first().lower_int() == range->range.key_start) << sr->DebugString();
-        NOVA_ASSERT(sr->last().last().upper_int() == range->range.key_end) << sr->DebugString();
+        NOVA_ASSERT(user_comparator->Compare(sr->first().first().lower, range->range.key_start) == 0)
+            << sr->DebugString();
+        NOVA_ASSERT(user_comparator->Compare(sr->last().last().upper, range->range.key_end) == 0)
+            << sr->DebugString();
         ComputeCompactionThreadsAssignment(sr);
         latest_subranges_.store(sr);
         NOVA_LOG(rdmaio::INFO)
-            << fmt::format("keys:{},{}", lower_bound_, upper_bound_);
+            << fmt::format("keys:{},{}", nova::KeySpace::EncodeBoundary(lower_bound_),
+                           nova::KeySpace::EncodeBoundary(upper_bound_));
+    }
+
+    void SubRangeManager::SetKeyRange(const std::string &lower, const std::string &upper) {
+        lower_bound_ = lower;
+        upper_bound_ = upper;
+    }
+
+    std::string SubRangeManager::MedianKey() {
+        SubRanges *ref = latest_subranges_;
+        double total = 0;
+        for (const auto &sr : ref->subranges) {
+            for (const auto &r : sr.tiny_ranges) {
+                total += r.ninserts;
+            }
+        }
+        if (total == 0) {
+            return "";
+        }
+        double sum = 0;
+        for (const auto &sr : ref->subranges) {
+            for (const auto &r : sr.tiny_ranges) {
+                if (sum >= total / 2) {
+                    return r.lower;
+                }
+                sum += r.ninserts;
+            }
+        }
+        return "";
     }
 
     void
@@ -1333,14 +1417,16 @@ namespace leveldb {
         db_stats->num_minor_reorgs_for_dup = num_minor_reorgs_for_dup;
         db_stats->num_minor_reorgs_samples = num_minor_reorgs_samples;
         std::vector<double> loads;
-        uint64_t totalkeys = upper_bound_ - lower_bound_;
-        if (nova::NovaConfig::config->client_access_pattern == "uniform") {
+        if (nova::NovaConfig::config->key_type == nova::KeyType::KEY_TYPE_BYTES) {
+            // The access distribution is known only for integer keys.
+            for (int i = 0; i < ref->subranges.size(); i++) {
+                loads.push_back(ref->subranges[i].insertion_ratio);
+            }
+        } else if (nova::NovaConfig::config->client_access_pattern == "uniform") {
+            uint64_t totalkeys = nova::KeySpace::NumKeys(lower_bound_, upper_bound_);
             for (int i = 0; i < ref->subranges.size(); i++) {
                 SubRange &sr = ref->subranges[i];
-                uint64_t lower = sr.first().lower_int();
-                uint64_t upper = sr.last().upper_int();
-                uint64_t keys = upper - lower;
-                loads.push_back((double) keys / (double) totalkeys);
+                loads.push_back((double) sr.keys() / (double) totalkeys);
             }
         } else {
             // Zipfian.
@@ -2,7 +2,6 @@
 //
 // Created by Haoyu Huang on 5/4/20.
 // Copyright (c) 2020 University of Southern California. All rights reserved.
-// It assumes keys are integers.
 //
 
 #ifndef LEVELDB_SUBRANGE_MANAGER_H
@@ -12,6 +11,7 @@
 #include "memtable.h"
 #include "version_set.h"
 #include "flush_order.h"
+#include "key_sketch.h"
 
 #define SUBRANGE_WARMUP_NPUTS 1000000
 #define SUBRANGE_MAJOR_REORG_INTERVAL 1000000
@@ -38,6 +38,10 @@ namespace leveldb {
 
         void ReorganizeSubranges();
 
+        // Record an insert of key into the sketch of partition_id. The
+        // caller holds the mutex of the partition.
+        void RecordInsert(uint32_t partition_id, const Slice &key);
+
         int SearchSubranges(const leveldb::WriteOptions &options,
                             const leveldb::Slice &key,
                             const leveldb::Slice &val,
@@ -45,6 +49,13 @@ namespace leveldb {
 
         void ConstructSubrangesWithUniform(const Comparator *user_comparator);
 
+        // Reorganize subranges within [lower, upper) from now on.
+        void SetKeyRange(const std::string &lower, const std::string &upper);
+
+        // The lower boundary of the tiny range at which the inserts
+        // recorded by the subranges reach half. Empty without inserts.
+        std::string MedianKey();
+
         void QueryDBStats(leveldb::DBStats *db_stats);
 
         void ComputeCompactionThreadsAssignment(SubRanges *subranges);
@@ -67,20 +78,26 @@ namespace leveldb {
         VersionEdit edit_;
     private:
         uint32_t dbindex_ = 0;
-        uint64_t lower_bound_ = 0;
-        uint64_t upper_bound_ = 0;
+        std::string lower_bound_;
+        std::string upper_bound_;
 
         void ComputeLoadImbalance(const std::vector<double> &loads,
                                   leveldb::DBStats *db_stats);
 
-        void ConstructRanges(const std::map<uint64_t, double> &userkey_rate,
-                             double total_rate, uint64_t lower, uint64_t upper,
+        void ConstructRanges(const std::map<std::string, double, nova::KeySpace::Less> &userkey_rate,
+                             double total_rate, const std::string &lower, const std::string &upper,
                              uint32_t num_ranges_to_construct,
                              bool is_constructing_subranges,
                              std::vector<Range> *ranges);
 
         std::vector<AtomicMemTable *> MinorSampling(int subrange_id);
 
+        // Add the weight of each key in [lower, upper) recorded by the
+        // sketch of partition_id to *userkey_rate. Return the total weight.
+        double SketchSampling(uint32_t partition_id, const std::string &lower,
+                              const std::string &upper,
+                              std::map<std::string, double, nova::KeySpace::Less> *userkey_rate);
+
         bool MajorReorg();
 
         bool DestroyDuplicates(int subrange_id, bool force);
@@ -105,6 +122,9 @@ namespace leveldb {
         std::atomic_int_fast32_t *memtable_id_seq_;
         std::vector<MemTablePartition *> *partitioned_active_memtables_ = nullptr;
         std::vector<uint32_t> *partitioned_imms_ = nullptr;
+        // One per partition. It is protected by the mutex of the partition.
+        // Empty when subrange_reorg_sketch_size is 0.
+        std::vector<KeySketch *> sketches_;
     };
 }
 
@@ -11,6 +11,9 @@
 #include "leveldb/table.h"
 #include "util/coding.h"
 
+#include <algorithm>
+#include <unordered_map>
+
 namespace leveldb {
 
     struct TableAndFile {
@@ -31,6 +34,54 @@ namespace leveldb {
         cache->Release(h);
     }
 
+    namespace {
+        struct RecentlyUsedEntries {
+            // Tables by the id of their data blocks in the block cache.
+            std::unordered_map<uint64_t, CachedBlock> tables;
+            std::vector<std::pair<uint32_t, CachedBlock>> ranked_tables;
+            std::vector<std::pair<uint32_t, CachedBlock>> ranked_blocks;
+        };
+
+        void CollectTable(void *arg, const Slice &key, void *value, uint32_t rank) {
+            if (key[0] != 'u') {
+                return;
+            }
+            auto entries = reinterpret_cast<RecentlyUsedEntries *>(arg);
+            TableAndFile *tf = reinterpret_cast<TableAndFile *>(value);
+            CachedBlock table = {};
+            table.file_number = DecodeFixed64(key.data() + 1);
+            table.replica_id = DecodeFixed32(key.data() + 9);
+            entries->tables[tf->table->cache_id()] = table;
+            entries->ranked_tables.emplace_back(rank, table);
+        }
+
+        void CollectBlock(void *arg, const Slice &key, void *value, uint32_t rank) {
+            if (key.size() != 8 + StoCBlockHandle::HandleSize()) {
+                return;
+            }
+            auto entries = reinterpret_cast<RecentlyUsedEntries *>(arg);
+            auto it = entries->tables.find(DecodeFixed64(key.data()));
+            if (it == entries->tables.end()) {
+                return;
+            }
+            CachedBlock block = it->second;
+            block.handle.DecodeHandle(key.data() + 8);
+            entries->ranked_blocks.emplace_back(rank, block);
+        }
+
+        void SortByRank(std::vector<std::pair<uint32_t, CachedBlock>> *ranked,
+                        std::vector<CachedBlock> *result) {
+            std::stable_sort(ranked->begin(), ranked->end(),
+                             [](const std::pair<uint32_t, CachedBlock> &a,
+                                const std::pair<uint32_t, CachedBlock> &b) {
+                                 return a.first < b.first;
+                             });
+            for (const auto &entry : *ranked) {
+                result->push_back(entry.second);
+            }
+        }
+    }
+
     TableCache::TableCache(const std::string &dbname, const Options &options,
                            int entries, DBProfiler *db_profiler)
             : env_(options.env),
@@ -201,6 +252,56 @@ namespace leveldb {
         return s;
     }
 
+    void TableCache::RecentlyUsed(Cache *block_cache, std::vector<CachedBlock> *tables,
+                                  std::vector<CachedBlock> *blocks) {
+        RecentlyUsedEntries entries;
+        cache_->ApplyToRecentEntries(&CollectTable, &entries);
+        if (block_cache) {
+            block_cache->ApplyToRecentEntries(&CollectBlock, &entries);
+        }
+        SortByRank(&entries.ranked_tables, tables);
+        SortByRank(&entries.ranked_blocks, blocks);
+    }
+
+    uint32_t TableCache::Prefetch(const ReadOptions &options, const FileMetaData *meta,
+                                  uint32_t replica_id,
+                                  const std::vector<StoCBlockHandle> &handles) {
+        Cache::Handle *handle = nullptr;
+        Status s = FindTable(AccessCaller::kUncategorized, options, meta, meta->number, replica_id,
+                             meta->converted_file_size, 0, &handle);
+        if (!s.ok()) {
+            return 0;
+        }
+        Table *table = reinterpret_cast<TableAndFile *>(cache_->Value(handle))->table;
+        Cache *block_cache = options_.block_cache;
+        BlockReadContext context = {
+                .caller = AccessCaller::kUncategorized,
+                .file_number = meta->number,
+                .level = 0,
+        };
+        uint32_t read_blocks = 0;
+        char handle_buf[StoCBlockHandle::HandleSize()];
+        char cache_key_buffer[8 + StoCBlockHandle::HandleSize()];
+        for (const auto &block_handle : handles) {
+            if (block_cache) {
+                EncodeFixed64(cache_key_buffer, table->cache_id());
+                block_handle.EncodeHandle(cache_key_buffer + 8);
+                Cache::Handle *cached = block_cache->Lookup(Slice(cache_key_buffer, sizeof(cache_key_buffer)));
+                if (cached) {
+                    block_cache->Release(cached);
+                    continue;
+                }
+            }
+            block_handle.EncodeHandle(handle_buf);
+            Iterator *iter = Table::DataBlockReader(table, nullptr, context, options,
+                                                    Slice(handle_buf, sizeof(handle_buf)), nullptr);
+            delete iter;
+            read_blocks++;
+        }
+        cache_->Release(handle);
+        return read_blocks;
+    }
+
     void TableCache::Evict(uint64_t file_number, bool compaction_file_only) {
         char buf[1 + 8 + 4];
         buf[0] = 'c';
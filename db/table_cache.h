@@ -10,6 +10,7 @@
 #include <stdint.h>
 
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "leveldb/cache.h"
@@ -20,6 +21,14 @@ namespace leveldb {
 
     class Env;
 
+    // A table opened for user requests or one of its data blocks in the
+    // block cache.
+    struct CachedBlock {
+        uint64_t file_number = 0;
+        uint32_t replica_id = 0;
+        StoCBlockHandle handle = {};
+    };
+
     class TableCache {
     public:
         TableCache(const std::string &dbname, const Options &options,
@@ -51,6 +60,19 @@ namespace leveldb {
         void
         Evict(uint64_t file_number, bool compaction_file_only);
 
+        // Append the tables opened for user requests to *tables and their
+        // data blocks in block_cache to *blocks, both ordered from the
+        // most recently used one.
+        void RecentlyUsed(Cache *block_cache, std::vector<CachedBlock> *tables,
+                          std::vector<CachedBlock> *blocks);
+
+        // Open the table for user requests and read its data blocks that
+        // are not in the block cache into the block cache. Return the
+        // number of read blocks.
+        uint32_t Prefetch(const ReadOptions &options, const FileMetaData *meta,
+                          uint32_t replica_id,
+                          const std::vector<StoCBlockHandle> &handles);
+
         Status
         FindTable(AccessCaller caller, const ReadOptions &options,
                   const FileMetaData *meta,
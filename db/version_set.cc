@@ -10,6 +10,7 @@
 #include <fmt/core.h>
 #include <getopt.h>
 #include <common/nova_common.h>
+#include "common/nova_config.h"
 #include "ltc/stoc_file_client_impl.h"
 #include "common/nova_console_logging.h"
 
@@ -163,17 +164,12 @@ namespace leveldb {
             }
 
             auto userkey = ExtractUserKey(target);
-            uint64_t userkeyint;
-            nova::str_to_int(userkey.data(), &userkeyint, userkey.size());
             while (Valid()) {
                 auto current_key = ExtractUserKey(key());
-                uint64_t pivot = 0;
-                nova::str_to_int(current_key.data(), &pivot,
-                                 current_key.size());
                 NOVA_LOG(rdmaio::DEBUG)
-                    << fmt::format("Level file skip:{} {}", userkeyint, pivot);
+                    << fmt::format("Level file skip:{} {}", userkey.ToString(), current_key.ToString());
 
-                if (userkeyint != pivot) {
+                if (nova::KeySpace::Compare(userkey, current_key) != 0) {
                     return;
                 }
                 index_++;
@@ -321,6 +317,38 @@ namespace leveldb {
         return a->number > b->number;
     }
 
+    static bool NewestRunFirst(FileMetaData *a, FileMetaData *b) {
+        if (a->flush_timestamp != b->flush_timestamp) {
+            return a->flush_timestamp > b->flush_timestamp;
+        }
+        return a->number > b->number;
+    }
+
+    namespace {
+        // Level-0 SSTables with the same flush timestamp.
+        struct SortedRun {
+            uint64_t flush_timestamp = 0;
+            uint64_t size = 0;
+            std::vector<FileMetaData *> files;
+        };
+
+        // Group level-0 SSTables into sorted runs, newest first.
+        void GetSortedRuns(const std::vector<FileMetaData *> &l0files,
+                           std::vector<SortedRun> *runs) {
+            std::vector<FileMetaData *> files(l0files);
+            std::sort(files.begin(), files.end(), NewestRunFirst);
+            for (auto f : files) {
+                if (runs->empty() ||
+                    runs->back().flush_timestamp != f->flush_timestamp) {
+                    runs->emplace_back();
+                    runs->back().flush_timestamp = f->flush_timestamp;
+                }
+                runs->back().size += f->file_size;
+                runs->back().files.push_back(f);
+            }
+        }
+    }
+
     void
     Version::ForEachOverlapping(Slice user_key, Slice internal_key, void *arg,
                                 bool (*func)(void *, int, FileMetaData *),
@@ -337,6 +365,10 @@ namespace leveldb {
                     tmp.push_back(f);
                 }
             }
+            if (options_->compaction_style == kCompactionStyleTiered) {
+                // Check sorted runs newest first.
+                std::sort(tmp.begin(), tmp.end(), NewestRunFirst);
+            }
             for (uint32_t i = 0; i < tmp.size(); i++) {
                 if (nova::NovaConfig::config->use_ordered_flush && !(*func)(arg, 0, tmp[i])) {
                     return;
@@ -1224,10 +1256,31 @@ namespace leveldb {
         // Precomputed best level for next compaction
         int best_level = -1;
         double best_score = -1;
+        v->pending_compaction_bytes_ = 0;
+        v->max_bytes_for_level_.resize(options_->level);
+        for (int level = 0; level < options_->level; level++) {
+            v->max_bytes_for_level_[level] = MaxBytesForLevel(*options_, level);
+        }
+        if (options_->enable_dynamic_level_bytes && options_->level > 2) {
+            // Derive the targets from the size of the last level so that most
+            // data resides in the last level. A level is never smaller than
+            // level-0.
+            int last_level = options_->level - 1;
+            double target = TotalFileSize(v->files_[last_level]);
+            for (int level = last_level - 1; level > 0; level--) {
+                target /= config::kLevelSizeMultiplier;
+                v->max_bytes_for_level_[level] = std::max(target,
+                                                          v->max_bytes_for_level_[0]);
+            }
+        }
         for (int level = 0; level < options_->level - 1; level++) {
             double score;
             // Compute the ratio of current size to size limit.
             const uint64_t level_bytes = TotalFileSize(v->files_[level]);
+            const double max_bytes = v->max_bytes_for_level_[level];
+            if (level > 0 && level_bytes > max_bytes) {
+                v->pending_compaction_bytes_ += level_bytes - (uint64_t) max_bytes;
+            }
             if (level == 0 && nova::NovaConfig::config->cfgs.size() > 1 &&
                 v->files_[level].size() > options_->l0nfiles_start_compaction_trigger) {
                 score = 99999;
@@ -1235,9 +1288,17 @@ namespace leveldb {
                 if (level_bytes > 0 && level == 0 && options_->l0bytes_start_compaction_trigger == 0) {
                     score = 99999;
                 } else {
-                    score = static_cast<double>(level_bytes) / MaxBytesForLevel(*options_, level);
+                    score = static_cast<double>(level_bytes) / max_bytes;
                 }
             }
+            if (level == 0 &&
+                options_->compaction_style == kCompactionStyleTiered &&
+                options_->tiered_max_sorted_runs > 0) {
+                std::vector<SortedRun> runs;
+                GetSortedRuns(v->files_[level], &runs);
+                score = std::max(score, static_cast<double>(runs.size()) /
+                                        options_->tiered_max_sorted_runs);
+            }
             if (score > best_score) {
                 best_level = level;
                 best_score = score;
@@ -1302,6 +1363,22 @@ namespace leveldb {
 
     }
 
+    void VersionSet::AddLiveStoCFiles(std::set<std::pair<uint32_t, uint32_t>> *live) {
+        for (Version *v = dummy_versions_.next_; v != &dummy_versions_; v = v->next_) {
+            for (int level = 0; level < options_->level; level++) {
+                for (auto file : v->files_[level]) {
+                    for (const auto &replica : file->block_replica_handles) {
+                        live->insert(std::make_pair(replica.meta_block_handle.server_id,
+                                                    replica.meta_block_handle.stoc_file_id));
+                        for (const auto &handle : replica.data_block_group_handles) {
+                            live->insert(std::make_pair(handle.server_id, handle.stoc_file_id));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
     void VersionSet::AddLiveFiles(std::set<uint64_t> *live,
                                   uint32_t compacting_version_id) {
         NOVA_LOG(rdmaio::DEBUG)
@@ -1733,6 +1810,82 @@ namespace leveldb {
         }
     }
 
+    bool Version::ComputeTieredCompactions(
+            std::vector<leveldb::Compaction *> *compactions) {
+        if (compaction_level_ != 0) {
+            return false;
+        }
+        // Level 0 is pushed into the leveled levels once it exceeds the
+        // start trigger.
+        if (l0_bytes_ >= options_->l0bytes_start_compaction_trigger) {
+            return false;
+        }
+        std::vector<SortedRun> runs;
+        GetSortedRuns(files_[0], &runs);
+        if (runs.size() < options_->tiered_max_sorted_runs) {
+            return false;
+        }
+        const uint32_t min_width = std::max(2u, options_->tiered_min_merge_width);
+        const uint32_t max_files = options_->max_num_sstables_in_nonoverlapping_set;
+        int start = -1;
+        int end = -1;
+        // Merge newer sorted runs with the next older sorted run if their sizes
+        // are similar.
+        for (int i = 0; i + min_width <= runs.size() && start == -1; i++) {
+            uint64_t size = runs[i].size;
+            uint32_t num_files = runs[i].files.size();
+            int j = i + 1;
+            while (j < runs.size()) {
+                if (runs[j].size * 100 > size * (100 + options_->tiered_size_ratio)) {
+                    break;
+                }
+                if (num_files + runs[j].files.size() > max_files) {
+                    break;
+                }
+                size += runs[j].size;
+                num_files += runs[j].files.size();
+                j++;
+            }
+            if (j - i >= min_width) {
+                start = i;
+                end = j;
+            }
+        }
+        // Too many sorted runs. Merge the newest sorted runs to reduce the
+        // number of sorted runs below the limit.
+        if (start == -1) {
+            uint32_t width = std::max(min_width, (uint32_t) (runs.size() -
+                                                             options_->tiered_max_sorted_runs +
+                                                             2));
+            uint32_t num_files = 0;
+            int j = 0;
+            while (j < runs.size() && j < width &&
+                   num_files + runs[j].files.size() <= max_files) {
+                num_files += runs[j].files.size();
+                j++;
+            }
+            if (j >= min_width) {
+                start = 0;
+                end = j;
+            }
+        }
+        if (start == -1) {
+            return false;
+        }
+        auto compaction = new Compaction(this, icmp_, options_, 0, 0);
+        for (int i = start; i < end; i++) {
+            for (auto f : runs[i].files) {
+                compaction->inputs_[0].push_back(f);
+            }
+        }
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("Merge sorted runs [{},{}) of {} at level 0: {}",
+                           start, end, runs.size(),
+                           compaction->DebugString(icmp_->user_comparator()));
+        compactions->push_back(compaction);
+        return true;
+    }
+
     void Version::GetOverlappingInputs(
             std::vector<leveldb::FileMetaData *> &inputs,
             const leveldb::Slice &begin, const leveldb::Slice &end,
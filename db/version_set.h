@@ -177,6 +177,11 @@ namespace leveldb {
 
         void ComputeNonOverlappingSet(std::vector<Compaction *> *compactions, bool *delete_due_to_low_overlap);
 
+        // Tiered compaction style. Merge sorted runs at level-0 once it has
+        // tiered_max_sorted_runs sorted runs and is below the start trigger.
+        // Return false if there are no sorted runs to merge.
+        bool ComputeTieredCompactions(std::vector<Compaction *> *compactions);
+
         bool
         AssertNonOverlappingSet(const std::vector<Compaction *> &compactions,
                                 std::string *reason);
@@ -211,6 +216,17 @@ namespace leveldb {
         std::vector<std::vector<FileMetaData *>> files_;
         uint32_t version_id_ = 0;
         uint64_t l0_bytes_ = 0;
+        // Bytes of levels 1 and above that exceed their target sizes.
+        uint64_t pending_compaction_bytes_ = 0;
+        // Target size of each level. Computed in VersionSet::Finalize.
+        std::vector<double> max_bytes_for_level_;
+
+        double TargetBytesForLevel(int level) const {
+            if (level < max_bytes_for_level_.size()) {
+                return max_bytes_for_level_[level];
+            }
+            return MaxBytesForLevel(*options_, level);
+        }
         VersionSet *vset_ = nullptr;
         const InternalKeyComparator *icmp_;
         const Options *const options_;
@@ -226,6 +242,8 @@ namespace leveldb {
 
         friend class VersionSet;
 
+        friend class VersionTest;
+
         class LevelFileNumIterator;
 
         Version(const Version &) = delete;
@@ -375,6 +393,10 @@ namespace leveldb {
         void AddLiveFiles(std::set<uint64_t> *live,
                           uint32_t compacting_version_id);
 
+        // Add the (StoC id, StoC file id) of the SSTable replicas in any
+        // live version to *live.
+        void AddLiveStoCFiles(std::set<std::pair<uint32_t, uint32_t>> *live);
+
         void AppendVersion(Version *v);
 
         void DeleteObsoleteVersions();
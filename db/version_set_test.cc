@@ -395,6 +395,45 @@ namespace leveldb {
             version->fn_files_[f->number] = f;
         }
 
+        // Add a sorted run of nfiles level-0 SSTables with size bytes in
+        // total. A larger flush_timestamp is a newer sorted run.
+        void CreateSortedRun(Version *version, uint64_t flush_timestamp,
+                             uint64_t size, uint32_t nfiles = 1) {
+            for (uint32_t i = 0; i < nfiles; i++) {
+                CreateFileMetaData(version, 0, i * 10, i * 10 + 5);
+                FileMetaData *f = version->files_[0].back();
+                f->flush_timestamp = flush_timestamp;
+                f->file_size = size / nfiles;
+                version->l0_bytes_ += f->file_size;
+            }
+            SetCompactionLevel(version, 0);
+        }
+
+        static void SetCompactionLevel(Version *version, int level) {
+            version->compaction_level_ = level;
+        }
+
+        static Options TieredOptions() {
+            Options options;
+            options.level = 2;
+            options.compaction_style = kCompactionStyleTiered;
+            options.tiered_max_sorted_runs = 4;
+            options.tiered_size_ratio = 20;
+            options.tiered_min_merge_width = 2;
+            options.max_num_sstables_in_nonoverlapping_set = 10;
+            options.l0bytes_start_compaction_trigger = 1000000;
+            return options;
+        }
+
+        // The flush timestamps of the sorted runs that the compaction merges.
+        static std::set<uint64_t> MergedRuns(Compaction *compaction) {
+            std::set<uint64_t> runs;
+            for (auto f : compaction->inputs_[0]) {
+                runs.insert(f->flush_timestamp);
+            }
+            return runs;
+        }
+
         void PrintCompactions(const Comparator *user_comparator,
                               std::vector<Compaction *> &compactions) {
             std::string debug;
@@ -565,6 +604,7 @@ namespace leveldb {
     TEST(VersionTest, TestNonOverlappingSetDEBUG3) {
         InternalKeyComparator icmp(new YCSBKeyComparator);
         Options options;
+        options.level = 2;
         options.max_num_coordinated_compaction_nonoverlapping_sets = 2;
         options.max_num_sstables_in_nonoverlapping_set = 3;
         Version *version = new Version(&icmp, nullptr, &options, 1, nullptr);
@@ -576,6 +616,7 @@ namespace leveldb {
         CreateFileMetaData(version, 1, 5, 9);
         CreateFileMetaData(version, 1, 9, 12);
         CreateFileMetaData(version, 1, 12, 18);
+        SetCompactionLevel(version, 0);
 
 //        CreateFileMetaData(version, 1, 2080413, 2766187);
 //        CreateFileMetaData(version, 1, 2766232, 3457725);
@@ -589,6 +630,87 @@ namespace leveldb {
         ASSERT_TRUE(version->AssertNonOverlappingSet(compactions, &reason));
     }
 
+    TEST(VersionTest, TieredSizeRatio) {
+        InternalKeyComparator icmp(new YCSBKeyComparator);
+        Options options = TieredOptions();
+        Version *version = new Version(&icmp, nullptr, &options, 1, nullptr);
+        CreateSortedRun(version, 1, 1000);
+        CreateSortedRun(version, 2, 11);
+        CreateSortedRun(version, 3, 10);
+
+        // Fewer sorted runs than tiered_max_sorted_runs.
+        std::vector<Compaction *> compactions;
+        ASSERT_TRUE(!version->ComputeTieredCompactions(&compactions));
+        ASSERT_TRUE(compactions.empty());
+
+        // The three newest sorted runs are within 20% of the total size of
+        // the newer ones. The oldest one is not.
+        CreateSortedRun(version, 4, 10);
+        ASSERT_TRUE(version->ComputeTieredCompactions(&compactions));
+        ASSERT_EQ(1, compactions.size());
+        ASSERT_EQ(0, compactions[0]->level());
+        ASSERT_EQ(3, compactions[0]->inputs_[0].size());
+        ASSERT_TRUE(MergedRuns(compactions[0]) == std::set<uint64_t>({2, 3, 4}));
+    }
+
+    TEST(VersionTest, TieredMaxSortedRuns) {
+        InternalKeyComparator icmp(new YCSBKeyComparator);
+        Options options = TieredOptions();
+        Version *version = new Version(&icmp, nullptr, &options, 1, nullptr);
+        // No two adjacent sorted runs have similar sizes.
+        CreateSortedRun(version, 1, 10000);
+        CreateSortedRun(version, 2, 1000);
+        CreateSortedRun(version, 3, 100);
+        CreateSortedRun(version, 4, 10);
+        CreateSortedRun(version, 5, 1);
+
+        // Merge the newest sorted runs to bring 5 sorted runs back below
+        // the limit of 4.
+        std::vector<Compaction *> compactions;
+        ASSERT_TRUE(version->ComputeTieredCompactions(&compactions));
+        ASSERT_EQ(1, compactions.size());
+        ASSERT_TRUE(MergedRuns(compactions[0]) == std::set<uint64_t>({3, 4, 5}));
+
+        // A compaction holds at most max_num_sstables_in_nonoverlapping_set
+        // SSTables.
+        options.max_num_sstables_in_nonoverlapping_set = 4;
+        version = new Version(&icmp, nullptr, &options, 1, nullptr);
+        CreateSortedRun(version, 1, 10000, 2);
+        CreateSortedRun(version, 2, 1000, 2);
+        CreateSortedRun(version, 3, 100, 2);
+        CreateSortedRun(version, 4, 10, 2);
+        CreateSortedRun(version, 5, 1, 2);
+        compactions.clear();
+        ASSERT_TRUE(version->ComputeTieredCompactions(&compactions));
+        ASSERT_EQ(4, compactions[0]->inputs_[0].size());
+        ASSERT_TRUE(MergedRuns(compactions[0]) == std::set<uint64_t>({4, 5}));
+    }
+
+    TEST(VersionTest, TieredFallsBackToLeveled) {
+        InternalKeyComparator icmp(new YCSBKeyComparator);
+        Options options = TieredOptions();
+        options.l0bytes_start_compaction_trigger = 40;
+        Version *version = new Version(&icmp, nullptr, &options, 1, nullptr);
+        for (int i = 1; i <= 4; i++) {
+            CreateSortedRun(version, i, 9);
+        }
+        std::vector<Compaction *> compactions;
+        ASSERT_TRUE(version->ComputeTieredCompactions(&compactions));
+        ASSERT_EQ(4, compactions[0]->inputs_[0].size());
+
+        // Level 0 reached l0bytes_start_compaction_trigger. It is compacted
+        // into level 1 instead.
+        CreateSortedRun(version, 5, 4);
+        compactions.clear();
+        ASSERT_TRUE(!version->ComputeTieredCompactions(&compactions));
+        ASSERT_TRUE(compactions.empty());
+
+        // Levels 1 and above are leveled.
+        version->l0_bytes_ = 0;
+        SetCompactionLevel(version, 1);
+        ASSERT_TRUE(!version->ComputeTieredCompactions(&compactions));
+    }
+
 }  // namespace leveldb
 
 using namespace std;
@@ -0,0 +1,99 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "write_controller.h"
+
+#include <algorithm>
+
+namespace leveldb {
+    namespace {
+        // Refresh the compaction debt at most once per millisecond.
+        const uint64_t kRefreshIntervalMicros = 1000;
+        // The rate never drops below 1% of the delayed write rate.
+        const double kMinRateRatio = 0.01;
+        // A single write is never delayed for more than one second.
+        const uint64_t kMaxDelayMicros = 1000000;
+    }
+
+    WriteController::WriteController(const Options &options)
+            : l0_slowdown_(options.l0bytes_slowdown_writes_trigger),
+              l0_stop_(options.l0bytes_stop_writes_trigger),
+              pending_slowdown_(options.pending_compaction_bytes_slowdown_trigger),
+              pending_stop_(options.pending_compaction_bytes_stop_trigger),
+              imm_slowdown_(options.imm_slowdown_writes_trigger),
+              imm_stop_(options.num_memtables),
+              max_rate_(options.delayed_write_rate),
+              enabled_(options.delayed_write_rate > 0 &&
+                       (options.l0bytes_slowdown_writes_trigger > 0 ||
+                        options.pending_compaction_bytes_slowdown_trigger > 0 ||
+                        options.imm_slowdown_writes_trigger > 0)) {
+        pressure_ = 0;
+        last_refresh_ = 0;
+    }
+
+    double WriteController::Pressure(uint64_t value, uint64_t slowdown,
+                                     uint64_t stop) {
+        if (slowdown == 0 || value < slowdown) {
+            return 0;
+        }
+        if (stop == 0) {
+            // Without a stop trigger, the pressure reaches 1 at twice the
+            // slowdown trigger.
+            stop = 2 * slowdown;
+        }
+        if (stop <= slowdown) {
+            return 1;
+        }
+        return std::min(1.0, (double) (value - slowdown) /
+                             (double) (stop - slowdown));
+    }
+
+    bool WriteController::ShouldRefresh(uint64_t now) {
+        uint64_t last = last_refresh_;
+        if (now < last + kRefreshIntervalMicros) {
+            return false;
+        }
+        return last_refresh_.compare_exchange_strong(last, now);
+    }
+
+    void WriteController::Refresh(uint64_t l0_bytes,
+                                  uint64_t pending_compaction_bytes,
+                                  uint32_t num_immutable_memtables) {
+        double pressure = Pressure(l0_bytes, l0_slowdown_, l0_stop_);
+        pressure = std::max(pressure,
+                            Pressure(pending_compaction_bytes,
+                                     pending_slowdown_, pending_stop_));
+        pressure = std::max(pressure,
+                            Pressure(num_immutable_memtables, imm_slowdown_,
+                                     imm_stop_));
+        pressure_ = pressure;
+    }
+
+    uint64_t WriteController::GetDelay(uint64_t now, uint64_t bytes) {
+        double pressure = pressure_;
+        if (pressure <= 0) {
+            return 0;
+        }
+        double rate = max_rate_ * std::max(kMinRateRatio, 1.0 - pressure);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (now > last_refill_) {
+            if (last_refill_ != 0) {
+                tokens_ += (double) (now - last_refill_) * rate / 1000000.0;
+            }
+            last_refill_ = now;
+        }
+        // Allow a burst of at most one refresh interval worth of bytes.
+        tokens_ = std::min(tokens_,
+                           rate * kRefreshIntervalMicros / 1000000.0);
+        tokens_ -= bytes;
+        if (tokens_ >= 0) {
+            return 0;
+        }
+        uint64_t delay = (uint64_t) (-tokens_ * 1000000.0 / rate);
+        return std::min(delay, kMaxDelayMicros);
+    }
+}
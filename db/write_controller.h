@@ -0,0 +1,72 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#ifndef LEVELDB_WRITE_CONTROLLER_H
+#define LEVELDB_WRITE_CONTROLLER_H
+
+#include <atomic>
+#include <mutex>
+
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+    // Throttle writes smoothly as compaction debt grows instead of stalling
+    // all writes once L0 reaches l0bytes_stop_writes_trigger.
+    //
+    // The compaction debt consists of L0 bytes, bytes that exceed the target
+    // size of levels 1 and above, and the number of immutable memtables.
+    // The write pressure is 0 below the slowdown triggers and grows linearly
+    // to 1 at the stop triggers, or at twice a slowdown trigger whose stop
+    // trigger is 0. Writes are admitted by a token bucket whose
+    // rate decreases linearly from delayed_write_rate to 1% of it as the
+    // pressure grows.
+    class WriteController {
+    public:
+        explicit WriteController(const Options &options);
+
+        // Return true if the caller should refresh the compaction debt.
+        // Only one caller is selected per refresh interval.
+        bool ShouldRefresh(uint64_t now);
+
+        void Refresh(uint64_t l0_bytes, uint64_t pending_compaction_bytes,
+                     uint32_t num_immutable_memtables);
+
+        // Return the number of microseconds a write of "bytes" should be
+        // delayed.
+        uint64_t GetDelay(uint64_t now, uint64_t bytes);
+
+        double pressure() const {
+            return pressure_;
+        }
+
+        bool enabled() const {
+            return enabled_;
+        }
+
+    private:
+        static double Pressure(uint64_t value, uint64_t slowdown,
+                               uint64_t stop);
+
+        const uint64_t l0_slowdown_;
+        const uint64_t l0_stop_;
+        const uint64_t pending_slowdown_;
+        const uint64_t pending_stop_;
+        const uint32_t imm_slowdown_;
+        const uint32_t imm_stop_;
+        const uint64_t max_rate_;
+        const bool enabled_;
+
+        std::atomic<double> pressure_;
+        std::atomic_uint_fast64_t last_refresh_;
+
+        std::mutex mutex_;
+        double tokens_ = 0;
+        uint64_t last_refill_ = 0;
+    };
+}
+
+#endif //LEVELDB_WRITE_CONTROLLER_H
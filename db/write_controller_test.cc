@@ -0,0 +1,147 @@
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "db/write_controller.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "util/testharness.h"
+
+namespace leveldb {
+
+    class WriteControllerTest {
+    public:
+        WriteControllerTest() {
+            options_.l0bytes_slowdown_writes_trigger = 100;
+            options_.l0bytes_stop_writes_trigger = 200;
+            options_.pending_compaction_bytes_slowdown_trigger = 1000;
+            options_.pending_compaction_bytes_stop_trigger = 3000;
+            options_.imm_slowdown_writes_trigger = 2;
+            options_.num_memtables = 4;
+            // 0.5 bytes per microsecond at pressure 0.5.
+            options_.delayed_write_rate = 1000000;
+        }
+
+        Options options_;
+    };
+
+    TEST(WriteControllerTest, PressureCurve) {
+        WriteController controller(options_);
+        ASSERT_TRUE(controller.enabled());
+        ASSERT_EQ(0, controller.pressure());
+
+        // L0 bytes.
+        controller.Refresh(50, 0, 0);
+        ASSERT_EQ(0, controller.pressure());
+        controller.Refresh(100, 0, 0);
+        ASSERT_EQ(0, controller.pressure());
+        controller.Refresh(150, 0, 0);
+        ASSERT_EQ(0.5, controller.pressure());
+        controller.Refresh(200, 0, 0);
+        ASSERT_EQ(1, controller.pressure());
+        controller.Refresh(400, 0, 0);
+        ASSERT_EQ(1, controller.pressure());
+
+        // Pending compaction bytes.
+        controller.Refresh(0, 1000, 0);
+        ASSERT_EQ(0, controller.pressure());
+        controller.Refresh(0, 2000, 0);
+        ASSERT_EQ(0.5, controller.pressure());
+        controller.Refresh(0, 3000, 0);
+        ASSERT_EQ(1, controller.pressure());
+
+        // Immutable memtables stop writes at num_memtables.
+        controller.Refresh(0, 0, 1);
+        ASSERT_EQ(0, controller.pressure());
+        controller.Refresh(0, 0, 3);
+        ASSERT_EQ(0.5, controller.pressure());
+        controller.Refresh(0, 0, 4);
+        ASSERT_EQ(1, controller.pressure());
+
+        // The highest pressure wins.
+        controller.Refresh(125, 2000, 1);
+        ASSERT_EQ(0.5, controller.pressure());
+        controller.Refresh(0, 0, 0);
+        ASSERT_EQ(0, controller.pressure());
+    }
+
+    TEST(WriteControllerTest, StopZero) {
+        options_.l0bytes_stop_writes_trigger = 0;
+        WriteController controller(options_);
+        // The pressure reaches 1 at twice the slowdown trigger.
+        controller.Refresh(150, 0, 0);
+        ASSERT_EQ(0.5, controller.pressure());
+        controller.Refresh(200, 0, 0);
+        ASSERT_EQ(1, controller.pressure());
+        controller.Refresh(1000, 0, 0);
+        ASSERT_EQ(1, controller.pressure());
+
+        // A stop trigger at the slowdown trigger stops writes at once.
+        options_.l0bytes_stop_writes_trigger = 100;
+        WriteController stop(options_);
+        stop.Refresh(99, 0, 0);
+        ASSERT_EQ(0, stop.pressure());
+        stop.Refresh(100, 0, 0);
+        ASSERT_EQ(1, stop.pressure());
+
+        // No slowdown triggers or no rate disables the controller.
+        options_.delayed_write_rate = 0;
+        ASSERT_TRUE(!WriteController(options_).enabled());
+        options_.delayed_write_rate = 1000000;
+        options_.l0bytes_slowdown_writes_trigger = 0;
+        options_.pending_compaction_bytes_slowdown_trigger = 0;
+        options_.imm_slowdown_writes_trigger = 0;
+        ASSERT_TRUE(!WriteController(options_).enabled());
+    }
+
+    TEST(WriteControllerTest, GetDelay) {
+        WriteController controller(options_);
+        // No pressure, no delay.
+        ASSERT_EQ(0, controller.GetDelay(1000, 1000000));
+
+        controller.Refresh(150, 0, 0);
+        // The bucket starts empty. 100 bytes take 200 us at 0.5 bytes/us.
+        ASSERT_EQ(200, controller.GetDelay(1000, 100));
+        ASSERT_EQ(200, controller.GetDelay(1200, 100));
+
+        // An idle writer accumulates at most one refresh interval worth
+        // of tokens.
+        ASSERT_EQ(0, controller.GetDelay(100000, 400));
+        ASSERT_EQ(600, controller.GetDelay(100000, 400));
+
+        // The rate never drops below 1% and a delay never exceeds 1 second.
+        controller.Refresh(200, 0, 0);
+        ASSERT_EQ(1000000, controller.GetDelay(200000, 1000000));
+    }
+
+    TEST(WriteControllerTest, ShouldRefresh) {
+        WriteController controller(options_);
+        ASSERT_TRUE(controller.ShouldRefresh(10000));
+        ASSERT_TRUE(!controller.ShouldRefresh(10000));
+        ASSERT_TRUE(!controller.ShouldRefresh(10999));
+        ASSERT_TRUE(controller.ShouldRefresh(11000));
+
+        // Concurrent callers in the same interval select exactly one.
+        for (uint64_t now = 20000; now < 30000; now += 1000) {
+            std::atomic_int selected(0);
+            std::vector<std::thread> threads;
+            for (int i = 0; i < 8; i++) {
+                threads.emplace_back([&]() {
+                    if (controller.ShouldRefresh(now)) {
+                        selected++;
+                    }
+                });
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            ASSERT_EQ(1, selected);
+        }
+    }
+}
+
+int main(int argc, char **argv) { return leveldb::test::RunAllTests(); }
@@ -31,6 +31,10 @@ namespace leveldb {
 // of Cache uses a least-recently-used eviction policy.
     LEVELDB_EXPORT Cache *NewLRUCache(size_t capacity);
 
+// Like NewLRUCache but with 2^num_shard_bits shards. Each shard holds
+// capacity / 2^num_shard_bits bytes.
+    LEVELDB_EXPORT Cache *NewLRUCache(size_t capacity, int num_shard_bits);
+
     class LEVELDB_EXPORT Cache {
     public:
         Cache() = default;
@@ -96,6 +100,21 @@ namespace leveldb {
         // leveldb may change Prune() to a pure abstract method.
         virtual void Prune() {}
 
+        // Change the capacity of the cache. It evicts entries that are not
+        // in use until the cache fits. The default implementation does
+        // nothing.
+        virtual void SetCapacity(size_t capacity) {}
+
+        // Call (*fn)(arg, key, value, rank) for each entry of the cache.
+        // rank is the recency of the entry within its shard where 0 is
+        // the most recently used one. Shards hash keys uniformly, so
+        // entries of all shards sorted by rank approximate the global
+        // recency order. fn is called with the lock of a shard held and
+        // must not access the cache. The default implementation does
+        // nothing.
+        virtual void ApplyToRecentEntries(void (*fn)(void *arg, const Slice &key, void *value, uint32_t rank),
+                                          void *arg) {}
+
         // Return an estimate of the combined charges of all elements stored in the
         // cache.
         virtual size_t TotalCharge() const = 0;
@@ -233,6 +233,9 @@ namespace leveldb {
 
         virtual void StartCoordinatedCompaction() = 0;
 
+        // The risk that the db stalls writes. 1 means writes are stalled.
+        virtual double StallRisk() = 0;
+
 //        std::vector<DB *> dbs_;
 //        std::vector<nova::RDMAMsgCallback *> rdma_threads_;
 
@@ -249,6 +252,11 @@ namespace leveldb {
         uint64_t processed_writes_ = 0;
         uint64_t number_of_puts_no_wait_ = 0;
         uint64_t number_of_puts_wait_ = 0;
+        uint64_t number_of_puts_delayed_ = 0;
+        uint64_t write_delay_us_ = 0;
+        // Bytes written by flushes and compactions.
+        uint64_t flushed_bytes_ = 0;
+        uint64_t compaction_output_bytes_ = 0;
     };
 
 // Destroy the contents of the specified database.
@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <map>
@@ -255,8 +256,43 @@ namespace leveldb {
 
     class MemTablePool {
     public:
+        // Return n memtables to the pool. It withholds them first if the
+        // pool has shrunk. Requires mutex_ held.
+        void Release(uint32_t n) {
+            uint32_t withheld = std::min(n, num_withheld_memtables_);
+            num_withheld_memtables_ -= withheld;
+            num_available_memtables_ += n - withheld;
+        }
+
+        // Change the total number of memtables. Memtables in use beyond the
+        // new capacity are withheld once they are released. Requires
+        // mutex_ held.
+        void Resize(uint32_t capacity) {
+            if (capacity >= capacity_) {
+                uint32_t grow = capacity - capacity_;
+                uint32_t cancel = std::min(grow, num_withheld_memtables_);
+                num_withheld_memtables_ -= cancel;
+                num_available_memtables_ += grow - cancel;
+            } else {
+                uint32_t shrink = capacity_ - capacity;
+                uint32_t take = std::min(shrink, num_available_memtables_);
+                num_available_memtables_ -= take;
+                num_withheld_memtables_ += shrink - take;
+            }
+            capacity_ = capacity;
+        }
+
+        // Requires mutex_ held.
+        uint32_t num_used_memtables() const {
+            return capacity_ + num_withheld_memtables_ -
+                   num_available_memtables_;
+        }
+
         port::CondVar **range_cond_vars_;
         uint32_t num_available_memtables_ = 0;
+        // Total number of memtables.
+        uint32_t capacity_ = 0;
+        uint32_t num_withheld_memtables_ = 0;
         std::mutex mutex_;
     };
 }
@@ -298,6 +298,14 @@ namespace leveldb {
 
         virtual Status Append(const Slice &data) = 0;
 
+        // Append the slices in order. The default implementation appends
+        // them one at a time.
+        virtual Status AppendBatch(const std::vector<Slice> &data);
+
+        // Deallocate [offset, offset+size) while keeping the file size.
+        // Later reads of the range return zeros.
+        virtual Status PunchHole(uint64_t offset, uint64_t size);
+
         virtual Status Close() = 0;
 
         virtual Status Flush() = 0;
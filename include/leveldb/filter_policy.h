@@ -17,6 +17,7 @@
 #define STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
 
 #include <string>
+#include <vector>
 
 #include "leveldb/export.h"
 
@@ -68,6 +69,29 @@ namespace leveldb {
 // trailing spaces in keys.
     LEVELDB_EXPORT const FilterPolicy *NewBloomFilterPolicy(int bits_per_key);
 
+// Return a new filter policy that keeps all probes of a key within one
+// 64-byte cache line. Lookups cost one cache miss and use AVX2 when the CPU
+// supports it. The false positive rate is slightly higher than that of
+// NewBloomFilterPolicy() with the same bits_per_key.
+    LEVELDB_EXPORT const FilterPolicy *NewBlockedBloomFilterPolicy(int bits_per_key);
+
+// Return a new ribbon filter policy with about the same false positive rate
+// as a bloom filter with bloom_equivalent_bits_per_key bits per key, using
+// about 30% less memory. Ribbon filters are space efficient only with many
+// keys per filter. Use them with Options::whole_table_filter.
+    LEVELDB_EXPORT const FilterPolicy *NewRibbonFilterPolicy(
+            double bloom_equivalent_bits_per_key);
+
+// Compute the bits per key of each level following Monkey and append them to
+// *level_bits_per_key. The size of level i is assumed to be
+// level_size_multiplier^i. Upper levels receive more bits per key than lower
+// levels while the total filter memory stays at bits_per_key bits per key.
+// This minimizes the sum of the false positive rates across levels.
+    LEVELDB_EXPORT void
+    MonkeyBitsPerKey(int num_levels, double bits_per_key,
+                     double level_size_multiplier,
+                     std::vector<double> *level_bits_per_key);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
@@ -33,7 +33,7 @@ namespace leveldb {
 
             Writer &operator=(const Writer &) = delete;
 
-            ~Writer();
+            virtual ~Writer();
 
             virtual Status AddRecord(const Slice &slice);
 
@@ -51,6 +51,11 @@ namespace leveldb {
         kMajorCoordinatedStoC = 3
     };
 
+    enum CompactionStyle {
+        kCompactionStyleLeveled = 0,
+        kCompactionStyleTiered = 1
+    };
+
     enum ClientAccessPattern {
         kClientAccessSkewed = 0,
         kClientAccessUniform = 1,
@@ -85,6 +90,11 @@ namespace leveldb {
 
         double subrange_reorg_sampling_ratio = 1.0;
 
+        // Number of keys per level of the key sketch of each subrange. A
+        // subrange reorganization computes new boundaries from the sketches
+        // instead of sampling memtables. 0 samples memtables.
+        uint32_t subrange_reorg_sketch_size = 0;
+
         uint32_t max_num_coordinated_compaction_nonoverlapping_sets = 1;
 
         uint32_t max_num_sstables_in_nonoverlapping_set = 20;
@@ -107,6 +117,19 @@ namespace leveldb {
 
         MajorCompactionType major_compaction_type = MajorCompactionType::kMajorSingleThreaded;
 
+        // With the tiered compaction style, level-0 SSTables flushed or merged
+        // at the same time form a sorted run. Sorted runs of similar sizes are
+        // merged with each other instead of being compacted into level-1.
+        // Level-0 is compacted into level-1 only when it exceeds
+        // l0bytes_start_compaction_trigger. Levels 1 and above are leveled.
+        CompactionStyle compaction_style = CompactionStyle::kCompactionStyleLeveled;
+        // Merge sorted runs once level-0 has this many sorted runs.
+        uint32_t tiered_max_sorted_runs = 8;
+        // A sorted run is merged with the newer sorted runs if its size is at
+        // most (100 + tiered_size_ratio)% of their total size.
+        uint32_t tiered_size_ratio = 20;
+        uint32_t tiered_min_merge_width = 2;
+
         bool enable_flush_multiple_memtables = false;
 
         bool enable_subrange_reorg = false;
@@ -140,6 +163,16 @@ namespace leveldb {
         // 4 GB.
         uint64_t l0bytes_start_compaction_trigger = 4l * 1024 * 1024 * 1024;
         uint64_t l0bytes_stop_writes_trigger = 0;
+        // Writes are delayed by a token bucket once the compaction debt
+        // exceeds one of the slowdown triggers. The write rate decreases
+        // linearly from delayed_write_rate as the debt approaches the
+        // corresponding stop trigger. 0 disables a trigger.
+        uint64_t l0bytes_slowdown_writes_trigger = 0;
+        uint64_t pending_compaction_bytes_slowdown_trigger = 0;
+        uint64_t pending_compaction_bytes_stop_trigger = 0;
+        uint32_t imm_slowdown_writes_trigger = 0;
+        // Bytes per second.
+        uint64_t delayed_write_rate = 16 * 1024 * 1024;
         uint64_t l0nfiles_start_compaction_trigger = 4;
         int level = 0;
 
@@ -151,8 +184,9 @@ namespace leveldb {
         uint32_t subrange_no_flush_num_keys = 100;
         uint32_t num_compaction_threads = 0;
 
-        uint64_t lower_key = 0;
-        uint64_t upper_key = 0;
+        // Keys served by the database in [lower_key, upper_key).
+        std::string lower_key;
+        std::string upper_key;
 
         // Any internal progress/error information generated by the db will
         // be written to info_log if it is non-null, or to a file stored
@@ -232,6 +266,19 @@ namespace leveldb {
         // NewBloomFilterPolicy() here.
         const FilterPolicy *filter_policy = nullptr;
 
+        // If non-empty, SSTables at level i are built with
+        // level_filter_policies[i] instead of filter_policy. All policies
+        // must be able to read filters built by each other.
+        std::vector<const FilterPolicy *> level_filter_policies;
+
+        // If true, each SSTable has a single filter for all its keys instead of
+        // one filter every 2KB of data blocks.
+        bool whole_table_filter = false;
+
+        // If true, the target sizes of levels 1 and above are derived from the
+        // size of the last level instead of l0bytes_start_compaction_trigger.
+        bool enable_dynamic_level_bytes = false;
+
         MemTablePool *memtable_pool = nullptr;
     };
 
@@ -279,6 +326,10 @@ namespace leveldb {
         StoCClient *stoc_client = nullptr;
 
         uint64_t total_writes = 0;
+        // If not 0, the write uses this sequence number instead of a new
+        // one. It replays a write that the source of a live migration
+        // processed.
+        uint64_t sequence_number = 0;
         char *rdma_backing_mem = nullptr;
         uint32_t rdma_backing_mem_size = 0;
         StoCReplicateLogRecordState *replicate_log_record_states = nullptr;
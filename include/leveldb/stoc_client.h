@@ -77,8 +77,15 @@ namespace leveldb {
         RDMA_WRITE_REQUEST = 'D',
         RDMA_WRITE_REMOTE_BUF_ALLOCATED = 'E',
         LTC_MIGRATION = 'F',
+        LTC_MIGRATION_CAUGHT_UP = 'L',
+        LTC_MIGRATION_TAIL = 'M',
+        LTC_MIGRATION_WARM_CACHE = 'N',
         STOC_REPLICATE_SSTABLES = 'G',
         STOC_REPLICATE_SSTABLES_RESPONSE = 'H',
+        STOC_ALLOCATE_LOG_BUFFERS = 'I',
+        STOC_ALLOCATE_LOG_BUFFERS_SUCC = 'J',
+        STOC_BIND_LOG_BUFFER = 'K',
+        STOC_FREE_LOG_BUFFERS = 'P',
     };
 
     struct StoCRequestContext {
@@ -98,6 +105,8 @@ namespace leveldb {
         uint64_t stoc_queue_depth = 0;
         uint64_t stoc_pending_read_bytes = 0;
         uint64_t stoc_pending_write_bytes = 0;
+        uint64_t stoc_block_cache_hits = 0;
+        uint64_t stoc_block_cache_misses = 0;
 
         // log records.
         char *log_record_mem = nullptr;
@@ -127,6 +136,8 @@ namespace leveldb {
         uint64_t stoc_queue_depth;
         uint64_t stoc_pending_read_bytes;
         uint64_t stoc_pending_write_bytes;
+        uint64_t stoc_block_cache_hits = 0;
+        uint64_t stoc_block_cache_misses = 0;
         bool is_ready_to_process_requests;
     };
 
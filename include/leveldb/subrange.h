@@ -66,6 +66,7 @@ namespace leveldb {
 
         bool IsAPoint(const Comparator *comparator) const;
 
+        // Integer keys only.
         uint64_t lower_int() const;
 
         uint64_t upper_int() const;
@@ -117,7 +118,8 @@ namespace leveldb {
             return tiny_ranges[tiny_ranges.size() - 1];
         }
 
-        int keys() const;
+        // UINT64_MAX when a byte-string subrange has more than one key.
+        uint64_t keys() const;
 
         uint32_t Encode(char *buf, uint32_t subrange_id) const;
 
@@ -79,6 +79,9 @@ namespace leveldb {
         // be close to the file length.
         uint64_t ApproximateOffsetOf(const Slice &key) const;
 
+        // The id of the data blocks of this table in the block cache.
+        uint64_t cache_id() const;
+
         static Status
         ReadBlock(RandomAccessFile *file, const ReadOptions &options,
                   const StoCBlockHandle &stoc_block_handle,
@@ -0,0 +1,411 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "disk_log_writer.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <thread>
+#include <fmt/core.h>
+
+#include "common/nova_config.h"
+#include "common/nova_console_logging.h"
+#include "db/log_reader.h"
+#include "leveldb/env.h"
+
+namespace leveldb {
+    namespace {
+        // O_DIRECT requires aligned buffers, offsets and sizes.
+        const uint64_t kDirectIOAlignment = 4096;
+
+        uint64_t AlignUp(uint64_t size) {
+            return (size + kDirectIOAlignment - 1) / kDirectIOAlignment *
+                   kDirectIOAlignment;
+        }
+
+        uint64_t AlignDown(uint64_t size) {
+            return size / kDirectIOAlignment * kDirectIOAlignment;
+        }
+
+        bool EndsWith(const std::string &str, const std::string &suffix) {
+            return str.size() >= suffix.size() &&
+                   str.compare(str.size() - suffix.size(), suffix.size(),
+                               suffix) == 0;
+        }
+
+        // Serves log::Reader from the contents of a log file in memory.
+        class StringSource : public SequentialFile {
+        public:
+            explicit StringSource(const std::string &contents)
+                    : contents_(contents) {}
+
+            Status Read(size_t n, Slice *result, char *scratch) override {
+                n = std::min(n, contents_.size() - offset_);
+                *result = Slice(contents_.data() + offset_, n);
+                offset_ += n;
+                return Status::OK();
+            }
+
+            Status Skip(uint64_t n) override {
+                offset_ += std::min(n, (uint64_t) (contents_.size() - offset_));
+                return Status::OK();
+            }
+
+        private:
+            const std::string &contents_;
+            uint64_t offset_ = 0;
+        };
+
+        class LogReporter : public log::Reader::Reporter {
+        public:
+            explicit LogReporter(const std::string &fname) : fname_(fname) {}
+
+            void Corruption(size_t bytes, const Status &status) override {
+                // The tail of a log file may be torn by a crash.
+                NOVA_LOG(rdmaio::INFO)
+                    << fmt::format("{}: dropped {} bytes: {}", fname_, bytes,
+                                   status.ToString());
+            }
+
+        private:
+            const std::string &fname_;
+        };
+
+        void ReadLogFile(const std::string &fname,
+                         std::vector<DiskLogRecord> *log_records) {
+            int fd = ::open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+            NOVA_ASSERT(fd >= 0)
+                << fmt::format("Cannot open {}: {}", fname, strerror(errno));
+            struct stat st = {};
+            NOVA_ASSERT(fstat(fd, &st) == 0);
+            std::string contents;
+            contents.resize(st.st_size);
+            uint64_t read = 0;
+            while (read < contents.size()) {
+                ssize_t n = ::pread(fd, &contents[read], contents.size() - read,
+                                    read);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                NOVA_ASSERT(n >= 0)
+                    << fmt::format("Cannot read {}: {}", fname, strerror(errno));
+                if (n == 0) {
+                    break;
+                }
+                read += n;
+            }
+            contents.resize(read);
+            close(fd);
+
+            StringSource source(contents);
+            LogReporter reporter(fname);
+            log::Reader reader(&source, &reporter, /*checksum=*/true, 0);
+            Slice record;
+            std::string scratch;
+            while (reader.ReadRecord(&record, &scratch)) {
+                LevelDBLogRecord log_record = {};
+                while (nova::DecodeLogRecord(&record, &log_record)) {
+                    DiskLogRecord disk_record = {};
+                    disk_record.sequence_number = log_record.sequence_number;
+                    disk_record.key = log_record.key.ToString();
+                    disk_record.value = log_record.value.ToString();
+                    log_records->push_back(std::move(disk_record));
+                }
+            }
+        }
+    }
+
+    // Holds a whole log file in an aligned buffer.
+    class DiskLogWriter::LogFileBuffer : public WritableFile {
+    public:
+        explicit LogFileBuffer(uint64_t capacity) : capacity_(capacity) {
+            NOVA_ASSERT(posix_memalign(reinterpret_cast<void **>(&buf_),
+                                       kDirectIOAlignment, capacity) == 0);
+        }
+
+        ~LogFileBuffer() override {
+            free(buf_);
+        }
+
+        Status Append(const Slice &data) override {
+            NOVA_ASSERT(size_ + data.size() <= capacity_)
+                << fmt::format("log file exceeds {} bytes", capacity_);
+            memcpy(buf_ + size_, data.data(), data.size());
+            size_ += data.size();
+            return Status::OK();
+        }
+
+        Status Close() override {
+            return Status::OK();
+        }
+
+        Status Flush() override {
+            return Status::OK();
+        }
+
+        // DiskLogWriter syncs log files in groups.
+        Status Sync() override {
+            return Status::OK();
+        }
+
+        char *data() {
+            return buf_;
+        }
+
+        uint64_t size() const {
+            return size_;
+        }
+
+    private:
+        char *buf_ = nullptr;
+        const uint64_t capacity_;
+        uint64_t size_ = 0;
+    };
+
+    DiskLogWriter::DiskLogWriter(const std::string &log_dir, uint32_t dbid,
+                                 StoCIOEngine *engine)
+            : log_dir_(log_dir), dbid_(dbid), incarnation_(Env::Default()->NowMicros()),
+              engine_(engine) {
+        NOVA_ASSERT(engine_);
+        nova::mkdirs(log_dir_.c_str());
+        std::string prefix = fmt::format("db{}-", dbid_);
+        DIR *dir = opendir(log_dir_.c_str());
+        NOVA_ASSERT(dir) << fmt::format("Cannot open {}: {}", log_dir_,
+                                        strerror(errno));
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            std::string name(entry->d_name);
+            if (name.compare(0, prefix.size(), prefix) == 0 &&
+                EndsWith(name, ".log")) {
+                old_log_files_.push_back(log_dir_ + "/" + name);
+            }
+        }
+        closedir(dir);
+    }
+
+    DiskLogWriter::~DiskLogWriter() {
+        for (auto &it : log_files_) {
+            close(it.second->fd);
+            delete it.second->writer;
+            delete it.second->buffer;
+            delete it.second;
+        }
+        delete engine_;
+    }
+
+    std::string DiskLogWriter::LogFilePath(uint32_t memtable_id) const {
+        return fmt::format("{}/db{}-{}-{}.log", log_dir_, dbid_, incarnation_,
+                           memtable_id);
+    }
+
+    DiskLogWriter::LogFile *DiskLogWriter::OpenLogFile(uint32_t memtable_id) {
+        auto it = log_files_.find(memtable_id);
+        if (it != log_files_.end()) {
+            return it->second;
+        }
+        auto file = new LogFile;
+        file->name = LogFilePath(memtable_id);
+        file->fd = ::open(file->name.c_str(),
+                          O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_DIRECT,
+                          0644);
+        if (file->fd < 0 && errno == EINVAL) {
+            // The file system does not support O_DIRECT, e.g., tmpfs.
+            file->fd = ::open(file->name.c_str(),
+                              O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        }
+        NOVA_ASSERT(file->fd >= 0)
+            << fmt::format("Cannot open {}: {}", file->name, strerror(errno));
+        // A memtable log fits in a StoC log buffer. Leave room for the
+        // headers of log::Writer.
+        uint64_t max_size = nova::NovaConfig::config->max_stoc_file_size;
+        file->buffer = new LogFileBuffer(
+                AlignUp(max_size + max_size / 4 + log::kBlockSize));
+        file->writer = new log::Writer(file->buffer);
+        log_files_[memtable_id] = file;
+        return file;
+    }
+
+    void DiskLogWriter::CloseLogFile(LogFile *file) {
+        close(file->fd);
+        unlink(file->name.c_str());
+        delete file->writer;
+        delete file->buffer;
+        delete file;
+    }
+
+    void DiskLogWriter::AddRecords(uint32_t memtable_id,
+                                   const std::vector<LevelDBLogRecord> &log_records) {
+        std::string payload;
+        payload.resize(nova::LogRecordsSize(log_records));
+        uint32_t size = 0;
+        for (const auto &record : log_records) {
+            size += nova::EncodeLogRecord(&payload[size], record);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        LogFile *file = OpenLogFile(memtable_id);
+        file->writer->AddRecord(payload);
+        dirty_files_.insert(file);
+        uint64_t seq = ++appended_seq_;
+        nova::NovaGlobalVariables::global.local_log_records += log_records.size();
+        while (synced_seq_ < seq) {
+            if (is_syncing_) {
+                cv_.wait(lock);
+                continue;
+            }
+            // Commit on behalf of all writers that have appended so far.
+            is_syncing_ = true;
+            uint64_t target_seq = appended_seq_;
+            std::vector<DirtyRange> ranges;
+            for (auto dirty_file : dirty_files_) {
+                DirtyRange range = {};
+                range.file = dirty_file;
+                range.size = dirty_file->buffer->size();
+                // Rewrite the last partial block.
+                range.start = AlignDown(dirty_file->synced);
+                range.end = AlignUp(range.size);
+                memset(dirty_file->buffer->data() + range.size, 0,
+                       range.end - range.size);
+                ranges.push_back(range);
+            }
+            dirty_files_.clear();
+            lock.unlock();
+            Commit(ranges);
+            lock.lock();
+            for (const auto &range : ranges) {
+                range.file->synced = range.size;
+            }
+            synced_seq_ = target_seq;
+            is_syncing_ = false;
+            cv_.notify_all();
+        }
+    }
+
+    void DiskLogWriter::Commit(const std::vector<DirtyRange> &ranges) {
+        uint64_t start = Env::Default()->NowMicros();
+        std::vector<StoCIORequest> writes(ranges.size());
+        std::vector<StoCIORequest> syncs(ranges.size());
+        for (size_t i = 0; i < ranges.size(); i++) {
+            writes[i].type = kStoCIOWrite;
+            writes[i].fd = ranges[i].file->fd;
+            writes[i].buf = ranges[i].file->buffer->data() + ranges[i].start;
+            writes[i].offset = ranges[i].start;
+            writes[i].size = ranges[i].end - ranges[i].start;
+            syncs[i].type = kStoCIOSync;
+            syncs[i].fd = ranges[i].file->fd;
+        }
+        RunIO(&writes);
+        for (size_t i = 0; i < writes.size(); i++) {
+            NOVA_ASSERT(writes[i].result == writes[i].size)
+                << fmt::format("Cannot write {}: {}", ranges[i].file->name,
+                               writes[i].result);
+        }
+        RunIO(&syncs);
+        for (size_t i = 0; i < syncs.size(); i++) {
+            NOVA_ASSERT(syncs[i].result == 0)
+                << fmt::format("Cannot sync {}: {}", ranges[i].file->name,
+                               syncs[i].result);
+        }
+        nova::NovaGlobalVariables::global.local_log_commits += 1;
+        nova::NovaGlobalVariables::global.local_log_commit_us +=
+                Env::Default()->NowMicros() - start;
+    }
+
+    void DiskLogWriter::RunIO(std::vector<StoCIORequest> *requests) {
+        {
+            std::lock_guard<std::mutex> lock(io_mutex_);
+            pending_ios_ = requests->size();
+        }
+        for (auto &request : *requests) {
+            request.done = [this]() {
+                {
+                    std::lock_guard<std::mutex> lock(io_mutex_);
+                    pending_ios_--;
+                }
+                io_cv_.notify_all();
+            };
+            engine_->Submit(&request);
+        }
+        engine_->Flush();
+        std::unique_lock<std::mutex> lock(io_mutex_);
+        io_cv_.wait(lock, [&]() { return pending_ios_ == 0; });
+        lock.unlock();
+        // The requests completed. Drain them from the engine.
+        std::vector<StoCIORequest *> completed;
+        engine_->PollCompletions(&completed);
+    }
+
+    void DiskLogWriter::DeleteLogFiles(const std::vector<uint32_t> &memtable_ids) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // The leader accesses the dirty files without the mutex.
+        cv_.wait(lock, [&]() { return !is_syncing_; });
+        for (auto memtable_id : memtable_ids) {
+            auto it = log_files_.find(memtable_id);
+            if (it == log_files_.end()) {
+                continue;
+            }
+            dirty_files_.erase(it->second);
+            CloseLogFile(it->second);
+            log_files_.erase(it);
+        }
+    }
+
+    void DiskLogWriter::ReadOldLogFiles(uint32_t num_threads,
+                                        std::vector<DiskLogRecord> *log_records) {
+        std::vector<std::vector<DiskLogRecord>> file_records(old_log_files_.size());
+        std::atomic_int_fast32_t next_file;
+        next_file = 0;
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < std::min((size_t) std::max(1u, num_threads),
+                                     old_log_files_.size()); i++) {
+            threads.emplace_back([&]() {
+                while (true) {
+                    size_t index = next_file.fetch_add(1);
+                    if (index >= old_log_files_.size()) {
+                        return;
+                    }
+                    ReadLogFile(old_log_files_[index], &file_records[index]);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        for (auto &records : file_records) {
+            std::move(records.begin(), records.end(),
+                      std::back_inserter(*log_records));
+        }
+        // Merging memtables logs their records again with the same sequence
+        // numbers.
+        std::stable_sort(log_records->begin(), log_records->end(),
+                         [](const DiskLogRecord &a, const DiskLogRecord &b) {
+                             return a.sequence_number < b.sequence_number;
+                         });
+        auto last = std::unique(log_records->begin(), log_records->end(),
+                                [](const DiskLogRecord &a, const DiskLogRecord &b) {
+                                    return a.sequence_number == b.sequence_number;
+                                });
+        log_records->erase(last, log_records->end());
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("Read {} log records from {} log files of db-{}",
+                           log_records->size(), old_log_files_.size(), dbid_);
+    }
+
+    void DiskLogWriter::DeleteOldLogFiles() {
+        for (const auto &fname : old_log_files_) {
+            unlink(fname.c_str());
+        }
+        old_log_files_.clear();
+    }
+}
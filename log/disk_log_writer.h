@@ -0,0 +1,114 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#ifndef LEVELDB_DISK_LOG_WRITER_H
+#define LEVELDB_DISK_LOG_WRITER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "leveldb/log_writer.h"
+#include "leveldb/stoc_client.h"
+#include "stoc/stoc_io_engine.h"
+
+namespace leveldb {
+
+    // A log record read back from a log file on disk.
+    struct DiskLogRecord {
+        uint64_t sequence_number = 0;
+        std::string key;
+        std::string value;
+    };
+
+    // Appends log records to one log file per memtable on a local disk.
+    // A log file uses the framing of log::Writer and is written with
+    // O_DIRECT from an aligned buffer that holds the whole file.
+    //
+    // Writers commit in groups. The first writer that finds no sync in
+    // progress becomes the leader. It writes the dirty blocks of all log
+    // files, syncs them and wakes up all writers whose log records are
+    // durable.
+    class DiskLogWriter {
+    public:
+        // The writer owns engine.
+        DiskLogWriter(const std::string &log_dir, uint32_t dbid,
+                      StoCIOEngine *engine);
+
+        ~DiskLogWriter();
+
+        // Return once the log records are durable.
+        void AddRecords(uint32_t memtable_id,
+                        const std::vector<LevelDBLogRecord> &log_records);
+
+        void DeleteLogFiles(const std::vector<uint32_t> &memtable_ids);
+
+        // Read the log files of previous runs with num_threads threads.
+        // Return their log records in the order of their sequence numbers.
+        void ReadOldLogFiles(uint32_t num_threads,
+                             std::vector<DiskLogRecord> *log_records);
+
+        // Delete the log files of previous runs.
+        void DeleteOldLogFiles();
+
+    private:
+        class LogFileBuffer;
+
+        struct LogFile {
+            std::string name;
+            int fd = -1;
+            LogFileBuffer *buffer = nullptr;
+            log::Writer *writer = nullptr;
+            // Bytes that are durable.
+            uint64_t synced = 0;
+        };
+
+        // A dirty range of a log file that the leader writes.
+        struct DirtyRange {
+            LogFile *file = nullptr;
+            uint64_t start = 0;
+            uint64_t end = 0;
+            uint64_t size = 0;
+        };
+
+        std::string LogFilePath(uint32_t memtable_id) const;
+
+        LogFile *OpenLogFile(uint32_t memtable_id);
+
+        void CloseLogFile(LogFile *file);
+
+        // Run the requests and wait for all of them to complete.
+        void RunIO(std::vector<StoCIORequest> *requests);
+
+        // Write and sync the dirty ranges. Requires mutex_ not held.
+        void Commit(const std::vector<DirtyRange> &ranges);
+
+        const std::string log_dir_;
+        const uint32_t dbid_;
+        // Distinguishes the log files of this run from those of previous
+        // runs since memtable ids restart from 0.
+        const uint64_t incarnation_;
+        StoCIOEngine *engine_ = nullptr;
+        std::vector<std::string> old_log_files_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::unordered_map<uint32_t, LogFile *> log_files_;
+        std::unordered_set<LogFile *> dirty_files_;
+        uint64_t appended_seq_ = 0;
+        uint64_t synced_seq_ = 0;
+        bool is_syncing_ = false;
+
+        std::mutex io_mutex_;
+        std::condition_variable io_cv_;
+        uint32_t pending_ios_ = 0;
+    };
+}
+
+#endif //LEVELDB_DISK_LOG_WRITER_H
@@ -0,0 +1,131 @@
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <thread>
+#include <fmt/core.h>
+
+#include "common/nova_config.h"
+#include "log/disk_log_writer.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+    class DiskLogWriterTest {
+    public:
+        DiskLogWriterTest() {
+            if (!nova::NovaConfig::config) {
+                nova::NovaConfig::config = new nova::NovaConfig;
+            }
+            nova::NovaConfig::config->max_stoc_file_size = 1024 * 1024;
+            char dir[] = "/tmp/disk_log_writer_test-XXXXXX";
+            ASSERT_TRUE(mkdtemp(dir) != nullptr);
+            log_dir_ = dir;
+        }
+
+        ~DiskLogWriterTest() {
+            std::string cmd = "rm -rf " + log_dir_;
+            system(cmd.c_str());
+        }
+
+        DiskLogWriter *NewWriter(uint32_t dbid) {
+            StoCIOEngine *engine = StoCIOEngine::NewEngine("threadpool", 0, 2, nullptr, 0, []() {});
+            return new DiskLogWriter(log_dir_, dbid, engine);
+        }
+
+        static std::string Key(uint64_t sequence_number) {
+            return fmt::format("key-{}", sequence_number);
+        }
+
+        // Append num_records records with sequence numbers first,
+        // first + 1, ... to the log file of memtable_id.
+        static void Append(DiskLogWriter *writer, uint32_t memtable_id,
+                           uint64_t first, uint32_t num_records) {
+            for (uint64_t seq = first; seq < first + num_records; seq++) {
+                std::string key = Key(seq);
+                LevelDBLogRecord record = {};
+                record.sequence_number = seq;
+                record.key = key;
+                record.value = "value";
+                writer->AddRecords(memtable_id, {record});
+            }
+        }
+
+        std::vector<DiskLogRecord> ReadOld(uint32_t dbid) {
+            DiskLogWriter *writer = NewWriter(dbid);
+            std::vector<DiskLogRecord> records;
+            writer->ReadOldLogFiles(2, &records);
+            delete writer;
+            return records;
+        }
+
+        std::string log_dir_;
+    };
+
+    TEST(DiskLogWriterTest, ConcurrentAppendAndRecover) {
+        DiskLogWriter *writer = NewWriter(0);
+        const uint32_t num_threads = 4;
+        const uint32_t num_records = 100;
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < num_threads; i++) {
+            threads.emplace_back(&DiskLogWriterTest::Append, writer, i % 2,
+                                 i * num_records + 1, num_records);
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        // Crash without deleting the log files.
+        delete writer;
+
+        std::vector<DiskLogRecord> records = ReadOld(0);
+        ASSERT_EQ(records.size(), num_threads * num_records);
+        for (uint64_t i = 0; i < records.size(); i++) {
+            ASSERT_EQ(records[i].sequence_number, i + 1);
+            ASSERT_EQ(records[i].key, Key(i + 1));
+            ASSERT_EQ(records[i].value, "value");
+        }
+        // The log files of another range are not read.
+        ASSERT_TRUE(ReadOld(1).empty());
+
+        writer = NewWriter(0);
+        writer->DeleteOldLogFiles();
+        delete writer;
+        ASSERT_TRUE(ReadOld(0).empty());
+    }
+
+    TEST(DiskLogWriterTest, DeleteLogFiles) {
+        DiskLogWriter *writer = NewWriter(0);
+        Append(writer, 0, 1, 10);
+        Append(writer, 1, 11, 10);
+        Append(writer, 2, 21, 10);
+        // Memtables 0 and 2 are flushed.
+        writer->DeleteLogFiles({0, 2});
+        // Deleting an unknown log file is a no-op.
+        writer->DeleteLogFiles({3});
+        delete writer;
+
+        std::vector<DiskLogRecord> records = ReadOld(0);
+        ASSERT_EQ(records.size(), 10);
+        for (uint64_t i = 0; i < records.size(); i++) {
+            ASSERT_EQ(records[i].sequence_number, i + 11);
+        }
+    }
+
+    TEST(DiskLogWriterTest, DuplicateSequenceNumbers) {
+        DiskLogWriter *writer = NewWriter(0);
+        Append(writer, 0, 1, 10);
+        // Merging memtables logs their records again.
+        Append(writer, 1, 1, 10);
+        delete writer;
+
+        std::vector<DiskLogRecord> records = ReadOld(0);
+        ASSERT_EQ(records.size(), 10);
+    }
+}
+
+nova::NovaConfig *nova::NovaConfig::config;
+nova::NovaGlobalVariables nova::NovaGlobalVariables::global;
+
+int main(int argc, char **argv) { return leveldb::test::RunAllTests(); }
@@ -5,6 +5,11 @@
 //
 
 #include "log_recovery.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
 #include "db/db_impl.h"
 #include "common/nova_config.h"
 
@@ -14,100 +19,298 @@ namespace leveldb {
             return (t2.tv_sec - t1.tv_sec) * 1000000 +
                    (t2.tv_usec - t1.tv_usec);
         }
+
+        // Fetches the log file of a memtable from one replica.
+        struct ReplicaFetch {
+            uint32_t server_id = 0;
+            uint64_t remote_offset = 0;
+            char *buf = nullptr;
+            uint64_t fetched_size = 0;
+            // Size of the valid log records in buf.
+            uint64_t valid_size = 0;
+        };
+
+        struct MemTableFetch {
+            uint32_t memtable_id = 0;
+            const leveldb::MemTableLogFilePair *pair = nullptr;
+            std::vector<ReplicaFetch> replicas;
+            uint32_t pending_reads = 0;
+        };
+    }
+
+    LogReplayPool::LogReplayPool(uint32_t num_threads) {
+        for (int i = 0; i < std::max(1u, num_threads); i++) {
+            threads_.emplace_back(&LogReplayPool::Run, this);
+        }
+    }
+
+    LogReplayPool::~LogReplayPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void LogReplayPool::Schedule(std::function<void(void)> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(task));
+        }
+        cv_.notify_one();
+    }
+
+    void LogReplayPool::Run() {
+        while (true) {
+            std::function<void(void)> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+                if (queue_.empty()) {
+                    return;
+                }
+                task = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            task();
+        }
     }
 
     LogRecovery::LogRecovery(leveldb::MemManager *mem_manager, leveldb::StoCBlockClient *client) : mem_manager_(
             mem_manager), client_(client) {
     }
 
+    uint32_t LogRecovery::Replay(const char *buf, uint64_t size, MemTable *memtable, uint64_t max_sequence) {
+        leveldb::Slice slice(buf, size);
+        leveldb::LevelDBLogRecord record = {};
+        uint32_t log_records = 0;
+        while (nova::DecodeLogRecord(&slice, &record)) {
+            if (record.sequence_number >= max_sequence) {
+                continue;
+            }
+            memtable->Add(record.sequence_number, leveldb::ValueType::kTypeValue, record.key, record.value);
+            log_records += 1;
+        }
+        return log_records;
+    }
+
+    bool LogRecovery::HasMoreLogRecords(const char *buf, uint64_t fetched_size, uint64_t max_size,
+                                        uint64_t *valid_size) {
+        NOVA_ASSERT(*valid_size <= fetched_size) << fmt::format("{} {}", *valid_size, fetched_size);
+        // A log record is valid only if it fits in the fetched bytes. The
+        // bytes after them may belong to a previous use of the buffer.
+        leveldb::Slice slice(buf + *valid_size, fetched_size - *valid_size);
+        leveldb::LevelDBLogRecord record = {};
+        while (nova::DecodeLogRecord(&slice, &record)) {
+            *valid_size = fetched_size - slice.size();
+        }
+        if (fetched_size >= max_size) {
+            return false;
+        }
+        uint64_t remaining = fetched_size - *valid_size;
+        if (remaining < 4) {
+            return true;
+        }
+        // The next log record is complete only if its size fits in the
+        // fetched bytes. Otherwise, it continues in the next read unless
+        // the log file ends here.
+        uint32_t record_size = leveldb::DecodeFixed32(buf + *valid_size);
+        if (record_size == 0) {
+            return false;
+        }
+        return record_size > remaining && *valid_size + record_size <= max_size;
+    }
+
     void
     LogRecovery::Recover(const std::unordered_map<uint32_t, leveldb::MemTableLogFilePair> &memtables_to_recover,
-                         uint32_t cfg_id, uint32_t dbid) {
+                         uint32_t cfg_id, uint32_t dbid, uint64_t max_sequence) {
         if (memtables_to_recover.empty()) {
             return;
         }
-        std::vector<char *> rdma_bufs;
-        std::vector<uint32_t> reqs;
-        timeval start = {};
-        gettimeofday(&start, nullptr);
-        for (const auto &replica : memtables_to_recover) {
-            uint32_t scid = mem_manager_->slabclassid(0, nova::NovaConfig::config->max_stoc_file_size);
-            char *rdma_buf = mem_manager_->ItemAlloc(0, scid);
-            NOVA_ASSERT(rdma_buf);
-            rdma_bufs.push_back(rdma_buf);
-            NOVA_ASSERT(!replica.second.server_logbuf.empty());
-
-            uint32_t server_id = replica.second.server_logbuf.begin()->first;
-            uint64_t remote_offset = replica.second.server_logbuf.begin()->second;
-            uint32_t reqid = client_->InitiateReadInMemoryLogFile(rdma_buf, server_id, remote_offset,
-                                                                  nova::NovaConfig::config->max_stoc_file_size);
-            NOVA_LOG(rdmaio::INFO)
-                << fmt::format("Restore memtable-{} from server-{} offset:{}", replica.first, server_id,
-                               remote_offset);
-            reqs.push_back(reqid);
+        // With a write quorum, a replica may miss the last log records
+        // acknowledged by the quorum. Read all replicas and recover from
+        // the one with the longest valid prefix. Otherwise, spread the
+        // reads across replicas.
+        bool read_all_replicas = nova::NovaConfig::config->log_write_quorum > 0;
+        uint64_t max_size = nova::NovaConfig::config->max_stoc_file_size;
+        uint64_t read_size = nova::NovaConfig::config->log_recovery_read_size;
+        if (read_size == 0 || read_size > max_size) {
+            read_size = max_size;
         }
+        uint32_t num_threads = std::max(1u, nova::NovaConfig::config->number_of_recovery_threads);
+        // Bound the number of log files held in memory.
+        uint32_t window = 2 * num_threads;
+        uint32_t scid = mem_manager_->slabclassid(0, max_size);
+        leveldb::DBImpl *dbimpl = reinterpret_cast<leveldb::DBImpl *>(nova::NovaConfig::config->cfgs[cfg_id]->fragments[dbid]->db);
 
-        // Wait for all RDMA READ to complete.
+        std::vector<MemTableFetch> fetches;
+        uint32_t replica_seq = 0;
         for (const auto &replica : memtables_to_recover) {
-            client_->Wait();
+            NOVA_ASSERT(!replica.second.server_logbuf.empty());
+            fetches.emplace_back();
+            MemTableFetch &fetch = fetches.back();
+            fetch.memtable_id = replica.first;
+            fetch.pair = &replica.second;
+            auto logbuf = replica.second.server_logbuf.begin();
+            if (!read_all_replicas) {
+                std::advance(logbuf, replica_seq % replica.second.server_logbuf.size());
+                replica_seq++;
+            }
+            for (; logbuf != replica.second.server_logbuf.end(); logbuf++) {
+                ReplicaFetch replica_fetch = {};
+                replica_fetch.server_id = logbuf->first;
+                replica_fetch.remote_offset = logbuf->second;
+                fetch.replicas.push_back(replica_fetch);
+                NOVA_LOG(rdmaio::INFO)
+                    << fmt::format("Restore memtable-{} from server-{} offset:{}", replica.first,
+                                   logbuf->first, logbuf->second);
+                if (!read_all_replicas) {
+                    break;
+                }
+            }
         }
 
-        for (int i = 0; i < reqs.size(); i++) {
-            leveldb::StoCResponse response;
-            NOVA_ASSERT(client_->IsDone(reqs[i], &response, nullptr));
-        }
+        timeval start = {};
+        gettimeofday(&start, nullptr);
+        timeval fetch_complete = {};
+        std::atomic_uint_fast64_t recovered_log_records;
+        recovered_log_records = 0;
+        uint64_t fetched_bytes = 0;
+        std::mutex mutex;
+        std::condition_variable cv;
+        uint32_t active_fetches = 0;
+        {
+            std::unordered_map<uint32_t, std::pair<MemTableFetch *, ReplicaFetch *>> inflight_reads;
+            auto read = [&](MemTableFetch *fetch, ReplicaFetch *replica) {
+                uint64_t size = std::min(read_size, max_size - replica->fetched_size);
+                uint32_t reqid = client_->InitiateReadInMemoryLogFile(replica->buf + replica->fetched_size,
+                                                                      replica->server_id,
+                                                                      replica->remote_offset +
+                                                                      replica->fetched_size,
+                                                                      size);
+                replica->fetched_size += size;
+                fetched_bytes += size;
+                fetch->pending_reads += 1;
+                inflight_reads[reqid] = std::make_pair(fetch, replica);
+            };
+            auto replay = [&](MemTableFetch *fetch) {
+                ReplicaFetch *longest = &fetch->replicas[0];
+                for (auto &replica : fetch->replicas) {
+                    if (replica.valid_size > longest->valid_size) {
+                        longest = &replica;
+                    }
+                }
+                const leveldb::MemTableLogFilePair &pair = *fetch->pair;
+                leveldb::MemTable *memtable = pair.memtable;
+                uint32_t log_records = Replay(longest->buf, longest->valid_size, memtable, max_sequence);
+                recovered_log_records += log_records;
+                memtable->SetReadyToProcessRequests();
+                // Schedule for compaction.
+                if (pair.is_immutable) {
+                    int thread_id = -1;
+                    bool merge_memtables_without_flushing = false;
+                    unsigned int rand_seed = fetch->memtable_id;
+                    if (pair.subrange) {
+                        thread_id = pair.subrange->GetCompactionThreadId(
+                                &EnvBGThread::bg_flush_memtable_thread_id_seq,
+                                &merge_memtables_without_flushing);
+                    } else {
+                        thread_id =
+                                EnvBGThread::bg_flush_memtable_thread_id_seq.fetch_add(
+                                        1, std::memory_order_relaxed) %
+                                dbimpl->bg_flush_memtable_threads_.size();
+                    }
+                    dbimpl->ScheduleFlushMemTableTask(thread_id, memtable->memtableid(), memtable,
+                                                      pair.partition_id, pair.imm_slot, &rand_seed,
+                                                      merge_memtables_without_flushing);
+                }
+                NOVA_LOG(rdmaio::INFO)
+                    << fmt::format("Recovery memtable-{} with {} log records of {} bytes from server-{}",
+                                   memtable->memtableid(), log_records, longest->valid_size,
+                                   longest->server_id);
+                std::vector<char *> bufs;
+                for (const auto &replica : fetch->replicas) {
+                    bufs.push_back(replica.buf);
+                }
+                mem_manager_->FreeItems(0, bufs, scid);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    active_fetches -= 1;
+                }
+                cv.notify_one();
+            };
 
-        timeval rdma_read_complete;
-        gettimeofday(&rdma_read_complete, nullptr);
-        uint32_t recovered_log_records = 0;
-        int index = 0;
-        leveldb::DBImpl *dbimpl = reinterpret_cast<leveldb::DBImpl *>(nova::NovaConfig::config->cfgs[cfg_id]->fragments[dbid]->db);
-        uint32_t rand_seed = 0;
-        for (const auto &replica : memtables_to_recover) {
-            char *buf = rdma_bufs[index];
-            leveldb::Slice slice(buf, nova::NovaConfig::config->max_stoc_file_size);
-
-            leveldb::MemTable *memtable = replica.second.memtable;
-            leveldb::LevelDBLogRecord record = {};
-            uint32_t log_records = 0;
-            while (nova::DecodeLogRecord(&slice, &record)) {
-                memtable->Add(record.sequence_number, leveldb::ValueType::kTypeValue, record.key, record.value);
-                recovered_log_records += 1;
-                log_records += 1;
-            }
-            memtable->SetReadyToProcessRequests();
-            // Schedule for compaction.
-            if (replica.second.is_immutable) {
-                int thread_id = -1;
-                bool merge_memtables_without_flushing = false;
-                if (replica.second.subrange) {
-                    thread_id = replica.second.subrange->GetCompactionThreadId(
-                            &EnvBGThread::bg_flush_memtable_thread_id_seq,
-                            &merge_memtables_without_flushing);
-                } else {
-                    thread_id =
-                            EnvBGThread::bg_flush_memtable_thread_id_seq.fetch_add(
-                                    1, std::memory_order_relaxed) %
-                            dbimpl->bg_flush_memtable_threads_.size();
+            // Destroyed before replay so that it completes all replays
+            // first.
+            LogReplayPool replay_pool(num_threads);
+            uint32_t next_fetch = 0;
+            while (true) {
+                // Start fetching more log files once their replay frees
+                // up buffers.
+                uint32_t num_new_fetches = 0;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (inflight_reads.empty() && next_fetch < fetches.size()) {
+                        cv.wait(lock, [&] { return active_fetches < window; });
+                    }
+                    if (active_fetches < window) {
+                        num_new_fetches = std::min(window - active_fetches,
+                                                   (uint32_t) fetches.size() - next_fetch);
+                    }
+                    active_fetches += num_new_fetches;
+                }
+                for (int i = 0; i < num_new_fetches; i++) {
+                    MemTableFetch *fetch = &fetches[next_fetch];
+                    next_fetch++;
+                    for (auto &replica : fetch->replicas) {
+                        replica.buf = mem_manager_->ItemAlloc(0, scid);
+                        NOVA_ASSERT(replica.buf);
+                        read(fetch, &replica);
+                    }
+                }
+                if (inflight_reads.empty()) {
+                    NOVA_ASSERT(next_fetch == fetches.size());
+                    break;
+                }
+
+                // Each completed read signals the client once. Handle one
+                // completed read per signal.
+                client_->Wait();
+                for (auto it = inflight_reads.begin(); it != inflight_reads.end(); it++) {
+                    leveldb::StoCResponse response;
+                    if (!client_->IsDone(it->first, &response, nullptr)) {
+                        continue;
+                    }
+                    MemTableFetch *fetch = it->second.first;
+                    ReplicaFetch *replica = it->second.second;
+                    inflight_reads.erase(it);
+                    fetch->pending_reads -= 1;
+                    if (HasMoreLogRecords(replica->buf, replica->fetched_size, max_size,
+                                          &replica->valid_size)) {
+                        read(fetch, replica);
+                    }
+                    if (fetch->pending_reads == 0) {
+                        replay_pool.Schedule([&replay, fetch]() {
+                            replay(fetch);
+                        });
+                    }
+                    break;
                 }
-                dbimpl->ScheduleFlushMemTableTask(thread_id, memtable->memtableid(), memtable, replica.second.partition_id,
-                                                  replica.second.imm_slot, &rand_seed,
-                                                  merge_memtables_without_flushing);
             }
-            index++;
-            NOVA_LOG(rdmaio::INFO)
-                << fmt::format("Recovery memtable-{} with {} log records", memtable->memtableid(), log_records);
-            uint32_t scid = mem_manager_->slabclassid(0, nova::NovaConfig::config->max_stoc_file_size);
-            mem_manager_->FreeItem(0, buf, scid);
+            gettimeofday(&fetch_complete, nullptr);
         }
 
         timeval end{};
         gettimeofday(&end, nullptr);
         NOVA_LOG(rdmaio::INFO)
-            << fmt::format("memtable recovery duration: {},{},{},{}",
+            << fmt::format("memtable recovery duration: {},{},{},{},{}",
                            memtables_to_recover.size(),
-                           recovered_log_records,
-                           time_diff(start, rdma_read_complete),
-                           time_diff(start, end));
+                           recovered_log_records.load(),
+                           time_diff(start, fetch_complete),
+                           time_diff(start, end),
+                           fetched_bytes);
     }
-}
\ No newline at end of file
+}
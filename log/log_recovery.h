@@ -7,20 +7,65 @@
 #ifndef LEVELDB_LOG_RECOVERY_H
 #define LEVELDB_LOG_RECOVERY_H
 
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "db/memtable.h"
 #include "ltc/stoc_client_impl.h"
 
 namespace leveldb {
     class StoCBlockClient;
 
+    // Replays log records into memtables on a pool of threads.
+    class LogReplayPool {
+    public:
+        explicit LogReplayPool(uint32_t num_threads);
+
+        // Wait for all scheduled tasks to complete.
+        ~LogReplayPool();
+
+        void Schedule(std::function<void(void)> task);
+
+    private:
+        void Run();
+
+        std::vector<std::thread> threads_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::list<std::function<void(void)>> queue_;
+        bool stop_ = false;
+    };
+
     class LogRecovery {
     public:
         LogRecovery(leveldb::MemManager *mem_manager,
                     leveldb::StoCBlockClient *client);
 
+        // Fetch the log files of memtables_to_recover with RDMA READs of
+        // log_recovery_read_size and replay each of them once it is
+        // fetched. Fetching a log file stops at the end of its log
+        // records. Replay runs on number_of_recovery_threads threads and
+        // overlaps with fetching the remaining log files. Log records with
+        // a sequence number of at least max_sequence are skipped.
         void
         Recover(const std::unordered_map<uint32_t, leveldb::MemTableLogFilePair> &memtables_to_recover, uint32_t cfg_id,
-                uint32_t dbid);
+                uint32_t dbid, uint64_t max_sequence = UINT64_MAX);
+
+        // Add the log records in buf whose sequence numbers are less than
+        // max_sequence to memtable. Return the number of added log
+        // records.
+        static uint32_t Replay(const char *buf, uint64_t size, MemTable *memtable,
+                               uint64_t max_sequence = UINT64_MAX);
+
+        // Extend *valid_size over the log records in [buf+*valid_size,
+        // buf+fetched_size). Return true if the log file may have more log
+        // records after fetched_size.
+        static bool HasMoreLogRecords(const char *buf, uint64_t fetched_size, uint64_t max_size,
+                                      uint64_t *valid_size);
 
     private:
         leveldb::MemManager *mem_manager_;
@@ -4,12 +4,23 @@
 // Copyright (c) 2019 University of Southern California. All rights reserved.
 //
 
+#include <algorithm>
+
 #include "common/nova_config.h"
 #include "logc_log_writer.h"
+#include "leveldb/env.h"
 
 
 namespace leveldb {
-
+    namespace {
+        uint32_t WriteQuorum(uint32_t num_replicas) {
+            uint32_t quorum = nova::NovaConfig::config->log_write_quorum;
+            if (quorum == 0 || quorum > num_replicas) {
+                return num_replicas;
+            }
+            return quorum;
+        }
+    }
 
     // Create a writer that will append data to "*dest".
 // "*dest" must be initially empty.
@@ -52,6 +63,10 @@ namespace leveldb {
                                        uint32_t client_req_id,
                                        StoCReplicateLogRecordState *replicate_log_record_states) {
         log_manager_->AddRemoteBuf(log_file_name, stoc_server_id, offset);
+        auto quorum_write = quorum_log_writes_.find(client_req_id);
+        if (quorum_write != quorum_log_writes_.end()) {
+            backing_mem = quorum_write->second->buf;
+        }
         replicate_log_record_states[stoc_server_id].result = StoCReplicateLogRecordResult::ALLOC_SUCCESS;
         auto meta = &logfile_last_buf_[log_file_name];
         meta->stoc_bufs[stoc_server_id].base = offset;
@@ -83,6 +98,91 @@ namespace leveldb {
         return false;
     }
 
+    void LogCLogWriter::AddPreallocatedLogBufs(int stoc_server_id,
+                                               const std::vector<uint64_t> &bufs,
+                                               uint64_t size) {
+        PreallocatedLogBufs &pool = preallocated_log_bufs_[stoc_server_id];
+        pool.bufs.insert(pool.bufs.end(), bufs.begin(), bufs.end());
+        pool.size = size;
+        pool.is_refilling = false;
+    }
+
+    bool LogCLogWriter::UsePreallocatedLogBuf(const std::string &log_file_name,
+                                              uint32_t stoc_server_id,
+                                              LogFileBuf *buf) {
+        auto pool = preallocated_log_bufs_.find(stoc_server_id);
+        if (pool == preallocated_log_bufs_.end() || pool->second.bufs.empty()) {
+            return false;
+        }
+        buf->base = pool->second.bufs.front();
+        buf->size = pool->second.size;
+        buf->offset = 0;
+        buf->is_initializing = false;
+        pool->second.bufs.pop_front();
+        log_manager_->AddRemoteBuf(log_file_name, stoc_server_id, buf->base);
+
+        // Tell the StoC the log file of the buf so that it can find the buf
+        // during recovery and free it once the memtable is flushed. It
+        // requires no response.
+        char *send_buf = rdma_broker_->GetSendBuf(stoc_server_id);
+        uint32_t msg_size = 1;
+        send_buf[0] = StoCRequestType::STOC_BIND_LOG_BUFFER;
+        msg_size += leveldb::EncodeFixed64(send_buf + msg_size, buf->base);
+        msg_size += leveldb::EncodeStr(send_buf + msg_size, log_file_name);
+        rdma_broker_->PostSend(send_buf, msg_size, stoc_server_id, 0);
+        return true;
+    }
+
+    void LogCLogWriter::RefillLogBufs(uint32_t stoc_server_id) {
+        uint32_t pool_size = nova::NovaConfig::config->log_buf_pool_size;
+        if (pool_size == 0) {
+            return;
+        }
+        PreallocatedLogBufs &pool = preallocated_log_bufs_[stoc_server_id];
+        if (pool.is_refilling || pool.bufs.size() * 2 > pool_size) {
+            return;
+        }
+        pool.is_refilling = true;
+        char *send_buf = rdma_broker_->GetSendBuf(stoc_server_id);
+        send_buf[0] = StoCRequestType::STOC_ALLOCATE_LOG_BUFFERS;
+        leveldb::EncodeFixed32(send_buf + 1, pool_size - pool.bufs.size());
+        rdma_broker_->PostSend(send_buf, 1 + 4, stoc_server_id, 0);
+    }
+
+    void LogCLogWriter::FillLogBufPools() {
+        auto cfg = nova::NovaConfig::config->cfgs[nova::NovaConfig::config->current_cfg_id];
+        if (!cfg->IsLTC()) {
+            return;
+        }
+        for (auto stoc_server_id : cfg->stoc_servers) {
+            if (stoc_server_id == nova::NovaConfig::config->my_server_id) {
+                continue;
+            }
+            RefillLogBufs(stoc_server_id);
+        }
+    }
+
+    void LogCLogWriter::Close() {
+        // A message carries at most this many bufs.
+        uint32_t max_bufs = (nova::NovaConfig::config->max_msg_size - 1 - 4 - 1) / 8;
+        for (auto &pool : preallocated_log_bufs_) {
+            while (!pool.second.bufs.empty()) {
+                char *send_buf = rdma_broker_->GetSendBuf(pool.first);
+                uint32_t nbufs = std::min((uint32_t) pool.second.bufs.size(), max_bufs);
+                uint32_t msg_size = 1;
+                send_buf[0] = StoCRequestType::STOC_FREE_LOG_BUFFERS;
+                msg_size += leveldb::EncodeFixed32(send_buf + msg_size, nbufs);
+                for (int i = 0; i < nbufs; i++) {
+                    msg_size += leveldb::EncodeFixed64(send_buf + msg_size,
+                                                       pool.second.bufs.front());
+                    pool.second.bufs.pop_front();
+                }
+                rdma_broker_->PostSend(send_buf, msg_size, pool.first, 0);
+            }
+        }
+        preallocated_log_bufs_.clear();
+    }
+
     bool
     LogCLogWriter::AddRecord(const std::string &log_file_name,
                              uint64_t thread_id,
@@ -108,10 +208,22 @@ namespace leveldb {
             }
         }
         uint32_t log_record_size = nova::LogRecordsSize(log_records);
+        if (WriteQuorum(frag->log_replica_stoc_ids.size()) <
+            frag->log_replica_stoc_ids.size()) {
+            auto write = new QuorumLogWrite;
+            write->scid = mem_manager_->slabclassid(0, log_record_size);
+            write->buf = mem_manager_->ItemAlloc(0, write->scid);
+            NOVA_ASSERT(write->buf) << "Running out of memory";
+            memcpy(write->buf, rdma_backing_buf, log_record_size);
+            quorum_log_writes_[client_req_id] = write;
+            rdma_backing_buf = write->buf;
+        }
         for (int i = 0; i < frag->log_replica_stoc_ids.size(); i++) {
             uint32_t stoc_server_id = cfg->stoc_servers[frag->log_replica_stoc_ids[i]];
             auto &it = logfile_last_buf_[log_file_name];
-            if (it.stoc_bufs[stoc_server_id].base == 0) {
+            if (it.stoc_bufs[stoc_server_id].base == 0 &&
+                !UsePreallocatedLogBuf(log_file_name, stoc_server_id,
+                                       &it.stoc_bufs[stoc_server_id])) {
                 it.stoc_bufs[stoc_server_id].is_initializing = true;
                 // Allocate a new buf.
                 char *send_buf = rdma_broker_->GetSendBuf(stoc_server_id);
@@ -142,18 +254,21 @@ namespace leveldb {
                 it.stoc_bufs[stoc_server_id].offset += log_record_size;
                 replicate_log_record_states[stoc_server_id].result = StoCReplicateLogRecordResult::WAIT_FOR_WRITE;
             }
+            RefillLogBufs(stoc_server_id);
         }
         return true;
     }
 
     bool LogCLogWriter::CheckCompletion(const std::string &log_file_name,
                                         uint32_t dbid,
+                                        uint32_t client_req_id,
                                         StoCReplicateLogRecordState *replicate_log_record_states) {
         uint32_t cfg_id = replicate_log_record_states[0].cfgid;
         auto cfg = nova::NovaConfig::config->cfgs[cfg_id];
         nova::LTCFragment *frag = cfg->fragments[dbid];
         // Pull all pending writes.
         int acks = 0;
+        int allocating = 0;
         int total_states = 0;
         for (int i = 0; i < frag->log_replica_stoc_ids.size(); i++) {
             uint32_t stoc_server_id = cfg->stoc_servers[frag->log_replica_stoc_ids[i]];
@@ -162,12 +277,14 @@ namespace leveldb {
                     break;
                 case StoCReplicateLogRecordResult::WAIT_FOR_ALLOC:
                     total_states += 1;
+                    allocating++;
                     break;
                 case StoCReplicateLogRecordResult::WAIT_FOR_WRITE:
                     total_states += 1;
                     break;
                 case StoCReplicateLogRecordResult::ALLOC_SUCCESS:
                     total_states += 1;
+                    allocating++;
                     break;
                 case StoCReplicateLogRecordResult::WRITE_SUCCESS:
                     total_states += 1;
@@ -176,7 +293,62 @@ namespace leveldb {
             }
         }
         NOVA_ASSERT(total_states == frag->log_replica_stoc_ids.size());
-        return acks == frag->log_replica_stoc_ids.size();
+        auto quorum_write = quorum_log_writes_.find(client_req_id);
+        if (acks == frag->log_replica_stoc_ids.size()) {
+            if (quorum_write != quorum_log_writes_.end()) {
+                mem_manager_->FreeItem(0, quorum_write->second->buf,
+                                       quorum_write->second->scid);
+                delete quorum_write->second;
+                quorum_log_writes_.erase(quorum_write);
+            }
+            return true;
+        }
+        // A replica waiting for its log buf still needs the request context.
+        if (acks < WriteQuorum(frag->log_replica_stoc_ids.size()) ||
+            allocating > 0) {
+            return false;
+        }
+        NOVA_ASSERT(quorum_write != quorum_log_writes_.end());
+        QuorumLogWrite *write = quorum_write->second;
+        quorum_log_writes_.erase(quorum_write);
+        write->quorum_time = Env::Default()->NowMicros();
+        write->pending_replicas = frag->log_replica_stoc_ids.size() - acks;
+        for (int i = 0; i < frag->log_replica_stoc_ids.size(); i++) {
+            uint32_t stoc_server_id = cfg->stoc_servers[frag->log_replica_stoc_ids[i]];
+            const auto &state = replicate_log_record_states[stoc_server_id];
+            if (state.result == StoCReplicateLogRecordResult::WAIT_FOR_WRITE) {
+                StragglerWrite straggler = {};
+                straggler.rdma_wr_id = state.rdma_wr_id;
+                straggler.write = write;
+                straggler_writes_[stoc_server_id].push_back(straggler);
+            }
+        }
+        nova::NovaGlobalVariables::global.log_quorum_writes += 1;
+        return true;
+    }
+
+    bool LogCLogWriter::AckStragglerWrite(int remote_sid, uint64_t rdma_wr_id) {
+        auto it = straggler_writes_.find(remote_sid);
+        // RDMA WRITEs to a StoC complete in the order they were posted.
+        if (it == straggler_writes_.end() || it->second.empty() ||
+            it->second.front().rdma_wr_id != rdma_wr_id) {
+            return false;
+        }
+        QuorumLogWrite *write = it->second.front().write;
+        it->second.pop_front();
+        uint64_t lag = Env::Default()->NowMicros() - write->quorum_time;
+        if (remote_sid < MAX_NUM_SERVERS) {
+            nova::NovaGlobalVariables::global.log_replica_lagged_writes[remote_sid] += 1;
+            nova::NovaGlobalVariables::global.log_replica_lag_us[remote_sid] += lag;
+        }
+        write->pending_replicas--;
+        if (write->pending_replicas == 0) {
+            // The write would have waited for the slowest replica.
+            nova::NovaGlobalVariables::global.log_quorum_saved_us += lag;
+            mem_manager_->FreeItem(0, write->buf, write->scid);
+            delete write;
+        }
+        return true;
     }
 
     Status
@@ -7,6 +7,8 @@
 #ifndef LEVELDB_LOGC_LOG_WRITER_H
 #define LEVELDB_LOGC_LOG_WRITER_H
 
+#include <list>
+
 #include "common/nova_mem_manager.h"
 #include "leveldb/status.h"
 #include "leveldb/slice.h"
@@ -47,9 +49,28 @@ namespace leveldb {
         CloseLogFiles(const std::vector<std::string> &log_file_name, uint32_t dbid,
                      uint32_t client_req_id);
 
+        // Return true once a write quorum of the replicas acknowledged the
+        // log record. The remaining replicas complete asynchronously.
         bool CheckCompletion(const std::string &log_file_name, uint32_t dbid,
+                             uint32_t client_req_id,
                              StoCReplicateLogRecordState *replicate_log_record_states);
 
+        // Return true if the completed RDMA WRITE belongs to a log record
+        // that was already acknowledged by a write quorum.
+        bool AckStragglerWrite(int remote_sid, uint64_t rdma_wr_id);
+
+        // stoc_server_id allocated bufs for new log files.
+        void AddPreallocatedLogBufs(int stoc_server_id,
+                                    const std::vector<uint64_t> &bufs,
+                                    uint64_t size);
+
+        // Fill the preallocated log buf pool of every StoC. Called once
+        // the RDMA connections are up.
+        void FillLogBufPools();
+
+        // Return the unused preallocated bufs to their StoCs.
+        void Close();
+
         nova::RDMAAdmissionCtrl *admission_control_ = nullptr;
     private:
         std::string write_result_str(StoCReplicateLogRecordResult wr) {
@@ -78,6 +99,40 @@ namespace leveldb {
             LogFileBuf *stoc_bufs = nullptr;
         };
 
+        // A log record written with a write quorum smaller than the number
+        // of replicas. The caller may reuse its buffer once the quorum
+        // acknowledges the record. So it is written from a private copy
+        // that is freed once all replicas acknowledge it.
+        struct QuorumLogWrite {
+            char *buf = nullptr;
+            uint32_t scid = 0;
+            uint32_t pending_replicas = 0;
+            uint64_t quorum_time = 0;
+        };
+
+        struct StragglerWrite {
+            uint64_t rdma_wr_id = 0;
+            QuorumLogWrite *write = nullptr;
+        };
+
+        // Log bufs a StoC allocated in advance. A new log file takes one
+        // without waiting for STOC_ALLOCATE_LOG_BUFFER.
+        struct PreallocatedLogBufs {
+            std::list<uint64_t> bufs;
+            uint64_t size = 0;
+            bool is_refilling = false;
+        };
+
+        // Assign a preallocated buf of stoc_server_id to the log file.
+        // Return false if there is none.
+        bool UsePreallocatedLogBuf(const std::string &log_file_name,
+                                   uint32_t stoc_server_id,
+                                   LogFileBuf *buf);
+
+        // Ask stoc_server_id for more bufs if it has fewer than half of
+        // log_buf_pool_size bufs left.
+        void RefillLogBufs(uint32_t stoc_server_id);
+
         void Init(const std::string &log_file_name,
                   uint64_t thread_id,
                   const std::vector<LevelDBLogRecord> &log_records,
@@ -85,6 +140,12 @@ namespace leveldb {
 
         nova::NovaRDMABroker *rdma_broker_ = nullptr;
         std::unordered_map<std::string, LogFileMetadata> logfile_last_buf_;
+        std::unordered_map<uint32_t, PreallocatedLogBufs> preallocated_log_bufs_;
+        // Key is the client request id.
+        std::unordered_map<uint32_t, QuorumLogWrite *> quorum_log_writes_;
+        // Writes that have not completed at each StoC in the order they were
+        // posted.
+        std::unordered_map<uint32_t, std::list<StragglerWrite>> straggler_writes_;
         MemManager *mem_manager_ = nullptr;
         nova::StoCInMemoryLogFileManager *log_manager_ = nullptr;
     };
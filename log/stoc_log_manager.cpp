@@ -55,7 +55,7 @@ namespace nova {
 
     StoCInMemoryLogFileManager::StoCInMemoryLogFileManager(
             nova::NovaMemManager *mem_manager) : mem_manager_(mem_manager) {
-        uint32_t nranges = NovaConfig::config->cfgs[0]->fragments.size();
+        uint32_t nranges = NovaConfig::config->max_num_ranges;
         db_log_files_ = new DBLogFiles *[nranges];
         NOVA_LOG(rdmaio::DEBUG)
             << fmt::format("{} {}", NovaConfig::config->servers.size(),
@@ -80,6 +80,15 @@ namespace nova {
         db->mutex_.Unlock();
     }
 
+    void StoCInMemoryLogFileManager::QueryLogFiles(uint32_t range_id, std::vector<std::string> *log_files) {
+        DBLogFiles *db = db_log_files_[range_id];
+        db->mutex_.Lock();
+        for (const auto &it : db->logfiles_) {
+            log_files->push_back(it.first);
+        }
+        db->mutex_.Unlock();
+    }
+
     void
     StoCInMemoryLogFileManager::AddLocalBuf(const std::string &log_file,
                                             char *local_buf) {
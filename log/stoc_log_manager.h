@@ -29,6 +29,9 @@ namespace nova {
         void QueryLogFiles(uint32_t range_id,
                            std::unordered_map<std::string, uint64_t> *logfile_offset);
 
+        // The names of all log files of a range.
+        void QueryLogFiles(uint32_t range_id, std::vector<std::string> *log_files);
+
         uint32_t EncodeLogFiles(char *buf, uint32_t dbid);
 
         bool
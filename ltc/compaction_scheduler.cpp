@@ -0,0 +1,136 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "compaction_scheduler.h"
+
+#include <algorithm>
+
+#include "common/nova_console_logging.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+
+namespace leveldb {
+    LTCCompactionScheduler::LTCCompactionScheduler(double urgent_stall_risk)
+            : urgent_stall_risk_(urgent_stall_risk) {
+        for (int i = 0; i < kNumBackgroundPools; i++) {
+            sem_init(&signals_[i], 0, 0);
+        }
+    }
+
+    LTCCompactionScheduler::DBQueue *
+    LTCCompactionScheduler::GetOrCreateQueue(void *db) {
+        auto it = db_queue_.find(db);
+        if (it != db_queue_.end()) {
+            return it->second;
+        }
+        DBQueue *queue = new DBQueue;
+        queue->db = db;
+        db_queue_[db] = queue;
+        queues_.push_back(queue);
+        return queue;
+    }
+
+    void LTCCompactionScheduler::RegisterDB(void *db, uint32_t weight) {
+        NOVA_ASSERT(weight > 0);
+        mutex_.Lock();
+        GetOrCreateQueue(db)->weight = weight;
+        mutex_.Unlock();
+    }
+
+    void LTCCompactionScheduler::Submit(LTCBackgroundPool pool,
+                                        const EnvBGTask &task) {
+        PendingTask pending = {};
+        pending.task = task;
+        pending.enqueue_time = Env::Default()->NowMicros();
+
+        mutex_.Lock();
+        DBQueue *queue = GetOrCreateQueue(task.db);
+        if (queue->tasks[pool].empty()) {
+            // A DB that was idle does not accumulate credits. It starts from
+            // the smallest virtual time of all backlogged DBs.
+            bool backlogged = false;
+            double min_vtime = 0;
+            for (auto q : queues_) {
+                if (q->tasks[pool].empty()) {
+                    continue;
+                }
+                if (!backlogged || q->vtime[pool] < min_vtime) {
+                    min_vtime = q->vtime[pool];
+                }
+                backlogged = true;
+            }
+            if (backlogged && queue->vtime[pool] < min_vtime) {
+                queue->vtime[pool] = min_vtime;
+            }
+        }
+        queue->tasks[pool].push_back(pending);
+        stats_[pool].queued_tasks += 1;
+        mutex_.Unlock();
+        sem_post(&signals_[pool]);
+    }
+
+    void LTCCompactionScheduler::Take(LTCBackgroundPool pool,
+                                      std::vector<EnvBGTask> *tasks) {
+        while (tasks->empty()) {
+            sem_wait(&signals_[pool]);
+
+            mutex_.Lock();
+            DBQueue *urgent = nullptr;
+            double urgent_risk = 0;
+            DBQueue *fair = nullptr;
+            for (auto queue : queues_) {
+                if (queue->tasks[pool].empty()) {
+                    continue;
+                }
+                double risk = reinterpret_cast<DB *>(queue->db)->StallRisk();
+                if (risk >= urgent_stall_risk_ &&
+                    (!urgent || risk > urgent_risk)) {
+                    urgent = queue;
+                    urgent_risk = risk;
+                }
+                if (!fair || queue->vtime[pool] < fair->vtime[pool]) {
+                    fair = queue;
+                }
+            }
+            DBQueue *selected = urgent ? urgent : fair;
+            if (!selected) {
+                mutex_.Unlock();
+                continue;
+            }
+
+            uint64_t now = Env::Default()->NowMicros();
+            LTCBackgroundPoolStats &stats = stats_[pool];
+            const PendingTask &pending = selected->tasks[pool].front();
+            uint64_t wait = 0;
+            if (now > pending.enqueue_time) {
+                wait = now - pending.enqueue_time;
+            }
+            stats.total_wait_us += wait;
+            stats.max_wait_us = std::max(stats.max_wait_us, wait);
+            tasks->push_back(pending.task);
+            stats.queued_tasks -= 1;
+            stats.dispatched_tasks += 1;
+            if (urgent) {
+                stats.urgent_dispatches += 1;
+            }
+            selected->vtime[pool] += 1.0 / (double) selected->weight;
+            selected->tasks[pool].pop_front();
+            mutex_.Unlock();
+        }
+    }
+
+    void LTCCompactionScheduler::QueryStats(LTCBackgroundPool pool,
+                                            LTCBackgroundPoolStats *stats,
+                                            std::vector<uint32_t> *queue_lengths) {
+        mutex_.Lock();
+        *stats = stats_[pool];
+        stats_[pool].max_wait_us = 0;
+        for (auto queue : queues_) {
+            queue_lengths->push_back(queue->tasks[pool].size());
+        }
+        mutex_.Unlock();
+    }
+}
@@ -0,0 +1,87 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#ifndef LEVELDB_COMPACTION_SCHEDULER_H
+#define LEVELDB_COMPACTION_SCHEDULER_H
+
+#include <deque>
+#include <semaphore.h>
+#include <unordered_map>
+#include <vector>
+
+#include "leveldb/env_bg_thread.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+
+namespace leveldb {
+
+    enum LTCBackgroundPool {
+        kFlushMemTablePool = 0,
+        kCompactionPool = 1,
+        kNumBackgroundPools = 2
+    };
+
+    struct LTCBackgroundPoolStats {
+        uint64_t queued_tasks = 0;
+        uint64_t dispatched_tasks = 0;
+        uint64_t urgent_dispatches = 0;
+        uint64_t total_wait_us = 0;
+        uint64_t max_wait_us = 0;
+    };
+
+    // A process-wide scheduler for flushes and compactions of all fragments
+    // hosted by this LTC. Each DB enqueues its tasks into a per-DB queue
+    // instead of picking a background thread in a round-robin manner.
+    // An idle background thread picks the DB with the highest stall risk
+    // when that risk exceeds the urgent threshold. Otherwise, it picks the DB
+    // with the smallest weighted virtual time so that a hot fragment cannot
+    // monopolize the background threads. The stall risk is computed when a
+    // thread takes a task since it changes while the task waits.
+    class LTCCompactionScheduler {
+    public:
+        explicit LTCCompactionScheduler(double urgent_stall_risk);
+
+        // Set the fairness weight of a DB. A DB with weight w receives w
+        // times the share of a DB with weight 1 when neither is urgent.
+        void RegisterDB(void *db, uint32_t weight);
+
+        void Submit(LTCBackgroundPool pool, const EnvBGTask &task);
+
+        // Block until there are tasks in the pool. Return the oldest pending
+        // task of the selected DB so that the remaining tasks are dispatched
+        // to other idle threads.
+        void Take(LTCBackgroundPool pool, std::vector<EnvBGTask> *tasks);
+
+        // max_wait_us is reset after each query.
+        void QueryStats(LTCBackgroundPool pool, LTCBackgroundPoolStats *stats,
+                        std::vector<uint32_t> *queue_lengths);
+
+    private:
+        struct PendingTask {
+            EnvBGTask task;
+            uint64_t enqueue_time = 0;
+        };
+
+        struct DBQueue {
+            void *db = nullptr;
+            uint32_t weight = 1;
+            double vtime[kNumBackgroundPools] = {};
+            std::deque<PendingTask> tasks[kNumBackgroundPools];
+        };
+
+        DBQueue *GetOrCreateQueue(void *db)
+        EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+        const double urgent_stall_risk_;
+        port::Mutex mutex_;
+        sem_t signals_[kNumBackgroundPools];
+        std::vector<DBQueue *> queues_ GUARDED_BY(mutex_);
+        std::unordered_map<void *, DBQueue *> db_queue_ GUARDED_BY(mutex_);
+        LTCBackgroundPoolStats stats_[kNumBackgroundPools] GUARDED_BY(mutex_);
+    };
+}
+
+#endif //LEVELDB_COMPACTION_SCHEDULER_H
@@ -17,6 +17,10 @@ namespace leveldb {
     }
 
     bool LTCCompactionThread::Schedule(const EnvBGTask &task) {
+        if (scheduler_) {
+            scheduler_->Submit(pool_, task);
+            return true;
+        }
         background_work_mutex_.Lock();
         background_work_queue_.push_back(task);
         background_work_mutex_.Unlock();
@@ -53,18 +57,23 @@ namespace leveldb {
         NOVA_LOG(rdmaio::DEBUG)
             << fmt::format("{} Compaction worker started.", thread_id_);
         while (is_running_) {
-            sem_wait(&signal);
+            std::vector<EnvBGTask> tasks;
+            if (scheduler_) {
+                scheduler_->Take(pool_, &tasks);
+            } else {
+                sem_wait(&signal);
+
+                background_work_mutex_.Lock();
+                if (background_work_queue_.empty()) {
+                    background_work_mutex_.Unlock();
+                    continue;
+                }
 
-            background_work_mutex_.Lock();
-            if (background_work_queue_.empty()) {
+                tasks = background_work_queue_;
+                background_work_queue_.clear();
                 background_work_mutex_.Unlock();
-                continue;
             }
 
-            std::vector<EnvBGTask> tasks(background_work_queue_);
-            background_work_queue_.clear();
-            background_work_mutex_.Unlock();
-
             num_tasks_ += tasks.size();
 
             bool reorg = false;
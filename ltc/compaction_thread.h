@@ -12,6 +12,7 @@
 #include "port/port.h"
 #include "stoc_client_impl.h"
 #include "leveldb/env_bg_thread.h"
+#include "compaction_scheduler.h"
 
 namespace leveldb {
 
@@ -106,6 +107,11 @@ namespace leveldb {
         StoCBlockClient *stoc_client_ = nullptr;
 
         void *db_ = nullptr;
+
+        // When set, tasks are dispatched by the process-wide scheduler
+        // instead of the local queue.
+        LTCCompactionScheduler *scheduler_ = nullptr;
+        LTCBackgroundPool pool_ = LTCBackgroundPool::kFlushMemTablePool;
     private:
         port::Mutex background_work_mutex_;
         sem_t signal;
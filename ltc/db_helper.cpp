@@ -6,6 +6,7 @@
 
 #include "db_helper.h"
 
+#include <cmath>
 #include <fmt/core.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -29,6 +30,39 @@
 
 
 namespace leveldb {
+    namespace {
+        const leveldb::FilterPolicy *NewFilterPolicy(double bits_per_key) {
+            if (nova::NovaConfig::config->filter_type == "blocked_bloom") {
+                return leveldb::NewBlockedBloomFilterPolicy(std::lround(bits_per_key));
+            } else if (nova::NovaConfig::config->filter_type == "ribbon") {
+                return leveldb::NewRibbonFilterPolicy(bits_per_key);
+            }
+            return leveldb::NewBloomFilterPolicy(std::lround(bits_per_key));
+        }
+
+        // Use the same filter policies at LTCs and StoCs.
+        void SetFilterPolicies(leveldb::Options *options) {
+            options->filter_policy = NewFilterPolicy(nova::NovaConfig::config->bloom_bits_per_key);
+            options->whole_table_filter = nova::NovaConfig::config->enable_whole_table_filter ||
+                                          nova::NovaConfig::config->filter_type == "ribbon";
+            if (nova::NovaConfig::config->enable_monkey_bloom_filter) {
+                std::vector<double> level_bits_per_key;
+                leveldb::MonkeyBitsPerKey(options->level, nova::NovaConfig::config->bloom_bits_per_key,
+                                          leveldb::config::kLevelSizeMultiplier, &level_bits_per_key);
+                for (double bits_per_key : level_bits_per_key) {
+                    options->level_filter_policies.push_back(NewFilterPolicy(bits_per_key));
+                }
+            }
+        }
+    }
+
+    const leveldb::Comparator *NewKeyComparator() {
+        if (nova::NovaConfig::config->key_type == nova::KeyType::KEY_TYPE_BYTES) {
+            return leveldb::BytewiseComparator();
+        }
+        return new YCSBKeyComparator();
+    }
+
     leveldb::Options
     BuildDBOptions(int cfg_id, int db_index, leveldb::Cache *cache,
                    leveldb::MemTablePool *memtable_pool,
@@ -60,6 +94,13 @@ namespace leveldb {
         options.num_memtables = nova::NovaConfig::config->num_memtables;
         options.l0bytes_start_compaction_trigger = nova::NovaConfig::config->l0_start_compaction_mb * 1024 * 1024;
         options.l0bytes_stop_writes_trigger = nova::NovaConfig::config->l0_stop_write_mb * 1024 * 1024;
+        options.l0bytes_slowdown_writes_trigger = nova::NovaConfig::config->l0_slowdown_write_mb * 1024 * 1024;
+        options.pending_compaction_bytes_slowdown_trigger =
+                nova::NovaConfig::config->pending_compaction_slowdown_write_mb * 1024 * 1024;
+        options.pending_compaction_bytes_stop_trigger =
+                nova::NovaConfig::config->pending_compaction_stop_write_mb * 1024 * 1024;
+        options.imm_slowdown_writes_trigger = nova::NovaConfig::config->num_imms_slowdown_write;
+        options.delayed_write_rate = nova::NovaConfig::config->delayed_write_rate_mb * 1024 * 1024;
         options.max_open_files = 100000;
         options.enable_lookup_index = nova::NovaConfig::config->enable_lookup_index;
         options.enable_range_index = nova::NovaConfig::config->enable_range_index;
@@ -70,11 +111,10 @@ namespace leveldb {
         options.env = env;
         options.create_if_missing = true;
         options.compression = leveldb::kNoCompression;
-        options.filter_policy = leveldb::NewBloomFilterPolicy(10);
         options.bg_compaction_threads = bg_compaction_threads;
         options.bg_flush_memtable_threads = bg_flush_memtable_threads;
         options.enable_tracing = false;
-        options.comparator = new YCSBKeyComparator();
+        options.comparator = NewKeyComparator();
         if (nova::NovaConfig::config->memtable_type == "pool") {
             options.memtable_type = leveldb::MemTableType::kMemTablePool;
         } else {
@@ -82,6 +122,7 @@ namespace leveldb {
         }
         options.enable_subranges = nova::NovaConfig::config->enable_subrange;
         options.subrange_reorg_sampling_ratio = 1.0;
+        options.subrange_reorg_sketch_size = nova::NovaConfig::config->subrange_sketch_size;
         options.reorg_thread = reorg_thread;
         options.compaction_coordinator_thread = compaction_coord_thread;
         options.enable_flush_multiple_memtables = nova::NovaConfig::config->enable_flush_multiple_memtables;
@@ -89,6 +130,8 @@ namespace leveldb {
         options.max_num_coordinated_compaction_nonoverlapping_sets = nova::NovaConfig::config->major_compaction_max_parallism;
         options.enable_subrange_reorg = nova::NovaConfig::config->enable_subrange_reorg;
         options.level = nova::NovaConfig::config->level;
+        options.enable_dynamic_level_bytes = nova::NovaConfig::config->enable_dynamic_level_bytes;
+        SetFilterPolicies(&options);
         if (nova::NovaConfig::config->major_compaction_type == "no") {
             options.major_compaction_type = leveldb::MajorCompactionType::kMajorDisabled;
         } else if (nova::NovaConfig::config->major_compaction_type == "st") {
@@ -100,9 +143,20 @@ namespace leveldb {
         } else {
             options.major_compaction_type = leveldb::MajorCompactionType::kMajorDisabled;
         }
+        const auto &styles = nova::NovaConfig::config->compaction_styles;
+        if (!styles.empty() && styles[std::min((size_t) db_index, styles.size() - 1)] == "tiered") {
+            options.compaction_style = leveldb::CompactionStyle::kCompactionStyleTiered;
+        } else {
+            options.compaction_style = leveldb::CompactionStyle::kCompactionStyleLeveled;
+        }
+        options.tiered_max_sorted_runs = nova::NovaConfig::config->tiered_max_sorted_runs;
+        options.tiered_size_ratio = nova::NovaConfig::config->tiered_size_ratio;
+        options.tiered_min_merge_width = nova::NovaConfig::config->tiered_min_merge_width;
         options.subrange_no_flush_num_keys = nova::NovaConfig::config->subrange_num_keys_no_flush;
-        options.lower_key = nova::NovaConfig::config->cfgs[0]->fragments[db_index]->range.key_start;
-        options.upper_key = nova::NovaConfig::config->cfgs[0]->fragments[db_index]->range.key_end;
+        // A range created by a split or a merge does not exist in the first
+        // configuration.
+        options.lower_key = nova::NovaConfig::config->cfgs[cfg_id]->fragments[db_index]->range.key_start;
+        options.upper_key = nova::NovaConfig::config->cfgs[cfg_id]->fragments[db_index]->range.key_end;
         auto cfg = nova::NovaConfig::config->cfgs[0];
         if (nova::NovaConfig::config->use_local_disk) {
             options.manifest_stoc_ids.push_back(nova::NovaConfig::config->my_server_id);
@@ -141,10 +195,14 @@ namespace leveldb {
         options.env = env;
         options.create_if_missing = true;
         options.compression = leveldb::kNoCompression;
-        leveldb::InternalFilterPolicy *filter = new leveldb::InternalFilterPolicy(leveldb::NewBloomFilterPolicy(10));
-        options.filter_policy = filter;
+        // StoCs build the SSTables of offloaded compactions.
+        SetFilterPolicies(&options);
+        options.filter_policy = new leveldb::InternalFilterPolicy(options.filter_policy);
+        for (auto &policy : options.level_filter_policies) {
+            policy = new leveldb::InternalFilterPolicy(policy);
+        }
         options.enable_tracing = false;
-        options.comparator = new YCSBKeyComparator();
+        options.comparator = NewKeyComparator();
         if (nova::NovaConfig::config->memtable_type == "pool") {
             options.memtable_type = leveldb::MemTableType::kMemTablePool;
         } else {
@@ -152,6 +210,7 @@ namespace leveldb {
         }
         options.enable_subranges = nova::NovaConfig::config->enable_subrange;
         options.subrange_reorg_sampling_ratio = 1.0;
+        options.subrange_reorg_sketch_size = nova::NovaConfig::config->subrange_sketch_size;
         options.enable_flush_multiple_memtables = nova::NovaConfig::config->enable_flush_multiple_memtables;
         options.max_num_sstables_in_nonoverlapping_set = 15;
         return options;
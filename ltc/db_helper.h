@@ -42,6 +42,9 @@ namespace leveldb {
         void FindShortSuccessor(std::string *) const {}
     };
 
+    // Orders keys as nova::KeySpace.
+    const leveldb::Comparator *NewKeyComparator();
+
     leveldb::Options
     BuildDBOptions(int cfg_id, int db_index, leveldb::Cache *cache,
                    leveldb::MemTablePool *memtable_pool,
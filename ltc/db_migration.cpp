@@ -14,6 +14,28 @@
 #define MAX_RESTORE_REPLICATION_BATCH_SIZE 10
 
 namespace nova {
+    namespace {
+        uint64_t time_diff(timeval t1, timeval t2) {
+            return (t2.tv_sec - t1.tv_sec) * 1000000 + (t2.tv_usec - t1.tv_usec);
+        }
+
+        void SetLiveMigrationState(LTCFragment *frag, LiveMigrationState state) {
+            frag->is_ready_mutex_.Lock();
+            frag->live_migration_state_ = state;
+            frag->is_ready_signal_.SignalAll();
+            frag->is_ready_mutex_.Unlock();
+        }
+
+        // Stop new writes to the range and wait for the writes in progress
+        // to complete.
+        void PauseWrites(LTCFragment *frag, LiveMigrationState state) {
+            frag->live_migration_state_ = state;
+            while (frag->live_migration_writes_ > 0) {
+                usleep(10);
+            }
+        }
+    }
+
     DBMigration::DBMigration(leveldb::MemManager *mem_manager,
                              leveldb::StoCBlockClient *client,
                              nova::StoCInMemoryLogFileManager *log_manager,
@@ -56,6 +78,61 @@ namespace nova {
         sem_post(&sem_);
     }
 
+    void DBMigration::AddSourceHandoff(char *buf, uint32_t msg_size) {
+        mu.lock();
+        DBMeta meta = {};
+        meta.migrate_type = MigrateType::SOURCE_HANDOFF;
+        meta.buf = buf;
+        meta.msg_size = msg_size;
+        db_metas.push_back(meta);
+        mu.unlock();
+        sem_post(&sem_);
+    }
+
+    void DBMigration::AddDestMigrationTail(char *buf, uint32_t msg_size) {
+        mu.lock();
+        DBMeta meta = {};
+        meta.migrate_type = MigrateType::DESTINATION_TAIL;
+        meta.buf = buf;
+        meta.msg_size = msg_size;
+        db_metas.push_back(meta);
+        mu.unlock();
+        sem_post(&sem_);
+    }
+
+    void DBMigration::AddDestWarmCache(char *buf, uint32_t msg_size) {
+        mu.lock();
+        DBMeta meta = {};
+        meta.migrate_type = MigrateType::DESTINATION_WARM_CACHE;
+        meta.buf = buf;
+        meta.msg_size = msg_size;
+        db_metas.push_back(meta);
+        mu.unlock();
+        sem_post(&sem_);
+    }
+
+    void DBMigration::AddSplit(nova::LTCFragment *parent, nova::LTCFragment *child) {
+        mu.lock();
+        DBMeta meta = {};
+        meta.migrate_type = MigrateType::SPLIT;
+        meta.source_fragment = parent;
+        meta.target_fragment = child;
+        db_metas.push_back(meta);
+        mu.unlock();
+        sem_post(&sem_);
+    }
+
+    void DBMigration::AddMerge(const std::vector<nova::LTCFragment *> &sources, nova::LTCFragment *target) {
+        mu.lock();
+        DBMeta meta = {};
+        meta.migrate_type = MigrateType::MERGE;
+        meta.merge_sources = sources;
+        meta.target_fragment = target;
+        db_metas.push_back(meta);
+        mu.unlock();
+        sem_post(&sem_);
+    }
+
     void DBMigration::AddStoCMigration(nova::LTCFragment *frag, const std::vector<uint32_t> &removed_stocs) {
         mu.lock();
         DBMeta meta = {};
@@ -167,15 +244,24 @@ namespace nova {
             mu.unlock();
 
             std::vector<nova::LTCFragment *> source_migrates;
+            std::vector<DBMeta> source_handoffs;
             std::vector<DBMeta> dest_migrates;
+            std::vector<DBMeta> reorgs;
             std::vector<uint32_t> removed_stocs;
             std::vector<nova::LTCFragment *> frags;
 
             for (auto dbmeta : rdbs) {
                 if (dbmeta.migrate_type == MigrateType::SOURCE) {
                     source_migrates.push_back(dbmeta.source_fragment);
-                } else if (dbmeta.migrate_type == MigrateType::DESTINATION) {
+                } else if (dbmeta.migrate_type == MigrateType::DESTINATION ||
+                           dbmeta.migrate_type == MigrateType::DESTINATION_TAIL ||
+                           dbmeta.migrate_type == MigrateType::DESTINATION_WARM_CACHE) {
                     dest_migrates.push_back(dbmeta);
+                } else if (dbmeta.migrate_type == MigrateType::SOURCE_HANDOFF) {
+                    source_handoffs.push_back(dbmeta);
+                } else if (dbmeta.migrate_type == MigrateType::SPLIT ||
+                           dbmeta.migrate_type == MigrateType::MERGE) {
+                    reorgs.push_back(dbmeta);
                 } else {
                     frags.push_back(dbmeta.source_fragment);
                     removed_stocs = dbmeta.removed_stocs;
@@ -185,8 +271,25 @@ namespace nova {
             if (!source_migrates.empty()) {
                 MigrateDB(source_migrates);
             }
+            for (auto dbmeta : source_handoffs) {
+                Handoff(dbmeta);
+            }
+            // A tail and hot blocks follow the metadata of their range.
             for (auto dbmeta : dest_migrates) {
-                RecoverDBMeta(dbmeta);
+                if (dbmeta.migrate_type == MigrateType::DESTINATION) {
+                    RecoverDBMeta(dbmeta);
+                } else if (dbmeta.migrate_type == MigrateType::DESTINATION_TAIL) {
+                    ApplyMigrationTail(dbmeta);
+                } else {
+                    WarmCache(dbmeta);
+                }
+            }
+            for (auto dbmeta : reorgs) {
+                if (dbmeta.migrate_type == MigrateType::SPLIT) {
+                    SplitDB(dbmeta);
+                } else {
+                    MergeDB(dbmeta);
+                }
             }
             if (!removed_stocs.empty()) {
                 for (auto frag : frags) {
@@ -203,12 +306,21 @@ namespace nova {
         uint32_t cfg_id = NovaConfig::config->current_cfg_id;
         auto cfg = NovaConfig::config->cfgs[cfg_id];
         uint32_t scid = mem_manager_->slabclassid(0, NovaConfig::config->max_stoc_file_size);
+        bool live = NovaConfig::config->ltc_migration_policy == LTCMigrationPolicy::LIVE;
         for (auto frag : migrate_frags) {
             NOVA_LOG(rdmaio::INFO) << fmt::format("Start Migrate {}", frag->dbid);
             leveldb::DBImpl *db = reinterpret_cast<leveldb::DBImpl *>(frag->db);
             char *buf = mem_manager_->ItemAlloc(0, scid);
             bufs.push_back(buf);
-            msg_sizes.push_back(db->EncodeDBMetadata(buf, log_manager_, cfg_id));
+            if (live) {
+                // The snapshot contains all writes before it and the tail
+                // contains all writes after it.
+                PauseWrites(frag, LiveMigrationState::LIVE_MIGRATION_SNAPSHOT);
+                msg_sizes.push_back(db->EncodeDBMetadata(buf, log_manager_, cfg_id, false, true));
+                SetLiveMigrationState(frag, LiveMigrationState::LIVE_MIGRATION_DUAL_SERVING);
+            } else {
+                msg_sizes.push_back(db->EncodeDBMetadata(buf, log_manager_, cfg_id));
+            }
         }
 
         // Inform the destination of the database metadata.
@@ -221,12 +333,446 @@ namespace nova {
         for (int i = 0; i < migrate_frags.size(); i++) {
             client_->Wait();
         }
+
+        // Inform the destination of the hot blocks to warm its caches.
+        uint32_t warm_blocks = NovaConfig::config->ltc_migration_warm_blocks;
+        if (warm_blocks > 0) {
+            for (int i = 0; i < migrate_frags.size(); i++) {
+                auto frag = migrate_frags[i];
+                leveldb::DBImpl *db = reinterpret_cast<leveldb::DBImpl *>(frag->db);
+                uint32_t msg_size = db->EncodeHotBlocks(bufs[i], cfg_id, warm_blocks,
+                                                        NovaConfig::config->max_stoc_file_size);
+                client_->InitiateRDMAWRITE(cfg->fragments[frag->dbid]->ltc_server_id, bufs[i], msg_size);
+            }
+            for (int i = 0; i < migrate_frags.size(); i++) {
+                client_->Wait();
+            }
+        }
         for (int i = 0; i < migrate_frags.size(); i++) {
             mem_manager_->FreeItem(0, bufs[i], scid);
         }
         NOVA_LOG(rdmaio::INFO) << fmt::format("!!!Migration complete");
     }
 
+    void DBMigration::NotifyCaughtUp(uint32_t cfg_id, uint32_t dbid) {
+        uint32_t msg_size = 1 + 4 + 4;
+        uint32_t scid = mem_manager_->slabclassid(0, msg_size);
+        char *buf = mem_manager_->ItemAlloc(0, scid);
+        NOVA_ASSERT(buf);
+        buf[0] = leveldb::StoCRequestType::LTC_MIGRATION_CAUGHT_UP;
+        leveldb::EncodeFixed32(buf + 1, cfg_id);
+        leveldb::EncodeFixed32(buf + 5, dbid);
+        uint32_t source_server_id = NovaConfig::config->cfgs[cfg_id - 1]->fragments[dbid]->ltc_server_id;
+        client_->InitiateRDMAWRITE(source_server_id, buf, msg_size);
+        client_->Wait();
+        mem_manager_->FreeItem(0, buf, scid);
+    }
+
+    void DBMigration::Handoff(DBMeta dbmeta) {
+        NOVA_ASSERT(dbmeta.buf[0] == leveldb::StoCRequestType::LTC_MIGRATION_CAUGHT_UP);
+        uint32_t cfg_id = leveldb::DecodeFixed32(dbmeta.buf + 1);
+        uint32_t dbid = leveldb::DecodeFixed32(dbmeta.buf + 5);
+        mem_manager_->FreeItem(0, dbmeta.buf, mem_manager_->slabclassid(0, dbmeta.msg_size));
+
+        timeval start{};
+        gettimeofday(&start, nullptr);
+        auto frag = NovaConfig::config->cfgs[cfg_id - 1]->fragments[dbid];
+        auto dest_frag = NovaConfig::config->cfgs[cfg_id]->fragments[dbid];
+        leveldb::DBImpl *db = reinterpret_cast<leveldb::DBImpl *>(frag->db);
+        PauseWrites(frag, LiveMigrationState::LIVE_MIGRATION_HANDOFF);
+
+        // The destination owns the range from now on.
+        db->StopCompaction();
+        db->StopCoordinatedCompaction();
+
+        // Ship all log files that contain writes of the range. The
+        // destination closes them.
+        std::set<std::string> unique_log_files;
+        std::vector<std::string> log_files;
+        log_manager_->QueryLogFiles(dbid, &log_files);
+        db->QueryMigrationLogFiles(&log_files);
+        unique_log_files.insert(log_files.begin(), log_files.end());
+        log_files.assign(unique_log_files.begin(), unique_log_files.end());
+
+        // The tail may span multiple messages.
+        uint32_t scid = mem_manager_->slabclassid(0, NovaConfig::config->max_stoc_file_size);
+        char *buf = mem_manager_->ItemAlloc(0, scid);
+        NOVA_ASSERT(buf);
+        bool last = false;
+        uint32_t tail_msgs = 0;
+        uint64_t tail_size = 0;
+        while (!last) {
+            uint32_t msg_size = db->EncodeMigrationTail(buf, cfg_id, log_files, &last);
+            client_->InitiateRDMAWRITE(dest_frag->ltc_server_id, buf, msg_size);
+            client_->Wait();
+            tail_msgs += 1;
+            tail_size += msg_size;
+        }
+        mem_manager_->FreeItem(0, buf, scid);
+        if (!log_files.empty()) {
+            log_manager_->DeleteLogBuf(log_files);
+        }
+        // Redirect the requests to the destination.
+        SetLiveMigrationState(frag, LiveMigrationState::LIVE_MIGRATION_NONE);
+
+        timeval end{};
+        gettimeofday(&end, nullptr);
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("!!!Handoff db-{} to LTC-{} tail:{} messages:{} log files:{} took {}", dbid,
+                           dest_frag->ltc_server_id, tail_size, tail_msgs, log_files.size(),
+                           time_diff(start, end));
+    }
+
+    void DBMigration::ApplyMigrationTail(DBMeta dbmeta) {
+        NOVA_ASSERT(dbmeta.buf[0] == leveldb::StoCRequestType::LTC_MIGRATION_TAIL);
+        leveldb::Slice buf(dbmeta.buf + 1, dbmeta.msg_size - 1);
+        uint32_t cfg_id = 0;
+        uint32_t dbid = 0;
+        uint32_t tail_size = 0;
+        NOVA_ASSERT(DecodeFixed32(&buf, &cfg_id));
+        NOVA_ASSERT(DecodeFixed32(&buf, &dbid));
+        bool last = buf[0] == 1;
+        buf.remove_prefix(1);
+        NOVA_ASSERT(DecodeFixed32(&buf, &tail_size));
+        leveldb::Slice tail(buf.data(), tail_size);
+        buf.remove_prefix(tail_size);
+
+        auto frag = NovaConfig::config->cfgs[cfg_id]->fragments[dbid];
+        auto db = reinterpret_cast<leveldb::DBImpl *>(frag->db);
+        NOVA_ASSERT(db);
+        unsigned int rand_seed = dbid;
+        leveldb::WriteOptions option;
+        option.stoc_client = client_;
+        option.rand_seed = &rand_seed;
+        option.thread_id = 0;
+        // The source has logged the writes. Its log files are closed once
+        // the memtables containing the tail are flushed.
+        option.local_write = true;
+        leveldb::LevelDBLogRecord record = {};
+        uint32_t log_records = 0;
+        while (nova::DecodeLogRecord(&tail, &record)) {
+            option.hash = nova::keyhash(record.key.data(), record.key.size());
+            option.total_writes = db->processed_writes_ + 1;
+            option.sequence_number = record.sequence_number;
+            leveldb::Status s = db->Put(option, record.key, record.value);
+            NOVA_ASSERT(s.ok()) << s.ToString();
+            log_records += 1;
+        }
+        std::vector<std::string> log_files;
+        if (last) {
+            uint32_t num_log_files = 0;
+            NOVA_ASSERT(DecodeFixed32(&buf, &num_log_files));
+            for (uint32_t i = 0; i < num_log_files; i++) {
+                std::string log_file;
+                NOVA_ASSERT(DecodeStr(&buf, &log_file));
+                log_files.push_back(log_file);
+            }
+        }
+        mem_manager_->FreeItem(0, dbmeta.buf, mem_manager_->slabclassid(0, dbmeta.msg_size));
+        if (!last) {
+            NOVA_LOG(rdmaio::INFO)
+                << fmt::format("!!!!!Apply {} {} with {} log records in the tail", cfg_id, dbid, log_records);
+            return;
+        }
+
+        frag->is_ready_mutex_.Lock();
+        frag->is_ready_ = true;
+        frag->is_complete_ = true;
+        frag->live_migration_state_ = LiveMigrationState::LIVE_MIGRATION_NONE;
+        frag->is_ready_signal_.SignalAll();
+        frag->is_ready_mutex_.Unlock();
+
+        auto it = live_migration_log_files_.find(dbid);
+        if (it != live_migration_log_files_.end()) {
+            log_files.insert(log_files.end(), it->second.begin(), it->second.end());
+            live_migration_log_files_.erase(it);
+        }
+        std::set<std::string> unique_log_files(log_files.begin(), log_files.end());
+        log_files.assign(unique_log_files.begin(), unique_log_files.end());
+        std::vector<uint32_t> memtable_ids;
+        db->FlushMemTables(true, &memtable_ids);
+        threads_for_new_dbs_.emplace_back(
+                std::thread(&DBMigration::CloseLogFilesAfterFlush, this, db, dbid, memtable_ids, log_files));
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("!!!!!Take over {} {} with {} log records in the tail, flushing {} memtables", cfg_id,
+                           dbid, log_records, memtable_ids.size());
+    }
+
+    void DBMigration::CloseLogFilesAfterFlush(leveldb::DBImpl *db, uint32_t dbid,
+                                              std::vector<uint32_t> memtable_ids,
+                                              std::vector<std::string> log_files) {
+        for (auto memtable_id : memtable_ids) {
+            while (!db->IsFlushed(memtable_id)) {
+                usleep(10000);
+            }
+        }
+        if (!log_files.empty()) {
+            auto c = reinterpret_cast<leveldb::StoCBlockClient *>(db->options_.stoc_client);
+            c->InitiateCloseLogFiles(log_files, dbid);
+        }
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("!!!!!Closed {} log files of db-{} after flushing {} memtables", log_files.size(), dbid,
+                           memtable_ids.size());
+    }
+
+    void DBMigration::WarmCache(DBMeta dbmeta) {
+        threads_for_new_dbs_.emplace_back(std::thread(&DBMigration::PrefetchHotBlocks, this, dbmeta));
+    }
+
+    void DBMigration::PrefetchHotBlocks(DBMeta dbmeta) {
+        NOVA_ASSERT(dbmeta.buf[0] == leveldb::StoCRequestType::LTC_MIGRATION_WARM_CACHE);
+        leveldb::Slice buf(dbmeta.buf + 1, dbmeta.msg_size - 1);
+        uint32_t cfg_id = 0;
+        uint32_t dbid = 0;
+        NOVA_ASSERT(DecodeFixed32(&buf, &cfg_id));
+        NOVA_ASSERT(DecodeFixed32(&buf, &dbid));
+        auto frag = NovaConfig::config->cfgs[cfg_id]->fragments[dbid];
+        auto db = reinterpret_cast<leveldb::DBImpl *>(frag->db);
+        NOVA_ASSERT(db);
+
+        timeval start{};
+        gettimeofday(&start, nullptr);
+        auto client = new leveldb::StoCBlockClient(dbid, stoc_file_manager_);
+        client->rdma_msg_handlers_ = bg_rdma_msg_handlers_;
+        uint32_t scid = mem_manager_->slabclassid(0, MAX_BLOCK_SIZE);
+        char *backing_mem = mem_manager_->ItemAlloc(0, scid);
+        NOVA_ASSERT(backing_mem);
+        memset(backing_mem, 0, MAX_BLOCK_SIZE);
+        leveldb::ReadOptions read_options;
+        read_options.stoc_client = client;
+        read_options.mem_manager = mem_manager_;
+        read_options.thread_id = 0;
+        read_options.rdma_backing_mem = backing_mem;
+        read_options.rdma_backing_mem_size = MAX_BLOCK_SIZE;
+        read_options.cfg_id = cfg_id;
+        uint32_t opened_tables = 0;
+        uint32_t read_blocks = 0;
+        db->WarmCache(&buf, read_options, &opened_tables, &read_blocks);
+        // Cached tables do not keep the client.
+        delete client;
+        mem_manager_->FreeItem(0, backing_mem, scid);
+        mem_manager_->FreeItem(0, dbmeta.buf, mem_manager_->slabclassid(0, dbmeta.msg_size));
+
+        // The range reaches its steady state once its caches are warm.
+        timeval end{};
+        gettimeofday(&end, nullptr);
+        uint64_t end_us = end.tv_sec * 1000000 + end.tv_usec;
+        uint64_t cfg_start_us = NovaConfig::config->cfgs[cfg_id]->start_time_us_;
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("!!!!!Warm cache {} {} tables:{} blocks:{} took {} steady state after {}", cfg_id, dbid,
+                           opened_tables, read_blocks, time_diff(start, end),
+                           end_us > cfg_start_us ? end_us - cfg_start_us : 0);
+    }
+
+    leveldb::DB *DBMigration::OpenDB(uint32_t cfg_id, uint32_t dbid, leveldb::Cache *cache,
+                                     leveldb::MemTablePool *memtable_pool,
+                                     leveldb::LTCCompactionThread **reorg,
+                                     leveldb::LTCCompactionThread **coord) {
+        // The log files of a range on local disk do not move with it.
+        NOVA_ASSERT(NovaConfig::config->log_record_mode != NovaLogRecordMode::LOG_LOCAL_DISK)
+            << "Cannot open a range at runtime with local disk logs";
+        *reorg = new leveldb::LTCCompactionThread(mem_manager_);
+        *coord = new leveldb::LTCCompactionThread(mem_manager_);
+        auto client = new leveldb::StoCBlockClient(dbid, stoc_file_manager_);
+        auto db = CreateDatabase(cfg_id, dbid, cache, memtable_pool, mem_manager_, client, bg_compaction_threads_,
+                                 bg_flush_memtable_threads_, *reorg, *coord);
+        (*coord)->db_ = db;
+        (*coord)->stoc_client_ = new leveldb::StoCBlockClient(dbid, stoc_file_manager_);
+        (*coord)->stoc_client_->rdma_msg_handlers_ = bg_rdma_msg_handlers_;
+        (*coord)->thread_id_ = dbid;
+        auto frag = nova::NovaConfig::config->cfgs[cfg_id]->fragments[dbid];
+        frag->db = db;
+        auto dbimpl = reinterpret_cast<leveldb::DBImpl *>(db);
+        dbimpl->log_manager_ = log_manager_;
+        client->rdma_msg_handlers_ = bg_rdma_msg_handlers_;
+
+        db->processed_writes_ = 0;
+        db->number_of_puts_no_wait_ = 0;
+        db->number_of_puts_wait_ = 0;
+        db->number_of_steals_ = 0;
+        db->number_of_wait_due_to_contention_ = 0;
+        db->number_of_gets_ = 0;
+        db->number_of_memtable_hits_ = 0;
+        return db;
+    }
+
+    void DBMigration::StartDB(leveldb::DB *db, leveldb::LTCCompactionThread *reorg,
+                              leveldb::LTCCompactionThread *coord) {
+        threads_for_new_dbs_.emplace_back(std::thread(&leveldb::LTCCompactionThread::Start, reorg));
+        threads_for_new_dbs_.emplace_back(std::thread(&leveldb::LTCCompactionThread::Start, coord));
+        db->StartCoordinatedCompaction();
+    }
+
+    void DBMigration::SplitDB(DBMeta dbmeta) {
+        auto parent = dbmeta.source_fragment;
+        auto child = dbmeta.target_fragment;
+        uint32_t cfg_id = NovaConfig::config->current_cfg_id;
+        auto parent_db = reinterpret_cast<leveldb::DBImpl *>(parent->db);
+        NOVA_ASSERT(parent_db);
+        timeval start{};
+        gettimeofday(&start, nullptr);
+
+        uint32_t scid = mem_manager_->slabclassid(0, NovaConfig::config->max_stoc_file_size);
+        char *buf = mem_manager_->ItemAlloc(0, scid);
+        NOVA_ASSERT(buf);
+        uint32_t msg_size = parent_db->EncodeDBMetadata(buf, log_manager_, cfg_id, true);
+        // The parent drops the keys of the child in its next compactions.
+        parent_db->SetKeyRange(parent->range.key_start, parent->range.key_end);
+
+        leveldb::Slice slice(buf + 1, msg_size - 1);
+        uint32_t encoded_cfg_id = 0;
+        uint32_t parent_dbid = 0;
+        uint32_t version_id = 0;
+        uint64_t last_sequence = 0;
+        uint64_t next_file_number = 0;
+        uint64_t memtable_id_seq = 0;
+        NOVA_ASSERT(DecodeFixed32(&slice, &encoded_cfg_id));
+        NOVA_ASSERT(DecodeFixed32(&slice, &parent_dbid));
+        NOVA_ASSERT(DecodeFixed32(&slice, &version_id));
+        NOVA_ASSERT(DecodeFixed64(&slice, &last_sequence));
+        NOVA_ASSERT(DecodeFixed64(&slice, &next_file_number));
+        NOVA_ASSERT(DecodeFixed64(&slice, &memtable_id_seq));
+
+        leveldb::LTCCompactionThread *reorg = nullptr;
+        leveldb::LTCCompactionThread *coord = nullptr;
+        auto db = OpenDB(cfg_id, child->dbid, parent_db->options_.block_cache,
+                         parent_db->options_.memtable_pool, &reorg, &coord);
+        auto dbimpl = reinterpret_cast<leveldb::DBImpl *>(db);
+        // The parent pinned the shared tables. New tables of the two
+        // databases have different names.
+        std::unordered_map<uint32_t, leveldb::MemTableLogFilePair> memtables_to_recover;
+        dbimpl->RecoverDBMetadata(slice, version_id, last_sequence, next_file_number, memtable_id_seq,
+                                  log_manager_, &memtables_to_recover, false);
+        std::unordered_map<uint32_t, leveldb::MemTableLogFilePair> actual_memtables_to_recover;
+        for (const auto &memtable : memtables_to_recover) {
+            if (memtable.second.server_logbuf.empty() || !memtable.second.memtable) {
+                if (memtable.second.memtable) {
+                    memtable.second.memtable->SetReadyToProcessRequests();
+                }
+                continue;
+            }
+            actual_memtables_to_recover[memtable.first] = memtable.second;
+        }
+        // The memtables of the parent contain the recent writes of the
+        // child. The parent continues to use their log files.
+        leveldb::LogRecovery recover(mem_manager_, client_);
+        recover.Recover(actual_memtables_to_recover, cfg_id, child->dbid);
+        StartDB(db, reorg, coord);
+        mem_manager_->FreeItem(0, buf, scid);
+
+        child->is_ready_mutex_.Lock();
+        child->is_ready_ = true;
+        child->is_complete_ = true;
+        child->is_ready_signal_.SignalAll();
+        child->is_ready_mutex_.Unlock();
+
+        timeval end{};
+        gettimeofday(&end, nullptr);
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("!!!!!Split db-{} [{},{}) from db-{} [{},{}) memtables:{} took {}", child->dbid,
+                           KeySpace::EncodeBoundary(child->range.key_start),
+                           KeySpace::EncodeBoundary(child->range.key_end), parent->dbid,
+                           KeySpace::EncodeBoundary(parent->range.key_start),
+                           KeySpace::EncodeBoundary(parent->range.key_end), actual_memtables_to_recover.size(),
+                           time_diff(start, end));
+    }
+
+    void DBMigration::MergeDB(DBMeta dbmeta) {
+        auto target = dbmeta.target_fragment;
+        uint32_t cfg_id = NovaConfig::config->current_cfg_id;
+        auto first_source = reinterpret_cast<leveldb::DBImpl *>(dbmeta.merge_sources[0]->db);
+        timeval start{};
+        gettimeofday(&start, nullptr);
+
+        leveldb::LTCCompactionThread *reorg = nullptr;
+        leveldb::LTCCompactionThread *coord = nullptr;
+        auto db = OpenDB(cfg_id, target->dbid, first_source->options_.block_cache,
+                         first_source->options_.memtable_pool, &reorg, &coord);
+        StartDB(db, reorg, coord);
+
+        auto client = new leveldb::StoCBlockClient(target->dbid, stoc_file_manager_);
+        client->rdma_msg_handlers_ = bg_rdma_msg_handlers_;
+        uint32_t scid = mem_manager_->slabclassid(0, MAX_BLOCK_SIZE);
+        char *backing_mem = mem_manager_->ItemAlloc(0, scid);
+        NOVA_ASSERT(backing_mem);
+        memset(backing_mem, 0, MAX_BLOCK_SIZE);
+        leveldb::ReadOptions read_options;
+        read_options.stoc_client = client;
+        read_options.mem_manager = mem_manager_;
+        read_options.thread_id = 0;
+        read_options.rdma_backing_mem = backing_mem;
+        read_options.rdma_backing_mem_size = MAX_BLOCK_SIZE;
+        // The sources serve their ranges in the previous configuration.
+        read_options.cfg_id = cfg_id - 1;
+
+        unsigned int rand_seed = target->dbid;
+        leveldb::WriteOptions option;
+        option.stoc_client = client_;
+        option.rand_seed = &rand_seed;
+        option.thread_id = 0;
+        uint64_t merged_records = 0;
+        for (auto source : dbmeta.merge_sources) {
+            auto source_db = reinterpret_cast<leveldb::DBImpl *>(source->db);
+            leveldb::Iterator *iterator = source_db->NewIterator(read_options);
+            // Tables shared with a split may contain keys outside the range.
+            iterator->Seek(source->range.key_start);
+            while (iterator->Valid()) {
+                leveldb::Slice key = iterator->key();
+                if (KeySpace::CompareEnd(key, source->range) >= 0) {
+                    break;
+                }
+                option.hash = nova::keyhash(key.data(), key.size());
+                option.total_writes = db->processed_writes_ + 1;
+                leveldb::Status s = db->Put(option, key, iterator->value());
+                NOVA_ASSERT(s.ok()) << s.ToString();
+                merged_records += 1;
+                iterator->Next();
+            }
+            delete iterator;
+        }
+        mem_manager_->FreeItem(0, backing_mem, scid);
+        delete client;
+        auto dbimpl = reinterpret_cast<leveldb::DBImpl *>(db);
+        std::vector<uint32_t> memtable_ids;
+        dbimpl->FlushMemTables(true, &memtable_ids);
+
+        target->is_ready_mutex_.Lock();
+        target->is_ready_ = true;
+        target->is_complete_ = true;
+        target->is_ready_signal_.SignalAll();
+        target->is_ready_mutex_.Unlock();
+
+        // Retire the sources. Their tables are released once the merged
+        // records are flushed.
+        for (auto source : dbmeta.merge_sources) {
+            auto source_db = reinterpret_cast<leveldb::DBImpl *>(source->db);
+            source_db->StopCompaction();
+            source_db->StopCoordinatedCompaction();
+            std::vector<std::string> logfiles;
+            log_manager_->QueryLogFiles(source->dbid, &logfiles);
+            if (!logfiles.empty()) {
+                client_->InitiateCloseLogFiles(logfiles, source->dbid);
+            }
+        }
+        for (auto memtable_id : memtable_ids) {
+            while (!dbimpl->IsFlushed(memtable_id)) {
+                usleep(10000);
+            }
+        }
+        for (auto source : dbmeta.merge_sources) {
+            auto source_db = reinterpret_cast<leveldb::DBImpl *>(source->db);
+            source_db->ReleaseTables(client_);
+        }
+
+        timeval end{};
+        gettimeofday(&end, nullptr);
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("!!!!!Merge {} ranges into db-{} [{},{}) records:{} took {}",
+                           dbmeta.merge_sources.size(), target->dbid,
+                           KeySpace::EncodeBoundary(target->range.key_start),
+                           KeySpace::EncodeBoundary(target->range.key_end), merged_records, time_diff(start, end));
+    }
+
     void
     DBMigration::RecoverDBMeta(DBMeta dbmeta) {
         // Open the new database.
@@ -252,33 +798,17 @@ namespace nova {
         NOVA_LOG(rdmaio::INFO)
             << fmt::format("!!!!!Recover {} {} {} {} {} {}", cfg_id, dbindex, version_id, last_sequence,
                            next_file_number, memtable_id_seq);
-        auto reorg = new leveldb::LTCCompactionThread(mem_manager_);
-        auto coord = new leveldb::LTCCompactionThread(mem_manager_);
-        auto client = new leveldb::StoCBlockClient(dbindex, stoc_file_manager_);
-        auto db = CreateDatabase(cfg_id, dbindex, nullptr, nullptr, mem_manager_, client, bg_compaction_threads_,
-                                 bg_flush_memtable_threads_, reorg, coord);
-        coord->db_ = db;
-        coord->stoc_client_ = new leveldb::StoCBlockClient(dbindex, stoc_file_manager_);
-        coord->stoc_client_->rdma_msg_handlers_ = bg_rdma_msg_handlers_;
-        coord->thread_id_ = dbindex;
+        leveldb::LTCCompactionThread *reorg = nullptr;
+        leveldb::LTCCompactionThread *coord = nullptr;
+        auto db = OpenDB(cfg_id, dbindex, nullptr, nullptr, &reorg, &coord);
         auto frag = nova::NovaConfig::config->cfgs[cfg_id]->fragments[dbindex];
-        frag->db = db;
         auto dbimpl = reinterpret_cast<leveldb::DBImpl *>(db);
-        dbimpl->log_manager_ = log_manager_;
-        {
-            auto c = reinterpret_cast<leveldb::StoCBlockClient *>(dbimpl->options_.stoc_client);
-            c->rdma_msg_handlers_ = bg_rdma_msg_handlers_;
-        }
-
-        db->processed_writes_ = 0;
-        db->number_of_puts_no_wait_ = 0;
-        db->number_of_puts_wait_ = 0;
-        db->number_of_steals_ = 0;
-        db->number_of_wait_due_to_contention_ = 0;
-        db->number_of_gets_ = 0;
-        db->number_of_memtable_hits_ = 0;
+        auto client = reinterpret_cast<leveldb::StoCBlockClient *>(dbimpl->options_.stoc_client);
 
         std::unordered_map<uint32_t, leveldb::MemTableLogFilePair> memtables_to_recover;
+        bool live = nova::NovaConfig::config->ltc_migration_policy == LTCMigrationPolicy::LIVE;
+        // The migration tail contains the writes since the snapshot.
+        uint64_t snapshot_sequence = live ? last_sequence : UINT64_MAX;
         // bump up the numbers to avoid conflicts.
         last_sequence += 100000;
         next_file_number += 100000;
@@ -306,10 +836,20 @@ namespace nova {
             frag->is_ready_mutex_.Unlock();
         }
         leveldb::LogRecovery recover(mem_manager_, client_);
-        recover.Recover(actual_memtables_to_recover, cfg_id, dbindex);
-        threads_for_new_dbs_.emplace_back(std::thread(&leveldb::LTCCompactionThread::Start, reorg));
-        threads_for_new_dbs_.emplace_back(std::thread(&leveldb::LTCCompactionThread::Start, coord));
-        db->StartCoordinatedCompaction();
+        recover.Recover(actual_memtables_to_recover, cfg_id, dbindex, snapshot_sequence);
+        StartDB(db, reorg, coord);
+
+        if (live) {
+            // The source continues to write to the log files until the
+            // handoff. The range becomes ready once the tail is applied.
+            live_migration_log_files_[dbindex] = close_log_files;
+            mem_manager_->FreeItem(0, dbmeta.buf, mem_manager_->slabclassid(0, dbmeta.msg_size));
+            NotifyCaughtUp(cfg_id, dbindex);
+            NOVA_LOG(rdmaio::INFO)
+                << fmt::format("!!!!!Recover {} {} caught up: log files:{}", cfg_id, dbindex,
+                               close_log_files.size());
+            return;
+        }
 
         frag->is_ready_mutex_.Lock();
         frag->is_ready_ = true;
@@ -9,6 +9,8 @@
 
 #include <atomic>
 #include <mutex>
+#include <set>
+#include <unordered_map>
 #include <semaphore.h>
 
 #include "leveldb/db_types.h"
@@ -22,6 +24,10 @@
 
 namespace leveldb {
     class StoCBlockClient;
+
+    class DBImpl;
+
+    class LTCCompactionThread;
 }
 
 namespace nova {
@@ -30,7 +36,19 @@ namespace nova {
     enum MigrateType {
         SOURCE = 0,
         DESTINATION = 1,
-        STOC = 2
+        STOC = 2,
+        // Live migration. The source hands off a range once its destination
+        // catches up.
+        SOURCE_HANDOFF = 3,
+        // The destination replays the writes that the source processed
+        // since the snapshot.
+        DESTINATION_TAIL = 4,
+        // The destination prefetches the hot blocks of the source.
+        DESTINATION_WARM_CACHE = 5,
+        // Split a range into two ranges on the same LTC.
+        SPLIT = 6,
+        // Merge adjacent ranges into one range on the same LTC.
+        MERGE = 7
     };
 
     class DBMigration {
@@ -52,7 +70,18 @@ namespace nova {
 
         void AddStoCMigration(nova::LTCFragment * frag, const std::vector<uint32_t>& removed_stocs);
 
-        static std::atomic_int_fast32_t migration_seq_id_;
+        void AddSourceHandoff(char *buf, uint32_t msg_size);
+
+        void AddDestMigrationTail(char *buf, uint32_t msg_size);
+
+        void AddDestWarmCache(char *buf, uint32_t msg_size);
+
+        // child takes over the upper part of the range of parent.
+        void AddSplit(nova::LTCFragment *parent, nova::LTCFragment *child);
+
+        // target takes over the ranges of sources.
+        void AddMerge(const std::vector<nova::LTCFragment *> &sources, nova::LTCFragment *target);
+
     private:
         void MigrateDB(const std::vector<nova::LTCFragment *> &migrate_frags);
 
@@ -62,16 +91,55 @@ namespace nova {
             char *buf = nullptr;
             uint32_t msg_size = 0;
             std::vector<uint32_t> removed_stocs;
+            nova::LTCFragment *target_fragment = nullptr;
+            std::vector<nova::LTCFragment *> merge_sources;
         };
 
+        // Open an empty database for the range dbid of configuration
+        // cfg_id.
+        leveldb::DB *OpenDB(uint32_t cfg_id, uint32_t dbid, leveldb::Cache *cache,
+                            leveldb::MemTablePool *memtable_pool,
+                            leveldb::LTCCompactionThread **reorg,
+                            leveldb::LTCCompactionThread **coord);
+
+        void StartDB(leveldb::DB *db, leveldb::LTCCompactionThread *reorg,
+                     leveldb::LTCCompactionThread *coord);
+
         void RecoverDBMeta(DBMeta dbmeta);
 
+        // The child shares the SSTables of the parent and replays the log
+        // files of its memtables.
+        void SplitDB(DBMeta dbmeta);
+
+        // Rewrite the ranges of the sources into the target.
+        void MergeDB(DBMeta dbmeta);
+
+        // Inform the source that the destination has caught up.
+        void NotifyCaughtUp(uint32_t cfg_id, uint32_t dbid);
+
+        void Handoff(DBMeta dbmeta);
+
+        void ApplyMigrationTail(DBMeta dbmeta);
+
+        // Close the log files of a migrated range once its memtables are
+        // flushed.
+        void CloseLogFilesAfterFlush(leveldb::DBImpl *db, uint32_t dbid, std::vector<uint32_t> memtable_ids,
+                                     std::vector<std::string> log_files);
+
+        // Prefetch the hot blocks of a range in the background.
+        void WarmCache(DBMeta dbmeta);
+
+        void PrefetchHotBlocks(DBMeta dbmeta);
+
         void MigrateStoC(nova::LTCFragment * frag, const std::vector<uint32_t>& removed_stocs);
 
         std::mutex mu;
         std::vector<DBMeta> db_metas;
         sem_t sem_;
         std::vector<std::thread> threads_for_new_dbs_;
+        // Log files that a destination closes once it takes over a range
+        // in live migration.
+        std::unordered_map<uint32_t, std::vector<std::string>> live_migration_log_files_;
 
         leveldb::MemManager *mem_manager_ = nullptr;
         leveldb::StoCBlockClient *client_ = nullptr;
@@ -0,0 +1,173 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "memory_governor.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <fmt/core.h>
+
+#include "common/nova_common.h"
+#include "common/nova_config.h"
+#include "leveldb/db.h"
+#include "util/arena.h"
+
+#define GOVERNOR_INTERVAL_SEC 1
+// Bounds of the fraction of the shared memory for memtables.
+#define MIN_MEMTABLE_SHARE 0.1
+#define MAX_MEMTABLE_SHARE 0.9
+// Step toward memtables when writes stall for memtables.
+#define STALL_MEMTABLE_SHARE_STEP 0.1
+#define MIN_MEMORY_WRITE_DELAY_US 10
+#define MAX_MEMORY_WRITE_DELAY_US 1000
+
+namespace nova {
+    MemoryGovernor::MemoryGovernor(uint64_t budget, uint64_t memtable_size,
+                                   leveldb::Cache *block_cache,
+                                   leveldb::MemTablePool *memtable_pool,
+                                   bool resize_memtables,
+                                   NovaMemManager *mem_manager,
+                                   uint64_t rdma_bytes)
+            : budget_(budget), memtable_size_(memtable_size),
+              block_cache_(block_cache), memtable_pool_(memtable_pool),
+              resize_memtables_(resize_memtables), mem_manager_(mem_manager),
+              rdma_bytes_(rdma_bytes) {
+        uint32_t num_memtables = NovaConfig::config->num_memtables;
+        // Each range pins memtables and the pool never runs dry.
+        uint32_t num_ranges = NovaConfig::config->cfgs[0]->fragments.size();
+        max_memtables_ = 2 * num_memtables;
+        min_memtables_ = std::min(max_memtables_,
+                                  std::max(num_memtables / 2,
+                                           3 * num_ranges));
+        uint64_t memtable_bytes = num_memtables * memtable_size_;
+        uint64_t cache_bytes = block_cache_ ? block_cache_->TotalCapacity() : 0;
+        memtable_share_ = MAX_MEMTABLE_SHARE;
+        if (memtable_bytes + cache_bytes > 0 && block_cache_) {
+            memtable_share_ = (double) memtable_bytes /
+                              (memtable_bytes + cache_bytes);
+        }
+        memtable_share_ = std::max(MIN_MEMTABLE_SHARE,
+                                   std::min(MAX_MEMTABLE_SHARE,
+                                            memtable_share_));
+        last_workload_ = CurrentWorkload();
+    }
+
+    MemoryGovernor::Workload MemoryGovernor::CurrentWorkload() {
+        Workload workload = {};
+        Configuration *cfg = NovaConfig::config->cfgs[NovaConfig::config->current_cfg_id];
+        for (auto frag : cfg->fragments) {
+            auto db = reinterpret_cast<leveldb::DB *>(frag->db);
+            if (!db) {
+                continue;
+            }
+            workload.gets += db->number_of_gets_;
+            workload.puts += db->number_of_puts_no_wait_ + db->number_of_puts_wait_;
+            workload.stalls += db->number_of_puts_wait_;
+        }
+        return workload;
+    }
+
+    void MemoryGovernor::Adjust() {
+        Workload workload = CurrentWorkload();
+        uint64_t gets = workload.gets - last_workload_.gets;
+        uint64_t puts = workload.puts - last_workload_.puts;
+        uint64_t stalls = workload.stalls - last_workload_.stalls;
+        last_workload_ = workload;
+
+        if (gets + puts > 0) {
+            double target = (double) puts / (gets + puts);
+            if (stalls > 0) {
+                target = std::max(target, memtable_share_ + STALL_MEMTABLE_SHARE_STEP);
+            }
+            target = std::max(MIN_MEMTABLE_SHARE, std::min(MAX_MEMTABLE_SHARE, target));
+            // Move halfway to avoid oscillating with bursty workloads.
+            memtable_share_ += (target - memtable_share_) / 2;
+        }
+
+        uint64_t mem_pool_bytes = mem_manager_->AllocatedBytes();
+        uint64_t fixed_bytes = rdma_bytes_ + mem_pool_bytes;
+        uint64_t shared_bytes = budget_ > fixed_bytes ? budget_ - fixed_bytes : 0;
+
+        uint32_t memtable_slots = NovaConfig::config->num_memtables;
+        uint32_t used_memtables = 0;
+        if (resize_memtables_ && memtable_size_ > 0) {
+            uint32_t target = (uint32_t) (memtable_share_ * shared_bytes / memtable_size_);
+            target = std::max(min_memtables_, std::min(max_memtables_, target));
+            bool grow = false;
+            memtable_pool_->mutex_.lock();
+            grow = target > memtable_pool_->capacity_;
+            memtable_pool_->Resize(target);
+            memtable_slots = memtable_pool_->capacity_;
+            used_memtables = memtable_pool_->num_used_memtables();
+            memtable_pool_->mutex_.unlock();
+            if (grow) {
+                // Wake up the writes waiting for memtables.
+                Configuration *cfg = NovaConfig::config->cfgs[NovaConfig::config->current_cfg_id];
+                for (int i = 0; i < cfg->fragments.size(); i++) {
+                    if (cfg->fragments[i]->db && memtable_pool_->range_cond_vars_[i]) {
+                        memtable_pool_->range_cond_vars_[i]->SignalAll();
+                    }
+                }
+            }
+        } else {
+            used_memtables = memtable_slots;
+        }
+
+        uint64_t memtable_bytes = (uint64_t) memtable_slots * memtable_size_;
+        uint64_t cache_capacity = 0;
+        uint64_t cache_charge = 0;
+        if (block_cache_) {
+            cache_capacity = shared_bytes > memtable_bytes ? shared_bytes - memtable_bytes : 0;
+            block_cache_->SetCapacity(cache_capacity);
+            cache_charge = block_cache_->TotalCharge();
+        }
+
+        // Arena chunks back the memtables when the pool is enabled.
+        uint64_t used_memtable_bytes = (uint64_t) used_memtables * memtable_size_;
+        uint64_t arena_bytes = 0;
+        if (leveldb::ArenaChunkPool::pool) {
+            arena_bytes = leveldb::ArenaChunkPool::pool->MappedBytes();
+            used_memtable_bytes = arena_bytes;
+        }
+        uint64_t used_bytes = rdma_bytes_ + mem_pool_bytes + used_memtable_bytes + cache_charge;
+
+        // Double the write delay while the LTC exceeds its budget and halve
+        // it otherwise.
+        uint64_t delay = NovaGlobalVariables::global.memory_write_delay_us;
+        if (used_bytes > budget_) {
+            delay = std::min((uint64_t) MAX_MEMORY_WRITE_DELAY_US,
+                             std::max((uint64_t) MIN_MEMORY_WRITE_DELAY_US, 2 * delay));
+        } else {
+            delay /= 2;
+            if (delay < MIN_MEMORY_WRITE_DELAY_US) {
+                delay = 0;
+            }
+        }
+        NovaGlobalVariables::global.memory_write_delay_us = delay;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_ = fmt::format(
+                "ltc-mem,{},{},{:.2f},{},{},{},{},{},{},{},{}\n",
+                budget_, used_bytes, memtable_share_, memtable_slots,
+                used_memtable_bytes, cache_charge, cache_capacity,
+                mem_pool_bytes, arena_bytes, rdma_bytes_, delay);
+    }
+
+    std::string MemoryGovernor::Stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    void MemoryGovernor::Start() {
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("Memory governor budget:{} memtables:[{},{}]",
+                           budget_, min_memtables_, max_memtables_);
+        while (true) {
+            sleep(GOVERNOR_INTERVAL_SEC);
+            Adjust();
+        }
+    }
+}
@@ -0,0 +1,70 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#ifndef LEVELDB_MEMORY_GOVERNOR_H
+#define LEVELDB_MEMORY_GOVERNOR_H
+
+#include <mutex>
+#include <string>
+
+#include "common/nova_mem_manager.h"
+#include "leveldb/cache.h"
+#include "leveldb/db_types.h"
+
+namespace nova {
+    // Keeps the memory of an LTC within a budget. Memtables and the block
+    // cache share the budget left after the RDMA buffers and the items of
+    // the memory pool. Every second, the governor moves memory toward
+    // memtables when the workload writes more or writes stall for
+    // memtables, and toward the block cache when it reads more. When the
+    // LTC exceeds its budget, it delays writes until flushes and cache
+    // evictions bring it back within the budget.
+    class MemoryGovernor {
+    public:
+        // Memtables are resized only when resize_memtables is true since
+        // static partitions have a fixed number of memtables.
+        MemoryGovernor(uint64_t budget, uint64_t memtable_size,
+                       leveldb::Cache *block_cache,
+                       leveldb::MemTablePool *memtable_pool,
+                       bool resize_memtables, NovaMemManager *mem_manager,
+                       uint64_t rdma_bytes);
+
+        // It never returns.
+        void Start();
+
+        // Memory used by each consumer in the last second.
+        std::string Stats();
+
+    private:
+        struct Workload {
+            uint64_t gets = 0;
+            uint64_t puts = 0;
+            uint64_t stalls = 0;
+        };
+
+        Workload CurrentWorkload();
+
+        void Adjust();
+
+        const uint64_t budget_;
+        const uint64_t memtable_size_;
+        leveldb::Cache *block_cache_;
+        leveldb::MemTablePool *memtable_pool_;
+        const bool resize_memtables_;
+        NovaMemManager *mem_manager_;
+        const uint64_t rdma_bytes_;
+        uint32_t min_memtables_ = 0;
+        uint32_t max_memtables_ = 0;
+        // Fraction of the shared memory for memtables.
+        double memtable_share_ = 0;
+        Workload last_workload_ = {};
+
+        std::mutex mutex_;
+        std::string stats_;
+    };
+}
+
+#endif //LEVELDB_MEMORY_GOVERNOR_H
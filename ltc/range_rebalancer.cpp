@@ -0,0 +1,364 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "range_rebalancer.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <set>
+#include <fmt/core.h>
+
+#include "common/nova_common.h"
+#include "leveldb/env.h"
+
+// Do not move ranges to an LTC whose cores are busier than this.
+#define MAX_DESTINATION_CPU 0.8
+#define QUERY_CONFIG_CHANGE_INTERVAL_SEC 1
+
+namespace nova {
+    namespace {
+        uint64_t Delta(uint64_t current, uint64_t last) {
+            // A migrated range starts with new counters.
+            if (current < last) {
+                return current;
+            }
+            return current - last;
+        }
+    }
+
+    double RangeRebalancer::RangeLoad::Weight() const {
+        // Writes that stall keep the LTC busy for longer.
+        return rate * (1 + pressure);
+    }
+
+    double RangeRebalancer::LTCLoad::Weight() const {
+        double weight = 0;
+        for (const auto &range : ranges) {
+            weight += range.Weight();
+        }
+        return weight;
+    }
+
+    std::map<uint32_t, uint32_t>
+    RangeRebalancer::Plan(const std::vector<LTCLoad> &loads, uint32_t max_moves,
+                          double imbalance) {
+        std::map<uint32_t, uint32_t> moves;
+        if (loads.size() < 2) {
+            return moves;
+        }
+        std::vector<LTCLoad> ltcs = loads;
+        std::vector<double> weights;
+        double total = 0;
+        for (const auto &ltc : ltcs) {
+            weights.push_back(ltc.Weight());
+            total += weights.back();
+        }
+        double avg = total / ltcs.size();
+        while (moves.size() < max_moves) {
+            int src = 0;
+            int dst = -1;
+            for (int i = 0; i < ltcs.size(); i++) {
+                if (weights[i] > weights[src]) {
+                    src = i;
+                }
+            }
+            if (weights[src] <= avg * imbalance) {
+                break;
+            }
+            for (int i = 0; i < ltcs.size(); i++) {
+                if (i == src || ltcs[i].cpu >= MAX_DESTINATION_CPU) {
+                    continue;
+                }
+                if (dst == -1 || weights[i] < weights[dst]) {
+                    dst = i;
+                }
+            }
+            if (dst == -1) {
+                break;
+            }
+            // Move the heaviest range that narrows the gap between the two
+            // LTCs without reversing it. Moving a range of weight w changes
+            // the gap to gap - 2w.
+            double gap = weights[src] - weights[dst];
+            int range = -1;
+            for (int i = 0; i < ltcs[src].ranges.size(); i++) {
+                double weight = ltcs[src].ranges[i].Weight();
+                if (weight <= 0 || 2 * weight > gap) {
+                    continue;
+                }
+                if (moves.find(ltcs[src].ranges[i].dbid) != moves.end()) {
+                    continue;
+                }
+                if (range == -1 || weight > ltcs[src].ranges[range].Weight()) {
+                    range = i;
+                }
+            }
+            if (range == -1) {
+                break;
+            }
+            RangeLoad moved = ltcs[src].ranges[range];
+            ltcs[src].ranges.erase(ltcs[src].ranges.begin() + range);
+            ltcs[dst].ranges.push_back(moved);
+            weights[src] -= moved.Weight();
+            weights[dst] += moved.Weight();
+            moves[moved.dbid] = ltcs[dst].server_id;
+        }
+        return moves;
+    }
+
+    int RangeRebalancer::PlanSplit(const std::vector<LTCLoad> &loads, double imbalance) {
+        if (loads.size() < 2) {
+            return -1;
+        }
+        double total = 0;
+        int src = 0;
+        for (int i = 0; i < loads.size(); i++) {
+            total += loads[i].Weight();
+            if (loads[i].Weight() > loads[src].Weight()) {
+                src = i;
+            }
+        }
+        if (loads[src].Weight() <= total / loads.size() * imbalance) {
+            return -1;
+        }
+        int range = -1;
+        for (int i = 0; i < loads[src].ranges.size(); i++) {
+            double weight = loads[src].ranges[i].Weight();
+            if (weight > 0 && (range == -1 || weight > loads[src].ranges[range].Weight())) {
+                range = i;
+            }
+        }
+        if (range == -1) {
+            return -1;
+        }
+        return loads[src].ranges[range].dbid;
+    }
+
+    std::string RangeRebalancer::SplitKey(const std::vector<LTCLoad> &loads, uint32_t dbid,
+                                          const RangePartition &range) {
+        if (KeySpace::NumKeys(range.key_start, range.key_end) < 2) {
+            return "";
+        }
+        for (const auto &load : loads) {
+            for (const auto &range_load : load.ranges) {
+                if (range_load.dbid == dbid && !range_load.split_key.empty() &&
+                    KeySpace::CompareStart(range_load.split_key, range) > 0 &&
+                    KeySpace::CompareEnd(range_load.split_key, range) < 0) {
+                    return range_load.split_key;
+                }
+            }
+        }
+        std::vector<std::string> boundaries = KeySpace::Split(range.key_start, range.key_end, 2);
+        if (boundaries.size() < 3) {
+            return "";
+        }
+        return boundaries[1];
+    }
+
+    std::string RangeRebalancer::Request(uint32_t server_id, const std::string &request) {
+        NovaClientSock *sock = socks_[server_id];
+        if (!sock) {
+            sock = new NovaClientSock;
+            sock->Connect(NovaConfig::config->servers[server_id]);
+            socks_[server_id] = sock;
+        }
+        NOVA_ASSERT(request.size() + 1 < NovaConfig::config->max_msg_size);
+        memcpy(sock->send_buf(), request.data(), request.size());
+        sock->send_buf()[request.size()] = MSG_TERMINATER_CHAR;
+        sock->Send(nullptr, request.size() + 1);
+        int size = sock->ReceiveResponse();
+        return std::string(sock->recv_buf(), size);
+    }
+
+    std::vector<RangeRebalancer::LTCLoad>
+    RangeRebalancer::CollectLoads(Configuration *cfg, double seconds) {
+        std::vector<LTCLoad> loads;
+        bool has_last_counters = true;
+        for (auto server_id : cfg->ltc_servers) {
+            std::string response = Request(server_id, std::string(1, RequestType::LOAD_STATS));
+            std::vector<std::string> tokens = SplitByDelimiter(&response, ",");
+            if (tokens.size() < 3) {
+                // Skip this round. The next round collects new counters.
+                NOVA_LOG(rdmaio::WARNING)
+                    << fmt::format("Invalid load stats from LTC-{}: {}", server_id, response);
+                last_counters_.clear();
+                return {};
+            }
+            Counters counters;
+            counters.cpu_ticks = std::stoull(tokens[0]);
+            uint64_t ticks_per_sec = std::max(1ull, std::stoull(tokens[1]));
+            uint64_t cores = std::max(1ull, std::stoull(tokens[2]));
+            for (int i = 3; i < tokens.size(); i++) {
+                std::vector<std::string> range = SplitByDelimiter(&tokens[i], ":");
+                if (range.size() != 3 && range.size() != 4) {
+                    NOVA_LOG(rdmaio::WARNING)
+                        << fmt::format("Invalid range stats from LTC-{}: {}", server_id, tokens[i]);
+                    last_counters_.clear();
+                    return {};
+                }
+                counters.ranges[std::stoi(range[0])] = std::make_pair(std::stoull(range[1]),
+                                                                      std::stoull(range[2]));
+                if (range.size() == 4) {
+                    counters.split_keys[std::stoi(range[0])] = KeySpace::DecodeBoundary(range[3]);
+                }
+            }
+
+            auto it = last_counters_.find(server_id);
+            if (it == last_counters_.end()) {
+                has_last_counters = false;
+            } else {
+                const Counters &last = it->second;
+                LTCLoad load;
+                load.server_id = server_id;
+                load.cpu = (double) Delta(counters.cpu_ticks, last.cpu_ticks) / ticks_per_sec / seconds / cores;
+                for (const auto &range : counters.ranges) {
+                    uint64_t requests = range.second.first;
+                    uint64_t stalls = range.second.second;
+                    auto last_range = last.ranges.find(range.first);
+                    if (last_range != last.ranges.end()) {
+                        requests = Delta(requests, last_range->second.first);
+                        stalls = Delta(stalls, last_range->second.second);
+                    }
+                    RangeLoad range_load;
+                    range_load.dbid = range.first;
+                    range_load.rate = requests / seconds;
+                    range_load.pressure = requests > 0 ? std::min(1.0, (double) stalls / requests) : 0;
+                    auto split_key = counters.split_keys.find(range.first);
+                    if (split_key != counters.split_keys.end()) {
+                        range_load.split_key = split_key->second;
+                    }
+                    load.ranges.push_back(range_load);
+                }
+                loads.push_back(load);
+            }
+            last_counters_[server_id] = counters;
+        }
+        if (!has_last_counters) {
+            loads.clear();
+        }
+        return loads;
+    }
+
+    void RangeRebalancer::ChangeConfiguration(Configuration *cfg,
+                                              const std::map<uint32_t, uint32_t> &moves,
+                                              int split_dbid, const std::string &split_key) {
+        Configuration new_cfg;
+        {
+            std::lock_guard<std::mutex> l(NovaConfig::config->m);
+            new_cfg.cfg_id = NovaConfig::config->cfgs.size();
+        }
+        NOVA_ASSERT(new_cfg.cfg_id == cfg->cfg_id + 1)
+            << fmt::format("Configuration {} is not the last one.", cfg->cfg_id);
+        new_cfg.ltc_servers = cfg->ltc_servers;
+        new_cfg.stoc_servers = cfg->stoc_servers;
+        new_cfg.ltc_server_ids = cfg->ltc_server_ids;
+        new_cfg.stoc_server_ids = cfg->stoc_server_ids;
+        for (auto frag : cfg->fragments) {
+            auto new_frag = new LTCFragment;
+            new_frag->range = frag->range;
+            new_frag->dbid = frag->dbid;
+            new_frag->ltc_server_id = frag->ltc_server_id;
+            new_frag->log_replica_stoc_ids = frag->log_replica_stoc_ids;
+            auto move = moves.find(frag->dbid);
+            if (move != moves.end()) {
+                NOVA_LOG(rdmaio::INFO)
+                    << fmt::format("Rebalance range {} from LTC-{} to LTC-{}", frag->dbid,
+                                   frag->ltc_server_id, move->second);
+                new_frag->ltc_server_id = move->second;
+            }
+            new_cfg.fragments.push_back(new_frag);
+        }
+        if (split_dbid != -1) {
+            // The new range takes over the upper half on the same LTC.
+            auto parent = new_cfg.fragments[split_dbid];
+            auto child = new LTCFragment;
+            child->range.SetBoundaries(split_key, parent->range.key_end);
+            child->dbid = new_cfg.fragments.size();
+            child->ltc_server_id = parent->ltc_server_id;
+            child->log_replica_stoc_ids = parent->log_replica_stoc_ids;
+            parent->range.SetBoundaries(parent->range.key_start, split_key);
+            new_cfg.fragments.push_back(child);
+            NOVA_LOG(rdmaio::INFO)
+                << fmt::format("Split range {} at {} into range {} on LTC-{}", split_dbid,
+                               KeySpace::EncodeBoundary(split_key), child->dbid, child->ltc_server_id);
+        }
+        std::string encoded = new_cfg.Encode();
+        for (auto frag : new_cfg.fragments) {
+            delete frag;
+        }
+
+        // All servers, including this one, add the configuration before
+        // any of them changes to it.
+        for (const auto &server : NovaConfig::config->servers) {
+            Request(server.server_id, std::string(1, RequestType::ADD_CONFIG) + encoded);
+        }
+        uint64_t start = leveldb::Env::Default()->NowMicros();
+        for (const auto &server : NovaConfig::config->servers) {
+            Request(server.server_id, std::string(1, RequestType::CHANGE_CONFIG));
+        }
+        std::set<uint32_t> pending;
+        for (const auto &server : NovaConfig::config->servers) {
+            pending.insert(server.server_id);
+        }
+        while (!pending.empty()) {
+            sleep(QUERY_CONFIG_CHANGE_INTERVAL_SEC);
+            for (auto it = pending.begin(); it != pending.end();) {
+                if (Request(*it, std::string(1, RequestType::QUERY_CONFIG_CHANGE)) == "0") {
+                    it = pending.erase(it);
+                } else {
+                    it++;
+                }
+            }
+        }
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("Rebalance to configuration {} moved {} ranges split:{} in {} ms", new_cfg.cfg_id,
+                           moves.size(), split_dbid, (leveldb::Env::Default()->NowMicros() - start) / 1000);
+    }
+
+    void RangeRebalancer::Start() {
+        uint32_t interval = NovaConfig::config->ltc_rebalance_interval_sec;
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("Range rebalancer interval:{}s max moves:{} imbalance:{}", interval,
+                           NovaConfig::config->ltc_rebalance_max_moves,
+                           NovaConfig::config->ltc_rebalance_imbalance);
+        uint64_t last = leveldb::Env::Default()->NowMicros();
+        while (true) {
+            sleep(interval);
+            uint64_t now = leveldb::Env::Default()->NowMicros();
+            double seconds = std::max(1ul, now - last) / 1000000.0;
+            last = now;
+            Configuration *cfg = NovaConfig::config->cfgs[NovaConfig::config->current_cfg_id];
+            std::vector<LTCLoad> loads = CollectLoads(cfg, seconds);
+            std::string debug;
+            for (const auto &load : loads) {
+                debug += fmt::format("LTC-{}:{:.2f}:{:.0f} ", load.server_id, load.cpu, load.Weight());
+            }
+            NOVA_LOG(rdmaio::INFO) << fmt::format("Range rebalancer loads: {}", debug);
+            std::map<uint32_t, uint32_t> moves = Plan(loads, NovaConfig::config->ltc_rebalance_max_moves,
+                                                      NovaConfig::config->ltc_rebalance_imbalance);
+            int split_dbid = -1;
+            std::string split_key;
+            if (moves.empty()) {
+                split_dbid = PlanSplit(loads, NovaConfig::config->ltc_rebalance_imbalance);
+                if (split_dbid != -1) {
+                    const RangePartition &range = cfg->fragments[split_dbid]->range;
+                    split_key = SplitKey(loads, split_dbid, range);
+                    if (split_key.empty() ||
+                        cfg->fragments.size() >= NovaConfig::config->max_num_ranges) {
+                        split_dbid = -1;
+                    }
+                }
+            }
+            if (moves.empty() && split_dbid == -1) {
+                continue;
+            }
+            ChangeConfiguration(cfg, moves, split_dbid, split_key);
+            // Counters of the migrated ranges restart at their new LTCs.
+            last_counters_.clear();
+            last = leveldb::Env::Default()->NowMicros();
+        }
+    }
+}
@@ -0,0 +1,90 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#ifndef LEVELDB_RANGE_REBALANCER_H
+#define LEVELDB_RANGE_REBALANCER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/nova_client_sock.h"
+#include "common/nova_config.h"
+
+namespace nova {
+    // Moves hot ranges from overloaded LTCs to underloaded LTCs. It runs on
+    // the first LTC of the initial configuration. Every interval, it
+    // collects the request rate and write stalls of each range and the CPU
+    // utilization of each LTC. When the most loaded LTC exceeds the average
+    // load by ltc_rebalance_imbalance, it computes a new configuration that
+    // moves at most ltc_rebalance_max_moves ranges, adds it to all servers
+    // and changes to it with the existing migration path. When no move
+    // narrows the gap, it splits the heaviest range of the most loaded LTC
+    // instead at the key that halves its inserts, or at its midpoint.
+    class RangeRebalancer {
+    public:
+        struct RangeLoad {
+            uint32_t dbid = 0;
+            // Requests per second.
+            double rate = 0;
+            // Fraction of writes that stalled.
+            double pressure = 0;
+            // A key that halves the recent inserts. Empty if unknown.
+            std::string split_key;
+
+            double Weight() const;
+        };
+
+        struct LTCLoad {
+            uint32_t server_id = 0;
+            // Fraction of the cores busy.
+            double cpu = 0;
+            std::vector<RangeLoad> ranges;
+
+            double Weight() const;
+        };
+
+        // Return the new LTC of each moved range.
+        static std::map<uint32_t, uint32_t>
+        Plan(const std::vector<LTCLoad> &loads, uint32_t max_moves,
+             double imbalance);
+
+        // Return the heaviest range of the most loaded LTC when it exceeds
+        // the average load by imbalance, or -1. Splitting it lets a later
+        // round move half of its load.
+        static int PlanSplit(const std::vector<LTCLoad> &loads, double imbalance);
+
+        // Return the key that splits range dbid: the key that halves its
+        // inserts when it lies inside the range, or the midpoint. Return an
+        // empty string if the range has fewer than 2 keys.
+        static std::string SplitKey(const std::vector<LTCLoad> &loads, uint32_t dbid,
+                                    const RangePartition &range);
+
+        // It never returns.
+        void Start();
+
+    private:
+        struct Counters {
+            uint64_t cpu_ticks = 0;
+            std::map<uint32_t, std::pair<uint64_t, uint64_t>> ranges;
+            std::map<uint32_t, std::string> split_keys;
+        };
+
+        std::string Request(uint32_t server_id, const std::string &request);
+
+        std::vector<LTCLoad> CollectLoads(Configuration *cfg, double seconds);
+
+        // Split range split_dbid at split_key unless it is -1.
+        void ChangeConfiguration(Configuration *cfg,
+                                 const std::map<uint32_t, uint32_t> &moves,
+                                 int split_dbid, const std::string &split_key);
+
+        std::map<uint32_t, NovaClientSock *> socks_;
+        std::map<uint32_t, Counters> last_counters_;
+    };
+}
+
+#endif //LEVELDB_RANGE_REBALANCER_H
@@ -0,0 +1,149 @@
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "ltc/range_rebalancer.h"
+#include "util/testharness.h"
+
+namespace nova {
+
+    class RangeRebalancerTest {
+    public:
+        typedef RangeRebalancer::LTCLoad LTCLoad;
+        typedef RangeRebalancer::RangeLoad RangeLoad;
+
+        // An LTC serving ranges first_dbid, first_dbid + 1, ... with the
+        // given request rates.
+        static LTCLoad LTC(uint32_t server_id, double cpu, uint32_t first_dbid,
+                           const std::vector<double> &rates) {
+            LTCLoad ltc;
+            ltc.server_id = server_id;
+            ltc.cpu = cpu;
+            for (int i = 0; i < rates.size(); i++) {
+                RangeLoad range;
+                range.dbid = first_dbid + i;
+                range.rate = rates[i];
+                ltc.ranges.push_back(range);
+            }
+            return ltc;
+        }
+
+        // The load of each LTC after applying the moves.
+        static std::map<uint32_t, double> Apply(const std::vector<LTCLoad> &loads,
+                                                const std::map<uint32_t, uint32_t> &moves) {
+            std::map<uint32_t, double> weights;
+            for (const auto &ltc : loads) {
+                weights[ltc.server_id] += 0;
+                for (const auto &range : ltc.ranges) {
+                    uint32_t server_id = ltc.server_id;
+                    auto move = moves.find(range.dbid);
+                    if (move != moves.end()) {
+                        server_id = move->second;
+                    }
+                    weights[server_id] += range.Weight();
+                }
+            }
+            return weights;
+        }
+    };
+
+    TEST(RangeRebalancerTest, Balanced) {
+        std::vector<LTCLoad> loads;
+        loads.push_back(LTC(0, 0.5, 0, {50, 50}));
+        loads.push_back(LTC(1, 0.5, 2, {60, 30}));
+        ASSERT_TRUE(RangeRebalancer::Plan(loads, 4, 1.2).empty());
+        ASSERT_EQ(RangeRebalancer::PlanSplit(loads, 1.2), -1);
+
+        // A single LTC has nowhere to move ranges.
+        loads.resize(1);
+        ASSERT_TRUE(RangeRebalancer::Plan(loads, 4, 1.2).empty());
+    }
+
+    TEST(RangeRebalancerTest, Imbalance) {
+        std::vector<LTCLoad> loads;
+        loads.push_back(LTC(0, 0.5, 0, {50, 30, 20}));
+        loads.push_back(LTC(1, 0.1, 3, {}));
+        std::map<uint32_t, uint32_t> moves = RangeRebalancer::Plan(loads, 4, 1.2);
+        // Moving the heaviest range balances the two LTCs.
+        ASSERT_EQ(moves.size(), 1);
+        ASSERT_EQ(moves[0], 1);
+        std::map<uint32_t, double> weights = Apply(loads, moves);
+        ASSERT_EQ(weights[0], 50);
+        ASSERT_EQ(weights[1], 50);
+
+        // Stalled writes add to the load of a range.
+        loads[0].ranges[1].pressure = 1;
+        moves = RangeRebalancer::Plan(loads, 4, 1.2);
+        ASSERT_EQ(moves.size(), 1);
+        ASSERT_EQ(moves[1], 1);
+    }
+
+    TEST(RangeRebalancerTest, MaxMoves) {
+        std::vector<LTCLoad> loads;
+        loads.push_back(LTC(0, 0.5, 0, {10, 10, 10, 10, 10, 10, 10, 10, 10, 10}));
+        loads.push_back(LTC(1, 0.1, 10, {}));
+        loads.push_back(LTC(2, 0.1, 10, {}));
+        std::map<uint32_t, uint32_t> moves = RangeRebalancer::Plan(loads, 2, 1.2);
+        ASSERT_EQ(moves.size(), 2);
+        std::map<uint32_t, double> weights = Apply(loads, moves);
+        ASSERT_EQ(weights[0], 80);
+        ASSERT_EQ(weights[1], 10);
+        ASSERT_EQ(weights[2], 10);
+
+        moves = RangeRebalancer::Plan(loads, 100, 1.2);
+        weights = Apply(loads, moves);
+        for (const auto &it : weights) {
+            ASSERT_LE(it.second, 100.0 / 3 * 1.2);
+        }
+        ASSERT_TRUE(RangeRebalancer::Plan(loads, 0, 1.2).empty());
+    }
+
+    TEST(RangeRebalancerTest, CPUCap) {
+        std::vector<LTCLoad> loads;
+        loads.push_back(LTC(0, 0.5, 0, {50, 30, 20}));
+        loads.push_back(LTC(1, 0.9, 3, {}));
+        // The only destination is too busy.
+        ASSERT_TRUE(RangeRebalancer::Plan(loads, 4, 1.2).empty());
+
+        // The least loaded LTC is too busy. The next one takes the range.
+        loads.push_back(LTC(2, 0.1, 3, {10}));
+        std::map<uint32_t, uint32_t> moves = RangeRebalancer::Plan(loads, 4, 1.2);
+        ASSERT_TRUE(!moves.empty());
+        for (const auto &it : moves) {
+            ASSERT_EQ(it.second, 2);
+        }
+    }
+
+    TEST(RangeRebalancerTest, NoReversal) {
+        std::vector<LTCLoad> loads;
+        // Moving the only range would make LTC-1 the most loaded.
+        loads.push_back(LTC(0, 0.5, 0, {100}));
+        loads.push_back(LTC(1, 0.1, 1, {10}));
+        ASSERT_TRUE(RangeRebalancer::Plan(loads, 4, 1.2).empty());
+        // Splitting the range lets a later round move half of it.
+        ASSERT_EQ(RangeRebalancer::PlanSplit(loads, 1.2), 0);
+
+        // Moving either range reverses the gap of 50: 30 vs 100 or 60 vs 70.
+        loads.clear();
+        loads.push_back(LTC(0, 0.5, 0, {60, 30}));
+        loads.push_back(LTC(1, 0.1, 2, {40}));
+        ASSERT_TRUE(RangeRebalancer::Plan(loads, 4, 1.2).empty());
+
+        loads.clear();
+        loads.push_back(LTC(0, 0.5, 0, {60, 20}));
+        loads.push_back(LTC(1, 0.1, 2, {40}));
+        std::map<uint32_t, uint32_t> moves = RangeRebalancer::Plan(loads, 4, 1.2);
+        // The 60 range would reverse the gap of 40. The 20 range closes it.
+        ASSERT_EQ(moves.size(), 1);
+        ASSERT_EQ(moves[1], 1);
+        std::map<uint32_t, double> weights = Apply(loads, moves);
+        ASSERT_EQ(weights[0], 60);
+        ASSERT_EQ(weights[1], 60);
+    }
+}
+
+nova::NovaConfig *nova::NovaConfig::config;
+nova::NovaGlobalVariables nova::NovaGlobalVariables::global;
+
+int main(int argc, char **argv) { return leveldb::test::RunAllTests(); }
@@ -80,6 +80,38 @@ namespace nova {
         output->append("\n");
     }
 
+    void NovaStatThread::OutputSchedulerStats(const std::string &prefix,
+                                              leveldb::LTCBackgroundPool pool,
+                                              std::string *output) {
+        leveldb::LTCBackgroundPoolStats stats = {};
+        std::vector<uint32_t> queue_lengths;
+        compaction_scheduler_->QueryStats(pool, &stats, &queue_lengths);
+        leveldb::LTCBackgroundPoolStats &last = last_scheduler_stats_[pool];
+        uint64_t dispatched = stats.dispatched_tasks - last.dispatched_tasks;
+        uint64_t avg_wait_us = 0;
+        if (dispatched > 0) {
+            avg_wait_us = (stats.total_wait_us - last.total_wait_us) / dispatched;
+        }
+        output->append(prefix + "-sched,");
+        output->append(std::to_string(stats.queued_tasks));
+        output->append(",");
+        output->append(std::to_string(dispatched));
+        output->append(",");
+        output->append(std::to_string(stats.urgent_dispatches - last.urgent_dispatches));
+        output->append(",");
+        output->append(std::to_string(avg_wait_us));
+        output->append(",");
+        output->append(std::to_string(stats.max_wait_us));
+        output->append("\n");
+        output->append(prefix + "-sched-queue,");
+        for (auto length : queue_lengths) {
+            output->append(std::to_string(length));
+            output->append(",");
+        }
+        output->append("\n");
+        last = stats;
+    }
+
     void NovaStatThread::Start() {
         std::vector<uint32_t> foreground_rdma_tasks;
         std::vector<uint32_t> bg_rdma_tasks;
@@ -145,11 +177,58 @@ namespace nova {
             }
             output += "\n";
 
+            if (compaction_scheduler_) {
+                OutputSchedulerStats("flush", leveldb::LTCBackgroundPool::kFlushMemTablePool, &output);
+                OutputSchedulerStats("compaction", leveldb::LTCBackgroundPool::kCompactionPool, &output);
+            }
+
             OutputStats("fg", &output, &fg_storage_stats, fg_storage_workers_);
             OutputStats("bg", &output, &bg_storage_stats, bg_storage_workers_);
             OutputStats("c", &output, &compaction_storage_stats,
                         compaction_storage_workers_);
 
+            output += fmt::format("stoc-space,{},{},{}\n",
+                                  nova::NovaGlobalVariables::global.stoc_live_bytes.load(),
+                                  nova::NovaGlobalVariables::global.stoc_dead_bytes.load(),
+                                  nova::NovaGlobalVariables::global.stoc_reclaimed_bytes.load());
+            output += fmt::format("stoc-replication,{}\n",
+                                  nova::NovaGlobalVariables::global.stoc_replicated_bytes.load());
+            output += fmt::format("stoc-block-cache,{},{}\n",
+                                  nova::NovaGlobalVariables::global.stoc_block_cache_hits.load(),
+                                  nova::NovaGlobalVariables::global.stoc_block_cache_misses.load());
+            if (memory_governor_) {
+                output += memory_governor_->Stats();
+            }
+            if (stoc_rebalancer_) {
+                output += stoc_rebalancer_->Stats();
+            }
+            if (mem_manager_) {
+                output += mem_manager_->Stats();
+            }
+            if (leveldb::ArenaChunkPool::pool) {
+                output += leveldb::ArenaChunkPool::pool->Stats();
+            }
+            if (stoc_io_scheduler_) {
+                output += stoc_io_scheduler_->Stats();
+            }
+            output += fmt::format("log-quorum,{},{}\n",
+                                  nova::NovaGlobalVariables::global.log_quorum_writes.load(),
+                                  nova::NovaGlobalVariables::global.log_quorum_saved_us.load());
+            output += fmt::format("local-log,{},{},{}\n",
+                                  nova::NovaGlobalVariables::global.local_log_records.load(),
+                                  nova::NovaGlobalVariables::global.local_log_commits.load(),
+                                  nova::NovaGlobalVariables::global.local_log_commit_us.load());
+            output += "log-replica-lag,";
+            for (int i = 0; i < MAX_NUM_SERVERS; i++) {
+                uint64_t writes = nova::NovaGlobalVariables::global.log_replica_lagged_writes[i];
+                if (writes == 0) {
+                    continue;
+                }
+                output += fmt::format("{}:{}:{},", i, writes,
+                                      nova::NovaGlobalVariables::global.log_replica_lag_us[i] / writes);
+            }
+            output += "\n";
+
             output += "active-memtables,";
             for (int i = 0; i < dbs.size(); i++) {
                 output += std::to_string(dbs[i]->number_of_active_memtables_);
@@ -179,6 +258,34 @@ namespace nova {
             }
             output += "\n";
 
+            output += "delayed-puts,";
+            for (int i = 0; i < dbs.size(); i++) {
+                output += std::to_string(dbs[i]->number_of_puts_delayed_);
+                output += ",";
+            }
+            output += "\n";
+
+            output += "write-delay-us,";
+            for (int i = 0; i < dbs.size(); i++) {
+                output += std::to_string(dbs[i]->write_delay_us_);
+                output += ",";
+            }
+            output += "\n";
+
+            // (flushed bytes + compaction output bytes) / flushed bytes.
+            output += "write-amp,";
+            for (int i = 0; i < dbs.size(); i++) {
+                double write_amp = 0;
+                if (dbs[i]->flushed_bytes_ > 0) {
+                    write_amp = (double) (dbs[i]->flushed_bytes_ +
+                                          dbs[i]->compaction_output_bytes_) /
+                                (double) dbs[i]->flushed_bytes_;
+                }
+                output += fmt::format("{:.2f}", write_amp);
+                output += ",";
+            }
+            output += "\n";
+
             output += "wait-due-to-contention,";
             for (int i = 0; i < dbs.size(); i++) {
                 output += std::to_string(
@@ -375,6 +482,8 @@ namespace nova {
                 output += ",";
             }
             output += "\n";
+            output += fmt::format("disk-syncs,{}\n",
+                                  nova::NovaGlobalVariables::global.total_disk_syncs.load());
             NOVA_LOG(INFO) << fmt::format("stats: \n{}", output);
             output.clear();
         }
@@ -12,6 +12,9 @@
 #include "common/nova_common.h"
 #include "novalsm/rdma_msg_handler.h"
 #include "stoc/storage_worker.h"
+#include "ltc/compaction_scheduler.h"
+#include "ltc/memory_governor.h"
+#include "ltc/stoc_rebalancer.h"
 
 namespace nova {
     class NovaStatThread {
@@ -24,6 +27,11 @@ namespace nova {
         std::vector<StorageWorker *> bg_storage_workers_;
         std::vector<StorageWorker *> compaction_storage_workers_;
         std::vector<leveldb::EnvBGThread *> bgs_;
+        leveldb::LTCCompactionScheduler *compaction_scheduler_ = nullptr;
+        leveldb::StoCIOScheduler *stoc_io_scheduler_ = nullptr;
+        NovaMemManager *mem_manager_ = nullptr;
+        MemoryGovernor *memory_governor_ = nullptr;
+        StoCRebalancer *stoc_rebalancer_ = nullptr;
     private:
         struct StorageWorkerStats {
             uint32_t tasks = 0;
@@ -38,6 +46,12 @@ namespace nova {
                          std::string *output,
                          std::vector<StorageWorkerStats> *storage_stats,
                          const std::vector<StorageWorker *> &storage_workers);
+
+        void OutputSchedulerStats(const std::string &prefix,
+                                  leveldb::LTCBackgroundPool pool,
+                                  std::string *output);
+
+        leveldb::LTCBackgroundPoolStats last_scheduler_stats_[leveldb::kNumBackgroundPools];
     };
 }
 
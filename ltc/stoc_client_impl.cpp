@@ -184,6 +184,8 @@ namespace leveldb {
             response->stoc_queue_depth = nova::NovaGlobalVariables::global.stoc_queue_depth;
             response->stoc_pending_write_bytes = nova::NovaGlobalVariables::global.stoc_pending_disk_writes;
             response->stoc_pending_read_bytes = nova::NovaGlobalVariables::global.stoc_pending_disk_reads;
+            response->stoc_block_cache_hits = nova::NovaGlobalVariables::global.stoc_block_cache_hits;
+            response->stoc_block_cache_misses = nova::NovaGlobalVariables::global.stoc_block_cache_misses;
             IncrementReqId();
             NOVA_LOG(rdmaio::DEBUG)
                 << fmt::format("Wake up local read stats");
@@ -285,6 +287,8 @@ namespace leveldb {
         response->stoc_queue_depth = stored_response->stoc_queue_depth;
         response->stoc_pending_read_bytes = stored_response->stoc_pending_read_bytes;
         response->stoc_pending_write_bytes = stored_response->stoc_pending_write_bytes;
+        response->stoc_block_cache_hits = stored_response->stoc_block_cache_hits;
+        response->stoc_block_cache_misses = stored_response->stoc_block_cache_misses;
         response->is_ready_to_process_requests = stored_response->is_ready_to_process_requests;
         delete it->second;
         req_response.erase(req_id);
@@ -791,6 +795,8 @@ namespace leveldb {
                 response->stoc_queue_depth = context_it->second.stoc_queue_depth;
                 response->stoc_pending_read_bytes = context_it->second.stoc_pending_read_bytes;
                 response->stoc_pending_write_bytes = context_it->second.stoc_pending_write_bytes;
+                response->stoc_block_cache_hits = context_it->second.stoc_block_cache_hits;
+                response->stoc_block_cache_misses = context_it->second.stoc_block_cache_misses;
                 response->is_ready_to_process_requests = context_it->second.is_ready_for_requests;
             }
             request_context_.erase(req_id);
@@ -834,6 +840,12 @@ namespace leveldb {
                 break;
             case IBV_WC_RDMA_WRITE: {
                 if (buf[0] == leveldb::StoCRequestType::STOC_REPLICATE_LOG_RECORDS) {
+                    if (rdma_log_writer_->AckStragglerWrite(remote_server_id,
+                                                            wr_id)) {
+                        // The request already completed with a write quorum.
+                        processed = true;
+                        break;
+                    }
                     req_id = leveldb::DecodeFixed32(buf + 1);
                     auto context_it = request_context_.find(req_id);
                     NOVA_ASSERT(context_it != request_context_.end())
@@ -853,7 +865,7 @@ namespace leveldb {
                                 "stocclient[{}]: Log record replicated req:{} wr_id:{} first:{}",
                                 stoc_client_id_, req_id, wr_id, buf[0]);
                     bool complete = rdma_log_writer_->CheckCompletion(
-                            context.log_file_name, context.db_id,
+                            context.log_file_name, context.db_id, req_id,
                             context.replicate_log_record_states);
                     if (complete) {
                         context.done = true;
@@ -877,6 +889,21 @@ namespace leveldb {
                 break;
             case IBV_WC_RECV:
             case IBV_WC_RECV_RDMA_WITH_IMM:
+                if (buf[0] == StoCRequestType::STOC_ALLOCATE_LOG_BUFFERS_SUCC) {
+                    // Not associated with a request.
+                    uint64_t size = leveldb::DecodeFixed64(buf + 1);
+                    uint32_t nbufs = leveldb::DecodeFixed32(buf + 9);
+                    std::vector<uint64_t> bufs;
+                    for (int i = 0; i < nbufs; i++) {
+                        bufs.push_back(leveldb::DecodeFixed64(buf + 13 + i * 8));
+                    }
+                    rdma_log_writer_->AddPreallocatedLogBufs(remote_server_id, bufs, size);
+                    NOVA_LOG(DEBUG) << fmt::format(
+                                "stocclient[{}]: Preallocated {} log buffers at server {}",
+                                stoc_client_id_, nbufs, remote_server_id);
+                    processed = true;
+                    break;
+                }
                 auto context_it = request_context_.find(req_id);
                 if (context_it != request_context_.end()) {
                     // I sent this request a while ago and now it is complete.
@@ -954,6 +981,10 @@ namespace leveldb {
                                 buf + 9);
                         context.stoc_pending_write_bytes = leveldb::DecodeFixed64(
                                 buf + 17);
+                        context.stoc_block_cache_hits = leveldb::DecodeFixed64(
+                                buf + 25);
+                        context.stoc_block_cache_misses = leveldb::DecodeFixed64(
+                                buf + 33);
                         context.done = true;
                         processed = true;
                     } else if (buf[0] ==
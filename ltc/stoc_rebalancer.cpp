@@ -0,0 +1,216 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "stoc_rebalancer.h"
+
+#include <unistd.h>
+#include <set>
+#include <fmt/core.h>
+
+#include "common/nova_common.h"
+#include "common/nova_config.h"
+#include "db/db_impl.h"
+#include "leveldb/env.h"
+
+#define MAX_REBALANCE_REPLICATION_BATCH_SIZE 10
+
+namespace nova {
+    namespace {
+        // The databases of the ranges that this LTC serves.
+        std::vector<leveldb::DBImpl *> MyDBs() {
+            std::vector<leveldb::DBImpl *> dbs;
+            Configuration *cfg = NovaConfig::config->cfgs[NovaConfig::config->current_cfg_id];
+            for (auto frag : cfg->fragments) {
+                auto db = reinterpret_cast<leveldb::DBImpl *>(frag->db);
+                if (!db || frag->IsRetired() || !frag->is_complete_ ||
+                    frag->ltc_server_id != NovaConfig::config->my_server_id) {
+                    continue;
+                }
+                dbs.push_back(db);
+            }
+            return dbs;
+        }
+    }
+
+    StoCRebalancer::StoCRebalancer(leveldb::StoCBlockClient *client) : client_(client) {
+    }
+
+    std::map<uint32_t, uint64_t> StoCRebalancer::QueryStoCBytes() {
+        Configuration *cfg = NovaConfig::config->cfgs[NovaConfig::config->current_cfg_id];
+        std::map<uint32_t, uint64_t> bytes;
+        for (auto stoc_id : cfg->stoc_servers) {
+            bytes[stoc_id] = 0;
+        }
+        std::unordered_map<uint32_t, uint64_t> db_bytes;
+        for (auto db : MyDBs()) {
+            db->QueryStoCBytes(&db_bytes);
+        }
+        // Replicas on removed StoCs are restored by the StoC migration.
+        for (const auto &it : db_bytes) {
+            if (bytes.find(it.first) != bytes.end()) {
+                bytes[it.first] = it.second;
+            }
+        }
+        return bytes;
+    }
+
+    uint64_t StoCRebalancer::QueryStalls() {
+        uint64_t stalls = 0;
+        for (auto db : MyDBs()) {
+            stalls += db->number_of_puts_wait_;
+        }
+        return stalls;
+    }
+
+    uint64_t StoCRebalancer::AcquireTokens(uint64_t bytes) {
+        uint64_t rate = NovaConfig::config->ltc_stoc_rebalance_rate_mb * 1024 * 1024;
+        if (rate == 0) {
+            return bytes;
+        }
+        // The bucket holds up to one second of moves.
+        bytes = std::min(bytes, rate);
+        leveldb::Env *env = leveldb::Env::Default();
+        while (true) {
+            uint64_t now = env->NowMicros();
+            if (last_refill_us_ == 0) {
+                last_refill_us_ = now;
+            }
+            tokens_ = std::min((double) rate, tokens_ + (now - last_refill_us_) * rate / 1000000.0);
+            last_refill_us_ = now;
+            if (tokens_ >= bytes) {
+                return bytes;
+            }
+            env->SleepForMicroseconds((int) ((bytes - tokens_) * 1000000 / rate) + 1);
+        }
+    }
+
+    uint64_t StoCRebalancer::Move(uint32_t src_stoc_id, uint32_t dest_stoc_id, uint64_t max_bytes) {
+        uint64_t moved_bytes = 0;
+        for (auto db : MyDBs()) {
+            // Start from the last level since its SSTables live longest.
+            for (int level = NovaConfig::config->level - 1; level >= 0 && moved_bytes < max_bytes; level--) {
+                std::vector<leveldb::ReplicationPair> pairs;
+                uint64_t tokens = AcquireTokens(max_bytes - moved_bytes);
+                uint64_t bytes = db->QueryReplicasToMove(src_stoc_id, dest_stoc_id, level, tokens, &pairs);
+                if (pairs.empty()) {
+                    continue;
+                }
+                // The last SSTable may exceed the tokens.
+                tokens_ -= bytes;
+                std::vector<uint32_t> reqs;
+                for (int i = 0; i < pairs.size(); i += MAX_REBALANCE_REPLICATION_BATCH_SIZE) {
+                    std::vector<leveldb::ReplicationPair> batch(
+                            pairs.begin() + i,
+                            pairs.begin() + std::min((int) pairs.size(), i + MAX_REBALANCE_REPLICATION_BATCH_SIZE));
+                    reqs.push_back(client_->InitiateReplicateSSTables(src_stoc_id, db->dbname(), batch));
+                }
+                for (int i = 0; i < reqs.size(); i++) {
+                    client_->Wait();
+                }
+                std::vector<leveldb::ReplicationPair> result;
+                for (auto reqid : reqs) {
+                    leveldb::StoCResponse response;
+                    NOVA_ASSERT(client_->IsDone(reqid, &response, nullptr));
+                    for (const auto &r : response.replication_results) {
+                        result.push_back(r);
+                    }
+                }
+                db->MoveReplicaLocations(result, src_stoc_id, level, client_);
+                db->ReleaseReplicasToMove(pairs);
+                std::set<uint64_t> moved_tables;
+                for (const auto &pair : pairs) {
+                    moved_tables.insert(pair.sstable_file_number);
+                }
+                for (auto fn : moved_tables) {
+                    db->EvictFileFromCache(fn);
+                }
+                moved_bytes += bytes;
+                // Move the rest of the level after the next refill.
+                level++;
+                NOVA_LOG(rdmaio::INFO)
+                    << fmt::format("DB[{}]: Move {} SSTables of level {} with {} bytes from StoC-{} to StoC-{}",
+                                   db->dbname(), moved_tables.size(), level, bytes, src_stoc_id, dest_stoc_id);
+            }
+            if (moved_bytes >= max_bytes) {
+                break;
+            }
+        }
+        return moved_bytes;
+    }
+
+    void StoCRebalancer::Rebalance() {
+        for (auto db : MyDBs()) {
+            db->DeleteObsoleteReplicas(client_);
+        }
+
+        std::map<uint32_t, uint64_t> bytes = QueryStoCBytes();
+        uint64_t stalls = QueryStalls();
+        bool stalled = stalls > last_stalls_;
+        last_stalls_ = stalls;
+
+        uint64_t budget = NovaConfig::config->ltc_stoc_rebalance_max_mb * 1024 * 1024;
+        uint64_t moved_bytes = 0;
+        uint64_t total = 0;
+        for (const auto &it : bytes) {
+            total += it.second;
+        }
+        while (!stalled && bytes.size() > 1 && moved_bytes < budget) {
+            auto src = bytes.begin();
+            auto dest = bytes.begin();
+            for (auto it = bytes.begin(); it != bytes.end(); it++) {
+                if (it->second > src->second) {
+                    src = it;
+                }
+                if (it->second < dest->second) {
+                    dest = it;
+                }
+            }
+            double avg = (double) total / bytes.size();
+            if (src->second <= avg * NovaConfig::config->ltc_stoc_rebalance_imbalance) {
+                break;
+            }
+            // Do not reverse the imbalance between the two StoCs.
+            uint64_t max_bytes = std::min(budget - moved_bytes, (src->second - dest->second) / 2);
+            uint64_t moved = Move(src->first, dest->first, max_bytes);
+            if (moved == 0) {
+                break;
+            }
+            src->second -= std::min(src->second, moved);
+            dest->second += moved;
+            moved_bytes += moved;
+        }
+        total_moved_bytes_ += moved_bytes;
+
+        std::string balance;
+        for (const auto &it : bytes) {
+            balance += fmt::format(",{}:{}", it.first, it.second);
+        }
+        if (moved_bytes > 0) {
+            NOVA_LOG(rdmaio::INFO)
+                << fmt::format("StoC rebalancer moved {} bytes stalled:{} balance{}", moved_bytes, stalled,
+                               balance);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_ = fmt::format("stoc-balance,{},{}{}\n", moved_bytes, total_moved_bytes_, balance);
+    }
+
+    std::string StoCRebalancer::Stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    void StoCRebalancer::Start() {
+        uint32_t interval = NovaConfig::config->ltc_stoc_rebalance_interval_sec;
+        NOVA_LOG(rdmaio::INFO)
+            << fmt::format("StoC rebalancer interval:{}s max:{}MB imbalance:{}", interval,
+                           NovaConfig::config->ltc_stoc_rebalance_max_mb,
+                           NovaConfig::config->ltc_stoc_rebalance_imbalance);
+        while (true) {
+            sleep(interval);
+            Rebalance();
+        }
+    }
+}
@@ -0,0 +1,69 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#ifndef LEVELDB_STOC_REBALANCER_H
+#define LEVELDB_STOC_REBALANCER_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "leveldb/db_types.h"
+#include "ltc/stoc_client_impl.h"
+
+namespace nova {
+    // Moves the SSTable replicas of the ranges of this LTC from StoCs that
+    // store more bytes than the average to StoCs that store fewer, e.g.,
+    // StoCs added by a configuration change. Only new SSTables land on new
+    // StoCs otherwise. Every interval, it moves at most
+    // ltc_stoc_rebalance_max_mb of replicas from the most utilized StoC to
+    // the least utilized StoC while the former exceeds the average by
+    // ltc_stoc_rebalance_imbalance. A token bucket paces the moves at
+    // ltc_stoc_rebalance_rate_mb per second. It skips an interval when
+    // writes stalled in the last interval to leave the StoCs to foreground
+    // requests. A moved replica is deleted once no live version references
+    // it.
+    class StoCRebalancer {
+    public:
+        explicit StoCRebalancer(leveldb::StoCBlockClient *client);
+
+        // It never returns.
+        void Start();
+
+        // Bytes moved in the last interval and bytes on each StoC.
+        std::string Stats();
+
+    private:
+        // Bytes of the ranges of this LTC on each StoC of the current
+        // configuration.
+        std::map<uint32_t, uint64_t> QueryStoCBytes();
+
+        uint64_t QueryStalls();
+
+        // Move up to max_bytes of replicas from src_stoc_id to
+        // dest_stoc_id. Return the moved bytes.
+        uint64_t Move(uint32_t src_stoc_id, uint32_t dest_stoc_id, uint64_t max_bytes);
+
+        // Wait until the token bucket holds bytes tokens or is full. Return
+        // the bytes that may be moved.
+        uint64_t AcquireTokens(uint64_t bytes);
+
+        void Rebalance();
+
+        leveldb::StoCBlockClient *client_ = nullptr;
+        uint64_t last_stalls_ = 0;
+        uint64_t total_moved_bytes_ = 0;
+        double tokens_ = 0;
+        uint64_t last_refill_us_ = 0;
+
+        std::mutex mutex_;
+        std::string stats_;
+    };
+}
+
+#endif //LEVELDB_STOC_REBALANCER_H
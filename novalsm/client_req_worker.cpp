@@ -31,6 +31,7 @@
 #include <arpa/inet.h>
 
 #include <event.h>
+#include <db/db_impl.h>
 #include <leveldb/write_batch.h>
 #include <ltc/storage_selector.h>
 
@@ -158,20 +159,104 @@ namespace nova {
         conn->response_ind = 0;
     }
 
+    // Respond with the configuration id that serves the request.
+    bool respond_cfg_id(Connection *conn, uint32_t cfg_id) {
+        auto worker = (NICClientReqWorker *) conn->worker;
+        char *response_buf = worker->buf;
+        int len = int_to_str(response_buf, cfg_id);
+        response_buf += len;
+        response_buf[0] = MSG_TERMINATER_CHAR;
+        conn->response_buf = worker->buf;
+        conn->response_size = len + 1;
+        return true;
+    }
+
+    // With live migration, the source serves a migrating range with the
+    // prior configuration until it hands off the range to the destination.
+    uint32_t live_migration_cfg_id(char *request_buf, uint32_t client_cfg_id, uint32_t server_cfg_id) {
+        if (client_cfg_id + 1 != server_cfg_id && client_cfg_id != server_cfg_id) {
+            return server_cfg_id;
+        }
+        leveldb::Slice key;
+        KeySpace::ParseKey(request_buf, &key);
+        if (client_cfg_id + 1 == server_cfg_id) {
+            LTCFragment *frag = NovaConfig::home_fragment(key, client_cfg_id);
+            if (frag && frag->ltc_server_id == NovaConfig::config->my_server_id &&
+                frag->live_migration_state_ != LiveMigrationState::LIVE_MIGRATION_NONE) {
+                return client_cfg_id;
+            }
+            return server_cfg_id;
+        }
+        // Redirect the client to the source until the source hands off the
+        // range.
+        LTCFragment *frag = NovaConfig::home_fragment(key, server_cfg_id);
+        if (server_cfg_id > 0 && frag && frag->ltc_server_id == NovaConfig::config->my_server_id &&
+            frag->live_migration_state_ == LiveMigrationState::LIVE_MIGRATION_DUAL_SERVING) {
+            return server_cfg_id - 1;
+        }
+        return server_cfg_id;
+    }
+
+    // The range has moved to another LTC once the source hands it off.
+    bool is_handed_off(LTCFragment *frag, uint32_t server_cfg_id) {
+        return NovaConfig::config->ltc_migration_policy == LTCMigrationPolicy::LIVE &&
+               server_cfg_id != NovaConfig::config->current_cfg_id &&
+               frag->live_migration_state_ == LiveMigrationState::LIVE_MIGRATION_NONE;
+    }
+
+    // Count a write to the range so that a live migration waits for it
+    // before it takes a snapshot of the range or hands it off. Return
+    // false if the range is handed off.
+    bool begin_write(LTCFragment *frag, uint32_t server_cfg_id) {
+        if (NovaConfig::config->ltc_migration_policy != LTCMigrationPolicy::LIVE) {
+            return true;
+        }
+        while (true) {
+            frag->live_migration_writes_.fetch_add(1);
+            int state = frag->live_migration_state_;
+            if (state == LiveMigrationState::LIVE_MIGRATION_DUAL_SERVING) {
+                return true;
+            }
+            if (state == LiveMigrationState::LIVE_MIGRATION_NONE) {
+                if (!is_handed_off(frag, server_cfg_id)) {
+                    return true;
+                }
+                frag->live_migration_writes_.fetch_sub(1);
+                return false;
+            }
+            frag->live_migration_writes_.fetch_sub(1);
+            frag->is_ready_mutex_.Lock();
+            while (frag->live_migration_state_ == LiveMigrationState::LIVE_MIGRATION_SNAPSHOT ||
+                   frag->live_migration_state_ == LiveMigrationState::LIVE_MIGRATION_HANDOFF) {
+                frag->is_ready_signal_.Wait();
+            }
+            frag->is_ready_mutex_.Unlock();
+        }
+    }
+
+    void end_write(LTCFragment *frag) {
+        if (NovaConfig::config->ltc_migration_policy != LTCMigrationPolicy::LIVE) {
+            return;
+        }
+        frag->live_migration_writes_.fetch_sub(1);
+    }
+
     bool
     process_socket_get(int fd, Connection *conn, char *request_buf,
                        uint32_t server_cfg_id) {
         // Stats.
         NICClientReqWorker *worker = (NICClientReqWorker *) conn->worker;
         worker->stats.ngets++;
-        uint64_t int_key = 0;
-        uint32_t nkey = str_to_int(request_buf, &int_key) - 1;
-        uint64_t hv = keyhash(request_buf, nkey);
+        leveldb::Slice key;
+        KeySpace::ParseKey(request_buf, &key);
+        uint64_t hv = keyhash(key.data(), key.size());
         worker->stats.nget_hits++;
 
-        leveldb::Slice key(request_buf, nkey);
-        LTCFragment *frag = NovaConfig::home_fragment(hv, server_cfg_id);
+        LTCFragment *frag = NovaConfig::home_fragment(key, server_cfg_id);
         NOVA_ASSERT(frag) << fmt::format("cfg:{} key:{}", server_cfg_id, hv);
+        if (is_handed_off(frag, server_cfg_id)) {
+            return respond_cfg_id(conn, NovaConfig::config->current_cfg_id);
+        }
 
         if (!frag->is_ready_) {
             frag->is_ready_mutex_.Lock();
@@ -185,7 +270,7 @@ namespace nova {
         NOVA_ASSERT(db);
         std::string value;
         leveldb::ReadOptions read_options;
-        read_options.hash = int_key;
+        read_options.hash = hv;
         read_options.stoc_client = worker->stoc_client_;
         read_options.mem_manager = worker->mem_manager_;
         read_options.thread_id = worker->thread_id_;
@@ -295,6 +380,7 @@ namespace nova {
         int new_cfg_id = current_cfg_id + 1;
         nova::Servers *new_stocs = new nova::Servers;
         std::vector<uint32_t> removed_stocs;
+        bool live = NovaConfig::config->ltc_migration_policy == LTCMigrationPolicy::LIVE;
         for (int fragid = 0; fragid < NovaConfig::config->cfgs[current_cfg_id]->fragments.size(); fragid++) {
             auto old_frag = NovaConfig::config->cfgs[current_cfg_id]->fragments[fragid];
             auto current_frag = NovaConfig::config->cfgs[new_cfg_id]->fragments[fragid];
@@ -302,14 +388,62 @@ namespace nova {
                 if (old_frag->ltc_server_id == NovaConfig::config->my_server_id) {
                     NOVA_LOG(rdmaio::INFO) << fmt::format("Migrate {}", current_frag->DebugString());
                     migrate_frags.push_back(old_frag);
+                    if (live) {
+                        // Serve the range until the destination catches up.
+                        old_frag->live_migration_state_ = LiveMigrationState::LIVE_MIGRATION_DUAL_SERVING;
+                    }
+                } else if (live && current_frag->ltc_server_id == NovaConfig::config->my_server_id) {
+                    current_frag->live_migration_state_ = LiveMigrationState::LIVE_MIGRATION_DUAL_SERVING;
                 }
             } else {
-                current_frag->db = old_frag->db;
+                // A split shrinks the range of its parent and a merge
+                // retires its sources on the same LTC.
+                current_frag->db = current_frag->IsRetired() ? nullptr : old_frag->db;
                 current_frag->is_ready_ = true;
                 current_frag->is_complete_ = true;
             }
         }
+        // The new ranges of the configuration split or merge the ranges of
+        // their LTC.
+        std::vector<std::pair<LTCFragment *, LTCFragment *>> splits;
+        std::vector<std::pair<std::vector<LTCFragment *>, LTCFragment *>> merges;
+        {
+            auto old_cfg = NovaConfig::config->cfgs[current_cfg_id];
+            auto new_cfg = NovaConfig::config->cfgs[new_cfg_id];
+            for (int fragid = old_cfg->fragments.size(); fragid < new_cfg->fragments.size(); fragid++) {
+                auto frag = new_cfg->fragments[fragid];
+                if (frag->ltc_server_id != NovaConfig::config->my_server_id || frag->IsRetired()) {
+                    continue;
+                }
+                LTCFragment *parent = NovaConfig::home_fragment(frag->range.key_start, current_cfg_id);
+                NOVA_ASSERT(parent) << frag->DebugString();
+                if (KeySpace::Compare(frag->range.key_end, parent->range.key_end) <= 0) {
+                    NOVA_ASSERT(parent->ltc_server_id == NovaConfig::config->my_server_id)
+                        << fmt::format("Split {} on another LTC", parent->DebugString());
+                    NOVA_LOG(rdmaio::INFO)
+                        << fmt::format("Split {} from {}", frag->DebugString(), parent->DebugString());
+                    splits.emplace_back(new_cfg->fragments[parent->dbid], frag);
+                    continue;
+                }
+                std::vector<LTCFragment *> sources;
+                for (auto old_frag : old_cfg->sorted_fragments) {
+                    if (KeySpace::Compare(old_frag->range.key_start, frag->range.key_end) < 0 &&
+                        KeySpace::Compare(old_frag->range.key_end, frag->range.key_start) > 0) {
+                        NOVA_ASSERT(old_frag->ltc_server_id == NovaConfig::config->my_server_id)
+                            << fmt::format("Merge {} on another LTC", old_frag->DebugString());
+                        sources.push_back(old_frag);
+                    }
+                }
+                NOVA_LOG(rdmaio::INFO)
+                    << fmt::format("Merge {} ranges into {}", sources.size(), frag->DebugString());
+                merges.emplace_back(sources, frag);
+            }
+        }
 
+        // The log files of a range on local disk do not move with it.
+        NOVA_ASSERT(NovaConfig::config->log_record_mode != NovaLogRecordMode::LOG_LOCAL_DISK ||
+                    (migrate_frags.empty() && splits.empty() && merges.empty()))
+            << "Cannot migrate, split or merge ranges with local disk logs";
         new_stocs->servers = NovaConfig::config->cfgs[new_cfg_id]->stoc_servers;
         new_stocs->server_ids = NovaConfig::config->cfgs[new_cfg_id]->stoc_server_ids;
         leveldb::StorageSelector::available_stoc_servers.store(new_stocs);
@@ -343,6 +477,14 @@ namespace nova {
                 thread_id = (thread_id + 1) % worker->db_migration_threads_.size();
                 worker->db_migration_threads_[thread_id]->AddSourceMigrateDB(batch);
             }
+            for (const auto &split : splits) {
+                thread_id = (thread_id + 1) % worker->db_migration_threads_.size();
+                worker->db_migration_threads_[thread_id]->AddSplit(split.first, split.second);
+            }
+            for (const auto &merge : merges) {
+                thread_id = (thread_id + 1) % worker->db_migration_threads_.size();
+                worker->db_migration_threads_[thread_id]->AddMerge(merge.first, merge.second);
+            }
             if (!removed_stocs.empty()) {
                 NOVA_ASSERT(removed_stocs.size() == 1);
                 for (int fragid = 0; fragid < NovaConfig::config->cfgs[new_cfg_id]->fragments.size(); fragid++) {
@@ -362,6 +504,93 @@ namespace nova {
         return true;
     }
 
+    bool
+    process_socket_load_stats_request(int fd, Connection *conn) {
+        NICClientReqWorker *worker = (NICClientReqWorker *) conn->worker;
+        // CPU time of this process in clock ticks.
+        uint64_t cpu_ticks = 0;
+        FILE *stat = fopen("/proc/self/stat", "r");
+        if (stat) {
+            unsigned long utime = 0;
+            unsigned long stime = 0;
+            if (fscanf(stat, "%*d %*s %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime,
+                       &stime) == 2) {
+                cpu_ticks = utime + stime;
+            }
+            fclose(stat);
+        }
+        std::string response = fmt::format("{},{},{}", cpu_ticks, sysconf(_SC_CLK_TCK),
+                                           sysconf(_SC_NPROCESSORS_ONLN));
+        Configuration *cfg = NovaConfig::config->cfgs[NovaConfig::config->current_cfg_id];
+        for (auto frag : cfg->fragments) {
+            auto db = reinterpret_cast<leveldb::DB *>(frag->db);
+            if (!db || frag->ltc_server_id != NovaConfig::config->my_server_id) {
+                continue;
+            }
+            uint64_t requests = db->number_of_gets_ + db->number_of_puts_no_wait_ + db->number_of_puts_wait_ +
+                                db->scan_stats.number_of_scans_;
+            uint64_t stalls = db->number_of_puts_wait_ + db->number_of_puts_delayed_;
+            response += fmt::format(",{}:{}:{}", frag->dbid, requests, stalls);
+            // A split point that halves the recent inserts.
+            std::string median = reinterpret_cast<leveldb::DBImpl *>(frag->db)->MedianKey();
+            if (!median.empty()) {
+                response += ":" + KeySpace::EncodeBoundary(median);
+            }
+        }
+        NOVA_ASSERT(response.size() < NovaConfig::config->max_msg_size);
+        char *response_buf = worker->buf;
+        memcpy(response_buf, response.data(), response.size());
+        response_buf[response.size()] = MSG_TERMINATER_CHAR;
+        conn->response_buf = worker->buf;
+        conn->response_size = response.size() + 1;
+        return true;
+    }
+
+    bool
+    process_socket_add_config_request(int fd, Connection *conn, char *request_buf) {
+        NICClientReqWorker *worker = (NICClientReqWorker *) conn->worker;
+        char *end = request_buf;
+        while (*end != MSG_TERMINATER_CHAR) {
+            end++;
+        }
+        Configuration *cfg = Configuration::Decode(std::string(request_buf, end - request_buf));
+        if (NovaConfig::AddConfiguration(cfg)) {
+            NOVA_LOG(rdmaio::INFO) << fmt::format("Add configuration {}", cfg->DebugString());
+        } else {
+            for (auto frag : cfg->fragments) {
+                delete frag;
+            }
+            delete cfg;
+        }
+        char *response_buf = worker->buf;
+        int len = int_to_str(response_buf, 1);
+        response_buf[len] = MSG_TERMINATER_CHAR;
+        conn->response_buf = worker->buf;
+        conn->response_size = len + 1;
+        return true;
+    }
+
+    bool
+    process_socket_fetch_config_request(int fd, Connection *conn, char *request_buf) {
+        NICClientReqWorker *worker = (NICClientReqWorker *) conn->worker;
+        uint64_t cfg_id = 0;
+        str_to_int(request_buf, &cfg_id);
+        std::string response;
+        {
+            std::lock_guard<std::mutex> l(NovaConfig::config->m);
+            if (cfg_id < NovaConfig::config->cfgs.size()) {
+                response = NovaConfig::config->cfgs[cfg_id]->Encode();
+            }
+        }
+        NOVA_ASSERT(response.size() < NovaConfig::config->max_msg_size);
+        char *response_buf = worker->buf;
+        memcpy(response_buf, response.data(), response.size());
+        response_buf[response.size()] = MSG_TERMINATER_CHAR;
+        conn->response_buf = worker->buf;
+        conn->response_size = response.size() + 1;
+        return true;
+    }
+
     bool
     process_socket_stats_request(int fd, Connection *conn) {
         NOVA_LOG(rdmaio::INFO) << "Obtain stats";
@@ -440,21 +669,17 @@ namespace nova {
                         uint32_t server_cfg_id) {
         NICClientReqWorker *worker = (NICClientReqWorker *) conn->worker;
         worker->stats.nscans++;
-        char *startkey;
-        uint64_t key = 0;
         char *buf = request_buf;
-        startkey = buf;
-        int nkey = str_to_int(buf, &key) - 1;
-        buf += nkey + 1;
+        leveldb::Slice startkey;
+        buf += KeySpace::ParseKey(buf, &startkey);
         uint64_t nrecords;
         buf += str_to_int(buf, &nrecords);
-        std::string skey(startkey, nkey);
         NOVA_LOG(DEBUG)
-            << fmt::format("memstore[{}]: scan fd:{} key:{} nkey:{} nrecords:{}", worker->thread_id_, fd, skey,
-                           nkey, nrecords);
-        uint64_t hv = keyhash(startkey, nkey);
+            << fmt::format("memstore[{}]: scan fd:{} key:{} nkey:{} nrecords:{}", worker->thread_id_, fd,
+                           startkey.ToString(), startkey.size(), nrecords);
+        uint64_t hv = keyhash(startkey.data(), startkey.size());
         auto cfg = NovaConfig::config->cfgs[server_cfg_id];
-        LTCFragment *frag = NovaConfig::home_fragment(hv, server_cfg_id);
+        LTCFragment *frag = NovaConfig::home_fragment(startkey, server_cfg_id);
         NOVA_ASSERT(frag) << fmt::format("cfg:{} key:{}", server_cfg_id, hv);
 
         leveldb::ReadOptions read_options;
@@ -464,9 +689,14 @@ namespace nova {
         read_options.rdma_backing_mem = worker->rdma_backing_mem;
         read_options.rdma_backing_mem_size = worker->rdma_backing_mem_size;
         read_options.cfg_id = server_cfg_id;
-        int pivot_db_id = frag->dbid;
+        // Ranges appended by splits are out of order in cfg->fragments.
+        int pivot = 0;
+        while (cfg->sorted_fragments[pivot] != frag) {
+            pivot++;
+        }
         int read_records = 0;
-        uint64_t prior_last_key = -1;
+        bool is_first_range = true;
+        std::string prior_last_key;
         uint64_t scan_size = 0;
 
         conn->response_buf = worker->buf;
@@ -475,14 +705,17 @@ namespace nova {
         response_buf += cfg_size;
         scan_size += cfg_size;
 
-        while (read_records < nrecords && pivot_db_id < cfg->fragments.size()) {
-            frag = cfg->fragments[pivot_db_id];
-            if (prior_last_key != -1 && prior_last_key != frag->range.key_start) {
+        while (read_records < nrecords && pivot < cfg->sorted_fragments.size()) {
+            frag = cfg->sorted_fragments[pivot];
+            if (!is_first_range && KeySpace::Compare(prior_last_key, frag->range.key_start) != 0) {
                 break;
             }
             if (frag->ltc_server_id != NovaConfig::config->my_server_id) {
                 break;
             }
+            if (read_records > 0 && is_handed_off(frag, server_cfg_id)) {
+                break;
+            }
 
             if (!frag->is_ready_) {
                 frag->is_ready_mutex_.Lock();
@@ -526,13 +759,22 @@ namespace nova {
 //                read_records++;
 //
 //                prior_last_key = frag->range.key_end;
-//                pivot_db_id += 1;
+//                pivot += 1;
 //                continue;
 //            }
             leveldb::Iterator *iterator = db->NewIterator(read_options);
-            iterator->Seek(startkey);
+            if (is_first_range) {
+                iterator->Seek(startkey);
+            } else {
+                iterator->Seek(frag->range.key_start);
+            }
             while (iterator->Valid() && read_records < nrecords) {
                 leveldb::Slice key = iterator->key();
+                // Tables shared with a split may contain keys after the
+                // range. The next range serves them.
+                if (KeySpace::CompareEnd(key, frag->range) >= 0) {
+                    break;
+                }
                 leveldb::Slice value = iterator->value();
                 scan_size += nint_to_str(key.size()) + 1;
                 scan_size += key.size();
@@ -549,10 +791,11 @@ namespace nova {
 //                NOVA_LOG(rdmaio::INFO) << fmt::format("Getting key {}", key.ToString());
                 iterator->Next();
             }
-//            NOVA_LOG(rdmaio::INFO) << fmt::format("Go to next range partition {}", pivot_db_id + 1);
+//            NOVA_LOG(rdmaio::INFO) << fmt::format("Go to next range partition {}", pivot + 1);
             delete iterator;
+            is_first_range = false;
             prior_last_key = frag->range.key_end;
-            pivot_db_id += 1;
+            pivot += 1;
         }
 
         NOVA_LOG(rdmaio::DEBUG) << fmt::format("Scan size:{}", scan_size);
@@ -571,17 +814,13 @@ namespace nova {
         NICClientReqWorker *worker = (NICClientReqWorker *) conn->worker;
         worker->stats.nputs++;
         char *buf = request_buf;
-        char *ckey;
-        uint64_t key = 0;
-        ckey = buf;
-        int nkey = str_to_int(buf, &key) - 1;
-        buf += nkey + 1;
+        leveldb::Slice dbkey;
+        buf += KeySpace::ParseKey(buf, &dbkey);
         uint64_t nval;
         buf += str_to_int(buf, &nval);
         char *val = buf;
-        uint64_t hv = keyhash(ckey, nkey);
+        uint64_t hv = keyhash(dbkey.data(), dbkey.size());
         // I'm the home.
-        leveldb::Slice dbkey(ckey, nkey);
         leveldb::Slice dbval(val, nval);
 
         worker->ResetReplicateState();
@@ -591,13 +830,13 @@ namespace nova {
         option.local_write = false;
         option.thread_id = worker->thread_id_;
         option.rand_seed = &worker->rand_seed;
-        option.hash = key;
+        option.hash = hv;
         option.total_writes = total_writes.fetch_add(1, std::memory_order_relaxed) + 1;
         option.replicate_log_record_states = worker->replicate_log_record_states;
         option.rdma_backing_mem = worker->rdma_backing_mem;
         option.rdma_backing_mem_size = worker->rdma_backing_mem_size;
         option.is_loading_db = false;
-        LTCFragment *frag = NovaConfig::home_fragment(hv, server_cfg_id);
+        LTCFragment *frag = NovaConfig::home_fragment(dbkey, server_cfg_id);
         NOVA_ASSERT(frag) << fmt::format("cfg:{} key:{}", server_cfg_id, hv);
 
         if (!frag->is_ready_) {
@@ -607,12 +846,16 @@ namespace nova {
             }
             frag->is_ready_mutex_.Unlock();
         }
+        if (!begin_write(frag, server_cfg_id)) {
+            return respond_cfg_id(conn, NovaConfig::config->current_cfg_id);
+        }
 
         leveldb::DB *db = reinterpret_cast<leveldb::DB *>(frag->db);
         NOVA_ASSERT(db) << fmt::format("cfg:{} key:{}", server_cfg_id, hv);
 
         leveldb::Status status = db->Put(option, dbkey, dbval);
         NOVA_ASSERT(status.ok()) << status.ToString();
+        end_write(frag);
 
         char *response_buf = worker->buf;
         uint32_t response_size = 0;
@@ -636,14 +879,11 @@ namespace nova {
             msg_type == RequestType::PUT) {
             uint64_t client_cfg_id = 0;
             request_buf += str_to_int(request_buf, &client_cfg_id);
+            if (NovaConfig::config->ltc_migration_policy == LTCMigrationPolicy::LIVE) {
+                server_cfg_id = live_migration_cfg_id(request_buf, client_cfg_id, server_cfg_id);
+            }
             if (client_cfg_id != server_cfg_id) {
-                char *response_buf = worker->buf;
-                int len = int_to_str(response_buf, server_cfg_id);
-                response_buf += len;
-                response_buf[0] = MSG_TERMINATER_CHAR;
-                conn->response_buf = worker->buf;
-                conn->response_size = len + 1;
-                return true;
+                return respond_cfg_id(conn, server_cfg_id);
             }
         }
         if (msg_type == RequestType::GET) {
@@ -662,6 +902,12 @@ namespace nova {
             return process_socket_change_config_request(fd, conn);
         } else if (msg_type == RequestType::QUERY_CONFIG_CHANGE) {
             return process_socket_query_ready_request(fd, conn);
+        } else if (msg_type == RequestType::LOAD_STATS) {
+            return process_socket_load_stats_request(fd, conn);
+        } else if (msg_type == RequestType::ADD_CONFIG) {
+            return process_socket_add_config_request(fd, conn, request_buf);
+        } else if (msg_type == RequestType::FETCH_CONFIG) {
+            return process_socket_fetch_config_request(fd, conn, request_buf);
         }
         NOVA_ASSERT(false) << msg_type;
         return false;
@@ -71,8 +71,10 @@ namespace nova {
             NOVA_LOG(INFO) << fmt::format("t[{}] Insert range {} to {}", tid_,
                                           frags[i]->range.key_start,
                                           frags[i]->range.key_end);
-            for (uint64_t j = frags[i]->range.key_end - 1;
-                 j >= frags[i]->range.key_start; j--) {
+            // Loading assumes integer keys.
+            uint64_t key_start = std::stoull(frags[i]->range.key_start);
+            uint64_t key_end = std::stoull(frags[i]->range.key_end);
+            for (uint64_t j = key_end - 1; j >= key_start; j--) {
                 auto v = static_cast<char>((j % 10) + 'a');
 
                 std::string key(std::to_string(j));
@@ -105,7 +107,7 @@ namespace nova {
                                        (now.tv_sec - start.tv_sec));
                 }
 
-                if (j == frags[i]->range.key_start) {
+                if (j == key_start) {
                     break;
                 }
             }
@@ -171,8 +173,9 @@ namespace nova {
                                           frags[i]->range.key_start,
                                           frags[i]->range.key_end);
 
-            for (uint64_t j = frags[i]->range.key_end - 1;
-                 j >= frags[i]->range.key_start; j--) {
+            uint64_t key_start = std::stoull(frags[i]->range.key_start);
+            uint64_t key_end = std::stoull(frags[i]->range.key_end);
+            for (uint64_t j = key_end - 1; j >= key_start; j--) {
                 auto v = static_cast<char>((j % 10) + 'a');
                 std::string key = std::to_string(j);
                 std::string expected_val(
@@ -187,7 +190,7 @@ namespace nova {
                     << fmt::format("key:{} status:{}", key, status.ToString());
                 NOVA_ASSERT(expected_val.compare(value) == 0) << value;
 
-                if (j == frags[i]->range.key_start) {
+                if (j == key_start) {
                     break;
                 }
             }
@@ -293,15 +296,27 @@ namespace nova {
                                          NovaConfig::config->mem_pool_size_gb,
                                          slab_size_mb);
         log_manager = new StoCInMemoryLogFileManager(mem_manager);
+        if (NovaConfig::config->memtable_arena_pool_mb > 0) {
+            leveldb::ArenaChunkPool::pool = new leveldb::ArenaChunkPool(
+                    NovaConfig::config->memtable_arena_pool_mb * 1024 * 1024);
+        }
         NovaConfig::config->add_tid_mapping();
         int bg_thread_id = 0;
+        if (NovaConfig::config->enable_compaction_scheduler) {
+            compaction_scheduler_ = new leveldb::LTCCompactionScheduler(
+                    NovaConfig::config->compaction_scheduler_urgent_stall_risk);
+        }
         for (int i = 0; i < NovaConfig::config->num_compaction_workers; i++) {
             {
                 auto bg = new leveldb::LTCCompactionThread(mem_manager);
+                bg->scheduler_ = compaction_scheduler_;
+                bg->pool_ = leveldb::LTCBackgroundPool::kFlushMemTablePool;
                 bg_flush_memtable_threads.push_back(bg);
             }
             {
                 auto bg = new leveldb::LTCCompactionThread(mem_manager);
+                bg->scheduler_ = compaction_scheduler_;
+                bg->pool_ = leveldb::LTCBackgroundPool::kCompactionPool;
                 bg_compaction_threads.push_back(bg);
             }
         }
@@ -321,16 +336,27 @@ namespace nova {
         }
         leveldb::MemTablePool *pool = new leveldb::MemTablePool;
         pool->num_available_memtables_ = NovaConfig::config->num_memtables;
-        pool->range_cond_vars_ = new leveldb::port::CondVar *[cfg->fragments.size()];
+        pool->capacity_ = NovaConfig::config->num_memtables;
+        pool->range_cond_vars_ = new leveldb::port::CondVar *[NovaConfig::config->max_num_ranges]();
 
         leveldb::EnvOptions env_option;
         env_option.sstable_mode = leveldb::NovaSSTableMode::SSTABLE_DISK;
         leveldb::PosixEnv *env = new leveldb::PosixEnv;
         env->set_env_option(env_option);
 
+        leveldb::Cache *stoc_block_cache = nullptr;
+        if (NovaConfig::config->stoc_block_cache_mb > 0) {
+            stoc_block_cache = leveldb::NewLRUCache(
+                    NovaConfig::config->stoc_block_cache_mb * 1024 * 1024);
+            NOVA_LOG(INFO)
+                << fmt::format("StoC block cache size {}. Configured size {} MB",
+                               stoc_block_cache->TotalCapacity(),
+                               NovaConfig::config->stoc_block_cache_mb);
+        }
         leveldb::StocPersistentFileManager *stoc_file_manager = new leveldb::StocPersistentFileManager(env, mem_manager,
                                                                                                        NovaConfig::config->stoc_files_path,
-                                                                                                       NovaConfig::config->max_stoc_file_size);
+                                                                                                       NovaConfig::config->max_stoc_file_size,
+                                                                                                       stoc_block_cache);
         std::vector<nova::RDMAMsgCallback *> rdma_threads;
         for (int db_index = 0; db_index < cfg->fragments.size(); db_index++) {
             if (NovaConfig::config->cfgs[0]->fragments[db_index]->ltc_server_id != NovaConfig::config->my_server_id) {
@@ -342,10 +368,25 @@ namespace nova {
             auto client = new leveldb::StoCBlockClient(db_index, stoc_file_manager);
             dbs_.push_back(CreateDatabase(0, db_index, block_cache, pool, mem_manager, client, bg_compaction_threads,
                                           bg_flush_memtable_threads, reorg, coord));
+            if (compaction_scheduler_) {
+                uint32_t weight = 1;
+                if (db_index < NovaConfig::config->compaction_scheduler_weights.size()) {
+                    weight = NovaConfig::config->compaction_scheduler_weights[db_index];
+                }
+                compaction_scheduler_->RegisterDB(dbs_[db_index], weight);
+            }
         }
         for (int db_index = 0; db_index < cfg->fragments.size(); db_index++) {
             NovaConfig::config->cfgs[0]->fragments[db_index]->db = dbs_[db_index];
         }
+        if (NovaConfig::config->ltc_memory_budget_mb > 0) {
+            memory_governor_ = new MemoryGovernor(
+                    NovaConfig::config->ltc_memory_budget_mb * 1024 * 1024,
+                    NovaConfig::config->memtable_size_mb * 1024 * 1024,
+                    block_cache, pool,
+                    NovaConfig::config->memtable_type == "pool",
+                    mem_manager, nrdma_buf_server());
+        }
 
         // Assign request id space so that they won't conflict.
         int worker_id = 0;
@@ -422,6 +463,7 @@ namespace nova {
             rdma_msg_handler->rdma_broker_ = broker;
             rdma_msg_handler->stoc_client_ = stoc_client;
             rdma_msg_handler->rdma_log_writer_ = log_writer;
+            rdma_msg_handler->fill_log_buf_pools_ = true;
             rdma_msg_handler->rdma_server_ = rdma_server;
 
             buf += nrdma_buf_unit() * NovaConfig::config->servers.size();
@@ -543,7 +585,7 @@ namespace nova {
         mem_env_option.sstable_mode = leveldb::NovaSSTableMode::SSTABLE_MEM;
         leveldb::PosixEnv *mem_env = new leveldb::PosixEnv;
         mem_env->set_env_option(mem_env_option);
-        auto user_comparator = new leveldb::YCSBKeyComparator();
+        auto user_comparator = leveldb::NewKeyComparator();
         leveldb::Options storage_options = BuildStorageOptions(mem_manager,
                                                                mem_env);
         storage_options.comparator = new leveldb::InternalKeyComparator(
@@ -588,6 +630,22 @@ namespace nova {
             compaction_storage_workers.push_back(worker);
         }
 
+        if (NovaConfig::config->stoc_qos_max_outstanding > 0) {
+            stoc_io_scheduler = new leveldb::StoCIOScheduler(
+                    NovaConfig::config->stoc_qos_max_outstanding,
+                    NovaConfig::config->stoc_qos_weights,
+                    NovaConfig::config->stoc_qos_rate_limits);
+            for (auto worker : fg_storage_workers) {
+                worker->io_scheduler_ = stoc_io_scheduler;
+            }
+            for (auto worker : bg_storage_workers) {
+                worker->io_scheduler_ = stoc_io_scheduler;
+            }
+            for (auto worker : compaction_storage_workers) {
+                worker->io_scheduler_ = stoc_io_scheduler;
+            }
+        }
+
         // Assign workers to ltc servers.
         for (int i = 0; i < rdma_servers.size(); i++) {
             rdma_servers[i]->fg_storage_workers_ = fg_storage_workers;
@@ -656,6 +714,12 @@ namespace nova {
             db_migrate_workers.emplace_back(&leveldb::LSMTreeCleaner::CleanLSMAfterCfgChange, lsm_tree_cleaner_);
         }
 
+        if (NovaConfig::config->ltc_stoc_rebalance_interval_sec > 0 && NovaConfig::config->cfgs[0]->IsLTC()) {
+            auto client = new leveldb::StoCBlockClient(0, stoc_file_manager);
+            client->rdma_msg_handlers_ = bg_rdma_msg_handlers;
+            stoc_rebalancer_ = new StoCRebalancer(client);
+        }
+
         // Wait for all RDMA connections to setup.
         bool all_initialized = false;
         while (!all_initialized) {
@@ -701,6 +765,19 @@ namespace nova {
             }
             auto db = reinterpret_cast<leveldb::DBImpl *>(dbs_[db_index]);
             db->log_manager_ = log_manager;
+            if (NovaConfig::config->log_record_mode == NovaLogRecordMode::LOG_LOCAL_DISK) {
+                leveldb::StoCIOEngine *engine = leveldb::StoCIOEngine::NewEngine(
+                        NovaConfig::config->local_log_io_engine,
+                        NovaConfig::config->stoc_io_queue_depth,
+                        NovaConfig::config->stoc_io_threads, nullptr, 0,
+                        []() {});
+                NOVA_ASSERT(engine) << NovaConfig::config->local_log_io_engine;
+                db->local_log_ = new leveldb::DiskLogWriter(
+                        NovaConfig::config->local_log_path, db_index, engine);
+                if (!NovaConfig::config->recover_dbs) {
+                    db->local_log_->DeleteOldLogFiles();
+                }
+            }
             auto client = reinterpret_cast<leveldb::StoCBlockClient *>(db->options_.stoc_client);
             client->rdma_msg_handlers_ = bg_rdma_msg_handlers;
         }
@@ -727,6 +804,8 @@ namespace nova {
             db->processed_writes_ = 0;
             db->number_of_puts_no_wait_ = 0;
             db->number_of_puts_wait_ = 0;
+            db->number_of_puts_delayed_ = 0;
+            db->write_delay_us_ = 0;
             db->number_of_steals_ = 0;
             db->number_of_wait_due_to_contention_ = 0;
             db->number_of_gets_ = 0;
@@ -738,11 +817,33 @@ namespace nova {
         stat_thread_->bg_storage_workers_ = bg_storage_workers;
         stat_thread_->fg_storage_workers_ = fg_storage_workers;
         stat_thread_->compaction_storage_workers_ = compaction_storage_workers;
+        stat_thread_->stoc_io_scheduler_ = stoc_io_scheduler;
+        stat_thread_->mem_manager_ = mem_manager;
+        stat_thread_->memory_governor_ = memory_governor_;
+        stat_thread_->stoc_rebalancer_ = stoc_rebalancer_;
         stat_thread_->bgs_ = bg_flush_memtable_threads;
+        stat_thread_->compaction_scheduler_ = compaction_scheduler_;
 
         stat_thread_->async_workers_ = fg_rdma_msg_handlers;
         stat_thread_->async_compaction_workers_ = bg_rdma_msg_handlers;
         stats_t_.emplace_back(std::thread(&NovaStatThread::Start, stat_thread_));
+        if (memory_governor_) {
+            stats_t_.emplace_back(std::thread(&MemoryGovernor::Start, memory_governor_));
+        }
+        if (NovaConfig::config->mem_rebalance_interval_sec > 0) {
+            stats_t_.emplace_back(std::thread(&NovaMemManager::StartRebalancer, mem_manager,
+                                              NovaConfig::config->mem_rebalance_interval_sec));
+        }
+        if (NovaConfig::config->ltc_rebalance_interval_sec > 0 &&
+            NovaConfig::config->cfgs[0]->ltc_servers[0] == NovaConfig::config->my_server_id) {
+            NOVA_ASSERT(NovaConfig::config->log_record_mode != NovaLogRecordMode::LOG_LOCAL_DISK)
+                << "Cannot rebalance ranges with local disk logs";
+            range_rebalancer_ = new RangeRebalancer;
+            stats_t_.emplace_back(std::thread(&RangeRebalancer::Start, range_rebalancer_));
+        }
+        if (stoc_rebalancer_) {
+            stats_t_.emplace_back(std::thread(&StoCRebalancer::Start, stoc_rebalancer_));
+        }
 
         NovaGlobalVariables::global.is_ready_to_process_requests = true;
         {
@@ -19,6 +19,8 @@
 #include "ltc/compaction_thread.h"
 #include "ltc/stat_thread.h"
 #include "ltc/db_migration.h"
+#include "ltc/range_rebalancer.h"
+#include "ltc/stoc_rebalancer.h"
 #include "lsm_tree_cleaner.h"
 
 namespace nova {
@@ -71,11 +73,16 @@ namespace nova {
         std::vector<StorageWorker *> fg_storage_workers;
         std::vector<StorageWorker *> bg_storage_workers;
         std::vector<StorageWorker *> compaction_storage_workers;
+        leveldb::StoCIOScheduler *stoc_io_scheduler = nullptr;
         std::vector<leveldb::EnvBGThread *> bg_compaction_threads;
         std::vector<leveldb::EnvBGThread *> bg_flush_memtable_threads;
         std::vector<DBMigration *> db_migration_threads;
+        leveldb::LTCCompactionScheduler *compaction_scheduler_ = nullptr;
 
         NovaStatThread *stat_thread_;
+        MemoryGovernor *memory_governor_ = nullptr;
+        RangeRebalancer *range_rebalancer_ = nullptr;
+        StoCRebalancer *stoc_rebalancer_ = nullptr;
 
         vector<std::thread> stats_t_;
         struct event_base *base;
@@ -33,6 +33,8 @@ DEFINE_int64(server_id, -1, "Server id.");
 DEFINE_int64(number_of_ltcs, 0, "The first n are LTCs and the rest are StoCs.");
 
 DEFINE_uint64(mem_pool_size_gb, 0, "Memory pool size in GB.");
+DEFINE_uint32(mem_rebalance_interval_sec, 10,
+              "Interval to return slabs whose items are all free to the memory pool. 0 disables it.");
 DEFINE_uint64(use_fixed_value_size, 0, "Fixed value size.");
 
 DEFINE_uint64(rdma_port, 0, "The port used by RDMA.");
@@ -45,6 +47,8 @@ DEFINE_bool(enable_load_data, false, "Enable loading data.");
 
 DEFINE_string(ltc_config_path, "/tmp/uniform-3-32-10000000-frags.txt",
               "The path that stores the configuration.");
+DEFINE_string(key_type, "int",
+              "int/bytes. int keys are decimal strings ordered by their values. bytes keys are byte strings ordered bytewise. Range boundaries in the configuration are hex encoded for bytes keys.");
 DEFINE_uint64(ltc_num_client_workers, 0, "Number of client worker threads.");
 DEFINE_uint32(num_rdma_fg_workers, 0,
               "Number of RDMA foreground worker threads.");
@@ -59,6 +63,7 @@ DEFINE_uint32(ltc_num_stocs_scatter_data_blocks, 0,
               "Number of StoCs to scatter data blocks of an SSTable.");
 
 DEFINE_uint64(block_cache_mb, 0, "block cache size in mb");
+DEFINE_uint64(stoc_block_cache_mb, 0, "StoC block cache size in mb");
 DEFINE_uint64(row_cache_mb, 0, "row cache size in mb. Not supported");
 
 DEFINE_uint32(num_memtables, 0, "Number of memtables.");
@@ -70,29 +75,94 @@ DEFINE_bool(enable_range_index, false, "Enable range index.");
 DEFINE_uint32(l0_start_compaction_mb, 0,
               "Level-0 size to start compaction in MB.");
 DEFINE_uint32(l0_stop_write_mb, 0, "Level-0 size to stall writes in MB.");
+DEFINE_uint32(l0_slowdown_write_mb, 0, "Level-0 size to start delaying writes in MB. 0 disables it.");
+DEFINE_uint32(pending_compaction_slowdown_write_mb, 0,
+              "Pending compaction bytes to start delaying writes in MB. 0 disables it.");
+DEFINE_uint32(pending_compaction_stop_write_mb, 0,
+              "Pending compaction bytes at which writes are delayed at the minimum rate in MB.");
+DEFINE_uint32(num_imms_slowdown_write, 0,
+              "Number of immutable memtables to start delaying writes. 0 disables it.");
+DEFINE_uint32(delayed_write_rate_mb, 16, "The write rate in MB/s when writes start to be delayed.");
 DEFINE_int32(level, 2, "Number of levels.");
+DEFINE_bool(enable_compaction_scheduler, false,
+            "Schedule flushes and compactions of all fragments with a process-wide scheduler.");
+DEFINE_double(compaction_scheduler_urgent_stall_risk, 0.8,
+              "Serve a fragment first when its stall risk exceeds this threshold.");
+DEFINE_string(compaction_scheduler_weights, "",
+              "Comma-separated fairness weights of fragments. Default is 1.");
+DEFINE_string(compaction_styles, "leveled",
+              "Comma-separated compaction styles of fragments: leveled/tiered. The last style applies to the remaining fragments.");
+DEFINE_uint32(tiered_max_sorted_runs, 8,
+              "Tiered compaction merges sorted runs once level-0 has this many sorted runs.");
+DEFINE_uint32(tiered_size_ratio, 20,
+              "Tiered compaction merges a sorted run if it is at most this percent larger than the newer sorted runs.");
+DEFINE_uint32(tiered_min_merge_width, 2,
+              "Minimum number of sorted runs to merge in tiered compaction.");
+DEFINE_bool(enable_dynamic_level_bytes, false,
+            "Derive the target sizes of levels from the size of the last level.");
+DEFINE_uint32(bloom_bits_per_key, 10, "Bloom filter bits per key.");
+DEFINE_string(filter_type, "bloom",
+              "bloom/blocked_bloom/ribbon. A ribbon filter has the false positive rate of a bloom filter with bloom_bits_per_key.");
+DEFINE_bool(enable_whole_table_filter, false,
+            "Build one filter per SSTable instead of one filter every 2KB of data. Always true for ribbon filters.");
+DEFINE_bool(enable_monkey_bloom_filter, false,
+            "Give upper levels more bloom filter bits per key. The average is bloom_bits_per_key.");
 
 DEFINE_uint64(memtable_size_mb, 0, "memtable size in mb");
+DEFINE_uint64(memtable_arena_pool_mb, 0,
+              "Allocate memtables from a pool of 2 MB huge-page chunks that keeps up to this many MB of free chunks for reuse. 0 allocates memtables from the heap.");
+DEFINE_uint64(ltc_memory_budget_mb, 0,
+              "Memory budget of an LTC shared by memtables and the block cache. It shifts memory between them based on the workload and delays writes when the LTC exceeds it. 0 disables it.");
 DEFINE_uint64(sstable_size_mb, 0, "sstable size in mb");
 DEFINE_uint32(cc_log_buf_size, 0,
               "log buffer size. Not supported. Same as memtable size.");
 DEFINE_uint32(max_stoc_file_size_mb, 0, "Max StoC file size in MB");
+DEFINE_string(stoc_io_engine, "sync",
+              "Disk engine of StoC storage workers: sync/io_uring/threadpool. io_uring falls back to threadpool if the kernel does not support it.");
+DEFINE_uint32(stoc_io_queue_depth, 64, "Maximum number of disk reads in flight per StoC storage worker.");
+DEFINE_uint32(stoc_io_threads, 4,
+              "Number of threads per StoC storage worker that persist StoC files and serve reads of the threadpool engine.");
+DEFINE_bool(stoc_io_direct, false, "Read aligned blocks of StoC files with O_DIRECT.");
+DEFINE_uint32(stoc_group_commit_window_us, 0,
+              "Time a persist request of a StoC file waits for concurrent requests to share its write and sync.");
+DEFINE_uint32(stoc_replication_window_mb, 64,
+              "Maximum bytes in MB a StoC storage worker reads ahead while replicating SSTables to other StoCs.");
+DEFINE_uint32(stoc_replication_rate_mb, 0,
+              "Maximum replication throughput in MB/s of a StoC storage worker. 0 means unlimited.");
+DEFINE_uint32(stoc_qos_max_outstanding, 0,
+              "Maximum number of disk I/Os a StoC issues at a time. 0 disables the StoC I/O scheduler.");
+DEFINE_string(stoc_qos_weights, "16,8,4,2,1",
+              "Weights of foreground reads, log, flush, compaction and replication I/Os at a StoC.");
+DEFINE_string(stoc_qos_rate_limits_mb, "0,0,0,0,0",
+              "Rate limits in MB/s of foreground reads, log, flush, compaction and replication I/Os at a StoC. 0 means unlimited.");
 DEFINE_bool(use_local_disk, false,
             "Enable LTC to write data to its local disk.");
 DEFINE_string(scatter_policy, "random",
               "Policy to scatter an SSTable, i.e., random/power_of_two");
 DEFINE_string(log_record_mode, "none",
-              "Policy for LogC to replicate log records, i.e., none/rdma");
+              "Policy for LogC to replicate log records, i.e., none/rdma/local_disk");
+DEFINE_string(local_log_path, "",
+              "Directory of the log files in local_disk log record mode. Default is db_path/log.");
+DEFINE_string(local_log_io_engine, "io_uring",
+              "Engine to write local log files, i.e., io_uring/threadpool. It uses stoc_io_queue_depth and stoc_io_threads.");
 DEFINE_uint32(num_log_replicas, 0, "Number of replicas for a log record.");
+DEFINE_uint32(log_write_quorum, 0,
+              "Number of log replicas that must acknowledge a log record before a write returns. 0 waits for all replicas.");
+DEFINE_uint32(log_buf_pool_size, 0,
+              "Number of log buffers each LTC thread preallocates at each StoC so that a new log file starts without a round trip. 0 disables it.");
 DEFINE_string(memtable_type, "", "Memtable type, i.e., pool/static_partition");
 
 DEFINE_bool(recover_dbs, false, "Enable recovery");
 DEFINE_uint32(num_recovery_threads, 32, "Number of recovery threads");
+DEFINE_uint32(log_recovery_read_kb, 64,
+              "Size of an RDMA READ that fetches a log file during recovery. Recovery fetches a log file in reads of this size until it reaches the end of its log records.");
 
 DEFINE_bool(enable_subrange, false, "Enable subranges");
 DEFINE_bool(enable_subrange_reorg, false, "Enable subrange reorganization.");
 DEFINE_double(sampling_ratio, 1,
               "Sampling ratio on memtables for subrange reorg. A value between 0 and 1.");
+DEFINE_uint32(subrange_sketch_size, 256,
+              "Number of keys per level of the streaming key sketch of each subrange. Subrange reorg computes new boundaries from the sketches. 0 samples memtables instead.");
 DEFINE_string(zipfian_dist_ref_counts, "/tmp/zipfian",
               "Zipfian ref count file used to report load imbalance across subranges.");
 DEFINE_string(client_access_pattern, "uniform",
@@ -122,7 +192,23 @@ DEFINE_int32(exp_seconds_to_fail_stoc, -1,
              "Number of seconds elapsed to fail the stoc.");
 DEFINE_int32(failure_duration, -1, "Failure duration");
 DEFINE_int32(num_migration_threads, 1, "Number of migration threads");
-DEFINE_string(ltc_migration_policy, "base", "immediate/base");
+DEFINE_string(ltc_migration_policy, "base", "immediate/live/base");
+DEFINE_uint32(ltc_migration_warm_blocks, 100000,
+              "Maximum number of hot data blocks of a range that the destination of a migration prefetches. 0 disables warming the caches.");
+DEFINE_uint32(ltc_rebalance_interval_sec, 0,
+              "Interval of the range rebalancer on the first LTC. 0 disables the rebalancer.");
+DEFINE_uint32(ltc_rebalance_max_moves, 2, "Maximum number of ranges moved by one configuration change.");
+DEFINE_double(ltc_rebalance_imbalance, 1.2,
+              "Rebalance when the most loaded LTC exceeds the average load by this ratio.");
+DEFINE_uint32(ltc_max_num_ranges, 0,
+              "Maximum number of ranges including the ones created by splits. It is at least the number of ranges in the configuration file.");
+DEFINE_uint32(ltc_stoc_rebalance_interval_sec, 0,
+              "Interval of the StoC rebalancer that moves SSTable replicas to underutilized StoCs. 0 disables the rebalancer.");
+DEFINE_uint64(ltc_stoc_rebalance_max_mb, 64, "Maximum size of the SSTable replicas moved in one interval.");
+DEFINE_double(ltc_stoc_rebalance_imbalance, 1.1,
+              "Move SSTable replicas away from a StoC that stores more than the average bytes by this ratio.");
+DEFINE_uint64(ltc_stoc_rebalance_rate_mb, 0,
+              "Rate in MB/s of moving SSTable replicas to underutilized StoCs. 0 does not limit the rate.");
 DEFINE_bool(use_ordered_flush, false, "use ordered flush");
 
 NovaConfig *NovaConfig::config;
@@ -134,7 +220,6 @@ std::atomic_int_fast32_t leveldb::EnvBGThread::bg_compaction_thread_id_seq;
 std::atomic_int_fast32_t nova::RDMAServerImpl::fg_storage_worker_seq_id_;
 std::atomic_int_fast32_t nova::RDMAServerImpl::bg_storage_worker_seq_id_;
 std::atomic_int_fast32_t leveldb::StoCBlockClient::rdma_worker_seq_id_;
-std::atomic_int_fast32_t nova::DBMigration::migration_seq_id_;
 std::atomic_int_fast32_t leveldb::StorageSelector::stoc_for_compaction_seq_id;
 
 std::unordered_map<uint64_t, leveldb::FileMetaData *> leveldb::Version::last_fnfile;
@@ -194,6 +279,7 @@ int main(int argc, char *argv[]) {
     NovaConfig::config->stoc_files_path = FLAGS_stoc_files_path;
 
     NovaConfig::config->mem_pool_size_gb = FLAGS_mem_pool_size_gb;
+    NovaConfig::config->mem_rebalance_interval_sec = FLAGS_mem_rebalance_interval_sec;
     NovaConfig::config->load_default_value_size = FLAGS_use_fixed_value_size;
     // RDMA
     NovaConfig::config->rdma_port = FLAGS_rdma_port;
@@ -202,7 +288,10 @@ int main(int argc, char *argv[]) {
     NovaConfig::config->rdma_doorbell_batch_size = FLAGS_rdma_doorbell_batch_size;
 
     NovaConfig::config->block_cache_mb = FLAGS_block_cache_mb;
+    NovaConfig::config->stoc_block_cache_mb = FLAGS_stoc_block_cache_mb;
     NovaConfig::config->memtable_size_mb = FLAGS_memtable_size_mb;
+    NovaConfig::config->memtable_arena_pool_mb = FLAGS_memtable_arena_pool_mb;
+    NovaConfig::config->ltc_memory_budget_mb = FLAGS_ltc_memory_budget_mb;
 
     NovaConfig::config->db_path = FLAGS_db_path;
     NovaConfig::config->enable_rdma = FLAGS_enable_rdma;
@@ -213,6 +302,7 @@ int main(int argc, char *argv[]) {
     NovaConfig::config->major_compaction_max_tables_in_a_set = FLAGS_major_compaction_max_tables_in_a_set;
 
     NovaConfig::config->number_of_recovery_threads = FLAGS_num_recovery_threads;
+    NovaConfig::config->log_recovery_read_size = (uint64_t) FLAGS_log_recovery_read_kb * 1024;
     NovaConfig::config->recover_dbs = FLAGS_recover_dbs;
     NovaConfig::config->number_of_sstable_data_replicas = FLAGS_num_sstable_replicas;
     NovaConfig::config->number_of_sstable_metadata_replicas = FLAGS_num_sstable_metadata_replicas;
@@ -255,11 +345,19 @@ int main(int argc, char *argv[]) {
         NovaConfig::config->log_record_mode = NovaLogRecordMode::LOG_NONE;
     } else if (FLAGS_log_record_mode == "rdma") {
         NovaConfig::config->log_record_mode = NovaLogRecordMode::LOG_RDMA;
+    } else if (FLAGS_log_record_mode == "local_disk") {
+        NovaConfig::config->log_record_mode = NovaLogRecordMode::LOG_LOCAL_DISK;
     }
+    NovaConfig::config->local_log_path = FLAGS_local_log_path;
+    if (NovaConfig::config->local_log_path.empty()) {
+        NovaConfig::config->local_log_path = FLAGS_db_path + "/log";
+    }
+    NovaConfig::config->local_log_io_engine = FLAGS_local_log_io_engine;
 
     NovaConfig::config->enable_lookup_index = FLAGS_enable_lookup_index;
     NovaConfig::config->enable_range_index = FLAGS_enable_range_index;
     NovaConfig::config->subrange_sampling_ratio = FLAGS_sampling_ratio;
+    NovaConfig::config->subrange_sketch_size = FLAGS_subrange_sketch_size;
     NovaConfig::config->zipfian_dist_file_path = FLAGS_zipfian_dist_ref_counts;
     NovaConfig::config->ReadZipfianDist();
     NovaConfig::config->client_access_pattern = FLAGS_client_access_pattern;
@@ -267,17 +365,74 @@ int main(int argc, char *argv[]) {
     NovaConfig::config->subrange_num_keys_no_flush = FLAGS_subrange_no_flush_num_keys;
     NovaConfig::config->l0_stop_write_mb = FLAGS_l0_stop_write_mb;
     NovaConfig::config->l0_start_compaction_mb = FLAGS_l0_start_compaction_mb;
+    NovaConfig::config->l0_slowdown_write_mb = FLAGS_l0_slowdown_write_mb;
+    NovaConfig::config->pending_compaction_slowdown_write_mb = FLAGS_pending_compaction_slowdown_write_mb;
+    NovaConfig::config->pending_compaction_stop_write_mb = FLAGS_pending_compaction_stop_write_mb;
+    NovaConfig::config->num_imms_slowdown_write = FLAGS_num_imms_slowdown_write;
+    NovaConfig::config->delayed_write_rate_mb = FLAGS_delayed_write_rate_mb;
     NovaConfig::config->level = FLAGS_level;
+    NovaConfig::config->enable_compaction_scheduler = FLAGS_enable_compaction_scheduler;
+    NovaConfig::config->compaction_scheduler_urgent_stall_risk = FLAGS_compaction_scheduler_urgent_stall_risk;
+    if (!FLAGS_compaction_scheduler_weights.empty()) {
+        NovaConfig::config->compaction_scheduler_weights = SplitByDelimiterToInt(&FLAGS_compaction_scheduler_weights,
+                                                                                 ",");
+    }
+    if (!FLAGS_compaction_styles.empty()) {
+        NovaConfig::config->compaction_styles = SplitByDelimiter(&FLAGS_compaction_styles, ",");
+    }
+    NovaConfig::config->tiered_max_sorted_runs = FLAGS_tiered_max_sorted_runs;
+    NovaConfig::config->tiered_size_ratio = FLAGS_tiered_size_ratio;
+    NovaConfig::config->tiered_min_merge_width = FLAGS_tiered_min_merge_width;
+    NovaConfig::config->enable_dynamic_level_bytes = FLAGS_enable_dynamic_level_bytes;
+    NovaConfig::config->bloom_bits_per_key = FLAGS_bloom_bits_per_key;
+    NovaConfig::config->filter_type = FLAGS_filter_type;
+    NovaConfig::config->enable_whole_table_filter = FLAGS_enable_whole_table_filter;
+    NovaConfig::config->enable_monkey_bloom_filter = FLAGS_enable_monkey_bloom_filter;
+    NovaConfig::config->stoc_io_engine = FLAGS_stoc_io_engine;
+    NovaConfig::config->stoc_io_queue_depth = FLAGS_stoc_io_queue_depth;
+    NovaConfig::config->stoc_io_threads = FLAGS_stoc_io_threads;
+    NovaConfig::config->stoc_io_direct = FLAGS_stoc_io_direct;
+    NovaConfig::config->stoc_group_commit_window_us = FLAGS_stoc_group_commit_window_us;
+    NovaConfig::config->stoc_replication_window_mb = FLAGS_stoc_replication_window_mb;
+    NovaConfig::config->stoc_replication_rate_mb = FLAGS_stoc_replication_rate_mb;
+    NovaConfig::config->stoc_qos_max_outstanding = FLAGS_stoc_qos_max_outstanding;
+    NovaConfig::config->log_buf_pool_size = FLAGS_log_buf_pool_size;
+    NOVA_ASSERT(FLAGS_log_write_quorum <= FLAGS_num_log_replicas)
+        << fmt::format("write quorum {} exceeds {} log replicas",
+                       FLAGS_log_write_quorum, FLAGS_num_log_replicas);
+    NovaConfig::config->log_write_quorum = FLAGS_log_write_quorum;
+    NovaConfig::config->stoc_qos_weights = SplitByDelimiterToInt(&FLAGS_stoc_qos_weights, ",");
+    for (auto rate : SplitByDelimiterToInt(&FLAGS_stoc_qos_rate_limits_mb, ",")) {
+        NovaConfig::config->stoc_qos_rate_limits.push_back((uint64_t) rate * 1024 * 1024);
+    }
     NovaConfig::config->enable_subrange_reorg = FLAGS_enable_subrange_reorg;
     NovaConfig::config->num_migration_threads = FLAGS_num_migration_threads;
     NovaConfig::config->use_ordered_flush = FLAGS_use_ordered_flush;
+    NovaConfig::config->ltc_migration_warm_blocks = FLAGS_ltc_migration_warm_blocks;
+    NovaConfig::config->ltc_rebalance_interval_sec = FLAGS_ltc_rebalance_interval_sec;
+    NovaConfig::config->ltc_rebalance_max_moves = FLAGS_ltc_rebalance_max_moves;
+    NovaConfig::config->ltc_rebalance_imbalance = FLAGS_ltc_rebalance_imbalance;
+    NovaConfig::config->max_num_ranges = FLAGS_ltc_max_num_ranges;
+    NovaConfig::config->ltc_stoc_rebalance_interval_sec = FLAGS_ltc_stoc_rebalance_interval_sec;
+    NovaConfig::config->ltc_stoc_rebalance_max_mb = FLAGS_ltc_stoc_rebalance_max_mb;
+    NovaConfig::config->ltc_stoc_rebalance_imbalance = FLAGS_ltc_stoc_rebalance_imbalance;
+    NovaConfig::config->ltc_stoc_rebalance_rate_mb = FLAGS_ltc_stoc_rebalance_rate_mb;
 
     if (FLAGS_ltc_migration_policy == "immediate") {
         NovaConfig::config->ltc_migration_policy = LTCMigrationPolicy::IMMEDIATE;
+    } else if (FLAGS_ltc_migration_policy == "live") {
+        NovaConfig::config->ltc_migration_policy = LTCMigrationPolicy::LIVE;
     } else {
         NovaConfig::config->ltc_migration_policy = LTCMigrationPolicy::PROCESS_UNTIL_MIGRATION_COMPLETE;
     }
 
+    if (FLAGS_key_type == "bytes") {
+        NovaConfig::config->key_type = KeyType::KEY_TYPE_BYTES;
+        // Both assume integer keys.
+        NOVA_ASSERT(!FLAGS_enable_lookup_index && !FLAGS_enable_load_data);
+    } else {
+        NovaConfig::config->key_type = KeyType::KEY_TYPE_INT;
+    }
     NovaConfig::ReadFragments(FLAGS_ltc_config_path);
     if (FLAGS_num_log_replicas > 0) {
         for (int i = 0; i < NovaConfig::config->cfgs.size(); i++) {
@@ -296,7 +451,6 @@ int main(int argc, char *argv[]) {
     leveldb::StoCBlockClient::rdma_worker_seq_id_ = 0;
     nova::StorageWorker::storage_file_number_seq = 0;
     nova::RDMAServerImpl::compaction_storage_worker_seq_id_ = 0;
-    nova::DBMigration::migration_seq_id_ = 0;
     leveldb::StorageSelector::stoc_for_compaction_seq_id = nova::NovaConfig::config->my_server_id;
     nova::NovaGlobalVariables::global.Initialize();
     auto available_stoc_servers = new Servers;
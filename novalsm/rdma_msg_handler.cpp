@@ -65,7 +65,8 @@ namespace nova {
                 task.type == leveldb::RDMA_CLIENT_REQ_LOG_RECORD) {
                 NOVA_ASSERT(task.server_id == -1);
                 // A log record request.
-                nova::LTCFragment *frag = nova::NovaConfig::config->cfgs[0]->fragments[task.dbid];
+                uint32_t cfg_id = nova::NovaConfig::config->current_cfg_id;
+                nova::LTCFragment *frag = nova::NovaConfig::config->cfgs[cfg_id]->fragments[task.dbid];
                 for (int i = 0; i < frag->log_replica_stoc_ids.size(); i++) {
                     uint32_t stoc_server_id = nova::NovaConfig::config->cfgs[0]->stoc_servers[frag->log_replica_stoc_ids[i]];
                     serverids.push_back(stoc_server_id);
@@ -221,6 +222,9 @@ namespace nova {
         mutex_.Lock();
         is_running_ = true;
         mutex_.Unlock();
+        if (fill_log_buf_pools_) {
+            rdma_log_writer_->FillLogBufPools();
+        }
 
         bool should_sleep = true;
         uint32_t timeout = RDMA_POLL_MIN_TIMEOUT_US;
@@ -260,6 +264,7 @@ namespace nova {
                 timeout = RDMA_POLL_MIN_TIMEOUT_US;
             }
         }
+        rdma_log_writer_->Close();
     }
 
     bool
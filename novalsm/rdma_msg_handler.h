@@ -61,6 +61,8 @@ namespace nova {
         leveldb::StoCClient *stoc_client_ = nullptr;
         leveldb::LogCLogWriter *rdma_log_writer_ = nullptr;
         RDMAServerImpl *rdma_server_ = nullptr;
+        // Set for the handlers that replicate log records.
+        bool fill_log_buf_pools_ = false;
         uint64_t thread_id_ = 0;
         std::atomic_int_fast64_t stat_tasks_;
 
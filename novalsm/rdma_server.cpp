@@ -6,6 +6,7 @@
 
 #include <fmt/core.h>
 #include <semaphore.h>
+#include <algorithm>
 #include <db/compaction.h>
 #include <db/table_cache.h>
 
@@ -120,6 +121,22 @@ namespace nova {
                 rdma_broker_->PostSend(send_buf, 1 + 8 + 8,
                                        task.remote_server_id,
                                        task.stoc_req_id);
+            } else if (task.request_type == leveldb::STOC_ALLOCATE_LOG_BUFFERS) {
+                char *send_buf = rdma_broker_->GetSendBuf(
+                        task.remote_server_id);
+                uint32_t msg_size = 1;
+                send_buf[0] = leveldb::StoCRequestType::STOC_ALLOCATE_LOG_BUFFERS_SUCC;
+                msg_size += leveldb::EncodeFixed64(send_buf + msg_size,
+                                                   NovaConfig::config->max_stoc_file_size);
+                msg_size += leveldb::EncodeFixed32(send_buf + msg_size,
+                                                   task.log_bufs.size());
+                for (auto log_buf : task.log_bufs) {
+                    msg_size += leveldb::EncodeFixed64(send_buf + msg_size,
+                                                       (uint64_t) log_buf);
+                }
+                rdma_broker_->PostSend(send_buf, msg_size,
+                                       task.remote_server_id,
+                                       task.stoc_req_id);
             } else if (task.request_type == leveldb::RDMA_WRITE_REQUEST) {
                 char *sendbuf = rdma_broker_->GetSendBuf(task.remote_server_id);
                 sendbuf[0] =
@@ -148,7 +165,11 @@ namespace nova {
                                        NovaGlobalVariables::global.stoc_pending_disk_reads);
                 leveldb::EncodeFixed64(sendbuf + 17,
                                        NovaGlobalVariables::global.stoc_pending_disk_writes);
-                rdma_broker_->PostSend(sendbuf, 13, task.remote_server_id,
+                leveldb::EncodeFixed64(sendbuf + 25,
+                                       NovaGlobalVariables::global.stoc_block_cache_hits);
+                leveldb::EncodeFixed64(sendbuf + 33,
+                                       NovaGlobalVariables::global.stoc_block_cache_misses);
+                rdma_broker_->PostSend(sendbuf, 41, task.remote_server_id,
                                        task.stoc_req_id);
             } else if (task.request_type ==
                        leveldb::StoCRequestType::STOC_READ_BLOCKS) {
@@ -234,11 +255,28 @@ namespace nova {
             : destination_migration_threads_(destination_migration_threads) {}
 
     void RDMAWriteHandler::Handle(char *buf, uint32_t size) {
-        NOVA_ASSERT(buf[0] == leveldb::StoCRequestType::LTC_MIGRATION);
-        int value = DBMigration::migration_seq_id_ %
-                    destination_migration_threads_.size();
-        DBMigration::migration_seq_id_ += 1;
-        destination_migration_threads_[value]->AddDestMigrateDB(buf, size);
+        // All messages of a range go to the same thread so that its tail
+        // and hot blocks are processed after its metadata.
+        uint32_t cfg_id = leveldb::DecodeFixed32(buf + 1);
+        uint32_t dbid = leveldb::DecodeFixed32(buf + 5);
+        DBMigration *thread = destination_migration_threads_[dbid % destination_migration_threads_.size()];
+        if (buf[0] == leveldb::StoCRequestType::LTC_MIGRATION) {
+            thread->AddDestMigrateDB(buf, size);
+        } else if (buf[0] == leveldb::StoCRequestType::LTC_MIGRATION_CAUGHT_UP) {
+            thread->AddSourceHandoff(buf, size);
+        } else if (buf[0] == leveldb::StoCRequestType::LTC_MIGRATION_WARM_CACHE) {
+            thread->AddDestWarmCache(buf, size);
+        } else {
+            NOVA_ASSERT(buf[0] == leveldb::StoCRequestType::LTC_MIGRATION_TAIL);
+            // The source has stopped serving the range. Stop redirecting
+            // its requests to the source.
+            LTCFragment *frag = NovaConfig::config->cfgs[cfg_id]->fragments[dbid];
+            frag->is_ready_mutex_.Lock();
+            frag->live_migration_state_ = LiveMigrationState::LIVE_MIGRATION_HANDOFF;
+            frag->is_ready_signal_.SignalAll();
+            frag->is_ready_mutex_.Unlock();
+            thread->AddDestMigrationTail(buf, size);
+        }
     }
 
     // No need to flush RDMA requests since Flush will be done after all requests are processed in a receive queue.
@@ -402,6 +440,12 @@ namespace nova {
                     task.stoc_block_handle.stoc_file_id = stoc_file_id;
                     task.stoc_block_handle.offset = offset;
                     task.stoc_block_handle.size = size;
+                    // Background reads, e.g., compactions, do not pollute
+                    // the block cache.
+                    task.fill_block_cache = is_foreground_read;
+                    // Background reads are issued by compactions.
+                    task.io_class = is_foreground_read ? leveldb::StoCIOClass::kStoCIOForegroundRead
+                                                       : leveldb::StoCIOClass::kStoCIOCompaction;
 
                     if (is_foreground_read) {
                         AddFGStorageTask(task);
@@ -500,6 +544,54 @@ namespace nova {
                                 "rdma-server{}]: Allocate log buffer for file {}.",
                                 thread_id_, log_file);
                     processed = true;
+                } else if (buf[0] ==
+                           leveldb::StoCRequestType::STOC_ALLOCATE_LOG_BUFFERS) {
+                    uint32_t nbufs = leveldb::DecodeFixed32(buf + 1);
+                    // The response is 1 + 8 + 4 + 8 * nbufs bytes. The LTC
+                    // asks again for the remaining bufs.
+                    uint32_t max_bufs = (nova::NovaConfig::config->max_msg_size - 1 - 8 - 4 - 1) / 8;
+                    nbufs = std::min(nbufs, max_bufs);
+                    uint32_t slabclassid = mem_manager_->slabclassid(thread_id_,
+                                                                     nova::NovaConfig::config->max_stoc_file_size);
+                    ServerCompleteTask task = {};
+                    task.request_type = leveldb::STOC_ALLOCATE_LOG_BUFFERS;
+                    task.remote_server_id = remote_server_id;
+                    task.stoc_req_id = stoc_req_id;
+                    for (int i = 0; i < nbufs; i++) {
+                        char *rdma_buf = mem_manager_->ItemAlloc(thread_id_, slabclassid);
+                        NOVA_ASSERT(rdma_buf) << "Running out of memory";
+                        // Recovery reads log records until the first empty one.
+                        memset(rdma_buf, 0, nova::NovaConfig::config->max_stoc_file_size);
+                        task.log_bufs.push_back(rdma_buf);
+                    }
+                    private_cq_.push_back(task);
+                    NOVA_LOG(DEBUG) << fmt::format(
+                                "rdma-server{}]: Preallocate {} log buffers for server {}.",
+                                thread_id_, nbufs, remote_server_id);
+                    processed = true;
+                } else if (buf[0] ==
+                           leveldb::StoCRequestType::STOC_BIND_LOG_BUFFER) {
+                    uint64_t rdma_buf = leveldb::DecodeFixed64(buf + 1);
+                    std::string log_file;
+                    leveldb::DecodeStr(buf + 9, &log_file);
+                    log_manager_->AddLocalBuf(log_file, (char *) rdma_buf);
+                    NOVA_LOG(DEBUG) << fmt::format(
+                                "rdma-server{}]: Bind log buffer {} to file {}.",
+                                thread_id_, rdma_buf, log_file);
+                    processed = true;
+                } else if (buf[0] ==
+                           leveldb::StoCRequestType::STOC_FREE_LOG_BUFFERS) {
+                    uint32_t nbufs = leveldb::DecodeFixed32(buf + 1);
+                    uint32_t slabclassid = mem_manager_->slabclassid(thread_id_,
+                                                                     nova::NovaConfig::config->max_stoc_file_size);
+                    for (int i = 0; i < nbufs; i++) {
+                        char *rdma_buf = (char *) leveldb::DecodeFixed64(buf + 5 + i * 8);
+                        mem_manager_->FreeItem(thread_id_, rdma_buf, slabclassid);
+                    }
+                    NOVA_LOG(DEBUG) << fmt::format(
+                                "rdma-server{}]: Free {} log buffers of server {}.",
+                                thread_id_, nbufs, remote_server_id);
+                    processed = true;
                 } else if (buf[0] ==
                            leveldb::StoCRequestType::RDMA_WRITE_REQUEST) {
                     uint32_t size = leveldb::DecodeFixed32(buf + 1);
@@ -18,6 +18,7 @@
 #include "log/stoc_log_manager.h"
 #include "stoc/persistent_stoc_file.h"
 #include "stoc/storage_worker.h"
+#include "stoc/stoc_io_scheduler.h"
 #include "rdma_admission_ctrl.h"
 
 #include "ltc/db_migration.h"
@@ -40,6 +41,8 @@ namespace nova {
         char *rdma_buf = nullptr;
         uint64_t ltc_mr_offset = 0;
         leveldb::FileInternalType internal_type;
+        bool fill_block_cache = true;
+        leveldb::StoCIOClass io_class = leveldb::StoCIOClass::kStoCIOForegroundRead;
 
         // Persist request
         std::vector<leveldb::SSTableStoCFilePair> persist_pairs;
@@ -70,6 +73,8 @@ namespace nova {
         leveldb::CompactionState *compaction_state = nullptr;
         leveldb::CompactionRequest *compaction_request = nullptr;
         std::vector<leveldb::ReplicationPair> replication_results = {};
+        // Preallocated log bufs.
+        std::vector<char *> log_bufs = {};
     };
 
     class StorageWorker;
@@ -3,6 +3,8 @@
 // Created by Haoyu Huang on 1/29/20.
 // Copyright (c) 2020 University of Southern California. All rights reserved.
 //
+#include <fcntl.h>
+#include <unistd.h>
 #include <fmt/core.h>
 #include "leveldb/cache.h"
 #include "db/filename.h"
@@ -72,6 +74,10 @@ namespace leveldb {
         meta.level = 0;
         Status s = env_->NewReadWriteFile(filename, meta, &file_);
         NOVA_ASSERT(s.ok()) << s.ToString();
+        // A recovered file is live until it is deleted.
+        s = env_->GetFileSize(filename, &live_bytes_);
+        NOVA_ASSERT(s.ok()) << s.ToString();
+        nova::NovaGlobalVariables::global.stoc_live_bytes += live_bytes_;
 
         uint32_t scid = mem_manager_->slabclassid(thread_id,
                                                   file_size);
@@ -109,19 +115,7 @@ namespace leveldb {
 
         mutex_.lock();
         reading_cnt--;
-        if (reading_cnt == 0 && waiting_to_be_deleted && !deleted_) {
-            waiting_to_be_deleted = false;
-            deleted_ = true;
-            NOVA_LOG(rdmaio::DEBUG) << fmt::format(
-                        "Delete  Stoc File {}.", stoc_file_name_);
-            NOVA_ASSERT(file_);
-            Status s = file_->Close();
-            NOVA_ASSERT(s.ok()) << fmt::format("{}", s.ToString());
-            delete file_;
-            file_ = nullptr;
-            s = env_->DeleteFile(stoc_file_name_);
-            NOVA_ASSERT(s.ok()) << fmt::format("{}", s.ToString());
-        }
+        CompleteRead();
         if (deleted_) {
             mutex_.unlock();
             return Status::NotFound("");
@@ -143,6 +137,89 @@ namespace leveldb {
         return status;
     }
 
+    void StoCPersistentFile::CompleteRead() {
+        if (reading_cnt > 0) {
+            return;
+        }
+        if (waiting_to_be_deleted && !deleted_) {
+            waiting_to_be_deleted = false;
+            deleted_ = true;
+            NOVA_LOG(rdmaio::DEBUG) << fmt::format(
+                        "Delete  Stoc File {}.", stoc_file_name_);
+            NOVA_ASSERT(file_);
+            Status s = file_->Close();
+            NOVA_ASSERT(s.ok()) << fmt::format("{}", s.ToString());
+            delete file_;
+            file_ = nullptr;
+            CloseReadFds();
+            s = env_->DeleteFile(stoc_file_name_);
+            NOVA_ASSERT(s.ok()) << fmt::format("{}", s.ToString());
+            ReclaimBytes(0);
+        }
+        if (close_read_fds_) {
+            CloseReadFds();
+            close_read_fds_ = false;
+        }
+    }
+
+    void StoCPersistentFile::ReleaseReadFd() {
+        mutex_.lock();
+        NOVA_ASSERT(reading_cnt > 0);
+        reading_cnt--;
+        CompleteRead();
+        mutex_.unlock();
+    }
+
+    int StoCPersistentFile::ReadFd(uint64_t offset, uint32_t size,
+                                   const char *scratch) {
+        const uint64_t kDirectIOAlignment = 4096;
+        bool direct = nova::NovaConfig::config->stoc_io_direct &&
+                      offset % kDirectIOAlignment == 0 &&
+                      size % kDirectIOAlignment == 0 &&
+                      (uint64_t) scratch % kDirectIOAlignment == 0;
+        mutex_.lock();
+        // The fd stays open until the read releases it.
+        reading_cnt++;
+        if (direct && direct_read_fd_ < 0) {
+            direct_read_fd_ = ::open(stoc_file_name_.c_str(),
+                                     O_RDONLY | O_CLOEXEC | O_DIRECT);
+        }
+        if (direct && direct_read_fd_ >= 0) {
+            int fd = direct_read_fd_;
+            mutex_.unlock();
+            return fd;
+        }
+        if (read_fd_ < 0) {
+            read_fd_ = ::open(stoc_file_name_.c_str(), O_RDONLY | O_CLOEXEC);
+            NOVA_ASSERT(read_fd_ >= 0)
+                << fmt::format("Cannot open {}: {}", stoc_file_name_,
+                               strerror(errno));
+        }
+        int fd = read_fd_;
+        mutex_.unlock();
+        return fd;
+    }
+
+    void StoCPersistentFile::ReclaimBytes(uint64_t deleted_bytes) {
+        nova::NovaGlobalVariables::global.stoc_reclaimed_bytes +=
+                deleted_bytes + live_bytes_ + dead_bytes_;
+        nova::NovaGlobalVariables::global.stoc_live_bytes -= live_bytes_;
+        nova::NovaGlobalVariables::global.stoc_dead_bytes -= dead_bytes_;
+        live_bytes_ = 0;
+        dead_bytes_ = 0;
+    }
+
+    void StoCPersistentFile::CloseReadFds() {
+        if (read_fd_ >= 0) {
+            ::close(read_fd_);
+            read_fd_ = -1;
+        }
+        if (direct_read_fd_ >= 0) {
+            ::close(direct_read_fd_);
+            direct_read_fd_ = -1;
+        }
+    }
+
     bool StoCPersistentFile::MarkOffsetAsWritten(
             uint32_t given_file_id_for_assertion,
             uint64_t offset) {
@@ -280,100 +357,80 @@ namespace leveldb {
         NOVA_ASSERT(current_disk_offset_ <= file_size_);
         mutex_.unlock();
 
+        // Group commit. Requests that arrive while another request holds
+        // persist_mutex_ append their blocks to written_mem_blocks_. The
+        // next holder writes all of them with one vectored write and one
+        // sync. Requests whose blocks were written by others find
+        // written_mem_blocks_ empty and return.
         persist_mutex_.lock();
-        // Make a copy of written_mem_blocks.
         mutex_.lock();
-        std::vector<BatchWrite> writes;
-        for (int i = 0; i < written_mem_blocks_.size(); i++) {
-            writes.push_back(written_mem_blocks_[i]);
-        }
-        if (writes.empty()) {
+        if (written_mem_blocks_.empty()) {
             Seal();
-        }
-        mutex_.unlock();
-
-        if (writes.empty()) {
+            mutex_.unlock();
             persist_mutex_.unlock();
             return persisted_bytes;
         }
+        mutex_.unlock();
 
+        if (nova::NovaConfig::config->stoc_group_commit_window_us > 0) {
+            // Wait for more concurrent requests to join this group.
+            env_->SleepForMicroseconds(
+                    nova::NovaConfig::config->stoc_group_commit_window_us);
+        }
+        // Make a copy of written_mem_blocks.
+        mutex_.lock();
+        std::vector<BatchWrite> writes(written_mem_blocks_.begin(),
+                                       written_mem_blocks_.end());
+        mutex_.unlock();
+        NOVA_ASSERT(!writes.empty());
 
-        int i = 1;
-        int persisted_i = 0;
+        // Coalesce blocks that are adjacent in memory. The disk offsets of
+        // the blocks follow the order of written_mem_blocks_.
+        std::vector<Slice> ranges;
         uint64_t offset = writes[0].mem_handle.offset();
         uint64_t size = writes[0].mem_handle.size();
-        while (i < writes.size()) {
+        for (int i = 1; i < writes.size(); i++) {
             if (offset + size == writes[i].mem_handle.offset()) {
                 size += writes[i].mem_handle.size();
-                i++;
                 continue;
             }
-
-            // persist offset -> size.
-            nova::NovaGlobalVariables::global.stoc_queue_depth += 1;
-            nova::NovaGlobalVariables::global.stoc_pending_disk_writes += size;
-            nova::NovaGlobalVariables::global.total_disk_writes += size;
+            ranges.emplace_back(backing_mem_ + offset, size);
             persisted_bytes += size;
-
-            Status s = file_->Append(Slice(backing_mem_ + offset, size));
-            NOVA_ASSERT(s.ok()) << fmt::format("{}", s.ToString());
-            s = file_->Sync();
-            NOVA_ASSERT(s.ok()) << fmt::format("{}", s.ToString());
-
-            nova::NovaGlobalVariables::global.stoc_queue_depth -= 1;
-            nova::NovaGlobalVariables::global.stoc_pending_disk_writes -= size;
-
-            mutex_.lock();
-            for (int j = persisted_i; j < i; j++) {
-                if (writes[j].internal_type == FileInternalType::kFileMetadata) {
-                    NOVA_ASSERT(file_meta_block_offset_.find(writes[j].sstable) != file_meta_block_offset_.end());
-                    file_meta_block_offset_[writes[j].sstable].persisted = true;
-                } else if (writes[j].internal_type == FileInternalType::kFileParity) {
-                    NOVA_ASSERT(file_parity_block_offset_.find(writes[j].sstable) != file_parity_block_offset_.end());
-                    file_parity_block_offset_[writes[j].sstable].persisted = true;
-                } else {
-                    NOVA_ASSERT(file_block_offset_.find(writes[j].sstable) != file_block_offset_.end());
-                    file_block_offset_[writes[j].sstable].persisted = true;
-                }
-                persisting_cnt -= 1;
-            }
-            mutex_.unlock();
-            persisted_i = i;
             offset = writes[i].mem_handle.offset();
             size = writes[i].mem_handle.size();
-            i += 1;
         }
-        // Persist the last range.
-        nova::NovaGlobalVariables::global.stoc_queue_depth += 1;
-        nova::NovaGlobalVariables::global.stoc_pending_disk_writes += size;
-        nova::NovaGlobalVariables::global.total_disk_writes += size;
+        ranges.emplace_back(backing_mem_ + offset, size);
         persisted_bytes += size;
 
-        Status s = file_->Append(Slice(backing_mem_ + offset, size));
+        nova::NovaGlobalVariables::global.stoc_queue_depth += 1;
+        nova::NovaGlobalVariables::global.stoc_pending_disk_writes += persisted_bytes;
+        nova::NovaGlobalVariables::global.total_disk_writes += persisted_bytes;
+        nova::NovaGlobalVariables::global.total_disk_syncs += 1;
+
+        Status s = file_->AppendBatch(ranges);
         NOVA_ASSERT(s.ok()) << fmt::format("{}", s.ToString());
         s = file_->Sync();
         NOVA_ASSERT(s.ok()) << fmt::format("{}", s.ToString());
 
         nova::NovaGlobalVariables::global.stoc_queue_depth -= 1;
-        nova::NovaGlobalVariables::global.stoc_pending_disk_writes -= size;
+        nova::NovaGlobalVariables::global.stoc_pending_disk_writes -= persisted_bytes;
 
         mutex_.lock();
-        for (int j = persisted_i; j < writes.size(); j++) {
-            if (writes[j].internal_type == FileInternalType::kFileMetadata) {
-                NOVA_ASSERT(file_meta_block_offset_.find(writes[j].sstable) != file_meta_block_offset_.end());
-                file_meta_block_offset_[writes[j].sstable].persisted = true;
-            } else if (writes[j].internal_type == FileInternalType::kFileParity) {
-                NOVA_ASSERT(file_parity_block_offset_.find(writes[j].sstable) != file_parity_block_offset_.end());
-                file_parity_block_offset_[writes[j].sstable].persisted = true;
+        for (const auto &write : writes) {
+            if (write.internal_type == FileInternalType::kFileMetadata) {
+                NOVA_ASSERT(file_meta_block_offset_.find(write.sstable) != file_meta_block_offset_.end());
+                file_meta_block_offset_[write.sstable].persisted = true;
+            } else if (write.internal_type == FileInternalType::kFileParity) {
+                NOVA_ASSERT(file_parity_block_offset_.find(write.sstable) != file_parity_block_offset_.end());
+                file_parity_block_offset_[write.sstable].persisted = true;
             } else {
-                NOVA_ASSERT(file_block_offset_.find(writes[j].sstable) != file_block_offset_.end());
-                file_block_offset_[writes[j].sstable].persisted = true;
+                NOVA_ASSERT(file_block_offset_.find(write.sstable) != file_block_offset_.end());
+                file_block_offset_[write.sstable].persisted = true;
             }
             persisting_cnt -= 1;
         }
-        mutex_.unlock();
-
-        mutex_.lock();
+        live_bytes_ += persisted_bytes;
+        nova::NovaGlobalVariables::global.stoc_live_bytes += persisted_bytes;
         written_mem_blocks_.erase(written_mem_blocks_.begin(),
                                   written_mem_blocks_.begin() + writes.size());
         Seal();
@@ -388,6 +445,7 @@ namespace leveldb {
         NOVA_ASSERT(given_fileid_for_assertion == file_id_)
             << fmt::format("{} {}", given_fileid_for_assertion, file_id_);
         bool delete_file = false;
+        std::vector<BlockHandle> dead_extents;
 
         mutex_.lock();
         Seal();
@@ -395,6 +453,7 @@ namespace leveldb {
             auto it = file_block_offset_.find(filename);
             if (it != file_block_offset_.end()) {
                 NOVA_ASSERT(it->second.persisted);
+                dead_extents.push_back(it->second.disk_handle);
                 int n = file_block_offset_.erase(filename);
                 NOVA_ASSERT(n == 1);
             }
@@ -403,6 +462,7 @@ namespace leveldb {
             auto it = file_meta_block_offset_.find(filename);
             if (it != file_meta_block_offset_.end()) {
                 NOVA_ASSERT(it->second.persisted);
+                dead_extents.push_back(it->second.disk_handle);
                 int n = file_meta_block_offset_.erase(filename);
                 NOVA_ASSERT(n == 1);
             }
@@ -411,6 +471,7 @@ namespace leveldb {
             auto it = file_parity_block_offset_.find(filename);
             if (it != file_parity_block_offset_.end()) {
                 NOVA_ASSERT(it->second.persisted);
+                dead_extents.push_back(it->second.disk_handle);
                 int n = file_parity_block_offset_.erase(filename);
                 NOVA_ASSERT(n == 1);
             }
@@ -431,6 +492,33 @@ namespace leveldb {
         if (delete_file) {
             NOVA_ASSERT(current_disk_offset_ == file_size_);
         }
+        uint64_t dead_bytes = 0;
+        for (const auto &extent : dead_extents) {
+            dead_bytes += extent.size();
+        }
+        NOVA_ASSERT(live_bytes_ >= dead_bytes);
+        live_bytes_ -= dead_bytes;
+        nova::NovaGlobalVariables::global.stoc_live_bytes -= dead_bytes;
+        if (delete_file) {
+            ReclaimBytes(dead_bytes);
+        } else if (!dead_extents.empty()) {
+            // Other fragments keep the file alive. Return the extents of
+            // this fragment to the file system. Skip it while the fragment
+            // may still be read for replication.
+            bool punched = reading_cnt == 0 && file_;
+            for (const auto &extent : dead_extents) {
+                if (!punched) {
+                    break;
+                }
+                punched = file_->PunchHole(extent.offset(), extent.size()).ok();
+            }
+            if (punched) {
+                nova::NovaGlobalVariables::global.stoc_reclaimed_bytes += dead_bytes;
+            } else {
+                dead_bytes_ += dead_bytes;
+                nova::NovaGlobalVariables::global.stoc_dead_bytes += dead_bytes;
+            }
+        }
         mutex_.unlock();
 
         if (!delete_file) {
@@ -442,6 +530,7 @@ namespace leveldb {
         NOVA_ASSERT(s.ok()) << fmt::format("{}", s.ToString());
         delete file_;
         file_ = nullptr;
+        CloseReadFds();
         s = env_->DeleteFile(stoc_file_name_);
         NOVA_ASSERT(s.ok()) << fmt::format("{}", s.ToString());
         return true;
@@ -459,6 +548,11 @@ namespace leveldb {
         NOVA_ASSERT(s.ok()) << fmt::format("{}", s.ToString());
         delete file_;
         file_ = nullptr;
+        if (reading_cnt == 0) {
+            CloseReadFds();
+        } else {
+            close_read_fds_ = true;
+        }
         mutex_.unlock();
     }
 
@@ -540,9 +634,112 @@ namespace leveldb {
         return handle;
     }
 
-    static void DeleteCachedBlock(const Slice &key, void *value) {
-        char *block = reinterpret_cast<char *>(value);
-        delete block;
+    namespace {
+        const int kBlockCacheKeySize = 16;
+
+        // A cached block is keyed by (stoc_file_id, offset, size). StoC file
+        // ids are never reused.
+        void EncodeBlockCacheKey(uint32_t stoc_file_id, uint64_t offset,
+                                 uint32_t size, char *buf) {
+            EncodeFixed32(buf, stoc_file_id);
+            EncodeFixed64(buf + 4, offset);
+            EncodeFixed32(buf + 12, size);
+        }
+    }
+
+    void StocPersistentFileManager::DeleteCachedBlock(const Slice &key, void *value) {
+        auto cached_block = reinterpret_cast<CachedBlock *>(value);
+        NOVA_ASSERT(key.size() == kBlockCacheKeySize);
+        uint32_t stoc_file_id = DecodeFixed32(key.data());
+        uint64_t offset = DecodeFixed64(key.data() + 4);
+        uint32_t size = DecodeFixed32(key.data() + 12);
+        StocPersistentFileManager *manager = cached_block->manager;
+        // block_cache_mutex_ is never held while calling into the cache.
+        manager->block_cache_mutex_.lock();
+        auto it = manager->cached_blocks_.find(stoc_file_id);
+        if (it != manager->cached_blocks_.end()) {
+            it->second.erase(std::make_pair(offset, size));
+            if (it->second.empty()) {
+                manager->cached_blocks_.erase(it);
+            }
+        }
+        manager->block_cache_mutex_.unlock();
+        delete[] cached_block->block;
+        delete cached_block;
+    }
+
+    bool StocPersistentFileManager::LookupBlockCache(
+            const StoCBlockHandle &stoc_block_handle, char *scratch) {
+        if (!block_cache_) {
+            return false;
+        }
+        char cache_key_buffer[kBlockCacheKeySize];
+        EncodeBlockCacheKey(stoc_block_handle.stoc_file_id,
+                            stoc_block_handle.offset, stoc_block_handle.size,
+                            cache_key_buffer);
+        Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+        auto cache_handle = block_cache_->Lookup(key);
+        if (cache_handle == nullptr) {
+            nova::NovaGlobalVariables::global.stoc_block_cache_misses += 1;
+            return false;
+        }
+        auto cached_block = reinterpret_cast<CachedBlock *>(block_cache_->Value(cache_handle));
+        memcpy(scratch, cached_block->block, stoc_block_handle.size);
+        block_cache_->Release(cache_handle);
+        nova::NovaGlobalVariables::global.stoc_block_cache_hits += 1;
+        return true;
+    }
+
+    void StocPersistentFileManager::InsertBlockCache(
+            StoCPersistentFile *stoc_file,
+            const StoCBlockHandle &stoc_block_handle, const char *block) {
+        if (!block_cache_ || !stoc_file->sealed()) {
+            return;
+        }
+        // Only the fragments of SSTables are immutable.
+        leveldb::FileType type;
+        NOVA_ASSERT(ParseFileName(stoc_file->stoc_file_name_, &type));
+        if (type != leveldb::FileType::kTableFile) {
+            return;
+        }
+        char cache_key_buffer[kBlockCacheKeySize];
+        EncodeBlockCacheKey(stoc_block_handle.stoc_file_id,
+                            stoc_block_handle.offset, stoc_block_handle.size,
+                            cache_key_buffer);
+        Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+        auto cached_block = new CachedBlock;
+        cached_block->manager = this;
+        cached_block->block = new char[stoc_block_handle.size];
+        memcpy(cached_block->block, block, stoc_block_handle.size);
+        // Index the block before inserting it so that the deleter of an
+        // evicted block never leaves a stale entry behind.
+        block_cache_mutex_.lock();
+        cached_blocks_[stoc_block_handle.stoc_file_id].insert(
+                std::make_pair(stoc_block_handle.offset, stoc_block_handle.size));
+        block_cache_mutex_.unlock();
+        block_cache_->Release(block_cache_->Insert(key, cached_block,
+                                                   stoc_block_handle.size,
+                                                   &DeleteCachedBlock));
+    }
+
+    void StocPersistentFileManager::EraseBlockCache(uint32_t stoc_file_id) {
+        if (!block_cache_) {
+            return;
+        }
+        std::set<std::pair<uint64_t, uint32_t>> blocks;
+        block_cache_mutex_.lock();
+        auto it = cached_blocks_.find(stoc_file_id);
+        if (it != cached_blocks_.end()) {
+            blocks.swap(it->second);
+            cached_blocks_.erase(it);
+        }
+        block_cache_mutex_.unlock();
+        for (const auto &block : blocks) {
+            char cache_key_buffer[kBlockCacheKeySize];
+            EncodeBlockCacheKey(stoc_file_id, block.first, block.second,
+                                cache_key_buffer);
+            block_cache_->Erase(Slice(cache_key_buffer, sizeof(cache_key_buffer)));
+        }
     }
 
     bool StocPersistentFileManager::ReadDataBlockForReplication(
@@ -553,98 +750,73 @@ namespace leveldb {
             return false;
         }
 
-        if (!block_cache_) {
-            leveldb::FileType type;
-            NOVA_ASSERT(ParseFileName(stoc_file->stoc_file_name_, &type));
-            NOVA_LOG(rdmaio::DEBUG)
-                << fmt::format("Read {} from stoc file {} offset:{} size:{}",
-                               stoc_block_handle.DebugString(),
-                               stoc_file->file_id(), offset, size);
-            auto status = stoc_file->ReadForReplication(offset, size, scratch, result);
-            if (status.IsNotFound()) {
-                return false;
-            }
-            NOVA_ASSERT(status.ok()) << status.ToString();
-            NOVA_ASSERT(type == leveldb::FileType::kTableFile);
-            NOVA_ASSERT(result->size() == size)
-                << fmt::format("fn:{} given size:{} read size:{}",
-                               stoc_file->stoc_file_name_,
-                               size,
-                               result->size());
-            NOVA_ASSERT(scratch[size - 1] != 0)
-                << fmt::format(
-                        "Read {} from stoc file {} offset:{} size:{}",
-                        stoc_block_handle.DebugString(),
-                        stoc_file->file_id(), offset, size);
-            return true;
-        }
-
-        char cache_key_buffer[StoCBlockHandle::HandleSize()];
-        stoc_block_handle.EncodeHandle(cache_key_buffer);
-        Slice key(cache_key_buffer, sizeof(cache_key_buffer));
-        auto cache_handle = block_cache_->Lookup(key);
-        if (cache_handle != nullptr) {
-            auto block = reinterpret_cast<char *>(block_cache_->Value(
-                    cache_handle));
-            memcpy(scratch, block, stoc_block_handle.size);
-        } else {
-            stoc_file->Read(offset, size, scratch, result);
-            char *block = new char[size];
-            memcpy(block, scratch, size);
-            cache_handle = block_cache_->Insert(key, block,
-                                                size,
-                                                &DeleteCachedBlock);
+        // Replication reads whole fragments. They bypass the block cache.
+        leveldb::FileType type;
+        NOVA_ASSERT(ParseFileName(stoc_file->stoc_file_name_, &type));
+        NOVA_LOG(rdmaio::DEBUG)
+            << fmt::format("Read {} from stoc file {} offset:{} size:{}",
+                           stoc_block_handle.DebugString(),
+                           stoc_file->file_id(), offset, size);
+        auto status = stoc_file->ReadForReplication(offset, size, scratch, result);
+        if (status.IsNotFound()) {
+            return false;
         }
-        block_cache_->Release(cache_handle);
+        NOVA_ASSERT(status.ok()) << status.ToString();
+        NOVA_ASSERT(type == leveldb::FileType::kTableFile);
+        NOVA_ASSERT(result->size() == size)
+            << fmt::format("fn:{} given size:{} read size:{}",
+                           stoc_file->stoc_file_name_,
+                           size,
+                           result->size());
+        NOVA_ASSERT(scratch[size - 1] != 0)
+            << fmt::format(
+                    "Read {} from stoc file {} offset:{} size:{}",
+                    stoc_block_handle.DebugString(),
+                    stoc_file->file_id(), offset, size);
         return true;
     }
 
     void StocPersistentFileManager::ReadDataBlock(
             const leveldb::StoCBlockHandle &stoc_block_handle, uint64_t offset, uint32_t size, char *scratch,
-            Slice *result) {
+            Slice *result, bool fill_block_cache) {
+        if (offset == stoc_block_handle.offset && size == stoc_block_handle.size &&
+            LookupBlockCache(stoc_block_handle, scratch)) {
+            *result = Slice(scratch, size);
+            return;
+        }
+        ReadUncachedDataBlock(stoc_block_handle, offset, size, scratch, result,
+                              fill_block_cache);
+    }
+
+    void StocPersistentFileManager::ReadUncachedDataBlock(
+            const leveldb::StoCBlockHandle &stoc_block_handle, uint64_t offset, uint32_t size, char *scratch,
+            Slice *result, bool fill_block_cache) {
         StoCPersistentFile *stoc_file = FindStoCFile(stoc_block_handle.stoc_file_id);
         NOVA_ASSERT(stoc_file) << stoc_block_handle.stoc_file_id;
-        if (!block_cache_) {
-            leveldb::FileType type;
-            NOVA_ASSERT(ParseFileName(stoc_file->stoc_file_name_, &type));
-            NOVA_LOG(rdmaio::DEBUG)
-                << fmt::format("Read {} from stoc file {} offset:{} size:{}",
-                               stoc_block_handle.DebugString(), stoc_file->file_id(), offset, size);
-            NOVA_ASSERT(stoc_file->Read(offset, size, scratch, result).ok());
-            if (type == leveldb::FileType::kTableFile) {
-                NOVA_ASSERT(result->size() == size)
-                    << fmt::format("fn:{} given size:{} read size:{}",
-                                   stoc_file->stoc_file_name_, size, result->size());
-                NOVA_ASSERT(stoc_file->sealed()) << fmt::format("Read but not sealed {}", stoc_file->stoc_file_name_);
+        leveldb::FileType type;
+        NOVA_ASSERT(ParseFileName(stoc_file->stoc_file_name_, &type));
+        NOVA_LOG(rdmaio::DEBUG)
+            << fmt::format("Read {} from stoc file {} offset:{} size:{}",
+                           stoc_block_handle.DebugString(), stoc_file->file_id(), offset, size);
+        NOVA_ASSERT(stoc_file->Read(offset, size, scratch, result).ok());
+        if (type == leveldb::FileType::kTableFile) {
+            NOVA_ASSERT(result->size() == size)
+                << fmt::format("fn:{} given size:{} read size:{}",
+                               stoc_file->stoc_file_name_, size, result->size());
+            NOVA_ASSERT(stoc_file->sealed()) << fmt::format("Read but not sealed {}", stoc_file->stoc_file_name_);
 //                NOVA_ASSERT(scratch[size - 1] != 0)
 //                    << fmt::format(
 //                            "Read {} from stoc file {} offset:{} size:{} result:{}",
 //                            stoc_block_handle.DebugString(), stoc_file->file_id(), offset, size, result->size());
-            } else {
-                NOVA_LOG(rdmaio::DEBUG)
-                    << fmt::format("Read file {} read size {}:{}", stoc_file->stoc_file_name_, size,
-                                   result->size());
+            if (fill_block_cache && offset == stoc_block_handle.offset &&
+                size == stoc_block_handle.size) {
+                InsertBlockCache(stoc_file, stoc_block_handle, scratch);
             }
-            return;
-        }
-
-        char cache_key_buffer[StoCBlockHandle::HandleSize()];
-        stoc_block_handle.EncodeHandle(cache_key_buffer);
-        Slice key(cache_key_buffer, sizeof(cache_key_buffer));
-        auto cache_handle = block_cache_->Lookup(key);
-        if (cache_handle != nullptr) {
-            auto block = reinterpret_cast<char *>(block_cache_->Value(
-                    cache_handle));
-            memcpy(scratch, block, stoc_block_handle.size);
         } else {
-            stoc_file->Read(offset, size, scratch, result);
-            char *block = new char[size];
-            memcpy(block, scratch, size);
-            cache_handle = block_cache_->Insert(key, block,
-                                                size,
-                                                &DeleteCachedBlock);
+            NOVA_LOG(rdmaio::DEBUG)
+                << fmt::format("Read file {} read size {}:{}", stoc_file->stoc_file_name_, size,
+                               result->size());
         }
-        block_cache_->Release(cache_handle);
     }
 
     void StocPersistentFileManager::OpenStoCFiles(
@@ -728,7 +900,9 @@ namespace leveldb {
         }
         mutex_.unlock();
         if (stoc_file) {
-            stoc_file->DeleteSSTable(stoc_file->file_id(), filename);
+            uint32_t stoc_file_id = stoc_file->file_id();
+            stoc_file->DeleteSSTable(stoc_file_id, filename);
+            EraseBlockCache(stoc_file_id);
         }
     }
 
@@ -747,9 +921,11 @@ namespace leveldb {
             leveldb::Env *env,
             leveldb::MemManager *mem_manager,
             const std::string &stoc_file_path,
-            uint32_t stoc_file_size) :
+            uint32_t stoc_file_size,
+            leveldb::Cache *block_cache) :
             env_(env), mem_manager_(mem_manager),
             stoc_file_path_(stoc_file_path),
-            stoc_file_size_(stoc_file_size) {
+            stoc_file_size_(stoc_file_size),
+            block_cache_(block_cache) {
     }
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 
 #include <string>
 #include <list>
+#include <set>
 #include <unordered_map>
 
 #include "leveldb/env.h"
@@ -48,6 +49,14 @@ namespace leveldb {
             return file_id_;
         }
 
+        // Return a file descriptor to read [offset, offset+size) into scratch
+        // asynchronously. The read bypasses the page cache if stoc_io_direct
+        // is enabled and the offset, size, and scratch are aligned. The file
+        // keeps the descriptor open until the read calls ReleaseReadFd.
+        int ReadFd(uint64_t offset, uint32_t size, const char *scratch);
+
+        void ReleaseReadFd();
+
         void ForceSeal();
 
         bool sealed() const {
@@ -59,6 +68,16 @@ namespace leveldb {
 
         void Seal();
 
+        void CloseReadFds();
+
+        // Delete the file or close its read fds if they wait for the last
+        // read to complete. Requires mutex_.
+        void CompleteRead();
+
+        // The file is deleted. Its live and dead bytes and deleted_bytes are
+        // reclaimed. Requires mutex_.
+        void ReclaimBytes(uint64_t deleted_bytes);
+
         struct AllocatedBuf {
             std::string filename;
             uint64_t offset;
@@ -80,6 +99,8 @@ namespace leveldb {
 
         Env *env_ = nullptr;
         ReadWriteFile *file_ = nullptr;
+        int read_fd_ = -1;
+        int direct_read_fd_ = -1;
 
         std::unordered_map<std::string, StoCPersistStatus> file_block_offset_;
         std::unordered_map<std::string, StoCPersistStatus> file_meta_block_offset_;
@@ -99,8 +120,14 @@ namespace leveldb {
         uint32_t file_id_ = 0;
         uint32_t persisting_cnt = 0;
         uint32_t reading_cnt = 0;
+        // Bytes of persisted fragments that are not deleted.
+        uint64_t live_bytes_ = 0;
+        // Bytes of deleted fragments that still occupy the file.
+        uint64_t dead_bytes_ = 0;
 
         bool waiting_to_be_deleted = false;
+        // Close the read fds once the reads in progress complete.
+        bool close_read_fds_ = false;
         bool deleted_ = false;
         std::mutex mutex_;
 
@@ -114,13 +141,33 @@ namespace leveldb {
         StocPersistentFileManager(Env *env,
                                   MemManager *mem_manager,
                                   const std::string &stoc_file_path,
-                                  uint32_t stoc_file_size);
+                                  uint32_t stoc_file_size,
+                                  Cache *block_cache = nullptr);
 
         StoCPersistentFile *FindStoCFile(uint32_t stoc_file_id);
 
+        // Read from the block cache first if the read covers the whole
+        // block. fill_block_cache is false for reads that should not pollute
+        // the cache, e.g., compactions.
         void
         ReadDataBlock(const StoCBlockHandle &stoc_block_handle, uint64_t offset,
-                      uint32_t size, char *scratch, Slice *result);
+                      uint32_t size, char *scratch, Slice *result,
+                      bool fill_block_cache = true);
+
+        void
+        ReadUncachedDataBlock(const StoCBlockHandle &stoc_block_handle,
+                              uint64_t offset, uint32_t size, char *scratch,
+                              Slice *result, bool fill_block_cache);
+
+        // Copy the cached block of stoc_block_handle into scratch. Return
+        // false if it is not cached.
+        bool LookupBlockCache(const StoCBlockHandle &stoc_block_handle,
+                              char *scratch);
+
+        // Cache a block of a sealed SSTable fragment.
+        void InsertBlockCache(StoCPersistentFile *stoc_file,
+                              const StoCBlockHandle &stoc_block_handle,
+                              const char *block);
 
         bool
         ReadDataBlockForReplication(const StoCBlockHandle &stoc_block_handle,
@@ -147,8 +194,23 @@ namespace leveldb {
         const uint32_t MAX_MANIFEST_FILE_ID = 10000;
         uint32_t current_stoc_file_id_ = MAX_MANIFEST_FILE_ID + 1;
         std::unordered_map<uint32_t, StoCPersistentFile *> stoc_files_;
+        // Drop the cached blocks of a deleted StoC file.
+        void EraseBlockCache(uint32_t stoc_file_id);
+
+        struct CachedBlock {
+            StocPersistentFileManager *manager = nullptr;
+            char *block = nullptr;
+        };
+
+        // Free an evicted or erased block and remove it from cached_blocks_.
+        static void DeleteCachedBlock(const Slice &key, void *value);
+
         leveldb::Cache *block_cache_ = nullptr;
         std::mutex mutex_;
+        // Blocks cached per StoC file. A block is removed when the cache
+        // evicts it.
+        std::unordered_map<uint32_t, std::set<std::pair<uint64_t, uint32_t>>> cached_blocks_;
+        std::mutex block_cache_mutex_;
     };
 }
 
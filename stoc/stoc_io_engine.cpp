@@ -0,0 +1,498 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "stoc_io_engine.h"
+
+#include <errno.h>
+#include <algorithm>
+#include <string.h>
+#include <unistd.h>
+#include <fmt/core.h>
+
+#include "common/nova_console_logging.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define NOVA_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace leveldb {
+
+    namespace {
+        int64_t ReadAll(StoCIORequest *request) {
+            uint32_t read = 0;
+            while (read < request->size) {
+                ssize_t n = ::pread(request->fd, request->buf + read,
+                                    request->size - read,
+                                    static_cast<off_t>(request->offset + read));
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return -errno;
+                }
+                if (n == 0) {
+                    break;
+                }
+                read += n;
+            }
+            return read;
+        }
+
+        int64_t WriteAll(StoCIORequest *request) {
+            uint32_t written = 0;
+            while (written < request->size) {
+                ssize_t n = ::pwrite(request->fd, request->buf + written,
+                                     request->size - written,
+                                     static_cast<off_t>(request->offset + written));
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return -errno;
+                }
+                written += n;
+            }
+            return written;
+        }
+
+        int64_t Execute(StoCIORequest *request) {
+            switch (request->type) {
+                case kStoCIORead:
+                    return ReadAll(request);
+                case kStoCIOWrite:
+                    return WriteAll(request);
+                case kStoCIOSync:
+                    return ::fdatasync(request->fd) == 0 ? 0 : -errno;
+                default:
+                    return request->call();
+            }
+        }
+    }
+
+    StoCIOThreadPool::StoCIOThreadPool(uint32_t num_threads,
+                                       std::function<void(StoCIORequest *)> complete)
+            : complete_(std::move(complete)) {
+        for (uint32_t i = 0; i < std::max(1u, num_threads); i++) {
+            threads_.emplace_back(&StoCIOThreadPool::Run, this);
+        }
+    }
+
+    StoCIOThreadPool::~StoCIOThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void StoCIOThreadPool::Submit(StoCIORequest *request) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(request);
+        }
+        cv_.notify_one();
+    }
+
+    void StoCIOThreadPool::Run() {
+        while (true) {
+            StoCIORequest *request = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [&]() { return stop_ || !queue_.empty(); });
+                if (queue_.empty()) {
+                    return;
+                }
+                request = queue_.front();
+                queue_.pop_front();
+            }
+            request->result = Execute(request);
+            complete_(request);
+        }
+    }
+
+    void StoCIOEngine::Complete(StoCIORequest *request) {
+        if (request->done) {
+            request->done();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            completed_.push_back(request);
+            num_inflight_ -= 1;
+        }
+        notify_();
+    }
+
+    void StoCIOEngine::PollCompletions(
+            std::vector<StoCIORequest *> *completed) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        completed->insert(completed->end(), completed_.begin(),
+                          completed_.end());
+        completed_.clear();
+    }
+
+    namespace {
+        class ThreadPoolIOEngine : public StoCIOEngine {
+        public:
+            ThreadPoolIOEngine(uint32_t num_threads,
+                               std::function<void(void)> notify)
+                    : StoCIOEngine(std::move(notify)),
+                      pool_(num_threads, [this](StoCIORequest *request) {
+                          Complete(request);
+                      }) {}
+
+            void Submit(StoCIORequest *request) override {
+                num_inflight_ += 1;
+                pool_.Submit(request);
+            }
+
+            const char *Name() const override {
+                return "threadpool";
+            }
+
+        private:
+            StoCIOThreadPool pool_;
+        };
+
+#ifdef NOVA_HAVE_IO_URING
+
+        // A registered buffer may not exceed 1 GB.
+        const uint64_t kRegisteredBufChunkSize = 1ull << 30;
+
+        // Reads, writes and syncs go through io_uring and a reaper thread
+        // completes them as their CQEs arrive. Calls, e.g., persist, run on
+        // a thread pool.
+        //
+        // The worker thread is the only submitter besides the reaper, which
+        // resubmits the backlog. Both hold sq_mutex_.
+        class IoUringIOEngine : public StoCIOEngine {
+        public:
+            IoUringIOEngine(uint32_t num_threads,
+                            std::function<void(void)> notify)
+                    : StoCIOEngine(std::move(notify)),
+                      call_pool_(num_threads, [this](StoCIORequest *request) {
+                          Complete(request);
+                      }) {
+                stop_ = false;
+            }
+
+            ~IoUringIOEngine() override {
+                if (ring_fd_ < 0) {
+                    return;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(sq_mutex_);
+                    stop_ = true;
+                    // Wake up the reaper.
+                    io_uring_sqe *sqe = NextSqe();
+                    sqe->opcode = IORING_OP_NOP;
+                    num_ring_inflight_ += 1;
+                    FlushLocked();
+                }
+                reaper_.join();
+                munmap(sqes_, sqes_size_);
+                if (cq_ring_ != sq_ring_) {
+                    munmap(cq_ring_, cq_ring_size_);
+                }
+                munmap(sq_ring_, sq_ring_size_);
+                close(ring_fd_);
+            }
+
+            bool Init(uint32_t queue_depth, char *registered_buf,
+                      uint64_t registered_buf_size) {
+                io_uring_params params = {};
+                ring_fd_ = (int) syscall(__NR_io_uring_setup, queue_depth,
+                                         &params);
+                if (ring_fd_ < 0) {
+                    NOVA_LOG(rdmaio::WARNING)
+                        << fmt::format("io_uring_setup failed: {}",
+                                       strerror(errno));
+                    return false;
+                }
+                sq_ring_size_ = params.sq_off.array +
+                                params.sq_entries * sizeof(unsigned);
+                cq_ring_size_ = params.cq_off.cqes +
+                                params.cq_entries * sizeof(io_uring_cqe);
+                bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+                if (single_mmap) {
+                    sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+                    cq_ring_size_ = sq_ring_size_;
+                }
+                sq_ring_ = mmap(nullptr, sq_ring_size_,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, ring_fd_,
+                                IORING_OFF_SQ_RING);
+                if (sq_ring_ == MAP_FAILED) {
+                    close(ring_fd_);
+                    ring_fd_ = -1;
+                    return false;
+                }
+                cq_ring_ = sq_ring_;
+                if (!single_mmap) {
+                    cq_ring_ = mmap(nullptr, cq_ring_size_,
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE, ring_fd_,
+                                    IORING_OFF_CQ_RING);
+                    NOVA_ASSERT(cq_ring_ != MAP_FAILED);
+                }
+                sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+                sqes_ = reinterpret_cast<io_uring_sqe *>(
+                        mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring_fd_,
+                             IORING_OFF_SQES));
+                NOVA_ASSERT(sqes_ != MAP_FAILED);
+
+                char *sq = reinterpret_cast<char *>(sq_ring_);
+                sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+                sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+                sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+                sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+                sq_entries_ = params.sq_entries;
+                char *cq = reinterpret_cast<char *>(cq_ring_);
+                cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+                cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+                cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+                cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+                // Register the buffer so that the kernel does not pin its
+                // pages on every read. It fails if the buffer exceeds
+                // RLIMIT_MEMLOCK. Reads use unregistered buffers then.
+                if (registered_buf && registered_buf_size > 0) {
+                    std::vector<iovec> iovs;
+                    for (uint64_t off = 0; off < registered_buf_size;
+                         off += kRegisteredBufChunkSize) {
+                        iovec iov = {};
+                        iov.iov_base = registered_buf + off;
+                        iov.iov_len = std::min(kRegisteredBufChunkSize,
+                                               registered_buf_size - off);
+                        iovs.push_back(iov);
+                    }
+                    int ret = (int) syscall(__NR_io_uring_register, ring_fd_,
+                                            IORING_REGISTER_BUFFERS,
+                                            iovs.data(), iovs.size());
+                    if (ret == 0) {
+                        registered_buf_ = registered_buf;
+                        registered_buf_size_ = registered_buf_size;
+                    } else {
+                        NOVA_LOG(rdmaio::INFO)
+                            << fmt::format(
+                                    "io_uring cannot register buffers: {}",
+                                    strerror(errno));
+                    }
+                }
+                reaper_ = std::thread(&IoUringIOEngine::Reap, this);
+                return true;
+            }
+
+            void Submit(StoCIORequest *request) override {
+                num_inflight_ += 1;
+                if (request->type == kStoCIOCall) {
+                    call_pool_.Submit(request);
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(sq_mutex_);
+                if (num_ring_inflight_ < sq_entries_) {
+                    Prepare(request);
+                } else {
+                    backlog_.push_back(request);
+                }
+            }
+
+            void Flush() override {
+                std::lock_guard<std::mutex> lock(sq_mutex_);
+                FlushLocked();
+            }
+
+            const char *Name() const override {
+                return "io_uring";
+            }
+
+        private:
+            // Requires sq_mutex_.
+            io_uring_sqe *NextSqe() {
+                unsigned tail = *sq_tail_;
+                unsigned index = tail & sq_mask_;
+                io_uring_sqe *sqe = &sqes_[index];
+                memset(sqe, 0, sizeof(io_uring_sqe));
+                sq_array_[index] = index;
+                __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+                num_unsubmitted_ += 1;
+                return sqe;
+            }
+
+            // Requires sq_mutex_.
+            void Prepare(StoCIORequest *request) {
+                io_uring_sqe *sqe = NextSqe();
+                sqe->fd = request->fd;
+                sqe->off = request->offset;
+                sqe->user_data = reinterpret_cast<uint64_t>(request);
+                num_ring_inflight_ += 1;
+                if (request->type == kStoCIOSync) {
+                    sqe->opcode = IORING_OP_FSYNC;
+                    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+                    return;
+                }
+                bool write = request->type == kStoCIOWrite;
+                uint64_t start = 0;
+                bool fixed = false;
+                if (registered_buf_ && request->buf >= registered_buf_) {
+                    // A registered read may not cross two chunks.
+                    start = (uint64_t) (request->buf - registered_buf_);
+                    fixed = request->size > 0 &&
+                            start + request->size <= registered_buf_size_ &&
+                            start / kRegisteredBufChunkSize ==
+                            (start + request->size - 1) / kRegisteredBufChunkSize;
+                }
+                if (fixed) {
+                    sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+                    sqe->addr = reinterpret_cast<uint64_t>(request->buf);
+                    sqe->len = request->size;
+                    sqe->buf_index = start / kRegisteredBufChunkSize;
+                } else {
+                    request->iov.iov_base = request->buf;
+                    request->iov.iov_len = request->size;
+                    sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+                    sqe->addr = reinterpret_cast<uint64_t>(&request->iov);
+                    sqe->len = 1;
+                }
+            }
+
+            // Requires sq_mutex_.
+            void FlushLocked() {
+                while (num_unsubmitted_ > 0) {
+                    int ret = (int) syscall(__NR_io_uring_enter, ring_fd_,
+                                            num_unsubmitted_, 0, 0, nullptr,
+                                            0);
+                    if (ret < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        // The completion queue is full. The reaper
+                        // flushes again once it reaps completions.
+                        NOVA_ASSERT(errno == EAGAIN || errno == EBUSY)
+                            << fmt::format("io_uring_enter failed: {}",
+                                           strerror(errno));
+                        return;
+                    }
+                    num_unsubmitted_ -= ret;
+                }
+            }
+
+            void Reap() {
+                std::vector<StoCIORequest *> completed;
+                while (true) {
+                    int ret = (int) syscall(__NR_io_uring_enter, ring_fd_, 0,
+                                            1, IORING_ENTER_GETEVENTS,
+                                            nullptr, 0);
+                    NOVA_ASSERT(ret >= 0 || errno == EINTR || errno == EAGAIN ||
+                                errno == EBUSY)
+                        << fmt::format("io_uring_enter failed: {}",
+                                       strerror(errno));
+                    completed.clear();
+                    unsigned head = *cq_head_;
+                    unsigned tail = __atomic_load_n(cq_tail_,
+                                                    __ATOMIC_ACQUIRE);
+                    uint32_t reaped = 0;
+                    while (head != tail) {
+                        io_uring_cqe *cqe = &cqes_[head & cq_mask_];
+                        auto request = reinterpret_cast<StoCIORequest *>(cqe->user_data);
+                        if (request) {
+                            request->result = cqe->res;
+                            completed.push_back(request);
+                        }
+                        head++;
+                        reaped++;
+                    }
+                    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+                    for (auto request : completed) {
+                        Complete(request);
+                    }
+
+                    std::lock_guard<std::mutex> lock(sq_mutex_);
+                    num_ring_inflight_ -= reaped;
+                    while (!backlog_.empty() &&
+                           num_ring_inflight_ < sq_entries_) {
+                        Prepare(backlog_.front());
+                        backlog_.pop_front();
+                    }
+                    FlushLocked();
+                    if (stop_ && num_ring_inflight_ == 0) {
+                        return;
+                    }
+                }
+            }
+
+            int ring_fd_ = -1;
+            void *sq_ring_ = nullptr;
+            void *cq_ring_ = nullptr;
+            size_t sq_ring_size_ = 0;
+            size_t cq_ring_size_ = 0;
+            size_t sqes_size_ = 0;
+
+            unsigned *sq_head_ = nullptr;
+            unsigned *sq_tail_ = nullptr;
+            unsigned *sq_array_ = nullptr;
+            unsigned sq_mask_ = 0;
+            uint32_t sq_entries_ = 0;
+            io_uring_sqe *sqes_ = nullptr;
+
+            unsigned *cq_head_ = nullptr;
+            unsigned *cq_tail_ = nullptr;
+            unsigned cq_mask_ = 0;
+            io_uring_cqe *cqes_ = nullptr;
+
+            char *registered_buf_ = nullptr;
+            uint64_t registered_buf_size_ = 0;
+
+            std::mutex sq_mutex_;
+            uint32_t num_unsubmitted_ = 0;
+            // Number of requests in the submission and completion queues.
+            uint32_t num_ring_inflight_ = 0;
+            std::list<StoCIORequest *> backlog_;
+            bool stop_ = false;
+            std::thread reaper_;
+            StoCIOThreadPool call_pool_;
+        };
+
+#endif
+    }
+
+    StoCIOEngine *StoCIOEngine::NewEngine(const std::string &type,
+                                          uint32_t queue_depth,
+                                          uint32_t num_threads,
+                                          char *registered_buf,
+                                          uint64_t registered_buf_size,
+                                          std::function<void(void)> notify) {
+        if (type == "io_uring") {
+#ifdef NOVA_HAVE_IO_URING
+            auto engine = new IoUringIOEngine(num_threads, notify);
+            if (engine->Init(queue_depth, registered_buf,
+                             registered_buf_size)) {
+                return engine;
+            }
+            delete engine;
+#endif
+            NOVA_LOG(rdmaio::WARNING)
+                << "io_uring is not supported. Fall back to a thread pool.";
+            // Keep queue_depth reads in flight.
+            return new ThreadPoolIOEngine(std::max(num_threads, queue_depth),
+                                          notify);
+        } else if (type == "threadpool") {
+            return new ThreadPoolIOEngine(num_threads, notify);
+        }
+        NOVA_ASSERT(type.empty() || type == "sync") << type;
+        return nullptr;
+    }
+}
@@ -0,0 +1,127 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#ifndef LEVELDB_STOC_IO_ENGINE_H
+#define LEVELDB_STOC_IO_ENGINE_H
+
+#include <sys/uio.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace leveldb {
+
+    enum StoCIORequestType {
+        kStoCIORead = 0,
+        // A blocking call, e.g., persist a StoC file.
+        kStoCIOCall = 1,
+        kStoCIOWrite = 2,
+        // fdatasync.
+        kStoCIOSync = 3,
+    };
+
+    struct StoCIORequest {
+        StoCIORequestType type = kStoCIORead;
+
+        // Read and write requests. A sync request only uses fd.
+        int fd = -1;
+        char *buf = nullptr;
+        uint64_t offset = 0;
+        uint32_t size = 0;
+
+        // Call request. Its return value becomes the result.
+        std::function<int64_t(void)> call;
+
+        // Number of bytes read or written or -errno for a read or write
+        // request.
+        int64_t result = 0;
+
+        // Owned by the caller.
+        void *context = nullptr;
+
+        // Invoked by the engine once the request completes, before the
+        // worker polls it.
+        std::function<void(void)> done;
+
+        struct iovec iov = {};
+    };
+
+    // Runs blocking requests on a pool of threads.
+    class StoCIOThreadPool {
+    public:
+        StoCIOThreadPool(uint32_t num_threads,
+                         std::function<void(StoCIORequest *)> complete);
+
+        ~StoCIOThreadPool();
+
+        void Submit(StoCIORequest *request);
+
+    private:
+        void Run();
+
+        std::function<void(StoCIORequest *)> complete_;
+        std::vector<std::thread> threads_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::list<StoCIORequest *> queue_;
+        bool stop_ = false;
+    };
+
+    // An asynchronous disk engine of a StoC storage worker. The worker
+    // submits requests and continues to serve other requests. The engine
+    // invokes notify once a request completes. The worker then polls the
+    // completed requests.
+    class StoCIOEngine {
+    public:
+        explicit StoCIOEngine(std::function<void(void)> notify)
+                : notify_(std::move(notify)) {
+            num_inflight_ = 0;
+        }
+
+        virtual ~StoCIOEngine() = default;
+
+        virtual void Submit(StoCIORequest *request) = 0;
+
+        // Issue the submitted requests to disk.
+        virtual void Flush() {}
+
+        virtual const char *Name() const = 0;
+
+        void PollCompletions(std::vector<StoCIORequest *> *completed);
+
+        uint32_t num_inflight() const {
+            return num_inflight_;
+        }
+
+        // Create an engine of the given type: io_uring/threadpool. Return
+        // nullptr for sync or an empty type. It falls back to a thread pool if the kernel does
+        // not support io_uring. Reads into [registered_buf,
+        // registered_buf+registered_buf_size) use registered buffers.
+        static StoCIOEngine *NewEngine(const std::string &type,
+                                       uint32_t queue_depth,
+                                       uint32_t num_threads,
+                                       char *registered_buf,
+                                       uint64_t registered_buf_size,
+                                       std::function<void(void)> notify);
+
+    protected:
+        void Complete(StoCIORequest *request);
+
+        std::atomic_uint_fast32_t num_inflight_;
+
+    private:
+        std::function<void(void)> notify_;
+        std::mutex mutex_;
+        std::vector<StoCIORequest *> completed_;
+    };
+}
+
+#endif //LEVELDB_STOC_IO_ENGINE_H
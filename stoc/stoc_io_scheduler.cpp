@@ -0,0 +1,146 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "stoc_io_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fmt/core.h>
+
+#include "common/nova_console_logging.h"
+#include "leveldb/env.h"
+
+namespace leveldb {
+
+    StoCIOScheduler::StoCIOScheduler(uint32_t max_outstanding,
+                                     const std::vector<uint32_t> &weights,
+                                     const std::vector<uint64_t> &rate_limits)
+            : max_outstanding_(std::max(1u, max_outstanding)) {
+        NOVA_ASSERT(weights.size() == kNumStoCIOClasses) << weights.size();
+        NOVA_ASSERT(rate_limits.size() == kNumStoCIOClasses)
+            << rate_limits.size();
+        for (int i = 0; i < kNumStoCIOClasses; i++) {
+            weights_[i] = std::max(1u, weights[i]);
+            rate_limits_[i] = rate_limits[i];
+            last_finish_tags_[i] = 0;
+            tokens_[i] = rate_limits[i];
+            latencies_[i].Clear();
+        }
+        last_refill_time_ = Env::Default()->NowMicros();
+    }
+
+    const char *StoCIOScheduler::ClassName(StoCIOClass io_class) {
+        switch (io_class) {
+            case kStoCIOForegroundRead:
+                return "fg-read";
+            case kStoCIOLog:
+                return "log";
+            case kStoCIOFlush:
+                return "flush";
+            case kStoCIOCompaction:
+                return "compaction";
+            case kStoCIOReplication:
+                return "replication";
+            default:
+                return "unknown";
+        }
+    }
+
+    void StoCIOScheduler::Refill(uint64_t now) {
+        if (now <= last_refill_time_) {
+            return;
+        }
+        uint64_t elapsed = now - last_refill_time_;
+        last_refill_time_ = now;
+        for (int i = 0; i < kNumStoCIOClasses; i++) {
+            if (rate_limits_[i] == 0) {
+                continue;
+            }
+            // Allow a burst of up to one second.
+            tokens_[i] = std::min((double) rate_limits_[i],
+                                  tokens_[i] + elapsed * rate_limits_[i] / 1000000.0);
+        }
+    }
+
+    StoCIOScheduler::Waiter *StoCIOScheduler::Next() {
+        Waiter *next = nullptr;
+        for (auto waiter : waiters_) {
+            if (rate_limits_[waiter->io_class] > 0 &&
+                tokens_[waiter->io_class] <= 0) {
+                continue;
+            }
+            if (next == nullptr || waiter->finish_tag < next->finish_tag) {
+                next = waiter;
+            }
+        }
+        return next;
+    }
+
+    uint64_t StoCIOScheduler::Acquire(StoCIOClass io_class, uint64_t size) {
+        uint64_t enqueue_time = Env::Default()->NowMicros();
+        std::unique_lock<std::mutex> lock(mutex_);
+        Waiter waiter = {};
+        waiter.io_class = io_class;
+        waiter.size = size;
+        waiter.finish_tag =
+                std::max(virtual_time_, last_finish_tags_[io_class]) +
+                std::max((uint64_t) 1, size) / weights_[io_class];
+        last_finish_tags_[io_class] = waiter.finish_tag;
+        waiters_.push_back(&waiter);
+        while (true) {
+            Refill(Env::Default()->NowMicros());
+            Waiter *next = Next();
+            if (next == &waiter && outstanding_ < max_outstanding_) {
+                break;
+            }
+            if (next != nullptr && outstanding_ < max_outstanding_) {
+                cv_.notify_all();
+            }
+            // Wake up periodically to refill the token buckets.
+            cv_.wait_for(lock, std::chrono::milliseconds(1));
+        }
+        waiters_.remove(&waiter);
+        outstanding_ += 1;
+        virtual_time_ = waiter.finish_tag;
+        if (rate_limits_[io_class] > 0) {
+            tokens_[io_class] -= size;
+        }
+        cv_.notify_all();
+        return enqueue_time;
+    }
+
+    void StoCIOScheduler::Release(StoCIOClass io_class,
+                                  uint64_t enqueue_time) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            NOVA_ASSERT(outstanding_ > 0);
+            outstanding_ -= 1;
+        }
+        cv_.notify_all();
+        uint64_t latency = Env::Default()->NowMicros() - enqueue_time;
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        latencies_[io_class].Add(latency);
+    }
+
+    std::string StoCIOScheduler::Stats() {
+        std::string output;
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        for (int i = 0; i < kNumStoCIOClasses; i++) {
+            Histogram &h = latencies_[i];
+            if (h.num() == 0) {
+                output += fmt::format("stoc-io-{},0,0,0,0\n",
+                                      ClassName((StoCIOClass) i));
+                continue;
+            }
+            output += fmt::format("stoc-io-{},{},{:.1f},{:.1f},{:.1f}\n",
+                                  ClassName((StoCIOClass) i),
+                                  (uint64_t) h.num(), h.Average(),
+                                  h.Percentile(50), h.Percentile(99));
+            h.Clear();
+        }
+        return output;
+    }
+}
@@ -0,0 +1,85 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#ifndef LEVELDB_STOC_IO_SCHEDULER_H
+#define LEVELDB_STOC_IO_SCHEDULER_H
+
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "util/histogram.h"
+
+namespace leveldb {
+
+    enum StoCIOClass {
+        kStoCIOForegroundRead = 0,
+        kStoCIOLog = 1,
+        kStoCIOFlush = 2,
+        kStoCIOCompaction = 3,
+        kStoCIOReplication = 4,
+        kNumStoCIOClasses = 5,
+    };
+
+    // A StoC-wide scheduler that arbitrates the disk among the storage
+    // workers. At most max_outstanding I/Os are issued at a time. Waiting
+    // I/Os are dispatched in the order of their virtual finish tags, i.e.,
+    // self-clocked weighted fair queueing, so that a class with a higher
+    // weight receives a larger share of the disk. A token bucket caps the
+    // throughput of a class with a rate limit.
+    class StoCIOScheduler {
+    public:
+        // weights and rate_limits are indexed by StoCIOClass. A rate limit
+        // is in bytes per second. 0 means unlimited.
+        StoCIOScheduler(uint32_t max_outstanding,
+                        const std::vector<uint32_t> &weights,
+                        const std::vector<uint64_t> &rate_limits);
+
+        // Block until an I/O of size bytes may be issued. Return the time
+        // it was enqueued.
+        uint64_t Acquire(StoCIOClass io_class, uint64_t size);
+
+        // The I/O completed. Its latency includes the queueing delay.
+        void Release(StoCIOClass io_class, uint64_t enqueue_time);
+
+        // Return the latency of each class since the last call.
+        std::string Stats();
+
+        static const char *ClassName(StoCIOClass io_class);
+
+    private:
+        struct Waiter {
+            StoCIOClass io_class;
+            uint64_t size;
+            double finish_tag;
+        };
+
+        void Refill(uint64_t now);
+
+        // The waiter to dispatch next. Requires mutex_.
+        Waiter *Next();
+
+        const uint32_t max_outstanding_;
+        double weights_[kNumStoCIOClasses];
+        uint64_t rate_limits_[kNumStoCIOClasses];
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        uint32_t outstanding_ = 0;
+        double virtual_time_ = 0;
+        double last_finish_tags_[kNumStoCIOClasses];
+        double tokens_[kNumStoCIOClasses];
+        uint64_t last_refill_time_ = 0;
+        std::list<Waiter *> waiters_;
+
+        std::mutex stats_mutex_;
+        Histogram latencies_[kNumStoCIOClasses];
+    };
+}
+
+#endif //LEVELDB_STOC_IO_SCHEDULER_H
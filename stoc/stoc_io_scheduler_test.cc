@@ -0,0 +1,134 @@
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "stoc/stoc_io_scheduler.h"
+
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "leveldb/env.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+    class StoCIOSchedulerTest {
+    public:
+        static std::vector<uint32_t> Weights(uint32_t fg_read, uint32_t compaction) {
+            std::vector<uint32_t> weights(kNumStoCIOClasses, 1);
+            weights[kStoCIOForegroundRead] = fg_read;
+            weights[kStoCIOCompaction] = compaction;
+            return weights;
+        }
+
+        static std::vector<uint64_t> NoRateLimits() {
+            return std::vector<uint64_t>(kNumStoCIOClasses, 0);
+        }
+    };
+
+    TEST(StoCIOSchedulerTest, MaxOutstanding) {
+        StoCIOScheduler scheduler(2, Weights(1, 1), NoRateLimits());
+        std::atomic_int outstanding(0);
+        std::atomic_int max_outstanding(0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; i++) {
+            threads.emplace_back([&]() {
+                for (int j = 0; j < 20; j++) {
+                    uint64_t enqueue_time = scheduler.Acquire(kStoCIOFlush, 4096);
+                    int n = ++outstanding;
+                    int max = max_outstanding;
+                    while (n > max && !max_outstanding.compare_exchange_weak(max, n)) {
+                    }
+                    usleep(200);
+                    outstanding--;
+                    scheduler.Release(kStoCIOFlush, enqueue_time);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        ASSERT_EQ(2, max_outstanding);
+        ASSERT_EQ(0, outstanding);
+    }
+
+    TEST(StoCIOSchedulerTest, WeightedShares) {
+        // One I/O at a time so that the two classes contend for every slot.
+        StoCIOScheduler scheduler(1, Weights(4, 1), NoRateLimits());
+        const uint32_t num_dispatches = 1000;
+        std::mutex mutex;
+        std::vector<StoCIOClass> dispatched;
+        std::atomic_bool done(false);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; i++) {
+            StoCIOClass io_class = i % 2 == 0 ? kStoCIOForegroundRead : kStoCIOCompaction;
+            threads.emplace_back([&, io_class]() {
+                while (!done) {
+                    uint64_t enqueue_time = scheduler.Acquire(io_class, 4096);
+                    mutex.lock();
+                    dispatched.push_back(io_class);
+                    if (dispatched.size() >= num_dispatches) {
+                        done = true;
+                    }
+                    mutex.unlock();
+                    usleep(50);
+                    scheduler.Release(io_class, enqueue_time);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        // Skip the first dispatches while the threads start.
+        uint32_t fg_reads = 0;
+        uint32_t total = 0;
+        for (uint32_t i = num_dispatches / 10; i < num_dispatches; i++) {
+            if (dispatched[i] == kStoCIOForegroundRead) {
+                fg_reads++;
+            }
+            total++;
+        }
+        // Foreground reads receive 4/5 of the disk.
+        double share = (double) fg_reads / total;
+        ASSERT_GE(share, 0.7);
+        ASSERT_LE(share, 0.9);
+    }
+
+    TEST(StoCIOSchedulerTest, RateLimit) {
+        const uint64_t rate = 100 * 1024 * 1024;
+        std::vector<uint64_t> rate_limits = NoRateLimits();
+        rate_limits[kStoCIOCompaction] = rate;
+        StoCIOScheduler scheduler(4, Weights(1, 1), rate_limits);
+        Env *env = Env::Default();
+
+        // The bucket starts with one second worth of bytes.
+        uint64_t start = env->NowMicros();
+        for (int i = 0; i < 10; i++) {
+            scheduler.Release(kStoCIOCompaction, scheduler.Acquire(kStoCIOCompaction, rate / 10));
+        }
+        ASSERT_LT(env->NowMicros() - start, 100000);
+
+        // The bucket is empty. Each I/O then waits for the bytes of the
+        // previous one, about 100 ms.
+        start = env->NowMicros();
+        for (int i = 0; i < 4; i++) {
+            scheduler.Release(kStoCIOCompaction, scheduler.Acquire(kStoCIOCompaction, rate / 10));
+        }
+        uint64_t elapsed = env->NowMicros() - start;
+        ASSERT_GE(elapsed, 250000);
+        ASSERT_LT(elapsed, 2000000);
+
+        // Classes without a rate limit are not throttled.
+        start = env->NowMicros();
+        for (int i = 0; i < 100; i++) {
+            scheduler.Release(kStoCIOFlush, scheduler.Acquire(kStoCIOFlush, rate / 10));
+        }
+        ASSERT_LT(env->NowMicros() - start, 100000);
+    }
+}
+
+int main(int argc, char **argv) { return leveldb::test::RunAllTests(); }
@@ -8,6 +8,9 @@
 
 #include <fmt/core.h>
 #include <semaphore.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
 #include "db/compaction.h"
 #include "db/table_cache.h"
 
@@ -18,6 +21,16 @@
 #include "db/version_set.h"
 
 namespace nova {
+    struct StorageWorker::StorageIO {
+        leveldb::StoCIORequest request;
+        uint32_t rdma_server_thread_id = 0;
+        ServerCompleteTask ct;
+        leveldb::StoCPersistentFile *stoc_file = nullptr;
+        bool fill_block_cache = false;
+        leveldb::StoCIOClass io_class = leveldb::StoCIOClass::kStoCIOForegroundRead;
+        uint64_t enqueue_time = 0;
+    };
+
     StorageWorker::StorageWorker(
             leveldb::StocPersistentFileManager *stoc_file_manager,
             std::vector<RDMAServerImpl *> &rdma_servers,
@@ -35,6 +48,15 @@ namespace nova {
         stat_read_bytes_ = 0;
         stat_write_bytes_ = 0;
         sem_init(&sem_, 0, 0);
+        io_engine_ = leveldb::StoCIOEngine::NewEngine(
+                NovaConfig::config->stoc_io_engine,
+                NovaConfig::config->stoc_io_queue_depth,
+                NovaConfig::config->stoc_io_threads,
+                NovaConfig::config->nova_buf,
+                NovaConfig::config->nnovabuf,
+                [this]() {
+                    sem_post(&sem_);
+                });
     }
 
     void StorageWorker::AddTask(
@@ -47,18 +69,81 @@ namespace nova {
         sem_post(&sem_);
     }
 
+    struct StorageWorker::InflightReplication {
+        uint32_t result_index = 0;
+        uint32_t req_id = 0;
+        char *buf = nullptr;
+        uint32_t scid = 0;
+        uint64_t size = 0;
+    };
+
+    void StorageWorker::ReapReplications(
+            std::list<InflightReplication> *inflight,
+            std::vector<leveldb::ReplicationPair> *replication_results,
+            uint64_t *inflight_bytes) {
+        auto client = reinterpret_cast<leveldb::StoCBlockClient *>(client_);
+        auto it = inflight->begin();
+        while (it != inflight->end()) {
+            leveldb::StoCResponse response;
+            if (!client->IsDone(it->req_id, &response, nullptr)) {
+                it++;
+                continue;
+            }
+            auto &result = (*replication_results)[it->result_index];
+            NOVA_ASSERT(response.stoc_block_handles.size() == 1)
+                << fmt::format("{} {}", it->req_id, response.stoc_block_handles.size());
+            result.dest_stoc_file_id = response.stoc_block_handles[0].stoc_file_id;
+            NOVA_ASSERT(response.stoc_block_handles[0].server_id == result.dest_stoc_id);
+            NOVA_ASSERT(response.stoc_block_handles[0].offset == 0);
+            NOVA_ASSERT(response.stoc_block_handles[0].size == result.source_file_size);
+            mem_manager_->FreeItem(0, it->buf, it->scid);
+            *inflight_bytes -= it->size;
+            it = inflight->erase(it);
+        }
+    }
+
     std::vector<leveldb::ReplicationPair> StorageWorker::ReplicateSSTables(
             const std::string &dbname,
             const std::vector<leveldb::ReplicationPair> &replication_pairs) {
-        std::vector<char *> bufs;
-        std::vector<uint32_t> reqs;
+        // Pipeline the replication. The worker reads the next file from disk
+        // while the previous files are being written to their destination
+        // StoCs. At most stoc_replication_window_mb bytes are in flight.
         auto client = reinterpret_cast<leveldb::StoCBlockClient *>(client_);
+        const uint64_t window_bytes =
+                (uint64_t) nova::NovaConfig::config->stoc_replication_window_mb * 1024 * 1024;
+        const uint64_t rate_bytes_per_sec =
+                (uint64_t) nova::NovaConfig::config->stoc_replication_rate_mb * 1024 * 1024;
         std::vector<leveldb::ReplicationPair> replication_results;
+        std::list<InflightReplication> inflight;
+        uint64_t inflight_bytes = 0;
+        uint32_t num_reqs = 0;
+        uint32_t num_waits = 0;
+        uint64_t replicated_bytes = 0;
+        timeval start{};
+        gettimeofday(&start, nullptr);
         for (int i = 0; i < replication_pairs.size(); i++) {
             const auto &pair = replication_pairs[i];
+            while (!inflight.empty() &&
+                   inflight_bytes + pair.source_file_size > window_bytes) {
+                client->Wait();
+                num_waits += 1;
+                ReapReplications(&inflight, &replication_results, &inflight_bytes);
+            }
+            if (rate_bytes_per_sec > 0) {
+                // Throttle the replication so that it does not starve
+                // foreground requests.
+                timeval now{};
+                gettimeofday(&now, nullptr);
+                uint64_t elapsed = (now.tv_sec - start.tv_sec) * 1000000 +
+                                   (now.tv_usec - start.tv_usec);
+                uint64_t expected = replicated_bytes * 1000000 / rate_bytes_per_sec;
+                if (expected > elapsed) {
+                    usleep(expected - elapsed);
+                }
+            }
+
             uint32_t scid = mem_manager_->slabclassid(0, pair.source_file_size);
             char *buf = mem_manager_->ItemAlloc(0, scid);
-            bufs.push_back(buf);
 
             leveldb::StoCBlockHandle handle;
             handle.server_id = nova::NovaConfig::config->my_server_id;
@@ -67,51 +152,174 @@ namespace nova {
             handle.size = pair.source_file_size;
 
             leveldb::Slice result;
+            uint64_t enqueue_time = AcquireIO(leveldb::StoCIOClass::kStoCIOReplication,
+                                              pair.source_file_size);
             bool success = stoc_file_manager_->ReadDataBlockForReplication(handle, 0,
                                                                            pair.source_file_size,
                                                                            buf, &result);
+            ReleaseIO(leveldb::StoCIOClass::kStoCIOReplication, enqueue_time);
             NOVA_LOG(DEBUG)
                 << fmt::format("Initiate replicate {} success:{}", pair.DebugString(), success);
-            if (success) {
-                stat_read_bytes_ += pair.source_file_size;
-                NOVA_ASSERT(result.size() == pair.source_file_size)
-                    << fmt::format("{} {} {}", pair.source_stoc_file_id,
-                                   pair.source_file_size, result.size());
-                uint32_t place_holder;
-                uint32_t req_id = client->InitiateAppendBlock(
-                        pair.dest_stoc_id, 0,
-                        &place_holder,
-                        buf,
-                        dbname,
-                        pair.sstable_file_number,
-                        pair.replica_id,
-                        pair.source_file_size,
-                        pair.internal_type);
-                reqs.push_back(req_id);
-                replication_results.push_back(pair);
+            if (!success) {
+                mem_manager_->FreeItem(0, buf, scid);
+                continue;
             }
+            stat_read_bytes_ += pair.source_file_size;
+            NOVA_ASSERT(result.size() == pair.source_file_size)
+                << fmt::format("{} {} {}", pair.source_stoc_file_id,
+                               pair.source_file_size, result.size());
+            uint32_t place_holder;
+            uint32_t req_id = client->InitiateAppendBlock(
+                    pair.dest_stoc_id, 0,
+                    &place_holder,
+                    buf,
+                    dbname,
+                    pair.sstable_file_number,
+                    pair.replica_id,
+                    pair.source_file_size,
+                    pair.internal_type);
+            InflightReplication repl = {};
+            repl.result_index = replication_results.size();
+            repl.req_id = req_id;
+            repl.buf = buf;
+            repl.scid = scid;
+            repl.size = pair.source_file_size;
+            inflight.push_back(repl);
+            inflight_bytes += pair.source_file_size;
+            replicated_bytes += pair.source_file_size;
+            replication_results.push_back(pair);
+            num_reqs += 1;
         }
-        for (int i = 0; i < reqs.size(); i++) {
+        for (; num_waits < num_reqs; num_waits++) {
             client->Wait();
         }
-        for (int i = 0; i < reqs.size(); i++) {
-            leveldb::StoCResponse response;
-            NOVA_ASSERT(client->IsDone(reqs[i], &response, nullptr));
-            NOVA_ASSERT(response.stoc_block_handles.size() == 1)
-                << fmt::format("{} {}", reqs[i], response.stoc_block_handles.size());
-            replication_results[i].dest_stoc_file_id = response.stoc_block_handles[0].stoc_file_id;
-            NOVA_ASSERT(response.stoc_block_handles[0].server_id == replication_results[i].dest_stoc_id);
-            NOVA_ASSERT(response.stoc_block_handles[0].offset == 0);
-            NOVA_ASSERT(response.stoc_block_handles[0].size == replication_results[i].source_file_size);
+        ReapReplications(&inflight, &replication_results, &inflight_bytes);
+        NOVA_ASSERT(inflight.empty()) << inflight.size();
+        nova::NovaGlobalVariables::global.stoc_replicated_bytes += replicated_bytes;
+        NOVA_LOG(DEBUG) << "All replications complete";
+        return replication_results;
+    }
+
+    uint64_t StorageWorker::PersistStoCFiles(const StorageTask &task,
+                                             ServerCompleteTask *ct) {
+        NOVA_ASSERT(task.persist_pairs.size() == 1);
+        uint64_t persisted_bytes = 0;
+        leveldb::FileType type = leveldb::FileType::kCurrentFile;
+        for (auto &pair : task.persist_pairs) {
+            leveldb::StoCPersistentFile *stoc_file = stoc_file_manager_->FindStoCFile(
+                    pair.stoc_file_id);
+            persisted_bytes += stoc_file->Persist(pair.stoc_file_id);
+            NOVA_LOG(DEBUG) << fmt::format(
+                        "Persisting stoc file {} for sstable {}",
+                        pair.stoc_file_id, pair.sstable_name);
+
+            leveldb::BlockHandle h = stoc_file->Handle(pair.sstable_name, task.internal_type);
+            leveldb::StoCBlockHandle rh = {};
+            rh.server_id = NovaConfig::config->my_server_id;
+            rh.stoc_file_id = pair.stoc_file_id;
+            rh.offset = h.offset();
+            rh.size = h.size();
+            ct->stoc_block_handles.push_back(rh);
+            NOVA_ASSERT(leveldb::ParseFileName(pair.sstable_name, &type));
+            if (type == leveldb::FileType::kTableFile) {
+                stoc_file->ForceSeal();
+            }
         }
+        return persisted_bytes;
+    }
 
-        for (int i = 0; i < replication_pairs.size(); i++) {
-            const auto &pair = replication_pairs[i];
-            uint32_t scid = mem_manager_->slabclassid(0, pair.source_file_size);
-            mem_manager_->FreeItem(0, bufs[i], scid);
+    bool StorageWorker::SubmitRead(const StorageTask &task,
+                                   const ServerCompleteTask &ct) {
+        const leveldb::StoCBlockHandle &handle = task.stoc_block_handle;
+        StorageIO *io = new StorageIO;
+        io->rdma_server_thread_id = task.rdma_server_thread_id;
+        io->ct = ct;
+        io->fill_block_cache = task.fill_block_cache;
+        io->stoc_file = stoc_file_manager_->FindStoCFile(handle.stoc_file_id);
+        NOVA_ASSERT(io->stoc_file) << handle.stoc_file_id;
+        io->request.type = leveldb::StoCIORequestType::kStoCIORead;
+        io->request.fd = io->stoc_file->ReadFd(handle.offset, handle.size,
+                                               task.rdma_buf);
+        io->request.buf = task.rdma_buf;
+        io->request.offset = handle.offset;
+        io->request.size = handle.size;
+        io->request.context = io;
+        io->io_class = task.io_class;
+        io->enqueue_time = AcquireIO(io->io_class, handle.size);
+        io->request.done = [this, io]() {
+            ReleaseIO(io->io_class, io->enqueue_time);
+        };
+        nova::NovaGlobalVariables::global.stoc_queue_depth += 1;
+        nova::NovaGlobalVariables::global.stoc_pending_disk_reads += handle.size;
+        nova::NovaGlobalVariables::global.total_disk_reads += handle.size;
+        io_engine_->Submit(&io->request);
+        return true;
+    }
+
+    void StorageWorker::SubmitPersist(const StorageTask &task,
+                                      const ServerCompleteTask &ct) {
+        StorageIO *io = new StorageIO;
+        io->rdma_server_thread_id = task.rdma_server_thread_id;
+        io->ct = ct;
+        io->request.type = leveldb::StoCIORequestType::kStoCIOCall;
+        io->request.call = [this, task, io]() {
+            return (int64_t) PersistStoCFiles(task, &io->ct);
+        };
+        io->request.context = io;
+        io->io_class = leveldb::StoCIOClass::kStoCIOFlush;
+        io->enqueue_time = AcquireIO(io->io_class,
+                                     nova::NovaConfig::config->sstable_size);
+        io->request.done = [this, io]() {
+            ReleaseIO(io->io_class, io->enqueue_time);
+        };
+        io_engine_->Submit(&io->request);
+    }
+
+    uint64_t StorageWorker::AcquireIO(leveldb::StoCIOClass io_class,
+                                      uint64_t size) {
+        if (!io_scheduler_) {
+            return 0;
         }
-        NOVA_LOG(DEBUG) << "All replications complete";
-        return replication_results;
+        return io_scheduler_->Acquire(io_class, size);
+    }
+
+    void StorageWorker::ReleaseIO(leveldb::StoCIOClass io_class,
+                                  uint64_t enqueue_time) {
+        if (!io_scheduler_) {
+            return;
+        }
+        io_scheduler_->Release(io_class, enqueue_time);
+    }
+
+    void StorageWorker::CompleteIO(StorageIO *io) {
+        const leveldb::StoCIORequest &request = io->request;
+        if (request.type == leveldb::StoCIORequestType::kStoCIOCall) {
+            stat_write_bytes_ += request.result;
+            return;
+        }
+        nova::NovaGlobalVariables::global.stoc_queue_depth -= 1;
+        nova::NovaGlobalVariables::global.stoc_pending_disk_reads -= request.size;
+        NOVA_ASSERT(request.result >= 0)
+            << fmt::format("Read stoc file {} failed: {}",
+                           io->stoc_file->stoc_file_name_,
+                           strerror(-request.result));
+        io->ct.size = request.result;
+        stat_read_bytes_ += request.size;
+
+        leveldb::FileType type;
+        NOVA_ASSERT(leveldb::ParseFileName(io->stoc_file->stoc_file_name_, &type));
+        if (type == leveldb::FileType::kTableFile) {
+            NOVA_ASSERT(request.result == request.size)
+                << fmt::format("fn:{} given size:{} read size:{}",
+                               io->stoc_file->stoc_file_name_, request.size,
+                               request.result);
+            if (io->fill_block_cache) {
+                stoc_file_manager_->InsertBlockCache(io->stoc_file,
+                                                     io->ct.stoc_block_handle,
+                                                     request.buf);
+            }
+        }
+        io->stoc_file->ReleaseReadFd();
     }
 
     void StorageWorker::Start() {
@@ -132,11 +340,22 @@ namespace nova {
             }
             mutex_.unlock();
 
-            if (tasks.empty()) {
+            std::vector<leveldb::StoCIORequest *> completed;
+            if (io_engine_) {
+                io_engine_->PollCompletions(&completed);
+            }
+
+            if (tasks.empty() && completed.empty()) {
                 continue;
             }
 
             std::map<uint32_t, std::vector<ServerCompleteTask>> t_tasks;
+            for (auto request : completed) {
+                auto io = reinterpret_cast<StorageIO *>(request->context);
+                CompleteIO(io);
+                t_tasks[io->rdma_server_thread_id].push_back(io->ct);
+                delete io;
+            }
             for (auto &task : tasks) {
                 stat_tasks_ += 1;
                 ServerCompleteTask ct = {};
@@ -149,40 +368,38 @@ namespace nova {
 
                 if (task.request_type ==
                     leveldb::StoCRequestType::STOC_READ_BLOCKS) {
-                    leveldb::Slice result;
-                    stoc_file_manager_->ReadDataBlock(task.stoc_block_handle,
-                                                      task.stoc_block_handle.offset,
-                                                      task.stoc_block_handle.size,
-                                                      task.rdma_buf, &result);
-                    ct.size = result.size();
-                    NOVA_ASSERT(result.size() <= task.stoc_block_handle.size);
-                    stat_read_bytes_ += task.stoc_block_handle.size;
+                    if (stoc_file_manager_->LookupBlockCache(task.stoc_block_handle,
+                                                             task.rdma_buf)) {
+                        ct.size = task.stoc_block_handle.size;
+                    } else if (io_engine_ && SubmitRead(task, ct)) {
+                        continue;
+                    } else {
+                        leveldb::Slice result;
+                        uint64_t enqueue_time = AcquireIO(task.io_class,
+                                                          task.stoc_block_handle.size);
+                        stoc_file_manager_->ReadUncachedDataBlock(task.stoc_block_handle,
+                                                                  task.stoc_block_handle.offset,
+                                                                  task.stoc_block_handle.size,
+                                                                  task.rdma_buf, &result,
+                                                                  task.fill_block_cache);
+                        ReleaseIO(task.io_class, enqueue_time);
+                        ct.size = result.size();
+                        NOVA_ASSERT(result.size() <= task.stoc_block_handle.size);
+                        stat_read_bytes_ += task.stoc_block_handle.size;
+                    }
                 } else if (task.request_type ==
                            leveldb::StoCRequestType::STOC_PERSIST) {
-                    NOVA_ASSERT(task.persist_pairs.size() == 1);
-                    leveldb::FileType type = leveldb::FileType::kCurrentFile;
-                    for (auto &pair : task.persist_pairs) {
-                        leveldb::StoCPersistentFile *stoc_file = stoc_file_manager_->FindStoCFile(
-                                pair.stoc_file_id);
-                        uint64_t persisted_bytes = stoc_file->Persist(
-                                pair.stoc_file_id);
-                        stat_write_bytes_ += persisted_bytes;
-                        NOVA_LOG(DEBUG) << fmt::format(
-                                    "Persisting stoc file {} for sstable {}",
-                                    pair.stoc_file_id, pair.sstable_name);
-
-                        leveldb::BlockHandle h = stoc_file->Handle(pair.sstable_name, task.internal_type);
-                        leveldb::StoCBlockHandle rh = {};
-                        rh.server_id = NovaConfig::config->my_server_id;
-                        rh.stoc_file_id = pair.stoc_file_id;
-                        rh.offset = h.offset();
-                        rh.size = h.size();
-                        ct.stoc_block_handles.push_back(rh);
-                        NOVA_ASSERT(leveldb::ParseFileName(pair.sstable_name, &type));
-                        if (type == leveldb::FileType::kTableFile) {
-                            stoc_file->ForceSeal();
-                        }
+                    if (io_engine_) {
+                        SubmitPersist(task, ct);
+                        continue;
                     }
+                    // The size of a persist is unknown until it runs. Charge
+                    // it as one SSTable.
+                    uint64_t enqueue_time = AcquireIO(
+                            leveldb::StoCIOClass::kStoCIOFlush,
+                            nova::NovaConfig::config->sstable_size);
+                    stat_write_bytes_ += PersistStoCFiles(task, &ct);
+                    ReleaseIO(leveldb::StoCIOClass::kStoCIOFlush, enqueue_time);
                 } else if (task.request_type ==
                            leveldb::StoCRequestType::STOC_REPLICATE_SSTABLES) {
                     ct.replication_results = ReplicateSSTables(task.dbname, task.replication_pairs);
@@ -258,6 +475,9 @@ namespace nova {
                             ct.request_type);
                 t_tasks[task.rdma_server_thread_id].push_back(ct);
             }
+            if (io_engine_) {
+                io_engine_->Flush();
+            }
 
             for (auto &it : t_tasks) {
                 rdma_servers_[it.first]->AddCompleteTasks(it.second);
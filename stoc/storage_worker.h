@@ -8,6 +8,7 @@
 #define LEVELDB_STORAGE_WORKER_H
 
 #include <semaphore.h>
+#include <list>
 
 #include "leveldb/db_types.h"
 #include "db/table_cache.h"
@@ -16,6 +17,8 @@
 #include "common/nova_mem_manager.h"
 #include "log/stoc_log_manager.h"
 #include "stoc/persistent_stoc_file.h"
+#include "stoc/stoc_io_engine.h"
+#include "stoc/stoc_io_scheduler.h"
 #include "novalsm/rdma_server.h"
 
 namespace nova {
@@ -78,7 +81,35 @@ namespace nova {
         uint32_t stat_tasks_ = 0;
         uint64_t stat_read_bytes_ = 0;
         uint64_t stat_write_bytes_ = 0;
+        // Shared by all storage workers. nullptr if disabled.
+        leveldb::StoCIOScheduler *io_scheduler_ = nullptr;
     private:
+        // A request served by io_engine_.
+        struct StorageIO;
+
+        // A replicated file whose write to the destination StoC is in flight.
+        struct InflightReplication;
+
+        // Record the completed replications and release their buffers.
+        void ReapReplications(std::list<InflightReplication> *inflight,
+                              std::vector<leveldb::ReplicationPair> *replication_results,
+                              uint64_t *inflight_bytes);
+
+        uint64_t PersistStoCFiles(const StorageTask &task,
+                                  ServerCompleteTask *ct);
+
+        bool SubmitRead(const StorageTask &task, const ServerCompleteTask &ct);
+
+        void SubmitPersist(const StorageTask &task,
+                           const ServerCompleteTask &ct);
+
+        void CompleteIO(StorageIO *io);
+
+        // Wait for io_scheduler_ to admit an I/O. Return its enqueue time.
+        uint64_t AcquireIO(leveldb::StoCIOClass io_class, uint64_t size);
+
+        void ReleaseIO(leveldb::StoCIOClass io_class, uint64_t enqueue_time);
+
         leveldb::StocPersistentFileManager *stoc_file_manager_;
         std::vector<RDMAServerImpl *> rdma_servers_;
 
@@ -96,6 +127,10 @@ namespace nova {
         std::mutex mutex_;
         std::list<StorageTask> queue_;
         sem_t sem_;
+
+        // Serves reads and persists asynchronously. nullptr if the worker
+        // serves them synchronously.
+        leveldb::StoCIOEngine *io_engine_ = nullptr;
     };
 }
 
@@ -16,6 +16,7 @@
 #include "util/logging.h"
 #include "db/dbformat.h"
 #include "common/nova_common.h"
+#include "common/nova_config.h"
 
 namespace leveldb {
 
@@ -184,16 +185,12 @@ namespace leveldb {
                 Seek(target);
             }
             auto userkey = ExtractUserKey(target);
-            uint64_t userkeyint;
-            nova::str_to_int(userkey.data(), &userkeyint, userkey.size());
             while (Valid()) {
                 auto pivot = ExtractUserKey(key());
-                uint64_t pivot_uk;
-                nova::str_to_int(pivot.data(), &pivot_uk, pivot.size());
                 NOVA_LOG(rdmaio::DEBUG)
                     << fmt::format("Block skip:{} {}", userkey.ToString(),
-                                   pivot_uk);
-                if (pivot_uk > userkeyint) {
+                                   pivot.ToString());
+                if (nova::KeySpace::Compare(pivot, userkey) > 0) {
                     return;
                 }
                 ParseNextKey();
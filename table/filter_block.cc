@@ -15,13 +15,17 @@ namespace leveldb {
 
 // Generate new filter every 2KB of data
     static const size_t kFilterBaseLg = 11;
-    static const size_t kFilterBase = 1 << kFilterBaseLg;
+// A whole-table filter covers offsets up to 4GB, i.e., the entire SSTable.
+    static const size_t kWholeTableFilterBaseLg = 32;
 
-    FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy *policy)
-            : policy_(policy) {}
+    FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy *policy,
+                                           bool whole_table_filter)
+            : policy_(policy),
+              base_lg_(whole_table_filter ? kWholeTableFilterBaseLg
+                                          : kFilterBaseLg) {}
 
     void FilterBlockBuilder::StartBlock(uint64_t block_offset) {
-        uint64_t filter_index = (block_offset / kFilterBase);
+        uint64_t filter_index = (block_offset >> base_lg_);
         assert(filter_index >= filter_offsets_.size());
         while (filter_index > filter_offsets_.size()) {
             GenerateFilter();
@@ -46,7 +50,7 @@ namespace leveldb {
         }
         PutFixed32(&result_, filter_offsets_.size());
         PutFixed32(&result_, filter_block_size);
-        result_.push_back(kFilterBaseLg);  // Save encoding parameter in result
+        result_.push_back(base_lg_);  // Save encoding parameter in result
         return Slice(result_);
     }
 
@@ -89,7 +93,8 @@ namespace leveldb {
         filter_size_ = DecodeFixed32(contents.data() + n - 5);
         uint32_t num_filter_offsets = DecodeFixed32(contents.data() + n - 9);
 
-        NOVA_ASSERT(base_lg_ == kFilterBaseLg);
+        NOVA_ASSERT(base_lg_ == kFilterBaseLg ||
+                    base_lg_ == kWholeTableFilterBaseLg) << base_lg_;
         uint32_t size = filter_size_ + num_filter_offsets * 4 + 4 + 4 + 1;
         NOVA_ASSERT(size == n) << fmt::format("{} {}", size, n);
         data_ = contents.data();
@@ -102,7 +107,7 @@ namespace leveldb {
 
     bool
     FilterBlockReader::KeyMayMatch(uint64_t block_offset, const Slice &key) {
-        uint64_t index = block_offset / kFilterBase;
+        uint64_t index = block_offset >> base_lg_;
         if (index >= filter_offsets_.size()) {
             return true;
         }
@@ -118,7 +123,7 @@ namespace leveldb {
     std::string FilterBlockReader::DebugString(uint64_t block_offset,
                                                const leveldb::Slice &key) {
         std::string debug;
-        uint64_t index = block_offset / kFilterBase;
+        uint64_t index = block_offset >> base_lg_;
         if (index < filter_offsets_.size()) {
             uint32_t start = filter_offsets_[index];
             uint32_t end = filter_size_;
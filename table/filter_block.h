@@ -30,7 +30,10 @@ namespace leveldb {
 //      (StartBlock AddKey*)* Finish
     class FilterBlockBuilder {
     public:
-        explicit FilterBlockBuilder(const FilterPolicy *);
+        // If whole_table_filter is true, generate one filter for all keys of
+        // the table instead of one filter every 2KB of data.
+        explicit FilterBlockBuilder(const FilterPolicy *,
+                                    bool whole_table_filter = false);
 
         FilterBlockBuilder(const FilterBlockBuilder &) = delete;
 
@@ -46,6 +49,7 @@ namespace leveldb {
         void GenerateFilter();
 
         const FilterPolicy *policy_;
+        const size_t base_lg_;
         std::string keys_;             // Flattened key contents
         std::vector<size_t> start_;    // Starting index in keys_ of each key
         std::string result_;           // Filter data computed so far
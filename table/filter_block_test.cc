@@ -121,6 +121,27 @@ namespace leveldb {
         ASSERT_TRUE(!reader.KeyMayMatch(9000, "bar"));
     }
 
+    TEST(FilterBlockTest, WholeTable) {
+        FilterBlockBuilder builder(policy_, true);
+        builder.StartBlock(0);
+        builder.AddKey("foo");
+        builder.StartBlock(3100);
+        builder.AddKey("box");
+        builder.StartBlock(9000);
+        builder.AddKey("hello");
+
+        Slice block = builder.Finish();
+        FilterBlockReader reader(policy_, block);
+
+        // All blocks share one filter.
+        ASSERT_TRUE(reader.KeyMayMatch(0, "foo"));
+        ASSERT_TRUE(reader.KeyMayMatch(0, "box"));
+        ASSERT_TRUE(reader.KeyMayMatch(3100, "hello"));
+        ASSERT_TRUE(reader.KeyMayMatch(9000, "foo"));
+        ASSERT_TRUE(!reader.KeyMayMatch(0, "bar"));
+        ASSERT_TRUE(!reader.KeyMayMatch(9000, "bar"));
+    }
+
 }  // namespace leveldb
 
 int main(int argc, char **argv) { return leveldb::test::RunAllTests(); }
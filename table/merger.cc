@@ -44,11 +44,8 @@ namespace leveldb {
 
             void SkipToNextUserKey(const Slice &target) override {
                 for (int i = 0; i < n_; i++) {
-                    uint64_t uk;
-                    auto user = ExtractUserKey(target);
-                    nova::str_to_int(user.data(), &uk, user.size());
                     NOVA_LOG(rdmaio::DEBUG)
-                        << fmt::format("Merge skip {} key:{}", i, uk);
+                        << fmt::format("Merge skip {} key:{}", i, ExtractUserKey(target).ToString());
                     children_[i].SkipToNextUserKey(target);
                 }
                 FindSmallest();
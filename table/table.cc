@@ -511,6 +511,10 @@ namespace leveldb {
         return ReadBlock(buf, contents, options, stoc_block_handle, result);
     }
 
+    uint64_t Table::cache_id() const {
+        return rep_->cache_id;
+    }
+
     uint64_t Table::ApproximateOffsetOf(const Slice &key) const {
         Iterator *index_iter =
                 rep_->index_block->NewIterator(rep_->options.comparator);
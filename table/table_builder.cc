@@ -34,7 +34,8 @@ namespace leveldb {
                   closed(false),
                   filter_block(opt.filter_policy == nullptr
                                ? nullptr
-                               : new FilterBlockBuilder(opt.filter_policy)),
+                               : new FilterBlockBuilder(opt.filter_policy,
+                                                        opt.whole_table_filter)),
                   pending_index_entry(false) {
             index_block_options.block_restart_interval = 1;
         }
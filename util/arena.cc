@@ -4,22 +4,144 @@
 
 #include "util/arena.h"
 
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fmt/core.h>
+
 namespace leveldb {
 
     static const int kBlockSize = 4096;
 
-    Arena::Arena()
-            : alloc_ptr_(nullptr), alloc_bytes_remaining_(0),
+    ArenaChunkPool *ArenaChunkPool::pool = nullptr;
+
+    ArenaChunkPool::ArenaChunkPool(uint64_t max_pooled_bytes)
+            : max_pooled_chunks_(max_pooled_bytes / kChunkSize) {
+    }
+
+    uint32_t ArenaChunkPool::CurrentNode() {
+        unsigned cpu = 0;
+        unsigned node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+            return 0;
+        }
+        return node;
+    }
+
+    char *ArenaChunkPool::MapChunk(bool *huge_pages) {
+        // Reserved huge pages.
+        void *chunk = mmap(nullptr, kChunkSize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                           MAP_POPULATE, -1, 0);
+        if (chunk != MAP_FAILED) {
+            *huge_pages = true;
+            return (char *) chunk;
+        }
+        // Transparent huge pages require a chunk aligned to its size.
+        *huge_pages = false;
+        char *region = (char *) mmap(nullptr, 2 * kChunkSize,
+                                     PROT_READ | PROT_WRITE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            return nullptr;
+        }
+        uintptr_t aligned = ((uintptr_t) region + kChunkSize - 1) &
+                            ~(uintptr_t) (kChunkSize - 1);
+        char *start = (char *) aligned;
+        if (start > region) {
+            munmap(region, start - region);
+        }
+        char *end = region + 2 * kChunkSize;
+        if (end > start + kChunkSize) {
+            munmap(start + kChunkSize, end - start - kChunkSize);
+        }
+        madvise(start, kChunkSize, MADV_HUGEPAGE);
+        // Fault in the chunk on this thread so that it is local to its
+        // NUMA node.
+        for (size_t offset = 0; offset < kChunkSize; offset += kBlockSize) {
+            start[offset] = 0;
+        }
+        return start;
+    }
+
+    char *ArenaChunkPool::Allocate() {
+        uint32_t node = CurrentNode();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (node < free_chunks_.size() && !free_chunks_[node].empty()) {
+                char *chunk = free_chunks_[node].back();
+                free_chunks_[node].pop_back();
+                npooled_chunks_--;
+                nreused_chunks_++;
+                return chunk;
+            }
+        }
+        bool huge_pages = false;
+        char *chunk = MapChunk(&huge_pages);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (chunk == nullptr) {
+            // Use a chunk of another node.
+            for (auto &chunks : free_chunks_) {
+                if (!chunks.empty()) {
+                    chunk = chunks.back();
+                    chunks.pop_back();
+                    npooled_chunks_--;
+                    nreused_chunks_++;
+                    return chunk;
+                }
+            }
+            return nullptr;
+        }
+        chunk_nodes_[chunk] = node;
+        if (huge_pages) {
+            nhuge_chunks_++;
+        }
+        return chunk;
+    }
+
+    void ArenaChunkPool::Free(char *chunk) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (npooled_chunks_ >= max_pooled_chunks_) {
+            chunk_nodes_.erase(chunk);
+            munmap(chunk, kChunkSize);
+            return;
+        }
+        uint32_t node = chunk_nodes_[chunk];
+        if (node >= free_chunks_.size()) {
+            free_chunks_.resize(node + 1);
+        }
+        free_chunks_[node].push_back(chunk);
+        npooled_chunks_++;
+    }
+
+    std::string ArenaChunkPool::Stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return fmt::format("arena-chunks,{},{},{},{}\n",
+                           chunk_nodes_.size(), npooled_chunks_,
+                           nhuge_chunks_, nreused_chunks_);
+    }
+
+    uint64_t ArenaChunkPool::MappedBytes() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return chunk_nodes_.size() * kChunkSize;
+    }
+
+    Arena::Arena(ArenaChunkPool *pool)
+            : pool_(pool), alloc_ptr_(nullptr), alloc_bytes_remaining_(0),
               memory_usage_(0) {}
 
     Arena::~Arena() {
         for (size_t i = 0; i < blocks_.size(); i++) {
             delete[] blocks_[i];
         }
+        for (auto chunk : chunks_) {
+            pool_->Free(chunk);
+        }
     }
 
     char *Arena::AllocateFallback(size_t bytes) {
-        if (bytes > kBlockSize / 4) {
+        size_t block_size = pool_ ? ArenaChunkPool::kChunkSize : kBlockSize;
+        if (bytes > block_size / 4) {
             // Object is more than a quarter of our block size.  Allocate it separately
             // to avoid wasting too much space in leftover bytes.
             char *result = AllocateNewBlock(bytes);
@@ -27,8 +149,12 @@ namespace leveldb {
         }
 
         // We waste the remaining space in the current block.
-        alloc_ptr_ = AllocateNewBlock(kBlockSize);
-        alloc_bytes_remaining_ = kBlockSize;
+        if (pool_) {
+            alloc_ptr_ = AllocateNewChunk();
+        } else {
+            alloc_ptr_ = AllocateNewBlock(kBlockSize);
+        }
+        alloc_bytes_remaining_ = block_size;
 
         char *result = alloc_ptr_;
         alloc_ptr_ += bytes;
@@ -64,4 +190,14 @@ namespace leveldb {
         return result;
     }
 
+    char *Arena::AllocateNewChunk() {
+        char *result = pool_->Allocate();
+        if (result == nullptr) {
+            return AllocateNewBlock(ArenaChunkPool::kChunkSize);
+        }
+        chunks_.push_back(result);
+        memory_usage_ += (ArenaChunkPool::kChunkSize + sizeof(char *));
+        return result;
+    }
+
 }  // namespace leveldb
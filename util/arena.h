@@ -9,13 +9,57 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace leveldb {
 
+    // A process-wide pool of chunks for memtable arenas. A chunk is backed
+    // by huge pages when the kernel has them and is pre-faulted. A freed
+    // chunk goes back to the free list of the NUMA node that faulted it
+    // in, so that an arena reuses chunks that are local to its thread.
+    class ArenaChunkPool {
+    public:
+        static const size_t kChunkSize = 2 * 1024 * 1024;
+
+        // Keep at most max_pooled_bytes of free chunks. Unmap the rest.
+        explicit ArenaChunkPool(uint64_t max_pooled_bytes);
+
+        // Return nullptr if it fails to map a chunk.
+        char *Allocate();
+
+        void Free(char *chunk);
+
+        std::string Stats();
+
+        // Bytes of chunks in use or in the pool.
+        uint64_t MappedBytes();
+
+        // nullptr if memtable arenas allocate from the heap.
+        static ArenaChunkPool *pool;
+
+    private:
+        char *MapChunk(bool *huge_pages);
+
+        static uint32_t CurrentNode();
+
+        const uint64_t max_pooled_chunks_;
+        std::mutex mutex_;
+        std::vector<std::vector<char *>> free_chunks_;
+        // The NUMA node of each mapped chunk.
+        std::unordered_map<char *, uint32_t> chunk_nodes_;
+        uint64_t npooled_chunks_ = 0;
+        uint64_t nhuge_chunks_ = 0;
+        uint64_t nreused_chunks_ = 0;
+    };
+
     class Arena {
     public:
-        Arena();
+        // Allocate blocks from pool if it is not nullptr. Otherwise,
+        // allocate them from the heap.
+        explicit Arena(ArenaChunkPool *pool = nullptr);
 
         Arena(const Arena &) = delete;
 
@@ -40,6 +84,13 @@ namespace leveldb {
 
         char *AllocateNewBlock(size_t block_bytes);
 
+        char *AllocateNewChunk();
+
+        ArenaChunkPool *const pool_;
+
+        // Chunks allocated from pool_.
+        std::vector<char *> chunks_;
+
         // Allocation state
         char *alloc_ptr_ = nullptr;
         size_t alloc_bytes_remaining_ = 0;
@@ -0,0 +1,175 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "leveldb/filter_policy.h"
+
+#include <algorithm>
+
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "util/hash.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define NOVA_HAVE_AVX2_PROBE 1
+#endif
+
+namespace leveldb {
+
+    namespace {
+        // A blocked bloom filter places all probes of a key in one 64-byte
+        // cache line. A lookup costs at most one cache miss instead of k.
+        //
+        // Format: [cache lines: num_lines * 64 bytes]
+        //         [num_lines: fixed32] [k: 1 byte]
+        const uint32_t kCacheLineBytes = 64;
+        const uint32_t kCacheLineBits = kCacheLineBytes * 8;
+        const uint32_t kMaxProbes = 16;
+
+        uint32_t BlockedBloomHash(const Slice &key) {
+            return Hash(key.data(), key.size(), 0x6a09e667);
+        }
+
+        // Map h uniformly to [0, n).
+        uint32_t FastRange32(uint32_t h, uint32_t n) {
+            return static_cast<uint32_t>(
+                    (static_cast<uint64_t>(h) * static_cast<uint64_t>(n)) >> 32);
+        }
+
+        // The i-th probe of a key is the top 9 bits of a + i * b.
+        inline uint32_t ProbeDelta(uint32_t a) {
+            return ((a >> 16) | (a << 16)) | 1;
+        }
+
+        inline uint32_t ProbeBit(uint32_t a, uint32_t b, uint32_t i) {
+            return (a + i * b) >> 23;
+        }
+
+        bool ProbeLine(const char *line, uint32_t a, uint32_t k) {
+            const uint32_t b = ProbeDelta(a);
+            for (uint32_t i = 0; i < k; i++) {
+                const uint32_t bitpos = ProbeBit(a, b, i);
+                if ((line[bitpos / 8] & (1 << (bitpos % 8))) == 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+#ifdef NOVA_HAVE_AVX2_PROBE
+
+        // Compute 8 probes at a time. Each probe gathers the 32-bit word that
+        // contains its bit. Bit i of a little-endian 32-bit word is bit
+        // (i % 8) of byte (i / 8), the same bit tested by ProbeLine.
+        __attribute__((target("avx2")))
+        bool ProbeLineAVX2(const char *line, uint32_t a, uint32_t k) {
+            const __m256i va = _mm256_set1_epi32(a);
+            const __m256i vb = _mm256_set1_epi32(ProbeDelta(a));
+            const __m256i vk = _mm256_set1_epi32(k);
+            const __m256i ones = _mm256_set1_epi32(1);
+            const __m256i bit_mask = _mm256_set1_epi32(31);
+            __m256i vi = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            for (uint32_t i = 0; i < k; i += 8) {
+                __m256i pos = _mm256_srli_epi32(
+                        _mm256_add_epi32(va, _mm256_mullo_epi32(vi, vb)), 23);
+                __m256i words = _mm256_i32gather_epi32(
+                        reinterpret_cast<const int *>(line),
+                        _mm256_srli_epi32(pos, 5), 4);
+                __m256i bits = _mm256_sllv_epi32(ones,
+                                                 _mm256_and_si256(pos, bit_mask));
+                // Ignore the lanes of probes beyond k.
+                __m256i active = _mm256_cmpgt_epi32(vk, vi);
+                __m256i missing = _mm256_andnot_si256(words, bits);
+                if (!_mm256_testz_si256(missing, active)) {
+                    return false;
+                }
+                vi = _mm256_add_epi32(vi, _mm256_set1_epi32(8));
+            }
+            return true;
+        }
+
+        bool HasAVX2() {
+            static const bool has_avx2 = []() {
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx2") != 0;
+            }();
+            return has_avx2;
+        }
+
+#endif
+
+        class BlockedBloomFilterPolicy : public FilterPolicy {
+        public:
+            explicit BlockedBloomFilterPolicy(int bits_per_key)
+                    : bits_per_key_(std::max(1, bits_per_key)) {
+                // 0.69 =~ ln(2).
+                k_ = static_cast<uint32_t>(bits_per_key_ * 0.69);
+                k_ = std::max(1u, std::min(kMaxProbes, k_));
+            }
+
+            const char *Name() const override {
+                return "nova.BlockedBloomFilter";
+            }
+
+            void CreateFilter(const Slice *keys, int n,
+                              std::string *dst) const override {
+                uint64_t bits = static_cast<uint64_t>(n) * bits_per_key_;
+                uint32_t num_lines = static_cast<uint32_t>(
+                        (bits + kCacheLineBits - 1) / kCacheLineBits);
+                num_lines = std::max(1u, num_lines);
+
+                const size_t init_size = dst->size();
+                dst->resize(init_size + num_lines * kCacheLineBytes, 0);
+                char *array = &(*dst)[init_size];
+                for (int i = 0; i < n; i++) {
+                    const uint32_t h = BlockedBloomHash(keys[i]);
+                    char *line = array + FastRange32(h, num_lines) * kCacheLineBytes;
+                    const uint32_t a = h * 0x9e3779b9;
+                    const uint32_t b = ProbeDelta(a);
+                    for (uint32_t j = 0; j < k_; j++) {
+                        const uint32_t bitpos = ProbeBit(a, b, j);
+                        line[bitpos / 8] |= (1 << (bitpos % 8));
+                    }
+                }
+                PutFixed32(dst, num_lines);
+                dst->push_back(static_cast<char>(k_));
+            }
+
+            bool KeyMayMatch(const Slice &key,
+                             const Slice &filter) const override {
+                const size_t len = filter.size();
+                if (len < 5) {
+                    return false;
+                }
+                const char *array = filter.data();
+                const uint32_t k = static_cast<uint8_t>(array[len - 1]);
+                const uint32_t num_lines = DecodeFixed32(array + len - 5);
+                if (k == 0 || k > kMaxProbes ||
+                    static_cast<uint64_t>(num_lines) * kCacheLineBytes + 5 != len) {
+                    // Unknown encoding. Consider it a match.
+                    return true;
+                }
+                const uint32_t h = BlockedBloomHash(key);
+                const char *line = array + FastRange32(h, num_lines) * kCacheLineBytes;
+                const uint32_t a = h * 0x9e3779b9;
+#ifdef NOVA_HAVE_AVX2_PROBE
+                if (HasAVX2()) {
+                    return ProbeLineAVX2(line, a, k);
+                }
+#endif
+                return ProbeLine(line, a, k);
+            }
+
+        private:
+            uint32_t bits_per_key_;
+            uint32_t k_;
+        };
+    }  // namespace
+
+    const FilterPolicy *NewBlockedBloomFilterPolicy(int bits_per_key) {
+        return new BlockedBloomFilterPolicy(bits_per_key);
+    }
+}
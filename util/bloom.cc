@@ -4,6 +4,9 @@
 
 #include "leveldb/filter_policy.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "leveldb/slice.h"
 #include "util/hash.h"
 
@@ -97,4 +100,28 @@ namespace leveldb {
         return new BloomFilterPolicy(bits_per_key);
     }
 
+    void MonkeyBitsPerKey(int num_levels, double bits_per_key,
+                          double level_size_multiplier,
+                          std::vector<double> *level_bits_per_key) {
+        // The false positive rate of level i is proportional to its number of
+        // keys N_i. It gives bits_i = bits_per_key + (H - ln(N_i)) / ln(2)^2
+        // where H is the average of ln(N_j) weighted by N_j.
+        const double ln2_squared = std::log(2) * std::log(2);
+        double total = 0;
+        double weighted_log = 0;
+        double size = 1;
+        for (int level = 0; level < num_levels; level++) {
+            total += size;
+            weighted_log += size * std::log(size);
+            size *= level_size_multiplier;
+        }
+        size = 1;
+        for (int level = 0; level < num_levels; level++) {
+            double bits = bits_per_key +
+                          (weighted_log / total - std::log(size)) / ln2_squared;
+            level_bits_per_key->push_back(std::max(1.0, bits));
+            size *= level_size_multiplier;
+        }
+    }
+
 }  // namespace leveldb
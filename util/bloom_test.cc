@@ -154,6 +154,124 @@ namespace leveldb {
 
 // Different bits-per-byte
 
+    TEST(BloomTest, MonkeyAllocation) {
+        std::vector<double> level_bits_per_key;
+        MonkeyBitsPerKey(3, 10, 3.2, &level_bits_per_key);
+        ASSERT_EQ(level_bits_per_key.size(), 3);
+        std::vector<const FilterPolicy *> policies;
+        for (double bits_per_key : level_bits_per_key) {
+            policies.push_back(NewBloomFilterPolicy(std::lround(bits_per_key)));
+        }
+
+        std::vector<std::string> keys;
+        std::vector<Slice> key_slices;
+        char buffer[sizeof(int)];
+        for (int i = 0; i < 10000; i++) {
+            keys.push_back(Key(i, buffer).ToString());
+        }
+        for (size_t i = 0; i < keys.size(); i++) {
+            key_slices.push_back(Slice(keys[i]));
+        }
+        std::vector<std::string> filters;
+        double weighted_bits = 0;
+        double total = 0;
+        double size = 1;
+        for (int level = 0; level < policies.size(); level++) {
+            std::string filter;
+            policies[level]->CreateFilter(&key_slices[0],
+                                          static_cast<int>(key_slices.size()),
+                                          &filter);
+            filters.push_back(filter);
+            weighted_bits += size * (filter.size() - 1) * 8.0 / keys.size();
+            total += size;
+            size *= 3.2;
+        }
+        // Upper levels have more bits per key.
+        ASSERT_GT(filters[0].size(), filters[1].size());
+        ASSERT_GT(filters[1].size(), filters[2].size());
+        // The average stays close to the budget.
+        ASSERT_LE(weighted_bits / total, 10.5);
+        ASSERT_GE(weighted_bits / total, 9.5);
+
+        // A filter built by one level is readable by the policy of another.
+        for (size_t i = 0; i < key_slices.size(); i++) {
+            ASSERT_TRUE(policies[2]->KeyMayMatch(key_slices[i], filters[0]));
+            ASSERT_TRUE(policies[0]->KeyMayMatch(key_slices[i], filters[2]));
+        }
+        for (auto policy : policies) {
+            delete policy;
+        }
+    }
+
+    static void CheckFilterPolicy(const FilterPolicy *policy,
+                                  double max_false_positive_rate) {
+        char buffer[sizeof(int)];
+        for (int length = 1; length <= 100000; length *= 10) {
+            std::vector<std::string> keys;
+            std::vector<Slice> key_slices;
+            for (int i = 0; i < length; i++) {
+                keys.push_back(Key(i, buffer).ToString());
+            }
+            for (int i = 0; i < length; i++) {
+                key_slices.push_back(Slice(keys[i]));
+            }
+            std::string filter;
+            policy->CreateFilter(&key_slices[0], length, &filter);
+            for (int i = 0; i < length; i++) {
+                ASSERT_TRUE(policy->KeyMayMatch(key_slices[i], filter))
+                    << "Length " << length << "; key " << i;
+            }
+            int false_positives = 0;
+            for (int i = 0; i < 10000; i++) {
+                if (policy->KeyMayMatch(Key(i + 1000000000, buffer), filter)) {
+                    false_positives++;
+                }
+            }
+            double rate = false_positives / 10000.0;
+            if (kVerbose >= 1) {
+                fprintf(stderr,
+                        "%s: False positives: %5.2f%% @ length = %6d ; bits per key = %5.2f\n",
+                        policy->Name(), rate * 100.0, length,
+                        filter.size() * 8.0 / length);
+            }
+            if (length >= 1000) {
+                ASSERT_LE(rate, max_false_positive_rate);
+            }
+        }
+    }
+
+    TEST(BloomTest, BlockedBloom) {
+        const FilterPolicy *policy = NewBlockedBloomFilterPolicy(10);
+        CheckFilterPolicy(policy, 0.02);
+        ASSERT_TRUE(!policy->KeyMayMatch("hello", ""));
+        delete policy;
+    }
+
+    TEST(BloomTest, Ribbon) {
+        const FilterPolicy *policy = NewRibbonFilterPolicy(10);
+        CheckFilterPolicy(policy, 0.02);
+
+        // Ribbon uses less memory than bloom with a similar false positive
+        // rate.
+        std::vector<std::string> keys;
+        std::vector<Slice> key_slices;
+        char buffer[sizeof(int)];
+        for (int i = 0; i < 100000; i++) {
+            keys.push_back(Key(i, buffer).ToString());
+        }
+        for (size_t i = 0; i < keys.size(); i++) {
+            key_slices.push_back(Slice(keys[i]));
+        }
+        const FilterPolicy *bloom = NewBloomFilterPolicy(10);
+        std::string ribbon_filter;
+        std::string bloom_filter;
+        policy->CreateFilter(&key_slices[0], keys.size(), &ribbon_filter);
+        bloom->CreateFilter(&key_slices[0], keys.size(), &bloom_filter);
+        ASSERT_LE(ribbon_filter.size(), bloom_filter.size() * 0.8);
+        delete bloom;
+        delete policy;
+    }
+
 }  // namespace leveldb
 
 nova::NovaGlobalVariables nova::NovaGlobalVariables::global;
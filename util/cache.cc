@@ -164,6 +164,10 @@ namespace leveldb {
                 return capacity_;
             }
 
+            // Change the capacity at runtime and evict entries that are
+            // not in use until the shard fits.
+            void Resize(size_t capacity);
+
             // Like Cache methods, but with an extra "hash" parameter.
             Cache::Handle *Insert(const Slice &key, uint32_t hash, void *value,
                                   size_t charge,
@@ -178,6 +182,9 @@ namespace leveldb {
 
             void Prune();
 
+            void ApplyToRecentEntries(void (*fn)(void *arg, const Slice &key, void *value, uint32_t rank),
+                                      void *arg);
+
             size_t TotalCharge() const {
                 MutexLock l(&mutex_);
                 return usage_;
@@ -324,6 +331,19 @@ namespace leveldb {
             return reinterpret_cast<Cache::Handle *>(e);
         }
 
+        void LRUCache::Resize(size_t capacity) {
+            MutexLock l(&mutex_);
+            capacity_ = capacity;
+            while (usage_ > capacity_ && lru_.next != &lru_) {
+                LRUHandle *old = lru_.next;
+                assert(old->refs == 1);
+                bool erased = FinishErase(table_.Remove(old->key(), old->hash));
+                if (!erased) {  // to avoid unused variable when compiled NDEBUG
+                    assert(erased);
+                }
+            }
+        }
+
 // If e != nullptr, finish removing *e from the cache; it has already been
 // removed from the hash table.  Return whether e != nullptr.
         bool LRUCache::FinishErase(LRUHandle *e) {
@@ -354,12 +374,26 @@ namespace leveldb {
             }
         }
 
+        void LRUCache::ApplyToRecentEntries(void (*fn)(void *arg, const Slice &key, void *value, uint32_t rank),
+                                            void *arg) {
+            MutexLock l(&mutex_);
+            uint32_t rank = 0;
+            // Entries in use are more recent than the entries in lru_.
+            for (LRUHandle *e = in_use_.prev; e != &in_use_; e = e->prev) {
+                (*fn)(arg, e->key(), e->value, rank++);
+            }
+            for (LRUHandle *e = lru_.prev; e != &lru_; e = e->prev) {
+                (*fn)(arg, e->key(), e->value, rank++);
+            }
+        }
+
         static const int kNumShardBits = 8;
-        static const int kNumShards = 1 << kNumShardBits;
 
         class ShardedLRUCache : public Cache {
         private:
-            LRUCache shard_[kNumShards];
+            const int num_shard_bits_;
+            const int num_shards_;
+            LRUCache *shard_;
             port::Mutex id_mutex_;
             uint64_t last_id_;
 
@@ -367,20 +401,26 @@ namespace leveldb {
                 return Hash(s.data(), s.size(), 0);
             }
 
-            static uint32_t Shard(uint32_t hash) {
-                return hash >> (32 - kNumShardBits);
+            uint32_t Shard(uint32_t hash) const {
+                return num_shard_bits_ == 0 ? 0 : hash >> (32 - num_shard_bits_);
             }
 
         public:
-            explicit ShardedLRUCache(size_t capacity) : last_id_(0) {
+            ShardedLRUCache(size_t capacity, int num_shard_bits)
+                    : num_shard_bits_(num_shard_bits),
+                      num_shards_(1 << num_shard_bits),
+                      shard_(new LRUCache[1 << num_shard_bits]),
+                      last_id_(0) {
                 const size_t per_shard =
-                        (capacity + (kNumShards - 1)) / kNumShards;
-                for (int s = 0; s < kNumShards; s++) {
+                        (capacity + (num_shards_ - 1)) / num_shards_;
+                for (int s = 0; s < num_shards_; s++) {
                     shard_[s].SetCapacity(per_shard);
                 }
             }
 
-            ~ShardedLRUCache() override {}
+            ~ShardedLRUCache() override {
+                delete[] shard_;
+            }
 
             Handle *Insert(const Slice &key, void *value, size_t charge,
                            void (*deleter)(const Slice &key,
@@ -415,14 +455,29 @@ namespace leveldb {
             }
 
             void Prune() override {
-                for (int s = 0; s < kNumShards; s++) {
+                for (int s = 0; s < num_shards_; s++) {
                     shard_[s].Prune();
                 }
             }
 
+            void ApplyToRecentEntries(void (*fn)(void *arg, const Slice &key, void *value, uint32_t rank),
+                                      void *arg) override {
+                for (int s = 0; s < num_shards_; s++) {
+                    shard_[s].ApplyToRecentEntries(fn, arg);
+                }
+            }
+
+            void SetCapacity(size_t capacity) override {
+                const size_t per_shard =
+                        (capacity + (num_shards_ - 1)) / num_shards_;
+                for (int s = 0; s < num_shards_; s++) {
+                    shard_[s].Resize(per_shard);
+                }
+            }
+
             size_t TotalCharge() const override {
                 size_t total = 0;
-                for (int s = 0; s < kNumShards; s++) {
+                for (int s = 0; s < num_shards_; s++) {
                     total += shard_[s].TotalCharge();
                 }
                 return total;
@@ -430,7 +485,7 @@ namespace leveldb {
 
             size_t TotalCapacity() const override {
                 size_t total = 0;
-                for (int s = 0; s < kNumShards; s++) {
+                for (int s = 0; s < num_shards_; s++) {
                     total += shard_[s].GetCapacity();
                 }
                 return total;
@@ -440,7 +495,12 @@ namespace leveldb {
     }  // end anonymous namespace
 
     Cache *NewLRUCache(size_t capacity) {
-        return new ShardedLRUCache(capacity);
+        return new ShardedLRUCache(capacity, kNumShardBits);
+    }
+
+    Cache *NewLRUCache(size_t capacity, int num_shard_bits) {
+        assert(num_shard_bits >= 0 && num_shard_bits <= 16);
+        return new ShardedLRUCache(capacity, num_shard_bits);
     }
 
 }  // namespace leveldb
@@ -4,6 +4,7 @@
 
 #include "leveldb/cache.h"
 
+#include <map>
 #include <vector>
 #include "util/coding.h"
 #include "util/testharness.h"
@@ -35,11 +36,14 @@ namespace leveldb {
         }
 
         static const int kCacheSize = 1000;
+        // The eviction tests need enough entries per shard. The caches of
+        // NovaLSM have 256 shards.
+        static const int kNumShardBits = 4;
         std::vector<int> deleted_keys_;
         std::vector<int> deleted_values_;
         Cache *cache_;
 
-        CacheTest() : cache_(NewLRUCache(kCacheSize)) { current_ = this; }
+        CacheTest() : cache_(NewLRUCache(kCacheSize, kNumShardBits)) { current_ = this; }
 
         ~CacheTest() { delete cache_; }
 
@@ -221,6 +225,54 @@ namespace leveldb {
         ASSERT_EQ(-1, Lookup(2));
     }
 
+    TEST(CacheTest, SetCapacity) {
+        Cache::Handle *handle = InsertAndReturnHandle(0, 100);
+        for (int i = 1; i < kCacheSize; i++) {
+            Insert(i, 1000 + i);
+        }
+        cache_->SetCapacity(kCacheSize / 10);
+        ASSERT_LE(cache_->TotalCharge(), cache_->TotalCapacity() + 1);
+        ASSERT_EQ(-1, Lookup(1));
+        ASSERT_EQ(1000 + kCacheSize - 1, Lookup(kCacheSize - 1));
+
+        // An entry in use survives the resize.
+        ASSERT_EQ(100, DecodeValue(cache_->Value(handle)));
+        cache_->Release(handle);
+
+        cache_->SetCapacity(kCacheSize);
+        for (int i = 0; i < kCacheSize / 2; i++) {
+            Insert(kCacheSize + i, i);
+        }
+        ASSERT_EQ(1000 + kCacheSize - 1, Lookup(kCacheSize - 1));
+    }
+
+    static void CollectEntry(void *arg, const Slice &key, void *value, uint32_t rank) {
+        auto entries = reinterpret_cast<std::map<int, std::pair<int, uint32_t>> *>(arg);
+        (*entries)[DecodeKey(key)] = std::make_pair(DecodeValue(value), rank);
+    }
+
+    TEST(CacheTest, ApplyToRecentEntries) {
+        for (int i = 0; i < 100; i++) {
+            Insert(i, 1000 + i);
+        }
+        Erase(50);
+        Cache::Handle *handle = InsertAndReturnHandle(200, 300);
+
+        std::map<int, std::pair<int, uint32_t>> entries;
+        cache_->ApplyToRecentEntries(&CollectEntry, &entries);
+        ASSERT_EQ(100, entries.size());
+        ASSERT_TRUE(entries.find(50) == entries.end());
+        for (int i = 0; i < 100; i++) {
+            if (i != 50) {
+                ASSERT_EQ(1000 + i, entries[i].first);
+            }
+        }
+        // An entry in use is the most recent one of its shard.
+        ASSERT_EQ(300, entries[200].first);
+        ASSERT_EQ(0, entries[200].second);
+        cache_->Release(handle);
+    }
+
     TEST(CacheTest, ZeroSizeCache) {
         delete cache_;
         cache_ = NewLRUCache(0);
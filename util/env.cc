@@ -19,6 +19,20 @@ namespace leveldb {
 
     WritableFile::~WritableFile() = default;
 
+    Status ReadWriteFile::AppendBatch(const std::vector<Slice> &data) {
+        for (const auto &slice : data) {
+            Status s = Append(slice);
+            if (!s.ok()) {
+                return s;
+            }
+        }
+        return Status::OK();
+    }
+
+    Status ReadWriteFile::PunchHole(uint64_t offset, uint64_t size) {
+        return Status::NotSupported("PunchHole");
+    }
+
     Logger::~Logger() = default;
 
     FileLock::~FileLock() = default;
@@ -205,6 +205,57 @@ namespace leveldb {
         return WriteUnbuffered(write_data, write_size);
     }
 
+    Status PosixReadWriteFile::AppendBatch(const std::vector<Slice> &data) {
+        std::vector<struct iovec> iovs;
+        for (const auto &slice : data) {
+            if (slice.empty()) {
+                continue;
+            }
+            struct iovec iov = {};
+            iov.iov_base = const_cast<char *>(slice.data());
+            iov.iov_len = slice.size();
+            iovs.push_back(iov);
+        }
+        size_t i = 0;
+        while (i < iovs.size()) {
+            int n = static_cast<int>(std::min<size_t>(iovs.size() - i, IOV_MAX));
+            ssize_t write_result = ::writev(fd_, &iovs[i], n);
+            if (write_result < 0) {
+                if (errno == EINTR) {
+                    continue;  // Retry
+                }
+                return PosixError(filename_, errno);
+            }
+            // Skip the written slices. Resume from the middle of a partially
+            // written slice.
+            size_t written = write_result;
+            while (written > 0) {
+                if (written >= iovs[i].iov_len) {
+                    written -= iovs[i].iov_len;
+                    i++;
+                } else {
+                    iovs[i].iov_base = static_cast<char *>(iovs[i].iov_base) + written;
+                    iovs[i].iov_len -= written;
+                    written = 0;
+                }
+            }
+        }
+        return Status::OK();
+    }
+
+    Status PosixReadWriteFile::PunchHole(uint64_t offset, uint64_t size) {
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(FALLOC_FL_KEEP_SIZE)
+        if (::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                        static_cast<off_t>(offset),
+                        static_cast<off_t>(size)) == 0) {
+            return Status::OK();
+        }
+        return PosixError(filename_, errno);
+#else
+        return Status::NotSupported("PunchHole", filename_);
+#endif
+    }
+
     Status PosixReadWriteFile::Close() {
         Status status;
         const int close_result = ::close(fd_);
@@ -15,9 +15,12 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <limits.h>
 #include <unistd.h>
 #include <list>
 
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
 #include <cstddef>
@@ -164,6 +167,11 @@ namespace leveldb {
 
         Status Append(const Slice &data) override;
 
+        // Write the slices with as few writev calls as possible.
+        Status AppendBatch(const std::vector<Slice> &data) override;
+
+        Status PunchHole(uint64_t offset, uint64_t size) override;
+
         Status Close() override;
 
         Status Flush() override;
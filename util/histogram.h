@@ -23,17 +23,21 @@ namespace leveldb {
 
         std::string ToString() const;
 
-    private:
-        enum {
-            kNumBuckets = 154
-        };
-
         double Median() const;
 
         double Percentile(double p) const;
 
         double Average() const;
 
+        double num() const {
+            return num_;
+        }
+
+    private:
+        enum {
+            kNumBuckets = 154
+        };
+
         double StandardDeviation() const;
 
         static const double kBucketLimit[kNumBuckets];
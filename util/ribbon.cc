@@ -0,0 +1,224 @@
+
+//
+// Created by Haoyu Huang on 10/19/20.
+// Copyright (c) 2020 University of Southern California. All rights reserved.
+//
+
+#include "leveldb/filter_policy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+    namespace {
+        // A standard ribbon filter (Dillinger and Walzer, 2021) with 64-bit
+        // coefficient rows. Each key maps to a start slot s, a 64-bit
+        // coefficient row c and an r-bit fingerprint f. Construction solves
+        // the linear system over GF(2) such that the XOR of the solution rows
+        // s + i with bit i of c set equals f for every key. A lookup of a
+        // missing key matches with probability 2^-r. The filter uses about
+        // r * 1.1 bits per key while a bloom filter with the same false
+        // positive rate uses r * 1.44 bits per key.
+        //
+        // The solution is stored column-major per 64 slots so that a lookup
+        // reads r words from two adjacent segments.
+        //
+        // Format: [segments: num_segments * r * 8 bytes]
+        //         [num_segments: fixed32] [seed: 1 byte] [r: 1 byte]
+        // r == 0 means the filter matches all keys.
+        const uint32_t kCoeffBits = 64;
+        const uint32_t kMaxResultBits = 32;
+        const uint32_t kMaxSeeds = 32;
+
+        struct RibbonHash {
+            uint32_t start;
+            uint64_t coeff;
+            uint32_t result;
+        };
+
+        inline RibbonHash GetRibbonHash(const Slice &key, uint32_t seed,
+                                        uint32_t num_starts,
+                                        uint32_t result_bits) {
+            const uint64_t h =
+                    (static_cast<uint64_t>(Hash(key.data(), key.size(), 0x510e527f + seed)) << 32) |
+                    Hash(key.data(), key.size(), 0x9b05688c + seed);
+            RibbonHash rh;
+            rh.start = static_cast<uint32_t>(
+                    ((h >> 32) * static_cast<uint64_t>(num_starts)) >> 32);
+            // The first coefficient is always 1.
+            rh.coeff = (h * 0x9e3779b97f4a7c15ull) | 1;
+            uint32_t fingerprint = static_cast<uint32_t>(
+                    (h * 0xc2b2ae3d27d4eb4full) >> 32);
+            if (result_bits < kMaxResultBits) {
+                fingerprint &= (1u << result_bits) - 1;
+            }
+            rh.result = fingerprint;
+            return rh;
+        }
+
+        inline uint32_t Parity64(uint64_t v) {
+            return static_cast<uint32_t>(__builtin_parityll(v));
+        }
+
+        inline uint64_t LoadWord(const char *p) {
+            return DecodeFixed64(p);
+        }
+
+        class RibbonFilterPolicy : public FilterPolicy {
+        public:
+            explicit RibbonFilterPolicy(double bloom_equivalent_bits_per_key) {
+                // A bloom filter with b bits per key has a false positive rate
+                // of 0.6185^b = 2^(-0.693 * b).
+                double r = std::round(bloom_equivalent_bits_per_key * 0.693);
+                result_bits_ = static_cast<uint32_t>(
+                        std::max(1.0, std::min<double>(kMaxResultBits, r)));
+            }
+
+            const char *Name() const override {
+                return "nova.RibbonFilter";
+            }
+
+            void CreateFilter(const Slice *keys, int n,
+                              std::string *dst) const override {
+                // Slots needed for a high probability of success grow
+                // slightly with r.
+                double overhead = 1.0 + (4.0 + result_bits_ / 4.0) / kCoeffBits;
+                uint32_t num_slots = static_cast<uint32_t>(n * overhead) + kCoeffBits;
+                for (uint32_t seed = 0; seed < kMaxSeeds; seed++) {
+                    uint32_t num_segments = std::max(2u, (num_slots + kCoeffBits - 1) / kCoeffBits);
+                    if (Build(keys, n, seed, num_segments, dst)) {
+                        return;
+                    }
+                    // Retry with a different seed and more slots.
+                    num_slots += num_slots / 16 + 1;
+                }
+                // Fall back to a filter that matches all keys.
+                PutFixed32(dst, 0);
+                dst->push_back(0);
+                dst->push_back(0);
+            }
+
+            bool KeyMayMatch(const Slice &key,
+                             const Slice &filter) const override {
+                const size_t len = filter.size();
+                if (len < 6) {
+                    return false;
+                }
+                const char *data = filter.data();
+                const uint32_t r = static_cast<uint8_t>(data[len - 1]);
+                const uint32_t seed = static_cast<uint8_t>(data[len - 2]);
+                const uint32_t num_segments = DecodeFixed32(data + len - 6);
+                if (r == 0 || r > kMaxResultBits || num_segments < 2 ||
+                    static_cast<uint64_t>(num_segments) * r * 8 + 6 != len) {
+                    return true;
+                }
+                const uint32_t num_starts = (num_segments - 1) * kCoeffBits + 1;
+                RibbonHash rh = GetRibbonHash(key, seed, num_starts, r);
+                const uint32_t segment = rh.start / kCoeffBits;
+                const uint32_t offset = rh.start % kCoeffBits;
+                const char *lo = data + segment * r * 8;
+                const char *hi = lo + r * 8;
+                uint32_t result = 0;
+                if (offset == 0) {
+                    for (uint32_t j = 0; j < r; j++) {
+                        result |= Parity64(LoadWord(lo + j * 8) & rh.coeff) << j;
+                    }
+                } else {
+                    const uint64_t lo_coeff = rh.coeff << offset;
+                    const uint64_t hi_coeff = rh.coeff >> (kCoeffBits - offset);
+                    for (uint32_t j = 0; j < r; j++) {
+                        uint64_t v = (LoadWord(lo + j * 8) & lo_coeff) ^
+                                     (LoadWord(hi + j * 8) & hi_coeff);
+                        result |= Parity64(v) << j;
+                    }
+                }
+                return result == rh.result;
+            }
+
+        private:
+            // Return false if the keys cannot be banded with this seed.
+            bool Build(const Slice *keys, int n, uint32_t seed,
+                       uint32_t num_segments, std::string *dst) const {
+                const uint32_t r = result_bits_;
+                const uint32_t num_slots = num_segments * kCoeffBits;
+                // The last start leaves room for a full coefficient row.
+                const uint32_t num_starts = num_slots - kCoeffBits + 1;
+                std::vector<uint64_t> coeffs(num_slots, 0);
+                std::vector<uint32_t> results(num_slots, 0);
+
+                // Banding. Gaussian elimination on the fly.
+                for (int i = 0; i < n; i++) {
+                    RibbonHash rh = GetRibbonHash(keys[i], seed, num_starts, r);
+                    uint32_t start = rh.start;
+                    uint64_t coeff = rh.coeff;
+                    uint32_t result = rh.result;
+                    while (true) {
+                        if (coeffs[start] == 0) {
+                            coeffs[start] = coeff;
+                            results[start] = result;
+                            break;
+                        }
+                        coeff ^= coeffs[start];
+                        result ^= results[start];
+                        if (coeff == 0) {
+                            if (result != 0) {
+                                // Inconsistent equations.
+                                return false;
+                            }
+                            // Duplicate key.
+                            break;
+                        }
+                        uint32_t tz = __builtin_ctzll(coeff);
+                        start += tz;
+                        coeff >>= tz;
+                    }
+                }
+
+                // Back substitution. Free slots are 0.
+                std::vector<uint32_t> solution(num_slots, 0);
+                for (int64_t slot = static_cast<int64_t>(num_slots) - 1; slot >= 0; slot--) {
+                    uint64_t coeff = coeffs[slot];
+                    if (coeff == 0) {
+                        continue;
+                    }
+                    uint32_t value = results[slot];
+                    coeff &= ~1ull;
+                    while (coeff != 0) {
+                        uint32_t bit = __builtin_ctzll(coeff);
+                        value ^= solution[slot + bit];
+                        coeff &= coeff - 1;
+                    }
+                    solution[slot] = value;
+                }
+
+                // Store the solution column-major per segment.
+                for (uint32_t segment = 0; segment < num_segments; segment++) {
+                    for (uint32_t j = 0; j < r; j++) {
+                        uint64_t column = 0;
+                        for (uint32_t i = 0; i < kCoeffBits; i++) {
+                            column |= static_cast<uint64_t>(
+                                              (solution[segment * kCoeffBits + i] >> j) & 1) << i;
+                        }
+                        PutFixed64(dst, column);
+                    }
+                }
+                PutFixed32(dst, num_segments);
+                dst->push_back(static_cast<char>(seed));
+                dst->push_back(static_cast<char>(r));
+                return true;
+            }
+
+            uint32_t result_bits_;
+        };
+    }  // namespace
+
+    const FilterPolicy *NewRibbonFilterPolicy(double bloom_equivalent_bits_per_key) {
+        return new RibbonFilterPolicy(bloom_equivalent_bits_per_key);
+    }
+}